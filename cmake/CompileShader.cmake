@@ -0,0 +1,28 @@
+# Compiles one GLSL shader to SPIR-V, run as a script by the HybridRendering_Shaders target:
+#
+# cmake -DGLSL_VALIDATOR=<path> -DSPIRV_OPT=<path> -DCONFIG=<config> -DINPUT=<shader> -DOUTPUT=<spirv> -P CompileShader.cmake
+#
+# Debug builds keep the debug info for graphics debuggers. Every other configuration drops it and runs the spirv-opt
+# performance passes, if spirv-opt was found.
+
+if(CONFIG STREQUAL "Debug")
+    set(GLSL_FLAGS -g)
+endif()
+
+execute_process(COMMAND ${GLSL_VALIDATOR} --target-env vulkan1.3 ${GLSL_FLAGS} -V ${INPUT} -o ${OUTPUT}
+                RESULT_VARIABLE RESULT)
+
+if(NOT RESULT EQUAL 0)
+    file(REMOVE ${OUTPUT})
+    message(FATAL_ERROR "Failed to compile shader: ${INPUT}")
+endif()
+
+if(NOT CONFIG STREQUAL "Debug" AND SPIRV_OPT)
+    execute_process(COMMAND ${SPIRV_OPT} --target-env=vulkan1.3 -O --strip-debug ${OUTPUT} -o ${OUTPUT}
+                    RESULT_VARIABLE RESULT)
+
+    if(NOT RESULT EQUAL 0)
+        file(REMOVE ${OUTPUT})
+        message(FATAL_ERROR "Failed to optimize shader: ${INPUT}")
+    endif()
+endif()
@@ -0,0 +1,30 @@
+# Writes the SPIR-V of every shader into a C++ source file, run as a script by the HybridRendering_Shaders target:
+#
+# cmake -DSPIRV_DIR=<directory> -DOUTPUT=<source> -P EmbedShaders.cmake
+#
+# Shaders are looked up by the same relative path the executable would otherwise load them from.
+
+file(GLOB SPIRV_FILES RELATIVE ${SPIRV_DIR} ${SPIRV_DIR}/*.spv)
+list(SORT SPIRV_FILES)
+
+set(CONTENTS "// Generated by cmake/EmbedShaders.cmake, do not edit.\n\n#include \"shader_library.h\"\n\n")
+set(TABLE "")
+set(INDEX 0)
+
+foreach(FILE_NAME ${SPIRV_FILES})
+    file(READ "${SPIRV_DIR}/${FILE_NAME}" HEX HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n    " BYTES "${BYTES}")
+    string(REGEX REPLACE "\n    $" "" BYTES "${BYTES}")
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR SIZE "${HEX_LENGTH} / 2")
+
+    string(APPEND CONTENTS "alignas(4) static const uint8_t kShader${INDEX}[] = {\n    ${BYTES}\n};\n\n")
+    string(APPEND TABLE "    { \"shaders/${FILE_NAME}\", kShader${INDEX}, ${SIZE} },\n")
+
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+string(APPEND CONTENTS "const EmbeddedShader kEmbeddedShaders[] = {\n${TABLE}};\n\nconst size_t kNumEmbeddedShaders = ${INDEX};\n")
+
+file(WRITE ${OUTPUT} "${CONTENTS}")
@@ -0,0 +1,195 @@
+#include "asset_loader.h"
+#include "utility.h"
+#include <logger.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Decoded images are uploaded in batches no larger than this, so the staging memory stays bounded.
+static const size_t kStagingBudget = 256 * 1024 * 1024;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string format_milliseconds(double value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f ms", value);
+
+    return buffer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AssetLoader::AssetLoader(dw::vk::Backend::Ptr backend) :
+    m_backend(backend)
+{
+    m_thread_pool = std::unique_ptr<ThreadPool>(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AssetLoader::~AssetLoader()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AssetLoader::load_image(const std::string& path, bool flip_vertical, LoadedFunc loaded)
+{
+    ImageRequest request;
+
+    request.path          = path;
+    request.flip_vertical = flip_vertical;
+    request.loaded        = loaded;
+
+    m_requests.push_back(request);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AssetLoader::flush()
+{
+    if (m_requests.size() == 0)
+        return;
+
+    auto backend = m_backend.lock();
+    auto start   = std::chrono::high_resolution_clock::now();
+
+    m_thread_pool->run((uint32_t)m_requests.size(), m_thread_pool->num_threads(), [this](uint32_t job_idx, uint32_t thread_idx) {
+        decode(m_requests[job_idx]);
+    });
+
+    double decode_wall_time = elapsed_milliseconds(start);
+
+    for (auto& request : m_requests)
+    {
+        if (!request.pixels)
+        {
+            for (auto& other : m_requests)
+                stbi_image_free(other.pixels);
+
+            DW_LOG_ERROR("Failed to load image: " + request.path);
+            throw std::runtime_error("Failed to load image: " + request.path);
+        }
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+
+    std::vector<dw::vk::Image::Ptr>        images(m_requests.size());
+    std::unique_ptr<dw::vk::BatchUploader> uploader;
+    size_t                                 staged_size     = 0;
+    uint32_t                               batch_begin     = 0;
+    uint32_t                               num_submissions = 0;
+
+    for (uint32_t i = 0; i <= m_requests.size(); i++)
+    {
+        // The decoded pixels of a batch are only needed until it has been submitted.
+        if (uploader && (i == m_requests.size() || staged_size + m_requests[i].size > kStagingBudget))
+        {
+            uploader->submit();
+            uploader.reset();
+
+            for (uint32_t j = batch_begin; j < i; j++)
+            {
+                stbi_image_free(m_requests[j].pixels);
+                m_requests[j].pixels = nullptr;
+            }
+
+            staged_size = 0;
+            batch_begin = i;
+            num_submissions++;
+        }
+
+        if (i == m_requests.size())
+            break;
+
+        ImageRequest& request      = m_requests[i];
+        auto          upload_start = std::chrono::high_resolution_clock::now();
+
+        if (!uploader)
+            uploader = std::unique_ptr<dw::vk::BatchUploader>(new dw::vk::BatchUploader(backend));
+
+        images[i] = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, request.width, request.height, 1, 1, 1, request.hdr ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        images[i]->set_name(request.path);
+
+        std::vector<size_t> sizes = { request.size };
+
+        uploader->upload_image_data(images[i], request.pixels, sizes);
+
+        staged_size += request.size;
+        request.upload_time = elapsed_milliseconds(upload_start);
+    }
+
+    report(decode_wall_time, elapsed_milliseconds(start), num_submissions);
+
+    std::vector<ImageRequest> requests;
+    requests.swap(m_requests);
+
+    // Callbacks are free to queue more work for the next flush.
+    for (uint32_t i = 0; i < requests.size(); i++)
+        requests[i].loaded(images[i]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AssetLoader::decode(ImageRequest& request)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int32_t channels = 0;
+
+    request.hdr = stbi_is_hdr(request.path.c_str()) != 0;
+
+    if (request.hdr)
+        request.pixels = stbi_loadf(request.path.c_str(), &request.width, &request.height, &channels, 4);
+    else
+        request.pixels = stbi_load(request.path.c_str(), &request.width, &request.height, &channels, 4);
+
+    if (request.pixels)
+    {
+        size_t row_size = size_t(request.width) * (request.hdr ? 4 * sizeof(float) : 4);
+
+        request.size = row_size * request.height;
+
+        // Flipped here rather than through stb_image, whose flip setting is shared by every thread.
+        if (request.flip_vertical)
+        {
+            uint8_t*             pixels = (uint8_t*)request.pixels;
+            std::vector<uint8_t> row(row_size);
+
+            for (int32_t y = 0; y < request.height / 2; y++)
+            {
+                uint8_t* top    = pixels + row_size * y;
+                uint8_t* bottom = pixels + row_size * (request.height - 1 - y);
+
+                memcpy(row.data(), top, row_size);
+                memcpy(top, bottom, row_size);
+                memcpy(bottom, row.data(), row_size);
+            }
+        }
+    }
+
+    request.decode_time = elapsed_milliseconds(start);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AssetLoader::report(double decode_wall_time, double upload_wall_time, uint32_t num_submissions)
+{
+    double decode_time = 0.0;
+
+    for (const auto& request : m_requests)
+        decode_time += request.decode_time;
+
+    DW_LOG_INFO("Loaded " + std::to_string(m_requests.size()) + " images, decode: " + format_milliseconds(decode_wall_time) + " (" + format_milliseconds(decode_time) + " on " + std::to_string(m_thread_pool->num_threads()) + " threads), upload: " + format_milliseconds(upload_wall_time) + " in " + std::to_string(num_submissions) + " submissions");
+
+    for (const auto& request : m_requests)
+        DW_LOG_INFO("    " + request.path + ", decode: " + format_milliseconds(request.decode_time) + ", upload: " + format_milliseconds(request.upload_time));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
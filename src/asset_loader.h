@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vk.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Loads images in batches: files are read and decoded on worker threads, then the decoded images are created and
+// uploaded from the calling thread through as few submissions as the staging budget allows. The time spent on each
+// asset is logged once the batch is done.
+class AssetLoader
+{
+public:
+    using LoadedFunc = std::function<void(dw::vk::Image::Ptr)>;
+
+public:
+    AssetLoader(dw::vk::Backend::Ptr backend);
+    ~AssetLoader();
+
+    // Queues a PNG, JPG or HDR image, HDR images are decoded to 32-bit floats. The callback runs during flush().
+    void load_image(const std::string& path, bool flip_vertical, LoadedFunc loaded);
+
+    // Decodes and uploads everything queued so far, then hands the images to their callbacks.
+    void flush();
+
+private:
+    struct ImageRequest
+    {
+        std::string path;
+        bool        flip_vertical;
+        LoadedFunc  loaded;
+        bool        hdr         = false;
+        int32_t     width       = 0;
+        int32_t     height      = 0;
+        void*       pixels      = nullptr;
+        size_t      size        = 0;
+        double      decode_time = 0.0;
+        double      upload_time = 0.0;
+    };
+
+    void decode(ImageRequest& request);
+    void report(double decode_wall_time, double upload_wall_time, uint32_t num_submissions);
+
+private:
+    std::weak_ptr<dw::vk::Backend> m_backend;
+    std::unique_ptr<ThreadPool>    m_thread_pool;
+    std::vector<ImageRequest>      m_requests;
+};
@@ -0,0 +1,198 @@
+#include "benchmark.h"
+#include <logger.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const float Benchmark::kTimestep = 1.0f / 60.0f;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    // Nearest-rank percentile.
+    size_t rank = (size_t)ceil(p * double(sorted.size()));
+
+    return sorted[std::max(rank, (size_t)1) - 1];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Benchmark::Benchmark(uint32_t warmup_frames, uint32_t measured_frames) :
+    m_warmup_frames(std::max(warmup_frames, (uint32_t)dw::vk::Backend::kMaxFramesInFlight)), m_measured_frames(std::max(measured_frames, 1u))
+{
+    for (uint32_t scene = 0; scene < SCENE_TYPE_COUNT; scene++)
+    {
+        for (uint32_t scale = RAY_TRACE_SCALE_FULL_RES; scale <= RAY_TRACE_SCALE_QUARTER_RES; scale++)
+        {
+            for (uint32_t denoise = 0; denoise < 2; denoise++)
+            {
+                BenchmarkConfiguration configuration;
+
+                configuration.scene   = (SceneType)scene;
+                configuration.scale   = (RayTraceScale)scale;
+                configuration.denoise = denoise == 1;
+
+                m_configurations.push_back(configuration);
+            }
+        }
+    }
+
+    m_samples.resize(m_configurations.size());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Benchmark::begin_frame()
+{
+    if (finished())
+        return false;
+
+    if (m_current_configuration == -1 || m_frame == m_warmup_frames + m_measured_frames)
+    {
+        m_current_configuration++;
+        m_frame = 0;
+
+        if (finished())
+            return false;
+
+        const BenchmarkConfiguration& configuration = current_configuration();
+
+        DW_LOG_INFO("Benchmark " + std::to_string(m_current_configuration + 1) + "/" + std::to_string(m_configurations.size()) + ": " + constants::scene_types[configuration.scene] + ", " + constants::ray_trace_scales[configuration.scale] + (configuration.denoise ? ", Denoised" : ""));
+
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Benchmark::end_frame(const std::vector<RenderGraph::PassTiming>& timings)
+{
+    if (finished())
+        return;
+
+    if (m_frame++ < m_warmup_frames)
+        return;
+
+    Samples& samples = m_samples[m_current_configuration];
+    double   total   = 0.0;
+
+    for (const auto& timing : timings)
+    {
+        auto it = samples.times.find(timing.name);
+
+        if (it == samples.times.end())
+        {
+            samples.names.push_back(timing.name);
+            it = samples.times.insert({ timing.name, std::vector<double>() }).first;
+        }
+
+        it->second.push_back(timing.gpu_time);
+        total += timing.gpu_time;
+    }
+
+    if (timings.size() > 0)
+    {
+        if (samples.times.find("Total") == samples.times.end())
+            samples.names.push_back("Total");
+
+        samples.times["Total"].push_back(total);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Benchmark::write_results(const std::string& path, uint32_t width, uint32_t height)
+{
+    std::ofstream json(path + ".json");
+    std::ofstream csv(path + ".csv");
+
+    if (!json.is_open() || !csv.is_open())
+    {
+        DW_LOG_ERROR("Failed to open benchmark output: " + path);
+        return false;
+    }
+
+    json << std::fixed << std::setprecision(4);
+    csv << std::fixed << std::setprecision(4);
+
+    json << "{\n";
+    json << "    \"width\": " << width << ",\n";
+    json << "    \"height\": " << height << ",\n";
+    json << "    \"warmup_frames\": " << m_warmup_frames << ",\n";
+    json << "    \"measured_frames\": " << m_measured_frames << ",\n";
+    json << "    \"configurations\": [\n";
+
+    csv << "scene,scale,denoise,pass,mean_ms,p50_ms,p95_ms,p99_ms\n";
+
+    for (uint32_t i = 0; i < m_configurations.size(); i++)
+    {
+        const BenchmarkConfiguration& configuration = m_configurations[i];
+        const std::string&            scene         = constants::scene_types[configuration.scene];
+        const std::string&            scale         = constants::ray_trace_scales[configuration.scale];
+        const char*                   denoise       = configuration.denoise ? "true" : "false";
+
+        json << "        {\n";
+        json << "            \"scene\": \"" << scene << "\",\n";
+        json << "            \"scale\": \"" << scale << "\",\n";
+        json << "            \"denoise\": " << denoise << ",\n";
+        json << "            \"passes\": [\n";
+
+        std::vector<PassStatistics> passes = statistics(m_samples[i]);
+
+        for (uint32_t j = 0; j < passes.size(); j++)
+        {
+            const PassStatistics& pass = passes[j];
+
+            json << "                { \"name\": \"" << pass.name << "\", \"mean\": " << pass.mean << ", \"p50\": " << pass.p50 << ", \"p95\": " << pass.p95 << ", \"p99\": " << pass.p99 << " }" << (j < passes.size() - 1 ? "," : "") << "\n";
+            csv << scene << "," << scale << "," << denoise << "," << pass.name << "," << pass.mean << "," << pass.p50 << "," << pass.p95 << "," << pass.p99 << "\n";
+        }
+
+        json << "            ]\n";
+        json << "        }" << (i < m_configurations.size() - 1 ? "," : "") << "\n";
+    }
+
+    json << "    ]\n";
+    json << "}\n";
+
+    DW_LOG_INFO("Benchmark results written to " + path + ".json and " + path + ".csv");
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::vector<Benchmark::PassStatistics> Benchmark::statistics(const Samples& samples)
+{
+    std::vector<PassStatistics> passes;
+
+    for (const auto& name : samples.names)
+    {
+        std::vector<double> times = samples.times.at(name);
+
+        std::sort(times.begin(), times.end());
+
+        PassStatistics pass;
+
+        pass.name = name;
+
+        for (double time : times)
+            pass.mean += time;
+
+        pass.mean /= double(times.size());
+        pass.p50 = percentile(times, 0.5);
+        pass.p95 = percentile(times, 0.95);
+        pass.p99 = percentile(times, 0.99);
+
+        passes.push_back(pass);
+    }
+
+    return passes;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
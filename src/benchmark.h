@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+#include "render_graph.h"
+
+struct BenchmarkConfiguration
+{
+    SceneType     scene;
+    RayTraceScale scale; // Applied to shadows, AO, reflections and GI alike.
+    bool          denoise;
+};
+
+// Runs every configuration for a fixed number of frames along the animated camera path of its scene and collects
+// the GPU time of each render graph pass. The first frames of a configuration are discarded, they cover the timings
+// still in flight from the previous configuration as well as the temporal accumulation settling.
+class Benchmark
+{
+public:
+    static const float kTimestep;
+
+public:
+    Benchmark(uint32_t warmup_frames, uint32_t measured_frames);
+
+    // Has to be called at the start of every frame, returns true when a new configuration has to be applied.
+    bool begin_frame();
+    void end_frame(const std::vector<RenderGraph::PassTiming>& timings);
+
+    // Writes the mean, median, 95th and 99th percentile of every pass to <path>.json and <path>.csv.
+    bool write_results(const std::string& path, uint32_t width, uint32_t height);
+
+    inline bool                          finished() { return m_current_configuration >= (int32_t)m_configurations.size(); }
+    inline const BenchmarkConfiguration& current_configuration() { return m_configurations[m_current_configuration]; }
+    inline uint32_t                      num_configurations() { return (uint32_t)m_configurations.size(); }
+
+private:
+    struct PassStatistics
+    {
+        std::string name;
+        double      mean = 0.0;
+        double      p50  = 0.0;
+        double      p95  = 0.0;
+        double      p99  = 0.0;
+    };
+
+    struct Samples
+    {
+        std::vector<std::string>                             names; // In the order the passes were first seen.
+        std::unordered_map<std::string, std::vector<double>> times;
+    };
+
+    std::vector<PassStatistics> statistics(const Samples& samples);
+
+private:
+    uint32_t                            m_warmup_frames;
+    uint32_t                            m_measured_frames;
+    uint32_t                            m_frame                 = 0;
+    int32_t                             m_current_configuration = -1;
+    std::vector<BenchmarkConfiguration> m_configurations;
+    std::vector<Samples>                m_samples;
+};
@@ -0,0 +1,400 @@
+#include "block_compression.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define BLOCK_COMPRESSION_SSE2
+#    include <emmintrin.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Interpolation weights of the 4-bit indices of BC7, out of 64.
+static const int32_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const uint32_t kPowerIterations = 8;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The four channels of an RGBA pixel.
+struct Float4
+{
+#if defined(BLOCK_COMPRESSION_SSE2)
+    __m128 v;
+
+    Float4() :
+        v(_mm_setzero_ps()) {}
+    explicit Float4(__m128 value) :
+        v(value) {}
+    explicit Float4(float value) :
+        v(_mm_set1_ps(value)) {}
+    Float4(float x, float y, float z, float w) :
+        v(_mm_setr_ps(x, y, z, w)) {}
+
+    inline Float4 operator+(const Float4& other) const { return Float4(_mm_add_ps(v, other.v)); }
+    inline Float4 operator-(const Float4& other) const { return Float4(_mm_sub_ps(v, other.v)); }
+    inline Float4 operator*(const Float4& other) const { return Float4(_mm_mul_ps(v, other.v)); }
+    inline void   store(float* values) const { _mm_storeu_ps(values, v); }
+
+    inline float sum() const
+    {
+        __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums     = _mm_add_ps(v, shuffled);
+
+        shuffled = _mm_movehl_ps(shuffled, sums);
+
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+    }
+#else
+    float v[4];
+
+    Float4() :
+        Float4(0.0f) {}
+    explicit Float4(float value) :
+        Float4(value, value, value, value) {}
+    Float4(float x, float y, float z, float w)
+    {
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+        v[3] = w;
+    }
+
+    inline Float4 operator+(const Float4& other) const { return Float4(v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]); }
+    inline Float4 operator-(const Float4& other) const { return Float4(v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3]); }
+    inline Float4 operator*(const Float4& other) const { return Float4(v[0] * other.v[0], v[1] * other.v[1], v[2] * other.v[2], v[3] * other.v[3]); }
+    inline void   store(float* values) const { memcpy(values, v, sizeof(v)); }
+    inline float  sum() const { return v[0] + v[1] + v[2] + v[3]; }
+#endif
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline float dot(const Float4& a, const Float4& b)
+{
+    return (a * b).sum();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* data, uint32_t size) :
+        m_data(data)
+    {
+        memset(data, 0, size);
+    }
+
+    void write(uint32_t value, uint32_t num_bits)
+    {
+        for (uint32_t i = 0; i < num_bits; i++, m_position++)
+        {
+            if ((value >> i) & 1)
+                m_data[m_position / 8] |= uint8_t(1 << (m_position % 8));
+        }
+    }
+
+private:
+    uint8_t* m_data;
+    uint32_t m_position = 0;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void load_block(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t block_x, uint32_t block_y, uint8_t block[16][4])
+{
+    for (uint32_t y = 0; y < 4; y++)
+    {
+        uint32_t src_y = std::min(block_y * 4 + y, height - 1);
+
+        for (uint32_t x = 0; x < 4; x++)
+        {
+            uint32_t src_x = std::min(block_x * 4 + x, width - 1);
+
+            memcpy(block[y * 4 + x], pixels + (size_t(src_y) * width + src_x) * 4, 4);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Eight value mode, with the endpoints at the minimum and maximum of the block.
+static void encode_bc4_block(const uint8_t block[16][4], uint32_t channel, uint8_t* output)
+{
+    uint8_t min_value = 255;
+    uint8_t max_value = 0;
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        min_value = std::min(min_value, block[i][channel]);
+        max_value = std::max(max_value, block[i][channel]);
+    }
+
+    uint64_t indices = 0;
+
+    // Equal endpoints select the six value mode instead, where index 0 still decodes to the first endpoint.
+    if (max_value > min_value)
+    {
+        float scale = 7.0f / float(max_value - min_value);
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            // Steps from the maximum towards the minimum, which the format stores as indices 0, 2, 3, ..., 7, 1.
+            uint32_t step  = uint32_t(float(max_value - block[i][channel]) * scale + 0.5f);
+            uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+
+            indices |= index << (3 * i);
+        }
+    }
+
+    output[0] = max_value;
+    output[1] = min_value;
+
+    for (uint32_t i = 0; i < 6; i++)
+        output[2 + i] = uint8_t(indices >> (8 * i));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Mode 6: one pair of 7-bit RGBA endpoints with a unique p-bit each, and 4-bit indices.
+static void encode_bc7_block(const uint8_t block[16][4], uint8_t* output)
+{
+    Float4 colors[16];
+    Float4 mean;
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        colors[i] = Float4(block[i][0], block[i][1], block[i][2], block[i][3]);
+        mean      = mean + colors[i];
+    }
+
+    mean = mean * Float4(1.0f / 16.0f);
+
+    // Rows of the covariance matrix of the block.
+    Float4 covariance[4];
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        Float4 offset = colors[i] - mean;
+        float  values[4];
+
+        offset.store(values);
+
+        for (uint32_t row = 0; row < 4; row++)
+            covariance[row] = covariance[row] + offset * Float4(values[row]);
+    }
+
+    // The principal axis is found by power iteration, starting from the channel that varies the most.
+    float    variances[4][4];
+    uint32_t start_row = 0;
+
+    for (uint32_t row = 0; row < 4; row++)
+    {
+        covariance[row].store(variances[row]);
+
+        if (variances[row][row] > variances[start_row][start_row])
+            start_row = row;
+    }
+
+    Float4 axis = covariance[start_row];
+
+    for (uint32_t i = 0; i < kPowerIterations; i++)
+    {
+        float components[4];
+        axis.store(components);
+
+        axis = covariance[0] * Float4(components[0]) + covariance[1] * Float4(components[1]) + covariance[2] * Float4(components[2]) + covariance[3] * Float4(components[3]);
+
+        float length = sqrtf(dot(axis, axis));
+
+        if (length < FLT_EPSILON)
+            break;
+
+        axis = axis * Float4(1.0f / length);
+    }
+
+    // Blocks of a single color have no axis, any one will do.
+    if (dot(axis, axis) < 0.5f)
+        axis = Float4(0.5f);
+
+    float min_t = FLT_MAX;
+    float max_t = -FLT_MAX;
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        float t = dot(colors[i] - mean, axis);
+
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+
+    float endpoints[2][4];
+
+    (mean + axis * Float4(min_t)).store(endpoints[0]);
+    (mean + axis * Float4(max_t)).store(endpoints[1]);
+
+    // Every combination of p-bits is tried, since they decide which values the endpoints can reach.
+    float    best_error = FLT_MAX;
+    uint32_t best_endpoints[2][4] = {};
+    uint32_t best_p_bits[2]       = {};
+    uint32_t best_indices[16]     = {};
+
+    for (uint32_t p_bits = 0; p_bits < 4; p_bits++)
+    {
+        uint32_t p[2] = { p_bits & 1, p_bits >> 1 };
+        uint32_t quantized[2][4];
+        int32_t  decoded[2][4];
+
+        for (uint32_t e = 0; e < 2; e++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                float value = (std::min(std::max(endpoints[e][c], 0.0f), 255.0f) - float(p[e])) * 0.5f;
+
+                quantized[e][c] = uint32_t(std::min(std::max(value + 0.5f, 0.0f), 127.0f));
+                decoded[e][c]   = int32_t((quantized[e][c] << 1) | p[e]);
+            }
+        }
+
+        Float4 palette[16];
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            int32_t w = kWeights4[i];
+
+            palette[i] = Float4(float(((64 - w) * decoded[0][0] + w * decoded[1][0] + 32) >> 6),
+                                float(((64 - w) * decoded[0][1] + w * decoded[1][1] + 32) >> 6),
+                                float(((64 - w) * decoded[0][2] + w * decoded[1][2] + 32) >> 6),
+                                float(((64 - w) * decoded[0][3] + w * decoded[1][3] + 32) >> 6));
+        }
+
+        float    error       = 0.0f;
+        uint32_t indices[16] = {};
+
+        for (uint32_t i = 0; i < 16 && error < best_error; i++)
+        {
+            float best_distance = FLT_MAX;
+
+            for (uint32_t j = 0; j < 16; j++)
+            {
+                Float4 difference = colors[i] - palette[j];
+                float  distance   = dot(difference, difference);
+
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    indices[i]    = j;
+                }
+            }
+
+            error += best_distance;
+        }
+
+        if (error < best_error)
+        {
+            best_error     = error;
+            best_p_bits[0] = p[0];
+            best_p_bits[1] = p[1];
+
+            memcpy(best_endpoints, quantized, sizeof(quantized));
+            memcpy(best_indices, indices, sizeof(indices));
+        }
+    }
+
+    // The top bit of the first index is implied to be zero, the endpoints are swapped to make it so.
+    if (best_indices[0] & 8)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+            std::swap(best_endpoints[0][c], best_endpoints[1][c]);
+
+        std::swap(best_p_bits[0], best_p_bits[1]);
+
+        for (uint32_t i = 0; i < 16; i++)
+            best_indices[i] = 15 - best_indices[i];
+    }
+
+    BitWriter writer(output, 16);
+
+    writer.write(1 << 6, 7);
+
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.write(best_endpoints[0][c], 7);
+        writer.write(best_endpoints[1][c], 7);
+    }
+
+    writer.write(best_p_bits[0], 1);
+    writer.write(best_p_bits[1], 1);
+
+    for (uint32_t i = 0; i < 16; i++)
+        writer.write(best_indices[i], i == 0 ? 3 : 4);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t BlockCompression::size(uint32_t width, uint32_t height, uint32_t block_size)
+{
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * block_size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BlockCompression::encode_bc4(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channel, uint8_t* blocks)
+{
+    uint32_t num_blocks_x = (width + 3) / 4;
+    uint32_t num_blocks_y = (height + 3) / 4;
+    uint8_t  block[16][4];
+
+    for (uint32_t y = 0; y < num_blocks_y; y++)
+    {
+        for (uint32_t x = 0; x < num_blocks_x; x++)
+        {
+            load_block(pixels, width, height, x, y, block);
+            encode_bc4_block(block, channel, blocks + (size_t(y) * num_blocks_x + x) * 8);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BlockCompression::encode_bc5(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channel_x, uint32_t channel_y, uint8_t* blocks)
+{
+    uint32_t num_blocks_x = (width + 3) / 4;
+    uint32_t num_blocks_y = (height + 3) / 4;
+    uint8_t  block[16][4];
+
+    for (uint32_t y = 0; y < num_blocks_y; y++)
+    {
+        for (uint32_t x = 0; x < num_blocks_x; x++)
+        {
+            uint8_t* output = blocks + (size_t(y) * num_blocks_x + x) * 16;
+
+            load_block(pixels, width, height, x, y, block);
+            encode_bc4_block(block, channel_x, output);
+            encode_bc4_block(block, channel_y, output + 8);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BlockCompression::encode_bc7(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+    uint32_t num_blocks_x = (width + 3) / 4;
+    uint32_t num_blocks_y = (height + 3) / 4;
+    uint8_t  block[16][4];
+
+    for (uint32_t y = 0; y < num_blocks_y; y++)
+    {
+        for (uint32_t x = 0; x < num_blocks_x; x++)
+        {
+            load_block(pixels, width, height, x, y, block);
+            encode_bc7_block(block, blocks + (size_t(y) * num_blocks_x + x) * 16);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU encoders for the BC4, BC5 and BC7 block compressed formats, taking tightly packed RGBA8 images. Blocks along
+// the right and bottom edges of sizes that are not a multiple of four repeat the last row or column. The BC7 encoder
+// works on all four channels of a pixel at once with SSE2 where available, and falls back to scalar code elsewhere.
+//
+// BC7 only uses mode 6, a single endpoint pair with 4-bit indices and alpha, fitted along the principal axis of the
+// block. That is noticeably faster than searching the partitioned modes, at the cost of some quality on blocks with
+// more than two distinct colors.
+class BlockCompression
+{
+public:
+    // Size of the blocks covering an image, 8 bytes per block for BC4 and 16 for BC5 and BC7.
+    static size_t size(uint32_t width, uint32_t height, uint32_t block_size);
+
+    static void encode_bc4(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channel, uint8_t* blocks);
+    static void encode_bc5(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channel_x, uint32_t channel_y, uint8_t* blocks);
+    static void encode_bc7(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* blocks);
+};
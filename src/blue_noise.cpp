@@ -1,4 +1,14 @@
 #include "blue_noise.h"
+#include "thread_pool.h"
+#include "utility.h"
+#include <logger.h>
+#include <chrono>
+#include <fstream>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -20,16 +30,313 @@ static const char* kSCRAMBLING_RANKING_TEXTURES[] = {
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-BlueNoise::BlueNoise(dw::vk::Backend::Ptr backend)
+static const char     kSpatiotemporalMagic[4]  = { 'H', 'R', 'B', 'N' };
+static const uint32_t kSpatiotemporalVersion   = 1;
+static const char*    kSpatiotemporalCachePath = "cache/spatiotemporal_blue_noise.bin";
+
+// Energy kernel of the void-and-cluster generator: a Gaussian over the texels of the same layer, plus one over the same
+// texel in the other layers, both truncated at kKernelRadius.
+static const float   kSpatialSigma  = 1.9f;
+static const float   kTemporalSigma = 1.9f;
+static const int32_t kKernelRadius  = 6;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct SpatiotemporalHeader
 {
-    m_sobol_image      = dw::vk::Image::create_from_file(backend, kSOBOL_TEXTURE);
-    m_sobol_image_view = dw::vk::ImageView::create(backend, m_sobol_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    char     magic[4];
+    uint32_t version;
+    uint32_t size;
+    uint32_t depth;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Ranks every texel of a toroidal size x size x depth volume with void-and-cluster. Texels only repel the ones in the
+// same layer and the same texel in other layers, so every layer is blue noise in space and every texel is blue noise
+// over time, rather than the volume being blue noise in 3D.
+// The lowest energy empty texel and highest energy set texel are tracked per row, so each step only rescans the
+// rows the kernel touched.
+class VoidAndCluster
+{
+public:
+    VoidAndCluster(uint32_t size, uint32_t depth) :
+        m_size(size), m_depth(depth), m_num_texels(size * size * depth)
+    {
+        for (int32_t i = 0; i <= kKernelRadius; i++)
+        {
+            m_spatial_weights[i]  = expf(-float(i * i) / (2.0f * kSpatialSigma * kSpatialSigma));
+            m_temporal_weights[i] = expf(-float(i * i) / (2.0f * kTemporalSigma * kTemporalSigma));
+        }
+    }
+
+    void generate(uint32_t seed, std::vector<uint32_t>& ranks)
+    {
+        m_set.assign(m_num_texels, 0);
+        m_energy.assign(m_num_texels, 0.0f);
+        m_rows.resize(m_size * m_depth);
+
+        for (uint32_t row = 0; row < m_rows.size(); row++)
+            update_row(row);
+
+        ranks.resize(m_num_texels);
+
+        // Initial pattern: a tenth of the texels set at random, then relaxed by moving the tightest cluster into the
+        // largest void until that no longer changes anything.
+        std::mt19937 rng(seed);
+        uint32_t     num_initial = m_num_texels / 10;
+
+        for (uint32_t count = 0; count < num_initial;)
+        {
+            uint32_t texel = rng() % m_num_texels;
+
+            if (!m_set[texel])
+            {
+                toggle(texel);
+                count++;
+            }
+        }
+
+        for (uint32_t i = 0; i < m_num_texels; i++)
+        {
+            uint32_t cluster = tightest_cluster();
+            toggle(cluster);
+
+            uint32_t largest_void = this->largest_void();
+            toggle(largest_void);
+
+            if (largest_void == cluster)
+                break;
+        }
+
+        std::vector<uint8_t> initial_set    = m_set;
+        std::vector<float>   initial_energy = m_energy;
+        std::vector<Row>     initial_rows   = m_rows;
+
+        // Ranks of the initial pattern, removing the tightest cluster each time.
+        for (uint32_t rank = num_initial; rank-- > 0;)
+        {
+            uint32_t cluster = tightest_cluster();
+            toggle(cluster);
+
+            ranks[cluster] = rank;
+        }
+
+        m_set    = initial_set;
+        m_energy = initial_energy;
+        m_rows   = initial_rows;
+
+        // Ranks of the rest, filling the largest void each time. Past half of the texels this equals picking the
+        // tightest cluster of the empty texels, since their energy is the complement of the one of the set texels.
+        for (uint32_t rank = num_initial; rank < m_num_texels; rank++)
+        {
+            uint32_t largest_void = this->largest_void();
+            toggle(largest_void);
+
+            ranks[largest_void] = rank;
+        }
+    }
+
+private:
+    struct Row
+    {
+        uint32_t cluster = UINT32_MAX; // Set texel with the highest energy.
+        uint32_t hole    = UINT32_MAX; // Empty texel with the lowest energy.
+    };
+
+    void toggle(uint32_t texel)
+    {
+        int32_t size  = int32_t(m_size);
+        int32_t depth = int32_t(m_depth);
+        int32_t x     = int32_t(texel % m_size);
+        int32_t y     = int32_t((texel / m_size) % m_size);
+        int32_t t     = int32_t(texel / (m_size * m_size));
+        float   sign  = m_set[texel] ? -1.0f : 1.0f;
+
+        m_set[texel] = !m_set[texel];
+
+        // Texels of the same layer.
+        for (int32_t dy = -kKernelRadius; dy <= kKernelRadius; dy++)
+        {
+            int32_t row    = t * size + (y + dy + size) % size;
+            float   weight = sign * m_spatial_weights[abs(dy)];
+            float*  energy = &m_energy[size_t(row) * m_size];
+
+            for (int32_t dx = -kKernelRadius; dx <= kKernelRadius; dx++)
+                energy[(x + dx + size) % size] += weight * m_spatial_weights[abs(dx)];
+
+            update_row(row);
+        }
+
+        // The same texel in the neighboring layers.
+        for (int32_t dt = -kKernelRadius; dt <= kKernelRadius; dt++)
+        {
+            if (dt == 0)
+                continue;
+
+            int32_t row = ((t + dt + depth) % depth) * size + y;
+
+            m_energy[size_t(row) * m_size + x] += sign * m_temporal_weights[abs(dt)];
+
+            update_row(row);
+        }
+    }
+
+    void update_row(uint32_t row)
+    {
+        Row& data = m_rows[row];
+
+        data.cluster = UINT32_MAX;
+        data.hole    = UINT32_MAX;
+
+        for (uint32_t texel = row * m_size; texel < (row + 1) * m_size; texel++)
+        {
+            if (m_set[texel])
+            {
+                if (data.cluster == UINT32_MAX || m_energy[texel] > m_energy[data.cluster])
+                    data.cluster = texel;
+            }
+            else if (data.hole == UINT32_MAX || m_energy[texel] < m_energy[data.hole])
+                data.hole = texel;
+        }
+    }
+
+    uint32_t tightest_cluster()
+    {
+        uint32_t cluster = UINT32_MAX;
+
+        for (const auto& row : m_rows)
+        {
+            if (row.cluster != UINT32_MAX && (cluster == UINT32_MAX || m_energy[row.cluster] > m_energy[cluster]))
+                cluster = row.cluster;
+        }
+
+        return cluster;
+    }
+
+    uint32_t largest_void()
+    {
+        uint32_t hole = UINT32_MAX;
+
+        for (const auto& row : m_rows)
+        {
+            if (row.hole != UINT32_MAX && (hole == UINT32_MAX || m_energy[row.hole] < m_energy[hole]))
+                hole = row.hole;
+        }
+
+        return hole;
+    }
+
+private:
+    uint32_t             m_size;
+    uint32_t             m_depth;
+    uint32_t             m_num_texels;
+    float                m_spatial_weights[kKernelRadius + 1];
+    float                m_temporal_weights[kKernelRadius + 1];
+    std::vector<uint8_t> m_set;
+    std::vector<float>   m_energy;
+    std::vector<Row>     m_rows;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool read_spatiotemporal_cache(std::vector<uint8_t>& data)
+{
+    std::ifstream file(kSpatiotemporalCachePath, std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    SpatiotemporalHeader header;
+    file.read((char*)&header, sizeof(SpatiotemporalHeader));
+
+    if (!file.good() || memcmp(header.magic, kSpatiotemporalMagic, sizeof(kSpatiotemporalMagic)) != 0 || header.version != kSpatiotemporalVersion)
+        return false;
+
+    if (header.size != BlueNoise::kSpatiotemporalSize || header.depth != BlueNoise::kSpatiotemporalDepth)
+        return false;
+
+    file.read((char*)data.data(), data.size());
+
+    return file.good();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void write_spatiotemporal_cache(const std::vector<uint8_t>& data)
+{
+    SpatiotemporalHeader header;
+
+    memcpy(header.magic, kSpatiotemporalMagic, sizeof(kSpatiotemporalMagic));
+
+    header.version = kSpatiotemporalVersion;
+    header.size    = BlueNoise::kSpatiotemporalSize;
+    header.depth   = BlueNoise::kSpatiotemporalDepth;
+
+    create_cache_directory();
+
+    write_file_atomic(kSpatiotemporalCachePath, "blue noise cache", [&](std::ofstream& file) {
+        file.write((const char*)&header, sizeof(SpatiotemporalHeader));
+        file.write((const char*)data.data(), data.size());
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Two channels ranked independently, one per dimension of a 2D sample, stored as the rank scaled to 8 bits.
+static void generate_spatiotemporal(std::vector<uint8_t>& data)
+{
+    uint32_t   num_texels = BlueNoise::kSpatiotemporalSize * BlueNoise::kSpatiotemporalSize * BlueNoise::kSpatiotemporalDepth;
+    ThreadPool thread_pool(2);
+
+    thread_pool.run(2, 2, [&data, num_texels](uint32_t job_idx, uint32_t thread_idx) {
+        VoidAndCluster        generator(BlueNoise::kSpatiotemporalSize, BlueNoise::kSpatiotemporalDepth);
+        std::vector<uint32_t> ranks;
+
+        generator.generate(job_idx + 1, ranks);
+
+        for (uint32_t i = 0; i < num_texels; i++)
+            data[i * 2 + job_idx] = uint8_t(uint64_t(ranks[i]) * 256 / num_texels);
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+BlueNoise::BlueNoise(dw::vk::Backend::Ptr backend, AssetLoader& loader)
+{
+    loader.load_image(kSOBOL_TEXTURE, false, [this, backend](dw::vk::Image::Ptr image) {
+        m_sobol_image      = image;
+        m_sobol_image_view = dw::vk::ImageView::create(backend, m_sobol_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    });
 
     for (int i = 0; i < 9; i++)
     {
-        m_scrambling_ranking_image[i]      = dw::vk::Image::create_from_file(backend, kSCRAMBLING_RANKING_TEXTURES[i]);
-        m_scrambling_ranking_image_view[i] = dw::vk::ImageView::create(backend, m_scrambling_ranking_image[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+        loader.load_image(kSCRAMBLING_RANKING_TEXTURES[i], false, [this, backend, i](dw::vk::Image::Ptr image) {
+            m_scrambling_ranking_image[i]      = image;
+            m_scrambling_ranking_image_view[i] = dw::vk::ImageView::create(backend, m_scrambling_ranking_image[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+        });
+    }
+
+    std::vector<uint8_t> data(kSpatiotemporalSize * kSpatiotemporalSize * kSpatiotemporalDepth * 2);
+
+    if (!read_spatiotemporal_cache(data))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        generate_spatiotemporal(data);
+        write_spatiotemporal_cache(data);
+
+        DW_LOG_INFO("Generated spatiotemporal blue noise in " + std::to_string(elapsed_milliseconds(start)) + " ms");
     }
+
+    m_spatiotemporal_image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, kSpatiotemporalSize, kSpatiotemporalSize, 1, 1, kSpatiotemporalDepth, VK_FORMAT_R8G8_UNORM, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    m_spatiotemporal_image->set_name("Spatiotemporal Blue Noise");
+    m_spatiotemporal_image_view = dw::vk::ImageView::create(backend, m_spatiotemporal_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, kSpatiotemporalDepth);
+
+    dw::vk::BatchUploader uploader(backend);
+
+    uploader.upload_image_data(m_spatiotemporal_image, data.data(), std::vector<size_t>(kSpatiotemporalDepth, kSpatiotemporalSize * kSpatiotemporalSize * 2));
+    uploader.submit();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
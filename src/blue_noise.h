@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vk.h>
+#include "asset_loader.h"
 
 enum BlueNoiseSpp
 {
@@ -14,14 +15,29 @@ enum BlueNoiseSpp
     BLUE_NOISE_128SPP
 };
 
+// Selects how the ray tracing passes draw their 2D random samples, passed to the shaders as is.
+enum BlueNoiseSampler
+{
+    BLUE_NOISE_SAMPLER_SOBOL,         // Scrambled and ranked Sobol sequence, three dependent fetches per dimension.
+    BLUE_NOISE_SAMPLER_SPATIOTEMPORAL // One fetch from a blue noise texture array, a new layer every frame.
+};
+
 struct BlueNoise
 {
+    // Must match the defines in bnd_sampler.glsl.
+    static const uint32_t kSpatiotemporalSize  = 64;
+    static const uint32_t kSpatiotemporalDepth = 32;
+
     dw::vk::Image::Ptr m_sobol_image;
     dw::vk::Image::Ptr m_scrambling_ranking_image[9];
+    dw::vk::Image::Ptr m_spatiotemporal_image;
 
     dw::vk::ImageView::Ptr m_sobol_image_view;
     dw::vk::ImageView::Ptr m_scrambling_ranking_image_view[9];
+    dw::vk::ImageView::Ptr m_spatiotemporal_image_view;
 
-    BlueNoise(dw::vk::Backend::Ptr backend);
+    // The images are only available once the loader has been flushed, apart from the spatiotemporal blue noise which
+    // is generated the first time and read from the cache afterwards.
+    BlueNoise(dw::vk::Backend::Ptr backend, AssetLoader& loader);
     ~BlueNoise();
-};
\ No newline at end of file
+};
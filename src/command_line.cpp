@@ -0,0 +1,157 @@
+#include "command_line.h"
+#include <logger.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const char* kUsage = "Usage: HybridRendering [--headless] [--width <pixels>] [--height <pixels>] [--frames <count>] [--output <path>] [--scene <index>] [--benchmark <path>] [--warmup-frames <count>] [--benchmark-frames <count>] [--trace <path>] [--trace-frames <count>] [--mesh-benchmark <runs>] [--tune-workgroups <frames>] [--texture-budget <MB>] [--sampler <index>]";
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool parse_integer(int argc, const char* argv[], int& i, int32_t min_value, int32_t& value)
+{
+    std::string name = argv[i];
+
+    if (i + 1 >= argc)
+    {
+        DW_LOG_ERROR("Missing value for command line argument: " + name);
+        return false;
+    }
+
+    const char* str = argv[++i];
+    char*       end = nullptr;
+    long        v   = strtol(str, &end, 10);
+
+    if (end == str || *end != '\0' || v < min_value || v > INT32_MAX)
+    {
+        DW_LOG_ERROR("Invalid value for command line argument " + name + ": " + str);
+        return false;
+    }
+
+    value = static_cast<int32_t>(v);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool parse_command_line(int argc, const char* argv[], CommandLineOptions& options)
+{
+    // The first argument is the executable.
+    for (int i = 1; i < argc; i++)
+    {
+        int32_t value = 0;
+        bool    valid = true;
+
+        if (strcmp(argv[i], "--headless") == 0)
+            options.headless = true;
+        else if (strcmp(argv[i], "--width") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.width = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--height") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.height = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--frames") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.num_frames = value;
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            if ((valid = i + 1 < argc))
+                options.output = argv[++i];
+            else
+                DW_LOG_ERROR("Missing value for command line argument: --output");
+        }
+        else if (strcmp(argv[i], "--scene") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 0, value)))
+                options.scene = value;
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            if ((valid = i + 1 < argc))
+                options.benchmark = argv[++i];
+            else
+                DW_LOG_ERROR("Missing value for command line argument: --benchmark");
+        }
+        else if (strcmp(argv[i], "--warmup-frames") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 0, value)))
+                options.warmup_frames = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--benchmark-frames") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.benchmark_frames = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            if ((valid = i + 1 < argc))
+                options.trace = argv[++i];
+            else
+                DW_LOG_ERROR("Missing value for command line argument: --trace");
+        }
+        else if (strcmp(argv[i], "--trace-frames") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.trace_frames = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--mesh-benchmark") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.mesh_benchmark = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--tune-workgroups") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.tune_workgroups = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--texture-budget") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 1, value)))
+                options.texture_budget = static_cast<uint32_t>(value);
+        }
+        else if (strcmp(argv[i], "--sampler") == 0)
+        {
+            if ((valid = parse_integer(argc, argv, i, 0, value)))
+                options.sampler = value;
+        }
+        else
+        {
+            DW_LOG_ERROR(std::string("Unknown command line argument: ") + argv[i]);
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            DW_LOG_ERROR(kUsage);
+            return false;
+        }
+    }
+
+    // The window always follows the size of the swap chain, only the offscreen target can take another resolution.
+    if ((options.width > 0 || options.height > 0) && !options.headless)
+    {
+        DW_LOG_ERROR("--width and --height require --headless");
+        return false;
+    }
+
+    // Without a frame count the hidden window is never closed, so there would be no last frame to write.
+    if (!options.output.empty() && (!options.headless || options.num_frames <= 0))
+    {
+        DW_LOG_ERROR("--output requires --headless and --frames");
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
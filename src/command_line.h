@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+struct CommandLineOptions
+{
+    bool        headless         = false; // Render into an offscreen target instead of the swap chain, without the GUI.
+    uint32_t    width            = 0;     // Output resolution when headless, zero uses the size of the swap chain.
+    uint32_t    height           = 0;
+    int32_t     num_frames       = -1; // Exit after rendering this many frames, negative runs until the window is closed.
+    std::string output;                // Path of a PPM image the headless output of the last frame is written to, empty skips it.
+    int32_t     scene            = -1; // Index into constants::scene_types, negative keeps the default scene.
+    std::string benchmark;             // Output path of the benchmark results without extension, empty disables the benchmark.
+    uint32_t    warmup_frames    = 60;
+    uint32_t    benchmark_frames = 300;
+    std::string trace;                 // Output path of a trace captured on startup, empty disables the capture.
+    uint32_t    trace_frames     = 60;
+    uint32_t    mesh_benchmark   = 0; // Runs of the mesh cache benchmark on startup, zero skips it.
+    uint32_t    tune_workgroups  = 0; // Frames measured for each workgroup size candidate, zero keeps the saved sizes.
+    uint32_t    texture_budget   = 0; // Memory the streamed textures may use in MB, zero keeps the default.
+    int32_t     sampler          = -1; // Index into constants::blue_noise_samplers, negative keeps the default sampler.
+};
+
+// Parses the arguments passed to the executable, logs the usage and returns false if any of them is invalid.
+//
+// --headless          Render offscreen without presenting the output.
+// --width <pixels>    Output width, requires --headless.
+// --height <pixels>   Output height, requires --headless.
+// --frames <count>    Number of frames to render before exiting.
+// --output <path>     Write the output of the last frame to <path> as a PPM image, requires --headless and --frames.
+// --scene <index>     Scene to load on startup.
+//
+// --benchmark <path>          Run the benchmark and write the results to <path>.json and <path>.csv, then exit.
+// --warmup-frames <count>     Frames rendered before measuring each benchmark configuration.
+// --benchmark-frames <count>  Frames measured for each benchmark configuration.
+//
+// --trace <path>              Capture a Chrome trace of the first frames and write it to <path>.
+// --trace-frames <count>      Frames covered by a trace capture.
+//
+// --mesh-benchmark <runs>     Log the CPU time of importing Sponza against loading it from the mesh cache on startup.
+//
+// --tune-workgroups <frames>  Time every workgroup size candidate of the tunable compute passes for this many frames after
+//                             --warmup-frames, save the fastest to workgroup_sizes.cfg, then exit.
+//
+// --texture-budget <MB>       Memory the mips of streamed textures may take up.
+//
+// --sampler <index>           Random sampler of the ray traced effects, 0 for Sobol and 1 for spatiotemporal blue noise.
+bool parse_command_line(int argc, const char* argv[], CommandLineOptions& options);
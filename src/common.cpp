@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <gtc/matrix_transform.hpp>
 #include <equirectangular_to_cubemap.h>
+#include "environment_cache.h"
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -15,6 +16,7 @@ const std::vector<std::string>            scene_types                   = { "Sha
 const std::vector<std::string>            ray_trace_scales              = { "Full-Res", "Half-Res", "Quarter-Res" };
 const std::vector<std::string>            light_types                   = { "Directional", "Point", "Spot" };
 const std::vector<std::string>            camera_types                  = { "Free", "Animated", "Fixed" };
+const std::vector<std::string>            blue_noise_samplers           = { "Sobol", "Spatiotemporal Blue Noise" };
 const std::vector<std::vector<glm::vec3>> fixed_camera_position_vectors = {
     { glm::vec3(-22.061460f, 16.624475f, 23.893597f),
       glm::vec3(-0.337131f, 15.421529f, 39.524925f),
@@ -301,14 +303,44 @@ const std::vector<float> animated_camera_speeds = {
 
 CommonResources::CommonResources(dw::vk::Backend::Ptr backend)
 {
+    pipeline_cache  = std::unique_ptr<PipelineCache>(new PipelineCache(backend, "cache/pipelines.bin"));
+    workgroup_tuner = std::unique_ptr<WorkgroupTuner>(new WorkgroupTuner(backend, "workgroup_sizes.cfg"));
+
     create_uniform_buffer(backend);
-    load_mesh(backend);
+
+    // Images are decoded on worker threads and uploaded together before anything that needs them is created.
+    AssetLoader                     loader(backend);
+    std::vector<dw::vk::Image::Ptr> environment_maps(constants::environment_map_images.size());
+
+    blue_noise = std::unique_ptr<BlueNoise>(new BlueNoise(backend, loader));
+
+    hdr_environments.resize(constants::environment_map_images.size());
+
+    // Environment maps found in the cache skip decoding along with the conversion passes.
+    for (uint32_t i = 0; i < environment_maps.size(); i++)
+    {
+        std::shared_ptr<HDREnvironment> environment = std::shared_ptr<HDREnvironment>(new HDREnvironment());
+
+        if (EnvironmentCache::load(backend, constants::environment_map_images[i], *environment))
+            hdr_environments[i] = environment;
+        else
+            loader.load_image(constants::environment_map_images[i], true, [&environment_maps, i](dw::vk::Image::Ptr image) { environment_maps[i] = image; });
+    }
+
+    loader.flush();
 
     brdf_preintegrate_lut = std::unique_ptr<dw::BRDFIntegrateLUT>(new dw::BRDFIntegrateLUT(backend));
-    blue_noise            = std::unique_ptr<BlueNoise>(new BlueNoise(backend));
+    deletion_queue        = std::unique_ptr<DeletionQueue>(new DeletionQueue(backend));
+    transient_allocator   = std::unique_ptr<TransientResourceAllocator>(new TransientResourceAllocator(backend, deletion_queue.get()));
 
-    create_environment_resources(backend);
     create_descriptor_set_layouts(backend);
+
+    // Scenes register their materials with the streamer as they are loaded.
+    texture_streamer = std::unique_ptr<TextureStreamer>(new TextureStreamer(backend, deletion_queue.get(), scene_ds_layout));
+
+    create_scene_cache(backend);
+
+    create_environment_resources(backend, environment_maps);
     create_descriptor_sets(backend);
     write_descriptor_sets(backend);
 
@@ -337,205 +369,57 @@ void CommonResources::create_uniform_buffer(dw::vk::Backend::Ptr backend)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void CommonResources::load_mesh(dw::vk::Backend::Ptr backend)
+void CommonResources::create_scene_cache(dw::vk::Backend::Ptr backend)
 {
-    scenes.reserve(SCENE_TYPE_COUNT);
-
-    {
-        std::vector<dw::RayTracedScene::Instance> instances;
-
-        dw::Mesh::Ptr pillar = dw::Mesh::load(backend, "meshes/pillar.gltf");
-
-        if (!pillar)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
-
-        pillar->initialize_for_ray_tracing(backend);
-
-        meshes.push_back(pillar);
-
-        dw::Mesh::Ptr bunny = dw::Mesh::load(backend, "meshes/bunny.gltf");
-
-        if (!bunny)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
+    std::vector<SceneDescription> descriptions(SCENE_TYPE_COUNT);
 
-        bunny->initialize_for_ray_tracing(backend);
+    for (uint32_t i = 0; i < SCENE_TYPE_COUNT; i++)
+        descriptions[i].name = constants::scene_types[i];
 
-        meshes.push_back(bunny);
-
-        dw::Mesh::Ptr ground = dw::Mesh::load(backend, "meshes/ground.gltf");
-
-        if (!ground)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
-
-        ground->initialize_for_ray_tracing(backend);
-
-        meshes.push_back(ground);
+    // Two rows of pillars along the ground with the bunny in between.
+    descriptions[SCENE_TYPE_SHADOWS_TEST].meshes          = { "meshes/pillar.gltf", "meshes/bunny.gltf", "meshes/ground.gltf" };
+    descriptions[SCENE_TYPE_SHADOWS_TEST].place_instances = [](const std::vector<dw::Mesh::Ptr>& meshes, std::vector<SceneDescription::Instance>& instances) {
+        const dw::Mesh::Ptr& ground = meshes[2];
 
         float segment_length = (ground->max_extents().z - ground->min_extents().z) / (NUM_PILLARS + 1);
 
-        for (uint32_t i = 0; i < NUM_PILLARS; i++)
+        for (float x : { 15.0f, -15.0f })
         {
-            dw::RayTracedScene::Instance pillar_instance;
-
-            pillar_instance.mesh      = pillar;
-            pillar_instance.transform = glm::mat4(1.0f);
+            for (uint32_t i = 0; i < NUM_PILLARS; i++)
+            {
+                glm::vec3 pos = glm::vec3(x, 0.0f, ground->min_extents().z + segment_length * (i + 1));
 
-            glm::vec3 pos = glm::vec3(15.0f, 0.0f, ground->min_extents().z + segment_length * (i + 1));
-
-            pillar_instance.transform = glm::translate(pillar_instance.transform, pos);
-
-            instances.push_back(pillar_instance);
+                instances.push_back({ 0, glm::translate(glm::mat4(1.0f), pos) });
+            }
         }
 
-        for (uint32_t i = 0; i < NUM_PILLARS; i++)
-        {
-            dw::RayTracedScene::Instance pillar_instance;
-
-            pillar_instance.mesh      = pillar;
-            pillar_instance.transform = glm::mat4(1.0f);
-
-            glm::vec3 pos = glm::vec3(-15.0f, 0.0f, ground->min_extents().z + segment_length * (i + 1));
-
-            pillar_instance.transform = glm::translate(pillar_instance.transform, pos);
-
-            instances.push_back(pillar_instance);
-        }
-
-        dw::RayTracedScene::Instance ground_instance;
-
-        ground_instance.mesh      = ground;
-        ground_instance.transform = glm::mat4(1.0f);
-
-        instances.push_back(ground_instance);
-
-        dw::RayTracedScene::Instance bunny_instance;
-
-        bunny_instance.mesh = bunny;
+        instances.push_back({ 2, glm::mat4(1.0f) });
 
         glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(5.0f));
         glm::mat4 R = glm::rotate(glm::mat4(1.0f), glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 0.0f));
 
-        bunny_instance.transform = T * R * S;
+        instances.push_back({ 1, T * R * S });
+    };
 
-        instances.push_back(bunny_instance);
+    descriptions[SCENE_TYPE_REFLECTIONS_TEST].meshes    = { "meshes/reflections_test.gltf" };
+    descriptions[SCENE_TYPE_REFLECTIONS_TEST].instances = { { 0, glm::mat4(1.0f) } };
 
-        scenes.push_back(dw::RayTracedScene::create(backend, instances));
-    }
-
-    {
-        std::vector<dw::RayTracedScene::Instance> instances;
-
-        dw::Mesh::Ptr reflections_test = dw::Mesh::load(backend, "meshes/reflections_test.gltf");
-
-        if (!reflections_test)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
+    descriptions[SCENE_TYPE_GLOBAL_ILLUMINATION_TEST].meshes    = { "meshes/global_illumination_test.gltf" };
+    descriptions[SCENE_TYPE_GLOBAL_ILLUMINATION_TEST].instances = { { 0, glm::mat4(1.0f) } };
 
-        reflections_test->initialize_for_ray_tracing(backend);
+    descriptions[SCENE_TYPE_PICA_PICA].meshes    = { "meshes/scene.gltf" };
+    descriptions[SCENE_TYPE_PICA_PICA].instances = { { 0, glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)) } };
 
-        meshes.push_back(reflections_test);
+    descriptions[SCENE_TYPE_SPONZA].meshes    = { "meshes/sponza.obj" };
+    descriptions[SCENE_TYPE_SPONZA].instances = { { 0, glm::scale(glm::mat4(1.0f), glm::vec3(0.3f)) } };
 
-        dw::RayTracedScene::Instance reflections_test_instance;
-
-        reflections_test_instance.mesh      = reflections_test;
-        reflections_test_instance.transform = glm::mat4(1.0f);
-
-        instances.push_back(reflections_test_instance);
-
-        scenes.push_back(dw::RayTracedScene::create(backend, instances));
-    }
-
-    {
-        std::vector<dw::RayTracedScene::Instance> instances;
-
-        dw::Mesh::Ptr gi_test = dw::Mesh::load(backend, "meshes/global_illumination_test.gltf");
-
-        if (!gi_test)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
-
-        gi_test->initialize_for_ray_tracing(backend);
-
-        meshes.push_back(gi_test);
-
-        dw::RayTracedScene::Instance gi_test_instance;
-
-        gi_test_instance.mesh      = gi_test;
-        gi_test_instance.transform = glm::mat4(1.0f);
-
-        instances.push_back(gi_test_instance);
-
-        scenes.push_back(dw::RayTracedScene::create(backend, instances));
-    }
-
-    {
-        std::vector<dw::RayTracedScene::Instance> instances;
-
-        dw::Mesh::Ptr pica_pica = dw::Mesh::load(backend, "meshes/scene.gltf");
-
-        if (!pica_pica)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
-
-        pica_pica->initialize_for_ray_tracing(backend);
-
-        meshes.push_back(pica_pica);
-
-        dw::RayTracedScene::Instance pica_pica_instance;
-
-        pica_pica_instance.mesh      = pica_pica;
-        pica_pica_instance.transform = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
-
-        instances.push_back(pica_pica_instance);
-
-        scenes.push_back(dw::RayTracedScene::create(backend, instances));
-    }
-
-    {
-        std::vector<dw::RayTracedScene::Instance> instances;
-
-        dw::Mesh::Ptr sponza = dw::Mesh::load(backend, "meshes/sponza.obj");
-
-        if (!sponza)
-        {
-            DW_LOG_ERROR("Failed to load mesh");
-            throw std::runtime_error("Failed to load mesh");
-        }
-
-        sponza->initialize_for_ray_tracing(backend);
-
-        meshes.push_back(sponza);
-
-        dw::RayTracedScene::Instance sponza_instance;
-
-        sponza_instance.mesh      = sponza;
-        sponza_instance.transform = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-
-        instances.push_back(sponza_instance);
-
-        scenes.push_back(dw::RayTracedScene::create(backend, instances));
-    }
+    scene_cache = std::unique_ptr<SceneCache>(new SceneCache(backend, deletion_queue.get(), texture_streamer.get(), descriptions));
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void CommonResources::create_environment_resources(dw::vk::Backend::Ptr backend)
+void CommonResources::create_environment_resources(dw::vk::Backend::Ptr backend, const std::vector<dw::vk::Image::Ptr>& environment_maps)
 {
     // Create procedural sky
     {
@@ -593,34 +477,45 @@ void CommonResources::create_environment_resources(dw::vk::Backend::Ptr backend)
         uploader.submit();
     }
 
-    // Load environment maps
-    std::unique_ptr<dw::EquirectangularToCubemap> equirectangular_to_cubemap = std::unique_ptr<dw::EquirectangularToCubemap>(new dw::EquirectangularToCubemap(backend, VK_FORMAT_R32G32B32A32_SFLOAT));
-
-    hdr_environments.resize(constants::environment_map_images.size());
+    // Convert the environment maps missing from the cache
+    std::unique_ptr<dw::EquirectangularToCubemap> equirectangular_to_cubemap;
 
     for (int i = 0; i < constants::environment_map_images.size(); i++)
     {
+        if (hdr_environments[i])
+            continue;
+
+        if (!equirectangular_to_cubemap)
+            equirectangular_to_cubemap = std::unique_ptr<dw::EquirectangularToCubemap>(new dw::EquirectangularToCubemap(backend, VK_FORMAT_R32G32B32A32_SFLOAT));
+
         std::shared_ptr<HDREnvironment> environment = std::shared_ptr<HDREnvironment>(new HDREnvironment());
 
-        auto input_image = dw::vk::Image::create_from_file(backend, constants::environment_map_images[i], true);
+        environment->image      = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, 1024, 1024, 1, 5, 6, VK_FORMAT_R32G32B32A32_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, nullptr, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+        environment->image_view = dw::vk::ImageView::create(backend, environment->image, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6);
 
-        environment->image                 = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, 1024, 1024, 1, 5, 6, VK_FORMAT_R32G32B32A32_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, nullptr, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
-        environment->image_view            = dw::vk::ImageView::create(backend, environment->image, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6);
-        environment->cubemap_sh_projection = std::unique_ptr<dw::CubemapSHProjection>(new dw::CubemapSHProjection(backend, environment->image));
-        environment->cubemap_prefilter     = std::unique_ptr<dw::CubemapPrefiler>(new dw::CubemapPrefiler(backend, environment->image));
+        dw::CubemapSHProjection cubemap_sh_projection(backend, environment->image);
+        dw::CubemapPrefiler     cubemap_prefilter(backend, environment->image);
 
-        equirectangular_to_cubemap->convert(input_image, environment->image);
+        equirectangular_to_cubemap->convert(environment_maps[i], environment->image);
 
         auto cmd_buf = backend->allocate_graphics_command_buffer(true);
 
         environment->image->generate_mipmaps(cmd_buf);
-        environment->cubemap_sh_projection->update(cmd_buf);
-        environment->cubemap_prefilter->update(cmd_buf);
+        cubemap_sh_projection.update(cmd_buf);
+        cubemap_prefilter.update(cmd_buf);
 
         vkEndCommandBuffer(cmd_buf->handle());
 
         backend->flush_graphics({ cmd_buf });
 
+        // The images outlive the passes that filled them.
+        environment->sh_image               = cubemap_sh_projection.image();
+        environment->sh_image_view          = cubemap_sh_projection.image_view();
+        environment->prefiltered_image      = cubemap_prefilter.image();
+        environment->prefiltered_image_view = cubemap_prefilter.image_view();
+
+        EnvironmentCache::store(backend, constants::environment_map_images[i], *environment);
+
         hdr_environments[i] = environment;
     }
 }
@@ -639,6 +534,8 @@ void CommonResources::create_descriptor_set_layouts(dw::vk::Backend::Ptr backend
             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
         };
 
@@ -646,7 +543,7 @@ void CommonResources::create_descriptor_set_layouts(dw::vk::Backend::Ptr backend
         DW_ZERO_MEMORY(set_layout_binding_flags);
 
         set_layout_binding_flags.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-        set_layout_binding_flags.bindingCount  = 7;
+        set_layout_binding_flags.bindingCount  = 9;
         set_layout_binding_flags.pBindingFlags = descriptor_binding_flags.data();
 
         scene_ds_layout_desc.set_next_ptr(&set_layout_binding_flags);
@@ -657,13 +554,17 @@ void CommonResources::create_descriptor_set_layouts(dw::vk::Backend::Ptr backend
         // Acceleration Structures
         scene_ds_layout_desc.add_binding(2, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
         // Vertex Buffers
-        scene_ds_layout_desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1024, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        scene_ds_layout_desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, TextureStreamer::kMaxSceneBuffers, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
         // Index Buffers
-        scene_ds_layout_desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1024, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        scene_ds_layout_desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, TextureStreamer::kMaxSceneBuffers, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
         // Material Indices Buffers
-        scene_ds_layout_desc.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1024, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        scene_ds_layout_desc.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, TextureStreamer::kMaxSceneBuffers, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
         // Textures
-        scene_ds_layout_desc.add_binding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        scene_ds_layout_desc.add_binding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, TextureStreamer::kFirstTexture + TextureStreamer::kMaxTextures, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        // Streamed Material Data
+        scene_ds_layout_desc.add_binding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
+        // Texture Streaming Feedback
+        scene_ds_layout_desc.add_binding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
 
         scene_ds_layout = dw::vk::DescriptorSetLayout::create(backend, scene_ds_layout_desc);
         scene_ds_layout->set_name("Scene Descriptor Set Layout");
@@ -683,6 +584,7 @@ void CommonResources::create_descriptor_set_layouts(dw::vk::Backend::Ptr backend
 
         desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
         desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
 
         blue_noise_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
         blue_noise_ds_layout->set_name("Blue Noise DS Layout");
@@ -799,7 +701,7 @@ void CommonResources::write_descriptor_sets(dw::vk::Backend::Ptr backend)
         else if (i == ENVIRONMENT_TYPE_PROCEDURAL_SKY)
             image_info[1].imageView = sky_environment->cubemap_sh_projection->image_view()->handle();
         else
-            image_info[1].imageView = hdr_environments[i - 2]->cubemap_sh_projection->image_view()->handle();
+            image_info[1].imageView = hdr_environments[i - 2]->sh_image_view->handle();
         image_info[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         image_info[2].sampler = backend->trilinear_sampler()->handle();
@@ -808,7 +710,7 @@ void CommonResources::write_descriptor_sets(dw::vk::Backend::Ptr backend)
         else if (i == ENVIRONMENT_TYPE_PROCEDURAL_SKY)
             image_info[2].imageView = sky_environment->cubemap_prefilter->image_view()->handle();
         else
-            image_info[2].imageView = hdr_environments[i - 2]->cubemap_prefilter->image_view()->handle();
+            image_info[2].imageView = hdr_environments[i - 2]->prefiltered_image_view->handle();
         image_info[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         image_info[3].sampler     = backend->bilinear_sampler()->handle();
@@ -858,7 +760,7 @@ void CommonResources::write_descriptor_sets(dw::vk::Backend::Ptr backend)
     {
         for (int i = 0; i < 9; i++)
         {
-            VkDescriptorImageInfo image_info[2];
+            VkDescriptorImageInfo image_info[3];
 
             image_info[0].sampler     = backend->nearest_sampler()->handle();
             image_info[0].imageView   = blue_noise->m_sobol_image_view->handle();
@@ -868,9 +770,14 @@ void CommonResources::write_descriptor_sets(dw::vk::Backend::Ptr backend)
             image_info[1].imageView   = blue_noise->m_scrambling_ranking_image_view[i]->handle();
             image_info[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-            VkWriteDescriptorSet write_data[2];
+            image_info[2].sampler     = backend->nearest_sampler()->handle();
+            image_info[2].imageView   = blue_noise->m_spatiotemporal_image_view->handle();
+            image_info[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+            VkWriteDescriptorSet write_data[3];
             DW_ZERO_MEMORY(write_data[0]);
             DW_ZERO_MEMORY(write_data[1]);
+            DW_ZERO_MEMORY(write_data[2]);
 
             write_data[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             write_data[0].descriptorCount = 1;
@@ -886,7 +793,14 @@ void CommonResources::write_descriptor_sets(dw::vk::Backend::Ptr backend)
             write_data[1].dstBinding      = 1;
             write_data[1].dstSet          = blue_noise_ds[i]->handle();
 
-            vkUpdateDescriptorSets(backend->device(), 2, &write_data[0], 0, nullptr);
+            write_data[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data[2].descriptorCount = 1;
+            write_data[2].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write_data[2].pImageInfo      = &image_info[2];
+            write_data[2].dstBinding      = 2;
+            write_data[2].dstSet          = blue_noise_ds[i]->handle();
+
+            vkUpdateDescriptorSets(backend->device(), 3, &write_data[0], 0, nullptr);
         }
     }
 }
@@ -13,6 +13,12 @@
 #include <cubemap_prefilter.h>
 #include <stdexcept>
 #include "blue_noise.h"
+#include "transient_resource_allocator.h"
+#include "deletion_queue.h"
+#include "scene_cache.h"
+#include "texture_streamer.h"
+#include "pipeline_cache.h"
+#include "workgroup_tuner.h"
 
 #define EPSILON 0.0001f
 #define NUM_PILLARS 6
@@ -31,6 +37,7 @@ extern const std::vector<std::string>            scene_types;
 extern const std::vector<std::string>            ray_trace_scales;
 extern const std::vector<std::string>            light_types;
 extern const std::vector<std::string>            camera_types;
+extern const std::vector<std::string>            blue_noise_samplers;
 extern const std::vector<std::vector<glm::vec3>> fixed_camera_position_vectors;
 extern const std::vector<std::vector<glm::vec3>> fixed_camera_forward_vectors;
 extern const std::vector<std::vector<glm::vec3>> fixed_camera_right_vectors;
@@ -97,10 +104,12 @@ struct SkyEnvironment
 
 struct HDREnvironment
 {
-    dw::vk::Image::Ptr                       image;
-    dw::vk::ImageView::Ptr                   image_view;
-    std::unique_ptr<dw::CubemapSHProjection> cubemap_sh_projection;
-    std::unique_ptr<dw::CubemapPrefiler>     cubemap_prefilter;
+    dw::vk::Image::Ptr     image;
+    dw::vk::ImageView::Ptr image_view;
+    dw::vk::Image::Ptr     sh_image;
+    dw::vk::ImageView::Ptr sh_image_view;
+    dw::vk::Image::Ptr     prefiltered_image;
+    dw::vk::ImageView::Ptr prefiltered_image_view;
 };
 
 struct Light
@@ -184,13 +193,18 @@ struct CommonResources
     VisualizationType                            current_visualization_type = VISUALIZATION_TYPE_FINAL;
     EnvironmentType                              current_environment_type   = ENVIRONMENT_TYPE_PROCEDURAL_SKY;
     bool                                         first_frame                = true;
+    bool                                         headless                   = false;
+    uint32_t                                     output_width               = 0;
+    uint32_t                                     output_height              = 0;
     bool                                         ping_pong                  = false;
     int32_t                                      num_frames                 = 0;
+    VkPhysicalDeviceFeatures                     enabled_features           = {}; // Vulkan only reports support, the owner of the device fills in what it enabled.
     size_t                                       ubo_size                   = 0;
     glm::vec4                                    z_buffer_params;
     glm::vec3                                    camera_delta         = glm::vec3(0.0f);
     float                                        frame_time           = 0.0f;
     float                                        roughness_multiplier = 1.0f;
+    BlueNoiseSampler                             blue_noise_sampler   = BLUE_NOISE_SAMPLER_SOBOL; // Random samples of the ray traced shadows, AO and reflections.
     glm::vec3                                    position;
     glm::vec3                                    prev_position;
     glm::mat4                                    view;
@@ -199,8 +213,10 @@ struct CommonResources
     std::vector<std::unique_ptr<dw::DemoPlayer>> demo_players;
 
     // Assets.
-    std::vector<dw::Mesh::Ptr>           meshes;
-    std::vector<dw::RayTracedScene::Ptr> scenes;
+    std::unique_ptr<TextureStreamer> texture_streamer; // Mips of material textures, modules bind its copy of the scene descriptor set.
+    std::unique_ptr<SceneCache>      scene_cache;      // Scenes are loaded the first time they become active.
+    std::unique_ptr<PipelineCache>   pipeline_cache;   // Modules queue their pipelines here, they are created together once all modules exist.
+    std::unique_ptr<WorkgroupTuner>  workgroup_tuner;  // Workgroup sizes of the compute passes registered with it, tuned per device.
 
     // Common
     dw::vk::DescriptorSet::Ptr                   per_frame_ds;
@@ -226,18 +242,20 @@ struct CommonResources
     std::unique_ptr<SkyEnvironment>              sky_environment;
     std::vector<std::shared_ptr<HDREnvironment>> hdr_environments;
     std::unique_ptr<dw::BRDFIntegrateLUT>        brdf_preintegrate_lut;
+    std::unique_ptr<TransientResourceAllocator>  transient_allocator;
+    std::unique_ptr<DeletionQueue>               deletion_queue; // Destroyed first, pending transient images are released through it.
 
     CommonResources(dw::vk::Backend::Ptr backend);
     ~CommonResources();
 
     void write_descriptor_sets(dw::vk::Backend::Ptr backend);
 
-    inline dw::RayTracedScene::Ptr current_scene() { return scenes[current_scene_type]; }
+    inline dw::RayTracedScene::Ptr current_scene() { return scene_cache->acquire(current_scene_type); }
 
 private:
     void create_uniform_buffer(dw::vk::Backend::Ptr backend);
-    void load_mesh(dw::vk::Backend::Ptr backend);
-    void create_environment_resources(dw::vk::Backend::Ptr backend);
+    void create_scene_cache(dw::vk::Backend::Ptr backend);
+    void create_environment_resources(dw::vk::Backend::Ptr backend, const std::vector<dw::vk::Image::Ptr>& environment_maps);
     void create_descriptor_set_layouts(dw::vk::Backend::Ptr backend);
     void create_descriptor_sets(dw::vk::Backend::Ptr backend);
 };
\ No newline at end of file
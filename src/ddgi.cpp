@@ -1,4 +1,5 @@
 #include "ddgi.h"
+#include "shader_library.h"
 #include "g_buffer.h"
 #include <stdexcept>
 #include <logger.h>
@@ -9,6 +10,9 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+// The workgroup size of the sample probe grid pass is tuned per device, under the name the render graph reports it with.
+static const char* SAMPLE_PROBE_GRID_PASS = "DDGI/Sample Probe Grid";
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct DDGIUniforms
@@ -61,21 +65,16 @@ struct SampleProbeGridPushConstants
 DDGI::DDGI(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale) :
     m_backend(backend), m_common_resources(common_resources), m_g_buffer(g_buffer), m_scale(scale)
 {
-    auto vk_backend = m_backend.lock();
-
-    float scale_divisor = powf(2.0f, float(scale));
-
-    m_width  = vk_backend->swap_chain_extents().width / scale_divisor;
-    m_height = vk_backend->swap_chain_extents().height / scale_divisor;
-
-    m_g_buffer_mip = static_cast<uint32_t>(scale);
+    update_dimensions();
 
     m_random_generator       = std::mt19937(m_random_device());
     m_random_distribution_zo = std::uniform_real_distribution<float>(0.0f, 1.0f);
     m_random_distribution_no = std::uniform_real_distribution<float>(-1.0f, 1.0f);
 
     create_descriptor_sets();
-    create_pipelines();
+    create_sample_probe_grid();
+    m_common_resources->workgroup_tuner->add_pass(SAMPLE_PROBE_GRID_PASS, { 32, 32 });
+    m_common_resources->pipeline_cache->queue([this]() { create_pipelines(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -86,18 +85,84 @@ DDGI::~DDGI()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DDGI::render(dw::vk::CommandBuffer::Ptr cmd_buf)
+void DDGI::render(RenderGraph& graph)
 {
-    DW_SCOPED_SAMPLE("DDGI", cmd_buf);
+    graph.begin_group("DDGI");
 
     // If the scene has changed re-initialize the probe grid
     if (m_last_scene_id != m_common_resources->current_scene()->id())
         initialize_probe_grid();
 
     update_properties_ubo();
-    ray_trace(cmd_buf);
-    probe_update(cmd_buf);
-    sample_probe_grid(cmd_buf);
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    // The ping-pong state flips once all passes are registered, so the recorded passes capture it by value.
+    bool     ping_pong   = m_ping_pong;
+    bool     first_frame = m_first_frame;
+    uint32_t read_idx    = static_cast<uint32_t>(!ping_pong);
+    uint32_t write_idx   = static_cast<uint32_t>(ping_pong);
+
+    graph.add_pass(
+        "Ray Trace",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.set_queue(RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+            builder.bind_untracked_resources(); // Acceleration structure, scene textures and per-frame uniforms.
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_UNIFORM_READ_BIT, m_probe_grid.properties_ubo);
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[read_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[read_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.radiance_image, subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.direction_depth_image, subresource_range);
+        },
+        [this, ping_pong, first_frame](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            ray_trace(cmd_buf, ping_pong, first_frame);
+        });
+
+    graph.add_pass(
+        "Probe Update",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.record_on_main_thread();
+            builder.set_queue(RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, m_probe_grid.properties_ubo);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.depth_image[write_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[read_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[read_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.radiance_image, subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.direction_depth_image, subresource_range);
+        },
+        [this, ping_pong, first_frame](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            probe_update(cmd_buf, true, ping_pong, first_frame);
+            probe_update(cmd_buf, false, ping_pong, first_frame);
+        });
+
+    graph.add_pass(
+        "Border Update",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.record_on_main_thread();
+            builder.set_queue(RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.depth_image[write_idx], subresource_range);
+        },
+        [this, ping_pong](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            border_update(cmd_buf, true, ping_pong);
+            border_update(cmd_buf, false, ping_pong);
+        });
+
+    graph.add_pass(
+        "Sample Probe Grid",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_sample_probe_grid.image, subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, m_probe_grid.properties_ubo);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[write_idx], subresource_range);
+            m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+        },
+        [this, ping_pong](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            sample_probe_grid(cmd_buf, ping_pong);
+        });
+
+    graph.end_group();
 
     m_first_frame = false;
     m_ping_pong   = !m_ping_pong;
@@ -139,6 +204,24 @@ dw::vk::DescriptorSet::Ptr DDGI::current_read_ds()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+dw::vk::Image::Ptr DDGI::output_image()
+{
+    return m_sample_probe_grid.image;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DDGI::use_probe_grid(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages)
+{
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[static_cast<uint32_t>(!m_ping_pong)], subresource_range);
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[static_cast<uint32_t>(!m_ping_pong)], subresource_range);
+    builder.use_resource(stages, VK_ACCESS_2_UNIFORM_READ_BIT, m_probe_grid.properties_ubo);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 uint32_t DDGI::current_ubo_offset()
 {
     auto vk_backend = m_backend.lock();
@@ -147,6 +230,39 @@ uint32_t DDGI::current_ubo_offset()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void DDGI::set_scale(RayTraceScale scale)
+{
+    if (scale == m_scale)
+        return;
+
+    // Only the output depends on the resolution, the probe grid itself carries over.
+    DeletionQueue* queue = m_common_resources->deletion_queue.get();
+
+    queue->push(m_sample_probe_grid.image);
+    queue->push(m_sample_probe_grid.image_view);
+    queue->push(m_sample_probe_grid.write_ds);
+    queue->push(m_sample_probe_grid.read_ds);
+
+    m_scale = scale;
+
+    update_dimensions();
+    create_sample_probe_grid();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DDGI::update_dimensions()
+{
+    float scale_divisor = powf(2.0f, float(m_scale));
+
+    m_width  = m_common_resources->output_width / scale_divisor;
+    m_height = m_common_resources->output_height / scale_divisor;
+
+    m_g_buffer_mip = static_cast<uint32_t>(m_scale);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void DDGI::initialize_probe_grid()
 {
     // Get the min and max extents of the scene.
@@ -215,15 +331,6 @@ void DDGI::create_images()
             m_probe_grid.depth_view[i]->set_name("DDGI Depth Probe Grid " + std::to_string(i));
         }
     }
-
-    // Sample Probe Grid
-    {
-        m_sample_probe_grid.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_sample_probe_grid.image->set_name("DDGI Sample Probe Grid");
-
-        m_sample_probe_grid.image_view = dw::vk::ImageView::create(backend, m_sample_probe_grid.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_sample_probe_grid.image_view->set_name("DDGI Sample Probe Grid");
-    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -281,15 +388,6 @@ void DDGI::create_descriptor_sets()
         m_probe_grid.write_ds[i] = backend->allocate_descriptor_set(m_probe_grid.write_ds_layout);
         m_probe_grid.read_ds[i]  = backend->allocate_descriptor_set(m_common_resources->ddgi_read_ds_layout);
     }
-
-    // Sample Probe Grid
-    {
-        m_sample_probe_grid.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
-        m_sample_probe_grid.write_ds->set_name("DDGI Sample Probe Grid");
-
-        m_sample_probe_grid.read_ds = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
-        m_sample_probe_grid.read_ds->set_name("DDGI Sample Probe Grid");
-    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -537,6 +635,25 @@ void DDGI::write_descriptor_sets()
 
         vkUpdateDescriptorSets(backend->device(), write_datas.size(), write_datas.data(), 0, nullptr);
     }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DDGI::create_sample_probe_grid()
+{
+    auto backend = m_backend.lock();
+
+    m_sample_probe_grid.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_sample_probe_grid.image->set_name("DDGI Sample Probe Grid");
+
+    m_sample_probe_grid.image_view = dw::vk::ImageView::create(backend, m_sample_probe_grid.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_sample_probe_grid.image_view->set_name("DDGI Sample Probe Grid");
+
+    m_sample_probe_grid.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
+    m_sample_probe_grid.write_ds->set_name("DDGI Sample Probe Grid");
+
+    m_sample_probe_grid.read_ds = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
+    m_sample_probe_grid.read_ds->set_name("DDGI Sample Probe Grid");
 
     // Sample Probe Grid write
     {
@@ -595,9 +712,9 @@ void DDGI::create_pipelines()
         // Create shader modules
         // ---------------------------------------------------------------------------
 
-        dw::vk::ShaderModule::Ptr rgen  = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_ray_trace.rgen.spv");
-        dw::vk::ShaderModule::Ptr rchit = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_ray_trace.rchit.spv");
-        dw::vk::ShaderModule::Ptr rmiss = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_ray_trace.rmiss.spv");
+        dw::vk::ShaderModule::Ptr rgen  = ShaderLibrary::load(vk_backend, "shaders/gi_ray_trace.rgen.spv");
+        dw::vk::ShaderModule::Ptr rchit = ShaderLibrary::load(vk_backend, "shaders/gi_ray_trace.rchit.spv");
+        dw::vk::ShaderModule::Ptr rmiss = ShaderLibrary::load(vk_backend, "shaders/gi_ray_trace.rmiss.spv");
 
         dw::vk::ShaderBindingTable::Desc sbt_desc;
 
@@ -629,7 +746,7 @@ void DDGI::create_pipelines()
 
         desc.set_pipeline_layout(m_ray_trace.pipeline_layout);
 
-        m_ray_trace.pipeline = dw::vk::RayTracingPipeline::create(vk_backend, desc);
+        m_ray_trace.pipeline = dw::vk::RayTracingPipeline::create(vk_backend, desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Probe Update
@@ -656,11 +773,11 @@ void DDGI::create_pipelines()
 
         for (int i = 0; i < 2; i++)
         {
-            dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(vk_backend, shaders[i]);
+            dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, shaders[i]);
 
             comp_desc.set_shader_stage(module, "main");
 
-            m_probe_update.pipeline[i] = dw::vk::ComputePipeline::create(vk_backend, comp_desc);
+            m_probe_update.pipeline[i] = dw::vk::ComputePipeline::create(vk_backend, comp_desc, m_common_resources->pipeline_cache->handle());
         }
     }
 
@@ -684,11 +801,11 @@ void DDGI::create_pipelines()
 
         for (int i = 0; i < 2; i++)
         {
-            dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(vk_backend, shaders[i]);
+            dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, shaders[i]);
 
             comp_desc.set_shader_stage(module, "main");
 
-            m_border_update.pipeline[i] = dw::vk::ComputePipeline::create(vk_backend, comp_desc);
+            m_border_update.pipeline[i] = dw::vk::ComputePipeline::create(vk_backend, comp_desc, m_common_resources->pipeline_cache->handle());
         }
     }
 
@@ -706,15 +823,15 @@ void DDGI::create_pipelines()
         m_sample_probe_grid.pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, desc);
         m_sample_probe_grid.pipeline_layout->set_name("Sample Probe Grid Pipeline Layout");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
-
-        comp_desc.set_pipeline_layout(m_sample_probe_grid.pipeline_layout);
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, "shaders/gi_sample_probe_grid.comp.spv");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_sample_probe_grid.comp.spv");
+        m_sample_probe_grid.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(vk_backend, m_common_resources->pipeline_cache->handle(), module, m_sample_probe_grid.pipeline_layout, "Sample Probe Grid"));
 
-        comp_desc.set_shader_stage(module, "main");
+        WorkgroupSize size = m_common_resources->workgroup_tuner->size(SAMPLE_PROBE_GRID_PASS);
 
-        m_sample_probe_grid.pipeline = dw::vk::ComputePipeline::create(vk_backend, comp_desc);
+        // Both settings of the visibility test are created up front so toggling it in the UI does not stall a frame.
+        m_sample_probe_grid.pipeline->variant({ size.x, size.y, 1 });
+        m_sample_probe_grid.pipeline->variant({ size.x, size.y, 0 });
     }
 }
 
@@ -764,30 +881,17 @@ void DDGI::update_properties_ubo()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DDGI::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
+void DDGI::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, bool ping_pong, bool first_frame)
 {
-    DW_SCOPED_SAMPLE("Ray Trace", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    uint32_t read_idx = static_cast<uint32_t>(!m_ping_pong);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[read_idx], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[read_idx], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.radiance_image, subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.direction_depth_image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_ray_trace.pipeline->handle());
 
     RayTracePushConstants push_constants;
 
     push_constants.random_orientation = glm::mat4_cast(glm::angleAxis(m_random_distribution_zo(m_random_generator) * (float(M_PI) * 2.0f), glm::normalize(glm::vec3(m_random_distribution_no(m_random_generator), m_random_distribution_no(m_random_generator), m_random_distribution_no(m_random_generator)))));
     push_constants.num_frames         = m_common_resources->num_frames;
-    push_constants.infinite_bounces   = m_ray_trace.infinite_bounces && !m_first_frame ? 1u : 0u;
+    push_constants.infinite_bounces   = m_ray_trace.infinite_bounces && !first_frame ? 1u : 0u;
     push_constants.gi_intensity       = m_ray_trace.infinite_bounce_intensity;
 
     vkCmdPushConstants(cmd_buf->handle(), m_ray_trace.pipeline_layout->handle(), VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0, sizeof(push_constants), &push_constants);
@@ -798,11 +902,11 @@ void DDGI::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
     };
 
     VkDescriptorSet descriptor_sets[] = {
-        m_common_resources->current_scene()->descriptor_set()->handle(),
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
         m_ray_trace.write_ds->handle(),
         m_common_resources->per_frame_ds->handle(),
         m_common_resources->current_skybox_ds->handle(),
-        m_probe_grid.read_ds[static_cast<uint32_t>(!m_ping_pong)]->handle(),
+        m_probe_grid.read_ds[static_cast<uint32_t>(!ping_pong)]->handle(),
     };
 
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_ray_trace.pipeline_layout->handle(), 0, 5, descriptor_sets, 2, dynamic_offsets);
@@ -817,49 +921,11 @@ void DDGI::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
     uint32_t num_total_probes = m_probe_grid.probe_counts.x * m_probe_grid.probe_counts.y * m_probe_grid.probe_counts.z;
 
     vkCmdTraceRaysKHR(cmd_buf->handle(), &raygen_sbt, &miss_sbt, &hit_sbt, &callable_sbt, m_ray_trace.rays_per_probe, num_total_probes, 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.radiance_image, subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.direction_depth_image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-}
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
-void DDGI::probe_update(dw::vk::CommandBuffer::Ptr cmd_buf)
-{
-    DW_SCOPED_SAMPLE("Probe Update", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    uint32_t write_idx = static_cast<uint32_t>(m_ping_pong);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.depth_image[write_idx], subresource_range);
-    
-    backend->flush_barriers(cmd_buf);
-
-    probe_update(cmd_buf, true);
-    probe_update(cmd_buf, false);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_probe_grid.depth_image[write_idx], subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
-    border_update(cmd_buf);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.irradiance_image[write_idx], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_probe_grid.depth_image[write_idx], subresource_range);
-
-    backend->flush_barriers(cmd_buf);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DDGI::probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
+void DDGI::probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance, bool ping_pong, bool first_frame)
 {
     DW_SCOPED_SAMPLE(is_irradiance ? "Irradiance" : "Depth", cmd_buf);
 
@@ -874,12 +940,12 @@ void DDGI::probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
 
     ProbeUpdatePushConstants push_constants;
 
-    push_constants.first_frame = (uint32_t)m_first_frame;
+    push_constants.first_frame = (uint32_t)first_frame;
 
     vkCmdPushConstants(cmd_buf->handle(), m_probe_update.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
-    uint32_t read_idx  = static_cast<uint32_t>(!m_ping_pong);
-    uint32_t write_idx = static_cast<uint32_t>(m_ping_pong);
+    uint32_t read_idx  = static_cast<uint32_t>(!ping_pong);
+    uint32_t write_idx = static_cast<uint32_t>(ping_pong);
 
     VkDescriptorSet descriptor_sets[] = {
         m_probe_grid.write_ds[write_idx]->handle(),
@@ -901,17 +967,7 @@ void DDGI::probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DDGI::border_update(dw::vk::CommandBuffer::Ptr cmd_buf)
-{
-    DW_SCOPED_SAMPLE("Border Update", cmd_buf);
-
-    border_update(cmd_buf, true);
-    border_update(cmd_buf, false);
-}
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
-void DDGI::border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
+void DDGI::border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance, bool ping_pong)
 {
     DW_SCOPED_SAMPLE(is_irradiance ? "Irradiance" : "Depth", cmd_buf);
 
@@ -924,7 +980,7 @@ void DDGI::border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
 
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 
-    uint32_t write_idx = static_cast<uint32_t>(m_ping_pong);
+    uint32_t write_idx = static_cast<uint32_t>(ping_pong);
 
     VkDescriptorSet descriptor_sets[] = {
         m_probe_grid.write_ds[write_idx]->handle()
@@ -940,19 +996,13 @@ void DDGI::border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DDGI::sample_probe_grid(dw::vk::CommandBuffer::Ptr cmd_buf)
+void DDGI::sample_probe_grid(dw::vk::CommandBuffer::Ptr cmd_buf, bool ping_pong)
 {
-    DW_SCOPED_SAMPLE("Sample Probe Grid", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(SAMPLE_PROBE_GRID_PASS);
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_sample_probe_grid.image, subresource_range);
-    
-    backend->flush_barriers(cmd_buf);
-  
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_sample_probe_grid.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_sample_probe_grid.pipeline->variant({ size.x, size.y, m_probe_grid.visibility_test ? 1u : 0u }));
 
     SampleProbeGridPushConstants push_constants;
 
@@ -968,21 +1018,14 @@ void DDGI::sample_probe_grid(dw::vk::CommandBuffer::Ptr cmd_buf)
 
     VkDescriptorSet descriptor_sets[] = {
         m_sample_probe_grid.write_ds->handle(),
-        m_probe_grid.read_ds[static_cast<uint32_t>(m_ping_pong)]->handle(),
+        m_probe_grid.read_ds[static_cast<uint32_t>(ping_pong)]->handle(),
         m_g_buffer->output_ds()->handle(),
         m_common_resources->per_frame_ds->handle()
     };
 
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_sample_probe_grid.pipeline_layout->handle(), 0, 4, descriptor_sets, 2, dynamic_offsets);
 
-    const int NUM_THREADS_X = 32;
-    const int NUM_THREADS_Y = 32;
-
-    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_sample_probe_grid.image->width()) / float(NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_sample_probe_grid.image->height()) / float(NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_sample_probe_grid.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
+    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_sample_probe_grid.image->width()) / float(size.x))), static_cast<uint32_t>(ceil(float(m_sample_probe_grid.image->height()) / float(size.y))), 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
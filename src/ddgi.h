@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.h"
+#include "render_graph.h"
+#include "specialized_pipeline.h"
 
 #include <random>
 
@@ -12,11 +14,14 @@ public:
     DDGI(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale = RAY_TRACE_SCALE_FULL_RES);
     ~DDGI();
 
-    void                       render(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                       render(RenderGraph& graph);
     void                       gui();
     dw::vk::DescriptorSet::Ptr output_ds();
     dw::vk::DescriptorSet::Ptr current_read_ds();
+    dw::vk::Image::Ptr         output_image();
+    void                       use_probe_grid(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages);
     uint32_t                   current_ubo_offset();
+    void                       set_scale(RayTraceScale scale);
 
     inline uint32_t      width() { return m_width; }
     inline uint32_t      height() { return m_height; }
@@ -33,20 +38,20 @@ public:
     inline void          restart_accumulation() { m_first_frame = true; }
 
 private:
+    void update_dimensions();
     void initialize_probe_grid();
     void create_images();
     void create_buffers();
     void create_descriptor_sets();
     void write_descriptor_sets();
+    void create_sample_probe_grid();
     void create_pipelines();
     void recreate_probe_grid_resources();
     void update_properties_ubo();
-    void ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void probe_update(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance);
-    void border_update(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance);
-    void sample_probe_grid(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, bool ping_pong, bool first_frame);
+    void probe_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance, bool ping_pong, bool first_frame);
+    void border_update(dw::vk::CommandBuffer::Ptr cmd_buf, bool is_irradiance, bool ping_pong);
+    void sample_probe_grid(dw::vk::CommandBuffer::Ptr cmd_buf, bool ping_pong);
 
 private:
     struct RayTrace
@@ -99,13 +104,13 @@ private:
 
     struct SampleProbeGrid
     {
-        float                        gi_intensity = 1.0f;
-        dw::vk::Image::Ptr           image;
-        dw::vk::ImageView::Ptr       image_view;
-        dw::vk::ComputePipeline::Ptr pipeline;
-        dw::vk::PipelineLayout::Ptr  pipeline_layout;
-        dw::vk::DescriptorSet::Ptr   write_ds;
-        dw::vk::DescriptorSet::Ptr   read_ds;
+        float                                       gi_intensity = 1.0f;
+        dw::vk::Image::Ptr                          image;
+        dw::vk::ImageView::Ptr                      image_view;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::PipelineLayout::Ptr                 pipeline_layout;
+        dw::vk::DescriptorSet::Ptr                  write_ds;
+        dw::vk::DescriptorSet::Ptr                  read_ds;
     };
 
     struct BorderUpdate
@@ -1,4 +1,5 @@
 #include "deferred_shading.h"
+#include "shader_library.h"
 #include "ray_traced_ao.h"
 #include "ray_traced_shadows.h"
 #include "ray_traced_reflections.h"
@@ -44,7 +45,7 @@ DeferredShading::DeferredShading(std::weak_ptr<dw::vk::Backend> backend, CommonR
     create_images();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipeline();
+    m_common_resources->pipeline_cache->queue([this]() { create_pipeline(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -55,24 +56,46 @@ DeferredShading::~DeferredShading()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DeferredShading::render(dw::vk::CommandBuffer::Ptr cmd_buf,
-                             RayTracedAO*               ao,
-                             RayTracedShadows*          shadows,
-                             RayTracedReflections*      reflections,
-                             DDGI*                      ddgi)
+void DeferredShading::render(RenderGraph&          graph,
+                             RayTracedAO*          ao,
+                             RayTracedShadows*     shadows,
+                             RayTracedReflections* reflections,
+                             DDGI*                 ddgi)
 {
-    DW_SCOPED_SAMPLE("Deferred Shading", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    render_shading(cmd_buf, ao, shadows, reflections, ddgi);
-    render_skybox(cmd_buf, ddgi);
+    graph.begin_group("Deferred Shading");
 
     VkImageSubresourceRange color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkImageSubresourceRange depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, m_g_buffer->depth_image()->mip_levels(), 0, 1 };
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_shading.image, color_subresource_range);
-
-    backend->flush_barriers(cmd_buf);
+    graph.add_pass(
+        "Opaque",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_shading.image, color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ao->output_image(), color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shadows->output_image(), color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, reflections->output_image(), color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ddgi->output_image(), color_subresource_range);
+            m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+        },
+        [this, ao, shadows, reflections, ddgi](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            render_shading(cmd_buf, ao, shadows, reflections, ddgi);
+        });
+
+    graph.add_pass(
+        "Skybox",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.record_on_main_thread();
+            builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_shading.image, color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, m_g_buffer->depth_image(), depth_subresource_range);
+
+            if (m_visualize_probe_grid.enabled)
+                ddgi->use_probe_grid(builder, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+        },
+        [this, ddgi](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            render_skybox(cmd_buf, ddgi);
+        });
+
+    graph.end_group();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -271,8 +294,8 @@ void DeferredShading::create_images()
 {
     auto vk_backend = m_backend.lock();
 
-    m_width  = vk_backend->swap_chain_extents().width;
-    m_height = vk_backend->swap_chain_extents().height;
+    m_width  = m_common_resources->output_width;
+    m_height = m_common_resources->output_height;
 
     // Shading
     {
@@ -355,8 +378,8 @@ void DeferredShading::create_pipeline()
         // Create shader modules
         // ---------------------------------------------------------------------------
 
-        dw::vk::ShaderModule::Ptr vs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/skybox.vert.spv");
-        dw::vk::ShaderModule::Ptr fs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/skybox.frag.spv");
+        dw::vk::ShaderModule::Ptr vs = ShaderLibrary::load(vk_backend, "shaders/skybox.vert.spv");
+        dw::vk::ShaderModule::Ptr fs = ShaderLibrary::load(vk_backend, "shaders/skybox.frag.spv");
 
         dw::vk::GraphicsPipeline::Desc pso_desc;
 
@@ -488,7 +511,7 @@ void DeferredShading::create_pipeline()
         // Create pipeline
         // ---------------------------------------------------------------------------
 
-        m_skybox.pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc);
+        m_skybox.pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Visualize Probe Grid
@@ -499,8 +522,8 @@ void DeferredShading::create_pipeline()
         // Create shader modules
         // ---------------------------------------------------------------------------
 
-        dw::vk::ShaderModule::Ptr vs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_probe_visualization.vert.spv");
-        dw::vk::ShaderModule::Ptr fs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/gi_probe_visualization.frag.spv");
+        dw::vk::ShaderModule::Ptr vs = ShaderLibrary::load(vk_backend, "shaders/gi_probe_visualization.vert.spv");
+        dw::vk::ShaderModule::Ptr fs = ShaderLibrary::load(vk_backend, "shaders/gi_probe_visualization.frag.spv");
 
         dw::vk::GraphicsPipeline::Desc pso_desc;
 
@@ -540,8 +563,8 @@ void DeferredShading::create_pipeline()
 
         dw::vk::ViewportStateDesc vp_desc;
 
-        vp_desc.add_viewport(0.0f, 0.0f, vk_backend->swap_chain_extents().width, vk_backend->swap_chain_extents().height, 0.0f, 1.0f)
-            .add_scissor(0, 0, vk_backend->swap_chain_extents().width, vk_backend->swap_chain_extents().height);
+        vp_desc.add_viewport(0.0f, 0.0f, m_common_resources->output_width, m_common_resources->output_height, 0.0f, 1.0f)
+            .add_scissor(0, 0, m_common_resources->output_width, m_common_resources->output_height);
 
         pso_desc.set_viewport_state(vp_desc);
 
@@ -637,7 +660,7 @@ void DeferredShading::create_pipeline()
         // Create pipeline
         // ---------------------------------------------------------------------------
 
-        m_visualize_probe_grid.pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc);
+        m_visualize_probe_grid.pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc, m_common_resources->pipeline_cache->handle());
     }
 }
 
@@ -649,16 +672,8 @@ void DeferredShading::render_shading(dw::vk::CommandBuffer::Ptr cmd_buf,
                                      RayTracedReflections*      reflections,
                                      DDGI*                      ddgi)
 {
-    DW_SCOPED_SAMPLE("Opaque", cmd_buf);
-
     auto vk_backend = m_backend.lock();
 
-    VkImageSubresourceRange color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-    
-    vk_backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_shading.image, color_subresource_range);
-    
-    vk_backend->flush_barriers(cmd_buf);
-
     VkRenderingAttachmentInfoKHR color_attachment = {};
 
     color_attachment.sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
@@ -733,18 +748,6 @@ void DeferredShading::render_shading(dw::vk::CommandBuffer::Ptr cmd_buf,
 
 void DeferredShading::render_skybox(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* ddgi)
 {
-    DW_SCOPED_SAMPLE("Skybox", cmd_buf);
-
-    auto vk_backend = m_backend.lock();
-
-    VkImageSubresourceRange color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-    VkImageSubresourceRange depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, m_g_buffer->depth_image()->mip_levels(), 0, 1 };
-
-    vk_backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_shading.image, color_subresource_range);
-    vk_backend->use_resource(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, m_g_buffer->depth_image(), depth_subresource_range);
-
-    vk_backend->flush_barriers(cmd_buf);
-
     VkRenderingAttachmentInfoKHR color_attachment = {};
 
     color_attachment.sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
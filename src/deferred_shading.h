@@ -5,6 +5,7 @@
 #include <cubemap_sh_projection.h>
 #include <cubemap_prefilter.h>
 #include <mesh.h>
+#include "render_graph.h"
 
 struct CommonResources;
 class GBuffer;
@@ -19,11 +20,11 @@ public:
     DeferredShading(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer);
     ~DeferredShading();
 
-    void render(dw::vk::CommandBuffer::Ptr cmd_buf,
-                RayTracedAO*               ao,
-                RayTracedShadows*          shadows,
-                RayTracedReflections*      reflections,
-                DDGI*                      ddhgi);
+    void render(RenderGraph&          graph,
+                RayTracedAO*          ao,
+                RayTracedShadows*     shadows,
+                RayTracedReflections* reflections,
+                DDGI*                 ddhgi);
 
     dw::vk::DescriptorSet::Ptr output_ds();
     dw::vk::Image::Ptr         output_image();
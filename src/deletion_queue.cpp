@@ -0,0 +1,73 @@
+#include "deletion_queue.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DeletionQueue::DeletionQueue(std::weak_ptr<dw::vk::Backend> backend) :
+    m_backend(backend)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DeletionQueue::~DeletionQueue()
+{
+    flush_all();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DeletionQueue::push(std::shared_ptr<void> object)
+{
+    if (!object)
+        return;
+
+    auto backend = m_backend.lock();
+
+    m_frames[backend->current_frame_idx()].objects.push_back(object);
+    m_num_pending++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DeletionQueue::push_function(std::function<void()> function)
+{
+    auto backend = m_backend.lock();
+
+    m_frames[backend->current_frame_idx()].functions.push_back(function);
+    m_num_pending++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DeletionQueue::flush()
+{
+    auto backend = m_backend.lock();
+
+    release(m_frames[backend->current_frame_idx()]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DeletionQueue::flush_all()
+{
+    for (auto& frame : m_frames)
+        release(frame);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DeletionQueue::release(Frame& frame)
+{
+    m_num_pending -= (uint32_t)(frame.objects.size() + frame.functions.size());
+
+    frame.objects.clear();
+
+    // Functions may queue more work (e.g. freeing memory once the last image using it is gone), so they run on a copy.
+    std::vector<std::function<void()>> functions;
+    functions.swap(frame.functions);
+
+    for (auto& function : functions)
+        function();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
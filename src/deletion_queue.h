@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vk.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Keeps objects that may still be referenced by frames in flight alive until the GPU is done with them. Objects
+// queued during a frame are released when the same frame in flight comes around again, which is after its fence
+// has been waited on, so replacing resources never requires idling the device.
+class DeletionQueue
+{
+public:
+    DeletionQueue(std::weak_ptr<dw::vk::Backend> backend);
+    ~DeletionQueue();
+
+    void push(std::shared_ptr<void> object);
+    void push_function(std::function<void()> function);
+
+    // Has to be called once per frame before anything is queued, after the frame fence has been waited on.
+    void flush();
+
+    // Releases everything at once, the device has to be idle.
+    void flush_all();
+
+    inline uint32_t num_pending() { return m_num_pending; }
+
+private:
+    struct Frame
+    {
+        std::vector<std::shared_ptr<void>>  objects;
+        std::vector<std::function<void()>> functions;
+    };
+
+    void release(Frame& frame);
+
+private:
+    std::weak_ptr<dw::vk::Backend> m_backend;
+    Frame                          m_frames[dw::vk::Backend::kMaxFramesInFlight];
+    uint32_t                       m_num_pending = 0;
+};
@@ -0,0 +1,725 @@
+#include "draw_culler.h"
+#include "g_buffer.h"
+#include "shader_library.h"
+#include "common.h"
+#include "mesh_cache.h"
+#include <logger.h>
+#include <macros.h>
+#include <imgui.h>
+#include <mesh.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+#define CULL_NUM_THREADS 64
+#define HI_Z_NUM_THREADS_X 8
+#define HI_Z_NUM_THREADS_Y 8
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct DrawData
+{
+    glm::mat4 model;
+    glm::vec4 center;
+    glm::vec4 extents;
+    uint32_t  material_index;
+    uint32_t  index_count;
+    uint32_t  first_index;
+    int32_t   vertex_offset;
+    uint32_t  group;
+    uint32_t  first_instance;
+    uint32_t  instance_idx;
+    uint32_t  padding;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct CullPushConstants
+{
+    glm::vec4 frustum_planes[6];
+    uint32_t  num_draws;
+    uint32_t  num_groups;
+    uint32_t  phase;
+    uint32_t  frustum_culling;
+    uint32_t  occlusion_culling;
+    uint32_t  stats_offset;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct HiZPushConstants
+{
+    glm::ivec2 source_size;
+    uint32_t   level;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t previous_power_of_two(uint32_t value)
+{
+    uint32_t result = 1;
+
+    while (result * 2 <= value)
+        result *= 2;
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DrawCuller::DrawCuller(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, uint32_t input_width, uint32_t input_height) :
+    m_backend(backend), m_common_resources(common_resources), m_g_buffer(g_buffer)
+{
+    auto vk_backend = m_backend.lock();
+
+    // Culled counts of every frame in flight, read back once the frame has finished.
+    m_stats_buffer = dw::vk::Buffer::create(vk_backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t) * CULL_STAT_COUNT * dw::vk::Backend::kMaxFramesInFlight, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_stats_buffer->set_name("Cull Stats Buffer");
+
+    memset(m_stats_buffer->mapped_ptr(), 0, sizeof(uint32_t) * CULL_STAT_COUNT * dw::vk::Backend::kMaxFramesInFlight);
+    memset(&m_stats[0], 0, sizeof(m_stats));
+
+    const VkPhysicalDeviceFeatures& features = m_common_resources->enabled_features;
+
+    m_multi_draw = features.multiDrawIndirect == VK_TRUE && features.drawIndirectFirstInstance == VK_TRUE;
+
+    if (!m_multi_draw)
+        DW_LOG_INFO("multiDrawIndirect or drawIndirectFirstInstance not enabled, every submesh will be drawn with its own indirect command");
+
+    create_descriptor_set_layout();
+    create_hi_z(input_width, input_height);
+    m_common_resources->pipeline_cache->queue([this]() { create_pipeline(); });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DrawCuller::~DrawCuller()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::update(dw::RayTracedScene::Ptr scene)
+{
+    if (m_scene_id != scene->id())
+        create_buffers(scene);
+
+    auto backend = m_backend.lock();
+
+    VkDeviceSize offset = sizeof(uint32_t) * CULL_STAT_COUNT * backend->current_frame_idx();
+
+    // GPU_TO_CPU memory may not be host coherent, the writes of the culling passes have to be made visible first.
+    vmaInvalidateAllocation(backend->allocator(), m_stats_buffer->allocation(), offset, sizeof(m_stats));
+
+    const uint32_t* stats = (const uint32_t*)((const uint8_t*)m_stats_buffer->mapped_ptr() + offset);
+
+    memcpy(&m_stats[0], stats, sizeof(m_stats));
+
+    // A pyramid left over from before occlusion culling was enabled no longer matches the view.
+    if (!m_occlusion_culling)
+        m_hi_z_valid = false;
+
+    m_test_hi_z = m_occlusion_culling && m_hi_z_valid;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::cull(RenderGraph& graph, CullPhase phase)
+{
+    if (phase == CULL_PHASE_EARLY)
+    {
+        graph.add_pass(
+            "Reset Draw Counts",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, m_stats_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, m_reset_command_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, m_command_buffer);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                reset_counts(cmd_buf);
+            });
+    }
+
+    graph.add_pass(
+        phase == CULL_PHASE_EARLY ? "Cull" : "Cull Late",
+        [&](RenderGraph::PassBuilder& builder) {
+            VkImageSubresourceRange hi_z_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_hi_z->mip_levels(), 0, 1 };
+
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, m_hi_z, hi_z_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_draw_buffer);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_command_buffer);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_visible_draw_buffer);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_occluded_buffer);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_stats_buffer);
+        },
+        [this, phase](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            cull_draws(cmd_buf, phase);
+        });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::build_hi_z(RenderGraph& graph)
+{
+    graph.add_pass(
+        "Hi-Z",
+        [&](RenderGraph::PassBuilder& builder) {
+            VkImageSubresourceRange hi_z_subresource_range  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_hi_z->mip_levels(), 0, 1 };
+            VkImageSubresourceRange depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, m_g_buffer->depth_image()->mip_levels(), 0, 1 };
+
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_g_buffer->depth_image(), depth_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_hi_z, hi_z_subresource_range);
+        },
+        [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            downsample_hi_z(cmd_buf);
+        });
+
+    m_hi_z_valid = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::gui()
+{
+    ImGui::Checkbox("Frustum Culling", &m_frustum_culling);
+    ImGui::Checkbox("Occlusion Culling", &m_occlusion_culling);
+    ImGui::Text("Draws: %u, Instanced Draws: %u, Meshes: %u", m_num_draws, m_num_groups, (uint32_t)m_batches.size());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::profiler_gui()
+{
+    ImGui::Text("Frustum Culled Draws: %u, Triangles: %u", m_stats[CULL_STAT_FRUSTUM_DRAWS], m_stats[CULL_STAT_FRUSTUM_TRIANGLES]);
+    ImGui::Text("Occlusion Culled Draws: %u, Triangles: %u", m_stats[CULL_STAT_OCCLUSION_DRAWS], m_stats[CULL_STAT_OCCLUSION_TRIANGLES]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::use_draws(RenderGraph::PassBuilder& builder)
+{
+    builder.use_resource(VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_draw_buffer);
+    builder.use_resource(VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_visible_draw_buffer);
+    builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_command_buffer);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::use_draw_data(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages)
+{
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, m_draw_buffer);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::draw(dw::vk::CommandBuffer::Ptr cmd_buf, dw::vk::PipelineLayout::Ptr pipeline_layout, CullPhase phase, DrawFilter filter)
+{
+    // The commands carry their first instance themselves.
+    if (m_multi_draw)
+    {
+        uint32_t first_instance = 0;
+        vkCmdPushConstants(cmd_buf->handle(), pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT, kPushConstantOffset, sizeof(uint32_t), &first_instance);
+    }
+
+    for (const auto& batch : m_batches)
+    {
+        uint32_t first_group = filter == DRAW_FILTER_ALPHA_TESTED ? batch.num_opaque_groups : 0;
+        uint32_t num_groups  = filter == DRAW_FILTER_OPAQUE ? batch.num_opaque_groups : batch.num_groups - first_group;
+
+        if (num_groups == 0)
+            continue;
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &batch.vertex_buffer->handle(), &offset);
+        vkCmdBindIndexBuffer(cmd_buf->handle(), batch.index_buffer->handle(), 0, VK_INDEX_TYPE_UINT32);
+
+        // Each phase has its own range of commands, submeshes without visible instances are drawn with zero instances.
+        uint32_t first_command = phase * m_num_groups + batch.first_command + first_group;
+
+        if (m_multi_draw)
+            vkCmdDrawIndexedIndirect(cmd_buf->handle(), m_command_buffer->handle(), first_command * sizeof(VkDrawIndexedIndirectCommand), num_groups, sizeof(VkDrawIndexedIndirectCommand));
+        else
+        {
+            for (uint32_t i = first_command; i < first_command + num_groups; i++)
+            {
+                vkCmdPushConstants(cmd_buf->handle(), pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT, kPushConstantOffset, sizeof(uint32_t), &m_first_instances[i]);
+                vkCmdDrawIndexedIndirect(cmd_buf->handle(), m_command_buffer->handle(), i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::create_hi_z(uint32_t input_width, uint32_t input_height)
+{
+    auto backend = m_backend.lock();
+
+    // A power of two pyramid halves exactly at every level, so a texel of one level always covers 2x2 texels of the one below.
+    uint32_t width      = previous_power_of_two(input_width);
+    uint32_t height     = previous_power_of_two(input_height);
+    uint32_t num_levels = 1;
+
+    while ((std::max(width, height) >> num_levels) > 0)
+        num_levels++;
+
+    m_hi_z = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, width, height, 1, num_levels, 1, VK_FORMAT_R32_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_hi_z->set_name("Hi-Z Image");
+
+    m_hi_z_view = dw::vk::ImageView::create(backend, m_hi_z, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, num_levels);
+    m_hi_z_view->set_name("Hi-Z Image View");
+
+    for (uint32_t i = 0; i < num_levels; i++)
+    {
+        dw::vk::ImageView::Ptr view = dw::vk::ImageView::create(backend, m_hi_z, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+        view->set_name("Hi-Z Level " + std::to_string(i) + " Image View");
+
+        m_hi_z_level_views.push_back(view);
+    }
+
+    // Each level reads the one above it. The first level samples the depth buffer itself, as the copy the G-buffer binds is
+    // only written once both phases are drawn, and binds its own level as the unused source.
+    for (uint32_t i = 0; i < num_levels; i++)
+    {
+        dw::vk::DescriptorSet::Ptr ds = backend->allocate_descriptor_set(m_hi_z_ds_layout);
+
+        VkDescriptorImageInfo image_info[3];
+
+        image_info[0].sampler     = VK_NULL_HANDLE;
+        image_info[0].imageView   = m_hi_z_level_views[i == 0 ? 0 : i - 1]->handle();
+        image_info[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        image_info[1].sampler     = VK_NULL_HANDLE;
+        image_info[1].imageView   = m_hi_z_level_views[i]->handle();
+        image_info[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        image_info[2].sampler     = backend->nearest_sampler()->handle();
+        image_info[2].imageView   = m_g_buffer->depth_image_view()->handle();
+        image_info[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet write_data[3];
+
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            DW_ZERO_MEMORY(write_data[j]);
+
+            write_data[j].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data[j].descriptorCount = 1;
+            write_data[j].descriptorType  = j == 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write_data[j].pImageInfo      = &image_info[j];
+            write_data[j].dstBinding      = j;
+            write_data[j].dstSet          = ds->handle();
+        }
+
+        vkUpdateDescriptorSets(backend->device(), 3, &write_data[0], 0, nullptr);
+
+        m_hi_z_ds.push_back(ds);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::create_descriptor_set_layout()
+{
+    auto backend = m_backend.lock();
+
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+        m_ds_layout->set_name("Draw Culler DS Layout");
+    }
+
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_hi_z_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+        m_hi_z_ds_layout->set_name("Hi-Z DS Layout");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::create_pipeline()
+{
+    auto backend = m_backend.lock();
+
+    {
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/g_buffer_cull.comp.spv");
+
+        dw::vk::PipelineLayout::Desc pl_desc;
+
+        pl_desc.add_descriptor_set_layout(m_ds_layout);
+        pl_desc.add_descriptor_set_layout(m_common_resources->per_frame_ds_layout);
+        pl_desc.add_push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants));
+
+        m_pipeline_layout = dw::vk::PipelineLayout::create(backend, pl_desc);
+        m_pipeline_layout->set_name("Cull Pipeline Layout");
+
+        dw::vk::ComputePipeline::Desc desc;
+
+        desc.set_shader_stage(module, "main");
+        desc.set_pipeline_layout(m_pipeline_layout);
+
+        m_pipeline = dw::vk::ComputePipeline::create(backend, desc, m_common_resources->pipeline_cache->handle());
+    }
+
+    {
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/g_buffer_hi_z.comp.spv");
+
+        dw::vk::PipelineLayout::Desc pl_desc;
+
+        pl_desc.add_descriptor_set_layout(m_hi_z_ds_layout);
+        pl_desc.add_push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZPushConstants));
+
+        m_hi_z_pipeline_layout = dw::vk::PipelineLayout::create(backend, pl_desc);
+        m_hi_z_pipeline_layout->set_name("Hi-Z Pipeline Layout");
+
+        dw::vk::ComputePipeline::Desc desc;
+
+        desc.set_shader_stage(module, "main");
+        desc.set_pipeline_layout(m_hi_z_pipeline_layout);
+
+        m_hi_z_pipeline = dw::vk::ComputePipeline::create(backend, desc, m_common_resources->pipeline_cache->handle());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::create_buffers(dw::RayTracedScene::Ptr scene)
+{
+    auto backend = m_backend.lock();
+
+    // Frames in flight may still draw the previous scene.
+    if (m_ds)
+    {
+        m_common_resources->deletion_queue->push(m_ds);
+        m_common_resources->deletion_queue->push(m_draw_buffer);
+        m_common_resources->deletion_queue->push(m_command_buffer);
+        m_common_resources->deletion_queue->push(m_reset_command_buffer);
+        m_common_resources->deletion_queue->push(m_visible_draw_buffer);
+        m_common_resources->deletion_queue->push(m_occluded_buffer);
+    }
+
+    m_batches.clear();
+
+    // Draws are numbered in the order of the instances and their submeshes, which the mesh IDs of the G-buffer follow.
+    // Every submesh of every mesh gets one instanced command that all of its draws are instances of.
+    std::vector<DrawData>                         draws;
+    std::vector<VkDrawIndexedIndirectCommand>     commands;
+    std::unordered_map<const dw::Mesh*, uint32_t> batch_indices;
+    std::vector<std::vector<uint32_t>>            batch_groups; // Command of every submesh of the mesh of a batch.
+
+    const auto& instances = scene->instances();
+
+    // The instance index is the one the instance buffer of the scene descriptor set is indexed with.
+    for (uint32_t instance_idx = 0; instance_idx < (uint32_t)instances.size(); instance_idx++)
+    {
+        const auto& instance = instances[instance_idx];
+
+        if (instance.mesh.expired())
+            continue;
+
+        const auto& mesh = instance.mesh.lock();
+
+        auto it = batch_indices.find(mesh.get());
+
+        if (it == batch_indices.end())
+        {
+            it = batch_indices.insert({ mesh.get(), (uint32_t)m_batches.size() }).first;
+
+            const auto& sub_meshes = mesh->sub_meshes();
+
+            std::vector<bool> alpha_tested(sub_meshes.size());
+            uint32_t          num_opaque_groups = 0;
+
+            for (uint32_t submesh_idx = 0; submesh_idx < (uint32_t)sub_meshes.size(); submesh_idx++)
+            {
+                alpha_tested[submesh_idx] = MeshCache::alpha_tested(mesh->material(sub_meshes[submesh_idx].mat_idx).get());
+
+                if (!alpha_tested[submesh_idx])
+                    num_opaque_groups++;
+            }
+
+            m_batches.push_back({ mesh->vertex_buffer(), mesh->index_buffer(), (uint32_t)commands.size(), (uint32_t)sub_meshes.size(), num_opaque_groups });
+
+            std::vector<uint32_t> groups(sub_meshes.size());
+            uint32_t              next_opaque       = (uint32_t)commands.size();
+            uint32_t              next_alpha_tested = next_opaque + num_opaque_groups;
+
+            commands.resize(commands.size() + sub_meshes.size());
+
+            // Instance counts start out as the number of draws of the submesh, they are turned into offsets below.
+            for (uint32_t submesh_idx = 0; submesh_idx < (uint32_t)sub_meshes.size(); submesh_idx++)
+            {
+                const auto& submesh = sub_meshes[submesh_idx];
+
+                groups[submesh_idx]           = alpha_tested[submesh_idx] ? next_alpha_tested++ : next_opaque++;
+                commands[groups[submesh_idx]] = { submesh.index_count, 0, submesh.base_index, (int32_t)submesh.base_vertex, 0 };
+            }
+
+            batch_groups.push_back(groups);
+        }
+
+        // Bounds are transformed as a box, which keeps them conservative under rotation.
+        glm::mat3 abs_model;
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            for (uint32_t j = 0; j < 3; j++)
+                abs_model[i][j] = fabsf(instance.transform[i][j]);
+        }
+
+        const auto& sub_meshes = mesh->sub_meshes();
+
+        for (uint32_t submesh_idx = 0; submesh_idx < (uint32_t)sub_meshes.size(); submesh_idx++)
+        {
+            const auto& submesh = sub_meshes[submesh_idx];
+
+            glm::vec3 center  = (submesh.min_extents + submesh.max_extents) * 0.5f;
+            glm::vec3 extents = (submesh.max_extents - submesh.min_extents) * 0.5f;
+
+            DrawData draw;
+
+            draw.model          = instance.transform;
+            draw.center         = glm::vec4(glm::vec3(instance.transform * glm::vec4(center, 1.0f)), 0.0f);
+            draw.extents        = glm::vec4(abs_model * extents, 0.0f);
+            draw.material_index = scene->material_index(mesh->material(submesh.mat_idx)->id());
+            draw.index_count    = submesh.index_count;
+            draw.first_index    = submesh.base_index;
+            draw.vertex_offset  = (int32_t)submesh.base_vertex;
+            draw.group          = batch_groups[it->second][submesh_idx];
+            draw.first_instance = 0;
+            draw.instance_idx   = instance_idx;
+            draw.padding        = 0;
+
+            commands[draw.group].instanceCount++;
+            draws.push_back(draw);
+        }
+    }
+
+    // The visible draws of a submesh are written to a range of their own, which its command starts its instances at.
+    uint32_t first_instance = 0;
+
+    for (auto& command : commands)
+    {
+        command.firstInstance = first_instance;
+        first_instance += command.instanceCount;
+        command.instanceCount = 0;
+    }
+
+    for (auto& draw : draws)
+        draw.first_instance = commands[draw.group].firstInstance;
+
+    m_num_draws  = (uint32_t)draws.size();
+    m_num_groups = (uint32_t)commands.size();
+    m_scene_id   = scene->id();
+    m_hi_z_valid = false;
+
+    // The late phase has its own commands, drawing from its own range of visible draws.
+    for (uint32_t i = 0; i < m_num_groups; i++)
+    {
+        VkDrawIndexedIndirectCommand command = commands[i];
+
+        command.firstInstance += m_num_draws;
+        commands.push_back(command);
+    }
+
+    m_first_instances.resize(commands.size());
+
+    for (uint32_t i = 0; i < (uint32_t)commands.size(); i++)
+    {
+        m_first_instances[i] = commands[i].firstInstance;
+
+        if (!m_multi_draw)
+            commands[i].firstInstance = 0;
+    }
+
+    // Buffers cannot be empty.
+    draws.resize(std::max(m_num_draws, 1u));
+    commands.resize(std::max(m_num_groups * 2, 1u));
+
+    // The commands are reset from a copy every frame, with the instance counts back at zero.
+    m_draw_buffer          = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(DrawData) * draws.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0, draws.data());
+    m_reset_command_buffer = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(VkDrawIndexedIndirectCommand) * commands.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0, commands.data());
+    m_command_buffer       = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(VkDrawIndexedIndirectCommand) * commands.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0);
+    m_visible_draw_buffer  = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t) * draws.size() * 2, VMA_MEMORY_USAGE_GPU_ONLY, 0);
+    m_occluded_buffer      = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t) * draws.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0);
+
+    m_draw_buffer->set_name("Draw Buffer");
+    m_reset_command_buffer->set_name("Draw Reset Command Buffer");
+    m_command_buffer->set_name("Draw Command Buffer");
+    m_visible_draw_buffer->set_name("Visible Draw Buffer");
+    m_occluded_buffer->set_name("Draw Occluded Buffer");
+
+    m_ds = backend->allocate_descriptor_set(m_ds_layout);
+
+    dw::vk::Buffer::Ptr buffers[] = { m_draw_buffer, m_command_buffer, m_visible_draw_buffer, m_occluded_buffer, m_stats_buffer };
+    uint32_t            bindings[] = { 0, 1, 2, 4, 5 };
+
+    VkDescriptorBufferInfo buffer_info[5];
+    VkWriteDescriptorSet   write_data[6];
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        buffer_info[i].buffer = buffers[i]->handle();
+        buffer_info[i].offset = 0;
+        buffer_info[i].range  = VK_WHOLE_SIZE;
+
+        DW_ZERO_MEMORY(write_data[i]);
+
+        write_data[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[i].descriptorCount = 1;
+        write_data[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_data[i].pBufferInfo     = &buffer_info[i];
+        write_data[i].dstBinding      = bindings[i];
+        write_data[i].dstSet          = m_ds->handle();
+    }
+
+    VkDescriptorImageInfo image_info;
+
+    image_info.sampler     = backend->nearest_sampler()->handle();
+    image_info.imageView   = m_hi_z_view->handle();
+    image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    DW_ZERO_MEMORY(write_data[5]);
+
+    write_data[5].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_data[5].descriptorCount = 1;
+    write_data[5].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write_data[5].pImageInfo      = &image_info;
+    write_data[5].dstBinding      = 3;
+    write_data[5].dstSet          = m_ds->handle();
+
+    vkUpdateDescriptorSets(backend->device(), 6, &write_data[0], 0, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::reset_counts(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = m_backend.lock();
+
+    if (m_num_groups > 0)
+    {
+        VkBufferCopy region;
+
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size      = sizeof(VkDrawIndexedIndirectCommand) * m_num_groups * 2;
+
+        vkCmdCopyBuffer(cmd_buf->handle(), m_reset_command_buffer->handle(), m_command_buffer->handle(), 1, &region);
+    }
+
+    vkCmdFillBuffer(cmd_buf->handle(), m_stats_buffer->handle(), sizeof(uint32_t) * CULL_STAT_COUNT * backend->current_frame_idx(), sizeof(uint32_t) * CULL_STAT_COUNT, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::cull_draws(dw::vk::CommandBuffer::Ptr cmd_buf, CullPhase phase)
+{
+    if (m_num_draws == 0)
+        return;
+
+    auto backend = m_backend.lock();
+
+    // Planes of the frustum point inwards, extracted from the rows of the view projection matrix. The near plane is the
+    // one of a [-1, 1] depth range, which lies behind the actual one and only culls a little less.
+    glm::mat4 view_proj = m_common_resources->projection * m_common_resources->view;
+    glm::vec4 rows[4];
+
+    for (uint32_t i = 0; i < 4; i++)
+        rows[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+
+    CullPushConstants push_constants;
+
+    push_constants.frustum_planes[0] = rows[3] + rows[0];
+    push_constants.frustum_planes[1] = rows[3] - rows[0];
+    push_constants.frustum_planes[2] = rows[3] + rows[1];
+    push_constants.frustum_planes[3] = rows[3] - rows[1];
+    push_constants.frustum_planes[4] = rows[3] + rows[2];
+    push_constants.frustum_planes[5] = rows[3] - rows[2];
+    push_constants.num_draws         = m_num_draws;
+    push_constants.num_groups        = m_num_groups;
+    push_constants.phase             = (uint32_t)phase;
+    push_constants.frustum_culling   = (uint32_t)m_frustum_culling;
+    push_constants.occlusion_culling = (uint32_t)m_test_hi_z;
+    push_constants.stats_offset      = CULL_STAT_COUNT * backend->current_frame_idx();
+
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->handle());
+
+    const uint32_t dynamic_offset = m_common_resources->ubo_size * backend->current_frame_idx();
+
+    VkDescriptorSet descriptor_sets[] = {
+        m_ds->handle(),
+        m_common_resources->per_frame_ds->handle()
+    };
+
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout->handle(), 0, 2, descriptor_sets, 1, &dynamic_offset);
+
+    vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push_constants);
+
+    vkCmdDispatch(cmd_buf->handle(), (m_num_draws + CULL_NUM_THREADS - 1) / CULL_NUM_THREADS, 1, 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DrawCuller::downsample_hi_z(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_hi_z_pipeline->handle());
+
+    VkMemoryBarrier2KHR barrier = {};
+
+    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT;
+    barrier.dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+
+    VkDependencyInfoKHR dependency_info = {};
+
+    dependency_info.sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers    = &barrier;
+
+    glm::ivec2 source_size = glm::ivec2(m_g_buffer->depth_image()->width(), m_g_buffer->depth_image()->height());
+
+    for (uint32_t i = 0; i < m_hi_z->mip_levels(); i++)
+    {
+        // Every level reads the one written before it.
+        if (i > 0)
+            vkCmdPipelineBarrier2KHR(cmd_buf->handle(), &dependency_info);
+
+        VkDescriptorSet descriptor_set = m_hi_z_ds[i]->handle();
+
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_hi_z_pipeline_layout->handle(), 0, 1, &descriptor_set, 0, nullptr);
+
+        HiZPushConstants push_constants;
+
+        push_constants.source_size = source_size;
+        push_constants.level       = i;
+
+        vkCmdPushConstants(cmd_buf->handle(), m_hi_z_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZPushConstants), &push_constants);
+
+        uint32_t width  = std::max(m_hi_z->width() >> i, 1u);
+        uint32_t height = std::max(m_hi_z->height() >> i, 1u);
+
+        vkCmdDispatch(cmd_buf->handle(), (width + HI_Z_NUM_THREADS_X - 1) / HI_Z_NUM_THREADS_X, (height + HI_Z_NUM_THREADS_Y - 1) / HI_Z_NUM_THREADS_Y, 1);
+
+        source_size = glm::ivec2(width, height);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vk.h>
+#include <ray_traced_scene.h>
+#include <vector>
+#include "render_graph.h"
+
+struct CommonResources;
+class GBuffer;
+
+enum CullPhase
+{
+    CULL_PHASE_EARLY,
+    CULL_PHASE_LATE
+};
+
+// Submeshes whose material can fail the alpha test are drawn separately, so the others can use a pipeline without it.
+enum DrawFilter
+{
+    DRAW_FILTER_ALL,
+    DRAW_FILTER_OPAQUE,
+    DRAW_FILTER_ALPHA_TESTED
+};
+
+// Builds the draws of the G-buffer on the GPU. Every submesh of every instance of the scene becomes a draw whose
+// transform, material and world space bounds are uploaded once when the scene becomes active. Each frame a compute
+// pass tests the bounds against the view frustum and appends the indices of the visible draws to the range of the
+// submesh they belong to, counting them as instances of its indirect command. The G-buffer then issues one indirect
+// draw per mesh, with one instanced command per submesh, so repeated meshes cost a single draw however many instances
+// of them the scene places.
+//
+// Commands start their instances at the range of their submesh, so shaders fetch the draw through the visible draw at
+// gl_InstanceIndex.
+//
+// Drawing every submesh of a mesh with one call needs multiDrawIndirect, and starting commands at the range of their
+// submesh needs drawIndirectFirstInstance. Unless both were enabled, every command is drawn on its own and starts at
+// instance zero, with the range of its submesh pushed to the vertex shader instead.
+//
+// Occlusion culling works in two phases. The early phase tests the bounds against a max depth pyramid (Hi-Z) built
+// from the depth of the previous frame and the G-buffer draws what passes. The pyramid is then rebuilt from that depth,
+// and the late phase tests only the draws the early phase rejected against it and draws the ones that became visible,
+// so nothing is missing from the frame even when the previous one was a poor guess.
+class DrawCuller
+{
+public:
+    // Offset of the first instance pushed to the vertex stage by draw(), past the push constants of the passes.
+    static const uint32_t kPushConstantOffset = 16;
+
+public:
+    DrawCuller(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, uint32_t input_width, uint32_t input_height);
+    ~DrawCuller();
+
+    // Rebuilds the draws whenever the scene changes, has to be called before the passes are added.
+    void update(dw::RayTracedScene::Ptr scene);
+    void cull(RenderGraph& graph, CullPhase phase);
+    // Builds the Hi-Z pyramid from the depth the G-buffer has drawn so far.
+    void build_hi_z(RenderGraph& graph);
+    void gui();
+    void profiler_gui();
+
+    // Declares the reads of the draw data and the indirect commands by a pass that calls draw().
+    void use_draws(RenderGraph::PassBuilder& builder);
+    // Declares the reads of the draw data alone, by passes that look draws up by their index.
+    void use_draw_data(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages);
+    void draw(dw::vk::CommandBuffer::Ptr cmd_buf, dw::vk::PipelineLayout::Ptr pipeline_layout, CullPhase phase, DrawFilter filter = DRAW_FILTER_ALL);
+
+    inline dw::vk::DescriptorSetLayout::Ptr ds_layout() { return m_ds_layout; }
+    inline dw::vk::DescriptorSet::Ptr       ds() { return m_ds; }
+    inline uint32_t                         num_draws() { return m_num_draws; }
+    inline bool                             occlusion_culling() { return m_occlusion_culling; }
+
+private:
+    // Draws sharing the vertex and index buffers of a mesh, the commands of its submeshes are consecutive with the
+    // opaque ones first.
+    struct Batch
+    {
+        dw::vk::Buffer::Ptr vertex_buffer;
+        dw::vk::Buffer::Ptr index_buffer;
+        uint32_t            first_command;
+        uint32_t            num_groups;
+        uint32_t            num_opaque_groups;
+    };
+
+    // Draws and triangles culled in a frame, indexed like the stats buffer.
+    enum CullStat
+    {
+        CULL_STAT_FRUSTUM_DRAWS,
+        CULL_STAT_FRUSTUM_TRIANGLES,
+        CULL_STAT_OCCLUSION_DRAWS,
+        CULL_STAT_OCCLUSION_TRIANGLES,
+        CULL_STAT_COUNT
+    };
+
+    void create_hi_z(uint32_t input_width, uint32_t input_height);
+    void create_descriptor_set_layout();
+    void create_pipeline();
+    void create_buffers(dw::RayTracedScene::Ptr scene);
+    void reset_counts(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void cull_draws(dw::vk::CommandBuffer::Ptr cmd_buf, CullPhase phase);
+    void downsample_hi_z(dw::vk::CommandBuffer::Ptr cmd_buf);
+
+private:
+    std::weak_ptr<dw::vk::Backend>          m_backend;
+    CommonResources*                        m_common_resources;
+    GBuffer*                                m_g_buffer;
+    uint32_t                                m_scene_id          = UINT32_MAX;
+    uint32_t                                m_num_draws         = 0;
+    uint32_t                                m_num_groups        = 0;
+    bool                                    m_frustum_culling   = true;
+    bool                                    m_occlusion_culling = true;
+    bool                                    m_hi_z_valid        = false;
+    bool                                    m_test_hi_z         = false;
+    bool                                    m_multi_draw        = false; // multiDrawIndirect and drawIndirectFirstInstance are enabled.
+    uint32_t                                m_stats[CULL_STAT_COUNT];
+    std::vector<Batch>                      m_batches;
+    std::vector<uint32_t>                   m_first_instances; // First instance of every command, pushed when the commands cannot carry it.
+    dw::vk::Buffer::Ptr                     m_draw_buffer;
+    dw::vk::Buffer::Ptr                     m_command_buffer;
+    dw::vk::Buffer::Ptr                     m_reset_command_buffer;
+    dw::vk::Buffer::Ptr                     m_visible_draw_buffer;
+    dw::vk::Buffer::Ptr                     m_occluded_buffer;
+    dw::vk::Buffer::Ptr                     m_stats_buffer;
+    dw::vk::Image::Ptr                      m_hi_z;
+    dw::vk::ImageView::Ptr                  m_hi_z_view;
+    std::vector<dw::vk::ImageView::Ptr>     m_hi_z_level_views;
+    std::vector<dw::vk::DescriptorSet::Ptr> m_hi_z_ds;
+    dw::vk::DescriptorSetLayout::Ptr        m_ds_layout;
+    dw::vk::DescriptorSetLayout::Ptr        m_hi_z_ds_layout;
+    dw::vk::DescriptorSet::Ptr              m_ds;
+    dw::vk::PipelineLayout::Ptr             m_pipeline_layout;
+    dw::vk::PipelineLayout::Ptr             m_hi_z_pipeline_layout;
+    dw::vk::ComputePipeline::Ptr            m_pipeline;
+    dw::vk::ComputePipeline::Ptr            m_hi_z_pipeline;
+};
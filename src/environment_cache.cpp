@@ -0,0 +1,345 @@
+#include "environment_cache.h"
+#include "utility.h"
+#include <logger.h>
+#include <gtc/packing.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const char     kMagic[4] = { 'H', 'R', 'I', 'B' };
+static const uint32_t kVersion  = 1;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+enum CacheImageType
+{
+    CACHE_IMAGE_CUBEMAP,
+    CACHE_IMAGE_SH,
+    CACHE_IMAGE_PREFILTERED,
+    CACHE_IMAGE_COUNT
+};
+
+struct CacheImage
+{
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint32_t array_size;
+    uint32_t padding;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// The data of every image follows the header, one layer after another with all the mips of a layer in a row, which is
+// the order the uploader expects.
+struct CacheHeader
+{
+    char       magic[4];
+    uint32_t   version;
+    uint64_t   source_hash;
+    CacheImage images[CACHE_IMAGE_COUNT];
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t texel_size(uint32_t format)
+{
+    if (format == VK_FORMAT_R32G32B32A32_SFLOAT)
+        return 16;
+    else if (format == VK_FORMAT_R16G16B16A16_SFLOAT)
+        return 8;
+    else
+        return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t mip_size(const CacheImage& image, uint32_t mip)
+{
+    return size_t(std::max(1u, image.width >> mip)) * size_t(std::max(1u, image.height >> mip)) * texel_size(image.format);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::vector<size_t> subresource_sizes(const CacheImage& image)
+{
+    std::vector<size_t> sizes;
+
+    for (uint32_t layer = 0; layer < image.array_size; layer++)
+    {
+        for (uint32_t mip = 0; mip < image.mip_levels; mip++)
+            sizes.push_back(mip_size(image, mip));
+    }
+
+    return sizes;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a over the contents of the file.
+static bool hash_file(const std::string& path, uint64_t& hash)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<char> chunk(1024 * 1024);
+
+    hash = 14695981039346656037ull;
+
+    while (file)
+    {
+        file.read(chunk.data(), chunk.size());
+
+        for (std::streamsize i = 0; i < file.gcount(); i++)
+        {
+            hash ^= (uint8_t)chunk[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string cache_path(uint64_t hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+
+    return std::string(kCacheDirectory) + "/" + name + ".ibl";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Copies the first mip_levels mips of every layer into host memory, converting 32-bit floats to half floats if asked to.
+// The image is expected in SHADER_READ_ONLY_OPTIMAL and is left that way.
+static bool read_back(dw::vk::Backend::Ptr backend, dw::vk::Image::Ptr image, uint32_t mip_levels, bool to_half, CacheImage& desc, std::vector<uint8_t>& data)
+{
+    memset(&desc, 0, sizeof(CacheImage));
+
+    desc.format     = image->format();
+    desc.width      = image->width();
+    desc.height     = image->height();
+    desc.mip_levels = mip_levels;
+    desc.array_size = image->array_size();
+
+    if (texel_size(desc.format) == 0)
+    {
+        DW_LOG_ERROR("Unsupported image format for the environment cache: " + std::to_string(desc.format));
+        return false;
+    }
+
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize                   size = 0;
+
+    for (uint32_t layer = 0; layer < desc.array_size; layer++)
+    {
+        for (uint32_t mip = 0; mip < desc.mip_levels; mip++)
+        {
+            VkBufferImageCopy region {};
+
+            region.bufferOffset                    = size;
+            region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel       = mip;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount     = 1;
+            region.imageExtent.width               = std::max(1u, desc.width >> mip);
+            region.imageExtent.height              = std::max(1u, desc.height >> mip);
+            region.imageExtent.depth               = 1;
+
+            regions.push_back(region);
+
+            size += mip_size(desc, mip);
+        }
+    }
+
+    dw::vk::Buffer::Ptr buffer = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+    auto cmd_buf = backend->allocate_graphics_command_buffer(true);
+
+    VkImageMemoryBarrier barrier {};
+
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask                   = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = image->handle();
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = image->mip_levels();
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = image->array_size();
+
+    vkCmdPipelineBarrier(cmd_buf->handle(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyImageToBuffer(cmd_buf->handle(), image->handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer->handle(), (uint32_t)regions.size(), regions.data());
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(cmd_buf->handle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkEndCommandBuffer(cmd_buf->handle());
+
+    backend->flush_graphics({ cmd_buf });
+
+    const uint8_t* mapped = (const uint8_t*)buffer->mapped_ptr();
+
+    if (to_half && desc.format == VK_FORMAT_R32G32B32A32_SFLOAT)
+    {
+        size_t num_texels = size / sizeof(glm::vec4);
+
+        data.resize(num_texels * sizeof(uint64_t));
+
+        for (size_t i = 0; i < num_texels; i++)
+        {
+            glm::vec4 texel;
+            memcpy(&texel, mapped + i * sizeof(glm::vec4), sizeof(glm::vec4));
+
+            uint64_t packed = glm::packHalf4x16(texel);
+            memcpy(data.data() + i * sizeof(uint64_t), &packed, sizeof(uint64_t));
+        }
+
+        desc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+    else
+        data.assign(mapped, mapped + size);
+
+    desc.size = data.size();
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool EnvironmentCache::load(dw::vk::Backend::Ptr backend, const std::string& source, HDREnvironment& environment)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t hash = 0;
+
+    if (!hash_file(source, hash))
+        return false;
+
+    std::ifstream file(cache_path(hash), std::ios::binary | std::ios::ate);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<uint8_t> data((size_t)file.tellg());
+
+    file.seekg(0);
+    file.read((char*)data.data(), data.size());
+
+    if (!file || data.size() < sizeof(CacheHeader))
+        return false;
+
+    const CacheHeader* header = (const CacheHeader*)data.data();
+
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion || header->source_hash != hash)
+        return false;
+
+    for (uint32_t i = 0; i < CACHE_IMAGE_COUNT; i++)
+    {
+        const CacheImage& image = header->images[i];
+
+        if (texel_size(image.format) == 0 || image.offset + image.size > data.size())
+            return false;
+
+        std::vector<size_t> sizes = subresource_sizes(image);
+
+        size_t expected_size = 0;
+
+        for (auto size : sizes)
+            expected_size += size;
+
+        if (expected_size != image.size)
+            return false;
+    }
+
+    const CacheImage& cubemap     = header->images[CACHE_IMAGE_CUBEMAP];
+    const CacheImage& sh          = header->images[CACHE_IMAGE_SH];
+    const CacheImage& prefiltered = header->images[CACHE_IMAGE_PREFILTERED];
+
+    environment.image      = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, cubemap.width, cubemap.height, 1, cubemap.mip_levels, cubemap.array_size, (VkFormat)cubemap.format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, nullptr, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+    environment.image_view = dw::vk::ImageView::create(backend, environment.image, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT, 0, cubemap.mip_levels, 0, cubemap.array_size);
+
+    environment.sh_image      = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, sh.width, sh.height, 1, sh.mip_levels, sh.array_size, (VkFormat)sh.format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    environment.sh_image_view = dw::vk::ImageView::create(backend, environment.sh_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, sh.mip_levels, 0, sh.array_size);
+
+    environment.prefiltered_image      = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, prefiltered.width, prefiltered.height, 1, prefiltered.mip_levels, prefiltered.array_size, (VkFormat)prefiltered.format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, nullptr, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+    environment.prefiltered_image_view = dw::vk::ImageView::create(backend, environment.prefiltered_image, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT, 0, prefiltered.mip_levels, 0, prefiltered.array_size);
+
+    dw::vk::BatchUploader uploader(backend);
+
+    uploader.upload_image_data(environment.image, data.data() + cubemap.offset, subresource_sizes(cubemap));
+    uploader.upload_image_data(environment.sh_image, data.data() + sh.offset, subresource_sizes(sh));
+    uploader.upload_image_data(environment.prefiltered_image, data.data() + prefiltered.offset, subresource_sizes(prefiltered));
+
+    uploader.submit();
+
+    DW_LOG_INFO("Loaded environment " + source + " from the cache in " + std::to_string(elapsed_milliseconds(start)) + " ms");
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void EnvironmentCache::store(dw::vk::Backend::Ptr backend, const std::string& source, const HDREnvironment& environment)
+{
+    uint64_t hash = 0;
+
+    if (!hash_file(source, hash))
+    {
+        DW_LOG_ERROR("Failed to read environment map: " + source);
+        return;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+
+    header.version     = kVersion;
+    header.source_hash = hash;
+
+    std::vector<uint8_t> data[CACHE_IMAGE_COUNT];
+
+    // Only the top mip of the cubemap is sampled once the SH coefficients and prefiltered cubemap exist.
+    if (!read_back(backend, environment.image, 1, true, header.images[CACHE_IMAGE_CUBEMAP], data[CACHE_IMAGE_CUBEMAP]) ||
+        !read_back(backend, environment.sh_image, environment.sh_image->mip_levels(), false, header.images[CACHE_IMAGE_SH], data[CACHE_IMAGE_SH]) ||
+        !read_back(backend, environment.prefiltered_image, environment.prefiltered_image->mip_levels(), true, header.images[CACHE_IMAGE_PREFILTERED], data[CACHE_IMAGE_PREFILTERED]))
+        return;
+
+    uint64_t offset = sizeof(CacheHeader);
+
+    for (uint32_t i = 0; i < CACHE_IMAGE_COUNT; i++)
+    {
+        header.images[i].offset = offset;
+        offset += header.images[i].size;
+    }
+
+    create_cache_directory();
+
+    write_file_atomic(cache_path(hash), "environment cache", [&](std::ofstream& file) {
+        file.write((const char*)&header, sizeof(CacheHeader));
+
+        for (uint32_t i = 0; i < CACHE_IMAGE_COUNT; i++)
+            file.write((const char*)data[i].data(), data[i].size());
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vk.h>
+#include <string>
+#include "common.h"
+
+// Stores the cubemap, SH coefficients and prefiltered cubemap computed from an HDR environment map under cache/, in a
+// file named after a hash of the source image. The cubemaps are stored as half floats. A changed source image hashes
+// to a new file, so stale entries are never loaded.
+class EnvironmentCache
+{
+public:
+    // Creates the images of the environment from the cache, returns false if the source image has not been cached yet.
+    static bool load(dw::vk::Backend::Ptr backend, const std::string& source, HDREnvironment& environment);
+
+    // Reads the images of an environment computed on the GPU back and writes them to the cache.
+    static void store(dw::vk::Backend::Ptr backend, const std::string& source, const HDREnvironment& environment);
+};
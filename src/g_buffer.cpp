@@ -1,20 +1,42 @@
 #include "g_buffer.h"
+#include "shader_library.h"
 #include "common.h"
+#include <logger.h>
 #include <profiler.h>
 #include <macros.h>
 #include <imgui.h>
 #include <mesh.h>
 
-#define GBUFFER_MIP_LEVELS 9
+// The ray traced passes go down to quarter resolution at most.
+#define GBUFFER_MIP_LEVELS (RAY_TRACE_SCALE_QUARTER_RES + 1)
+#define GBUFFER_1_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+#define GBUFFER_2_FORMAT VK_FORMAT_A2B10G10R10_UNORM_PACK32
+#define GBUFFER_2_FALLBACK_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define GBUFFER_3_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define GBUFFER_MESH_ID_FORMAT VK_FORMAT_R16_UINT
+#define GBUFFER_MESH_ID_FALLBACK_FORMAT VK_FORMAT_R32_UINT
+#define GBUFFER_DEPTH_FORMAT VK_FORMAT_R32_SFLOAT
+#define GBUFFER_VISIBILITY_FORMAT VK_FORMAT_R32G32_UINT
+#define GBUFFER_SHARED_TEXEL_SIZE (4 + 8)   // Image 1 and 3, the same in both layouts.
+#define GBUFFER_COMPACT_TEXEL_SIZE (4 + 2)  // Image 2 and mesh IDs.
+#define GBUFFER_FALLBACK_TEXEL_SIZE (8 + 4) // Image 2 and mesh IDs.
+#define RESOLVE_NUM_THREADS_X 8
+#define RESOLVE_NUM_THREADS_Y 8
+#define DOWNSAMPLE_NUM_THREADS_X 8
+#define DOWNSAMPLE_NUM_THREADS_Y 8
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct GBufferPushConstants
 {
-    glm::mat4 model;
-    uint32_t  material_index;
-    uint32_t  mesh_id;
-    float     roughness_multiplier;
+    float roughness_multiplier;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct DownsamplePushConstants
+{
+    uint32_t num_levels;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -22,11 +44,18 @@ struct GBufferPushConstants
 GBuffer::GBuffer(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, uint32_t input_width, uint32_t input_height) :
     m_backend(backend), m_common_resources(common_resources), m_input_width(input_width), m_input_height(input_height)
 {
+    select_formats();
     create_images();
+
+    // The Hi-Z descriptor sets bind the depth buffer.
+    m_draw_culler = std::unique_ptr<DrawCuller>(new DrawCuller(backend, common_resources, this, input_width, input_height));
+
     create_descriptor_set_layouts();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipeline();
+    m_common_resources->pipeline_cache->queue([this]() { create_pipeline(); });
+    m_common_resources->pipeline_cache->queue([this]() { create_visibility_pipelines(); });
+    m_common_resources->pipeline_cache->queue([this]() { create_downsample_pipeline(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -37,37 +66,153 @@ GBuffer::~GBuffer()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void GBuffer::render(dw::vk::CommandBuffer::Ptr cmd_buf)
+void GBuffer::render(RenderGraph& graph, RayTraceScale scale)
 {
-    DW_SCOPED_SAMPLE("G-Buffer", cmd_buf);
-    
-    auto backend = cmd_buf->backend().lock();
-    
-    VkImageSubresourceRange all_color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS, 0, 1 };
-    VkImageSubresourceRange all_depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, GBUFFER_MIP_LEVELS, 0, 1 };
+    graph.begin_group("G-Buffer");
+
+    bool visibility_buffer = m_visibility_buffer;
+
+    m_draw_culler->update(m_common_resources->current_scene());
+    m_draw_culler->cull(graph, CULL_PHASE_EARLY);
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_1[!m_common_resources->ping_pong], all_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_2[!m_common_resources->ping_pong], all_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_3[!m_common_resources->ping_pong], all_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_depth[!m_common_resources->ping_pong], all_depth_subresource_range);
+    add_geometry_pass(graph, CULL_PHASE_EARLY, visibility_buffer);
+
+    // The pyramid built from the early draws is what the late phase tests against, and what the next frame starts from.
+    if (m_draw_culler->occlusion_culling())
+    {
+        m_draw_culler->build_hi_z(graph);
+        m_draw_culler->cull(graph, CULL_PHASE_LATE);
+
+        add_geometry_pass(graph, CULL_PHASE_LATE, visibility_buffer);
+    }
+
+    if (visibility_buffer)
+        add_resolve_pass(graph);
+
+    // Only the mips down to the coarsest scale a ray traced pass currently works at are generated.
+    add_downsample_pass(graph, static_cast<uint32_t>(scale) + 1);
+
+    graph.end_group();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::use_output(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages)
+{
+    use_images(builder, stages, static_cast<uint32_t>(m_common_resources->ping_pong), false);
+}
 
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::use_history(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages)
+{
+    use_images(builder, stages, static_cast<uint32_t>(!m_common_resources->ping_pong), true);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::add_geometry_pass(RenderGraph& graph, CullPhase phase, bool visibility_buffer)
+{
     VkImageSubresourceRange single_color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
     VkImageSubresourceRange single_depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_1[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_2[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_3[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, m_depth[m_common_resources->ping_pong], single_depth_subresource_range);
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+
+    graph.add_pass(
+        phase == CULL_PHASE_EARLY ? "Geometry" : "Geometry Late",
+        [&](RenderGraph::PassBuilder& builder) {
+            if (visibility_buffer)
+                builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_visibility, single_color_subresource_range);
+            else
+            {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_1, single_color_subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_2[write_idx], single_color_subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_image_3, single_color_subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_mesh_id[write_idx], single_color_subresource_range);
+            }
+
+            builder.use_resource(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, m_depth_buffer, single_depth_subresource_range);
+            m_draw_culler->use_draws(builder);
+        },
+        [this, phase, visibility_buffer](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            fill(cmd_buf, phase, visibility_buffer);
+        });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::add_resolve_pass(RenderGraph& graph)
+{
+    VkImageSubresourceRange single_color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+
+    graph.add_pass(
+        "Resolve",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_visibility, single_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_1, single_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_2[write_idx], single_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_3, single_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_mesh_id[write_idx], single_color_subresource_range);
+            m_draw_culler->use_draw_data(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+        },
+        [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            resolve(cmd_buf);
+        });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::add_downsample_pass(RenderGraph& graph, uint32_t num_levels)
+{
+    VkImageSubresourceRange single_depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+    VkImageSubresourceRange all_color_subresource_range    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS, 0, 1 };
+
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+
+    graph.add_pass(
+        "Downsample",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_depth_buffer, single_depth_subresource_range);
+
+            // The first mip is read through storage views, so every target stays in GENERAL across all of its mips. Every
+            // level is bound whether it is generated or not, so all of them have to be in the layout of the descriptors.
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_depth[write_idx], all_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_1, all_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_2[write_idx], all_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image_3, all_color_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_mesh_id[write_idx], all_color_subresource_range);
+        },
+        [this, num_levels](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            downsample(cmd_buf, num_levels);
+        });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    backend->flush_barriers(cmd_buf);
+void GBuffer::fill(dw::vk::CommandBuffer::Ptr cmd_buf, CullPhase phase, bool visibility_buffer)
+{
+    // The late phase draws on top of the early one.
+    VkAttachmentLoadOp load_op = phase == CULL_PHASE_EARLY ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
 
-    VkRenderingAttachmentInfoKHR color_attachments[3];
+    VkRenderingAttachmentInfoKHR visibility_attachment = {};
+
+    visibility_attachment.sType                      = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    visibility_attachment.imageView                  = m_visibility_view->handle();
+    visibility_attachment.imageLayout                = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    visibility_attachment.loadOp                     = load_op;
+    visibility_attachment.storeOp                    = VK_ATTACHMENT_STORE_OP_STORE;
+    visibility_attachment.clearValue.color.uint32[0] = 0;
+    visibility_attachment.clearValue.color.uint32[1] = 0;
+
+    VkRenderingAttachmentInfoKHR color_attachments[4];
 
     color_attachments[0]                  = {};
     color_attachments[0].sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-    color_attachments[0].imageView        = m_image_1_fbo_view[m_common_resources->ping_pong]->handle();
+    color_attachments[0].imageView        = m_image_1_fbo_view->handle();
     color_attachments[0].imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    color_attachments[0].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachments[0].loadOp           = load_op;
     color_attachments[0].storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachments[0].clearValue.color = { 0.0f, 0.0f, 0.0f, 0.0f };
 
@@ -75,23 +220,31 @@ void GBuffer::render(dw::vk::CommandBuffer::Ptr cmd_buf)
     color_attachments[1].sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
     color_attachments[1].imageView        = m_image_2_fbo_view[m_common_resources->ping_pong]->handle();
     color_attachments[1].imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    color_attachments[1].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachments[1].loadOp           = load_op;
     color_attachments[1].storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachments[1].clearValue.color = { 0.0f, 0.0f, 0.0f, 0.0f };
 
     color_attachments[2]                  = {};
     color_attachments[2].sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-    color_attachments[2].imageView        = m_image_3_fbo_view[m_common_resources->ping_pong]->handle();
+    color_attachments[2].imageView        = m_image_3_fbo_view->handle();
     color_attachments[2].imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    color_attachments[2].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachments[2].loadOp           = load_op;
     color_attachments[2].storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachments[2].clearValue.color = { 0.0f, 0.0f, 0.0f, -1.0f };
 
+    color_attachments[3]                  = {};
+    color_attachments[3].sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachments[3].imageView        = m_mesh_id_fbo_view[m_common_resources->ping_pong]->handle();
+    color_attachments[3].imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachments[3].loadOp           = load_op;
+    color_attachments[3].storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachments[3].clearValue.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
     VkRenderingAttachmentInfoKHR depth_stencil_sttachment {};
     depth_stencil_sttachment.sType                   = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-    depth_stencil_sttachment.imageView               = m_depth_fbo_view[m_common_resources->ping_pong]->handle();
+    depth_stencil_sttachment.imageView               = m_depth_buffer_view->handle();
     depth_stencil_sttachment.imageLayout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    depth_stencil_sttachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_stencil_sttachment.loadOp                  = load_op;
     depth_stencil_sttachment.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
     depth_stencil_sttachment.clearValue.depthStencil = { 1.0f, 0 };
 
@@ -100,8 +253,8 @@ void GBuffer::render(dw::vk::CommandBuffer::Ptr cmd_buf)
     rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
     rendering_info.renderArea           = { 0, 0, m_input_width, m_input_height };
     rendering_info.layerCount           = 1;
-    rendering_info.colorAttachmentCount = 3;
-    rendering_info.pColorAttachments    = &color_attachments[0];
+    rendering_info.colorAttachmentCount = visibility_buffer ? 1 : 4;
+    rendering_info.pColorAttachments    = visibility_buffer ? &visibility_attachment : &color_attachments[0];
     rendering_info.pDepthAttachment     = &depth_stencil_sttachment;
 
     vkCmdBeginRenderingKHR(cmd_buf->handle(), &rendering_info);
@@ -126,67 +279,176 @@ void GBuffer::render(dw::vk::CommandBuffer::Ptr cmd_buf)
 
     vkCmdSetScissor(cmd_buf->handle(), 0, 1, &scissor_rect);
 
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->handle());
+    dw::vk::PipelineLayout::Ptr pipeline_layout = visibility_buffer ? m_visibility_pipeline_layout : m_pipeline_layout;
+
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, visibility_buffer ? m_visibility_opaque_pipeline->handle() : m_pipeline->handle());
 
     auto           vk_backend     = m_backend.lock();
     const uint32_t dynamic_offset = m_common_resources->ubo_size * vk_backend->current_frame_idx();
 
     VkDescriptorSet descriptor_sets[] = {
-        m_common_resources->current_scene()->descriptor_set()->handle(),
-        m_common_resources->per_frame_ds->handle()
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
+        m_common_resources->per_frame_ds->handle(),
+        m_draw_culler->ds()->handle()
     };
 
-    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 0, 2, descriptor_sets, 1, &dynamic_offset);
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout->handle(), 0, 3, descriptor_sets, 1, &dynamic_offset);
+
+    // Material properties are evaluated by the resolve in visibility buffer mode.
+    if (!visibility_buffer)
+    {
+        GBufferPushConstants push_constants;
 
-    uint32_t mesh_id = 0;
+        push_constants.roughness_multiplier = m_common_resources->roughness_multiplier;
 
-    const auto& instances = m_common_resources->current_scene()->instances();
+        vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GBufferPushConstants), &push_constants);
+    }
 
-    for (uint32_t instance_idx = 0; instance_idx < instances.size(); instance_idx++)
+    if (visibility_buffer)
     {
-        const auto& instance = instances[instance_idx];
+        // Opaque submeshes first, so the alpha tested ones are depth tested against them.
+        m_draw_culler->draw(cmd_buf, pipeline_layout, phase, DRAW_FILTER_OPAQUE);
 
-        if (!instance.mesh.expired())
-        {
-            const auto& mesh      = instance.mesh.lock();
-            const auto& submeshes = mesh->sub_meshes();
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibility_pipeline->handle());
+
+        m_draw_culler->draw(cmd_buf, pipeline_layout, phase, DRAW_FILTER_ALPHA_TESTED);
+    }
+    else
+        m_draw_culler->draw(cmd_buf, pipeline_layout, phase);
 
-            VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &mesh->vertex_buffer()->handle(), &offset);
-            vkCmdBindIndexBuffer(cmd_buf->handle(), mesh->index_buffer()->handle(), 0, VK_INDEX_TYPE_UINT32);
+    vkCmdEndRenderingKHR(cmd_buf->handle());
+}
 
-            for (uint32_t submesh_idx = 0; submesh_idx < submeshes.size(); submesh_idx++)
-            {
-                auto& submesh = submeshes[submesh_idx];
-                auto& mat     = mesh->material(submesh.mat_idx);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-                GBufferPushConstants push_constants;
+void GBuffer::resolve(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto vk_backend = m_backend.lock();
 
-                push_constants.model                = instance.transform;
-                push_constants.material_index       = m_common_resources->current_scene()->material_index(mat->id());
-                push_constants.mesh_id              = mesh_id;
-                push_constants.roughness_multiplier = m_common_resources->roughness_multiplier;
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_resolve_pipeline->handle());
 
-                vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GBufferPushConstants), &push_constants);
+    const uint32_t dynamic_offset = m_common_resources->ubo_size * vk_backend->current_frame_idx();
+
+    VkDescriptorSet descriptor_sets[] = {
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
+        m_common_resources->per_frame_ds->handle(),
+        m_draw_culler->ds()->handle(),
+        m_resolve_ds[static_cast<uint32_t>(m_common_resources->ping_pong)]->handle()
+    };
 
-                // Issue draw call.
-                vkCmdDrawIndexed(cmd_buf->handle(), submesh.index_count, 1, submesh.base_index, submesh.base_vertex, 0);
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_resolve_pipeline_layout->handle(), 0, 4, descriptor_sets, 1, &dynamic_offset);
 
-                mesh_id++;
-            }
-        }
+    GBufferPushConstants push_constants;
+
+    push_constants.roughness_multiplier = m_common_resources->roughness_multiplier;
+
+    vkCmdPushConstants(cmd_buf->handle(), m_resolve_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GBufferPushConstants), &push_constants);
+
+    vkCmdDispatch(cmd_buf->handle(), (m_input_width + RESOLVE_NUM_THREADS_X - 1) / RESOLVE_NUM_THREADS_X, (m_input_height + RESOLVE_NUM_THREADS_Y - 1) / RESOLVE_NUM_THREADS_Y, 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::gui()
+{
+    ImGui::Checkbox("Visibility Buffer", &m_visibility_buffer);
+
+    if (m_compact_supported)
+    {
+        bool compact_formats = m_compact_formats;
+
+        if (ImGui::Checkbox("Compact Formats", &compact_formats))
+            set_compact_formats(compact_formats);
     }
+    else
+        ImGui::Text("Compact Formats: Unsupported");
 
-    vkCmdEndRenderingKHR(cmd_buf->handle());
+    const float kMB = 1024.0f * 1024.0f;
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image_1[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image_2[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_image_3[m_common_resources->ping_pong], single_color_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_depth[m_common_resources->ping_pong], single_depth_subresource_range);
+    ImGui::Text("Memory: %.1f MB", (float)memory_usage() / kMB);
+    ImGui::Text("Layout Memory (Compact / Fallback): %.1f MB / %.1f MB", (float)layout_memory(true) / kMB, (float)layout_memory(false) / kMB);
+    ImGui::Text("Layout Writes (Compact / Fallback): %.1f MB / %.1f MB", (float)layout_writes(true) / kMB, (float)layout_writes(false) / kMB);
 
-    backend->flush_barriers(cmd_buf);
+    m_draw_culler->gui();
+}
 
-    downsample_gbuffer(cmd_buf);
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::profiler_gui()
+{
+    m_draw_culler->profiler_gui();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t GBuffer::memory_usage()
+{
+    auto vk_backend = m_backend.lock();
+
+    dw::vk::Image::Ptr images[] = { m_image_1, m_image_2[0], m_image_2[1], m_image_3, m_mesh_id[0], m_mesh_id[1], m_depth_buffer, m_depth[0], m_depth[1], m_visibility };
+    size_t             size     = 0;
+
+    for (auto& image : images)
+    {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(vk_backend->device(), image->handle(), &requirements);
+
+        size += requirements.size;
+    }
+
+    return size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t GBuffer::layout_memory(bool compact)
+{
+    auto vk_backend = m_backend.lock();
+
+    // Only the double buffered normals and mesh IDs change format, the other targets are measured.
+    dw::vk::Image::Ptr images[] = { m_image_1, m_image_3, m_depth_buffer, m_depth[0], m_depth[1], m_visibility };
+    size_t             size     = 0;
+
+    for (auto& image : images)
+    {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(vk_backend->device(), image->handle(), &requirements);
+
+        size += requirements.size;
+    }
+
+    size_t num_texels = 0;
+
+    for (uint32_t level = 0; level < GBUFFER_MIP_LEVELS; level++)
+        num_texels += size_t(std::max(m_input_width >> level, 1u)) * size_t(std::max(m_input_height >> level, 1u));
+
+    return size + 2 * num_texels * (compact ? GBUFFER_COMPACT_TEXEL_SIZE : GBUFFER_FALLBACK_TEXEL_SIZE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t GBuffer::layout_writes(bool compact)
+{
+    // Bytes the geometry pass or the resolve write to the first mip of the four targets every frame.
+    return size_t(m_input_width) * size_t(m_input_height) * (GBUFFER_SHARED_TEXEL_SIZE + (compact ? GBUFFER_COMPACT_TEXEL_SIZE : GBUFFER_FALLBACK_TEXEL_SIZE));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::set_compact_formats(bool compact)
+{
+    auto vk_backend = m_backend.lock();
+
+    // The targets change format along with the descriptor sets binding them and the pipelines writing them.
+    vk_backend->wait_idle();
+
+    m_compact_formats = compact;
+
+    create_layout_images();
+    write_descriptor_sets();
+    create_pipeline();
+    create_visibility_pipelines();
+    create_downsample_pipeline();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -214,33 +476,83 @@ dw::vk::DescriptorSet::Ptr GBuffer::history_ds()
 
 dw::vk::Image::Ptr GBuffer::depth_image() 
 { 
-    return m_depth[m_common_resources->ping_pong]; 
+    return m_depth_buffer; 
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 dw::vk::ImageView::Ptr GBuffer::depth_image_view() 
 { 
-    return m_depth_view[m_common_resources->ping_pong]; 
+    return m_depth_buffer_view; 
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-dw::vk::ImageView::Ptr GBuffer::depth_fbo_image_view(uint32_t idx)
+void GBuffer::downsample(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t num_levels)
 {
-    return m_depth_fbo_view[idx];
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_downsample_pipeline->handle());
+
+    VkDescriptorSet descriptor_set = m_downsample_ds[static_cast<uint32_t>(m_common_resources->ping_pong)]->handle();
+
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_downsample_pipeline_layout->handle(), 0, 1, &descriptor_set, 0, nullptr);
+
+    DownsamplePushConstants push_constants;
+
+    push_constants.num_levels = num_levels;
+
+    vkCmdPushConstants(cmd_buf->handle(), m_downsample_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConstants), &push_constants);
+
+    // A thread per texel of the second mip, rounded up so that the last row and column of an odd sized first mip are copied.
+    uint32_t width  = (m_input_width + 1) / 2;
+    uint32_t height = (m_input_height + 1) / 2;
+
+    vkCmdDispatch(cmd_buf->handle(), (width + DOWNSAMPLE_NUM_THREADS_X - 1) / DOWNSAMPLE_NUM_THREADS_X, (height + DOWNSAMPLE_NUM_THREADS_Y - 1) / DOWNSAMPLE_NUM_THREADS_Y, 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void GBuffer::downsample_gbuffer(dw::vk::CommandBuffer::Ptr cmd_buf)
+void GBuffer::use_images(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages, uint32_t idx, bool history)
 {
-    DW_SCOPED_SAMPLE("Downsample", cmd_buf);
+    VkImageSubresourceRange all_color_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS, 0, 1 };
+
+    // The history descriptor set binds the current single buffered targets, which history reads must not touch.
+    if (!history)
+    {
+        builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_1, all_color_subresource_range);
+        builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_3, all_color_subresource_range);
+    }
 
-    m_image_1[static_cast<uint32_t>(m_common_resources->ping_pong)]->generate_mipmaps(cmd_buf, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_FILTER_NEAREST);
-    m_image_2[static_cast<uint32_t>(m_common_resources->ping_pong)]->generate_mipmaps(cmd_buf, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_FILTER_NEAREST);
-    m_image_3[static_cast<uint32_t>(m_common_resources->ping_pong)]->generate_mipmaps(cmd_buf, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, VK_FILTER_NEAREST);
-    m_depth[static_cast<uint32_t>(m_common_resources->ping_pong)]->generate_mipmaps(cmd_buf, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT, VK_FILTER_NEAREST);
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image_2[idx], all_color_subresource_range);
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_mesh_id[idx], all_color_subresource_range);
+    builder.use_resource(stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_depth[idx], all_color_subresource_range);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::select_formats()
+{
+    auto vk_backend = m_backend.lock();
+
+    // RGB10A2 and R16_UINT are only guaranteed as color attachments, storage images of them also need the extended
+    // formats to be enabled.
+    const VkFormatFeatureFlags kRequiredFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    const VkFormat             kCompactFormats[] = { GBUFFER_2_FORMAT, GBUFFER_MESH_ID_FORMAT };
+
+    m_compact_supported = m_common_resources->enabled_features.shaderStorageImageExtendedFormats == VK_TRUE;
+
+    for (VkFormat format : kCompactFormats)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(vk_backend->physical_device(), format, &properties);
+
+        if ((properties.optimalTilingFeatures & kRequiredFeatures) != kRequiredFeatures)
+            m_compact_supported = false;
+    }
+
+    if (!m_compact_supported)
+        DW_LOG_INFO("RGB10A2 and R16_UINT storage images unavailable, G-buffer normals fall back to RGBA16F and mesh IDs to R32_UINT");
+
+    m_compact_formats = m_compact_supported;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -249,43 +561,76 @@ void GBuffer::create_images()
 {
     auto vk_backend = m_backend.lock();
 
+    m_image_1 = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, GBUFFER_1_FORMAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_image_1->set_name("G-Buffer 1 Image");
+
+    m_image_3 = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, GBUFFER_3_FORMAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_image_3->set_name("G-Buffer 3 Image");
+
+    m_image_1_view = dw::vk::ImageView::create(vk_backend, m_image_1, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
+    m_image_1_view->set_name("G-Buffer 1 Image View");
+
+    m_image_3_view = dw::vk::ImageView::create(vk_backend, m_image_3, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
+    m_image_3_view->set_name("G-Buffer 3 Image View");
+
+    m_image_1_fbo_view = dw::vk::ImageView::create(vk_backend, m_image_1, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_image_1_fbo_view->set_name("G-Buffer 1 FBO Image View");
+
+    m_image_3_fbo_view = dw::vk::ImageView::create(vk_backend, m_image_3, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_image_3_fbo_view->set_name("G-Buffer 3 FBO Image View");
+
+    m_depth_buffer = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, 1, 1, vk_backend->swap_chain_depth_format(), VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_depth_buffer->set_name("G-Buffer Depth Buffer Image");
+
+    m_depth_buffer_view = dw::vk::ImageView::create(vk_backend, m_depth_buffer, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT);
+    m_depth_buffer_view->set_name("G-Buffer Depth Buffer Image View");
+
+    m_visibility = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, 1, 1, GBUFFER_VISIBILITY_FORMAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_visibility->set_name("G-Buffer Visibility Image");
+
+    m_visibility_view = dw::vk::ImageView::create(vk_backend, m_visibility, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_visibility_view->set_name("G-Buffer Visibility Image View");
+
     for (int i = 0; i < 2; i++)
     {
-        m_image_1[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, VK_FORMAT_R8G8B8A8_UNORM, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_image_1[i]->set_name("G-Buffer 1 Image " + std::to_string(i));
+        m_depth[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, GBUFFER_DEPTH_FORMAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
+        m_depth[i]->set_name("G-Buffer Depth Image " + std::to_string(i));
 
-        m_image_2[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_image_2[i]->set_name("G-Buffer 2 Image " + std::to_string(i));
+        m_depth_view[i] = dw::vk::ImageView::create(vk_backend, m_depth[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
+        m_depth_view[i]->set_name("G-Buffer Depth Image View " + std::to_string(i));
+    }
+
+    create_layout_images();
+}
 
-        m_image_3[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_image_3[i]->set_name("G-Buffer 3 Image " + std::to_string(i));
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        m_depth[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, vk_backend->swap_chain_depth_format(), VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_depth[i]->set_name("G-Buffer Depth Image " + std::to_string(i));
+void GBuffer::create_layout_images()
+{
+    auto vk_backend = m_backend.lock();
 
-        m_image_1_view[i] = dw::vk::ImageView::create(vk_backend, m_image_1[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
-        m_image_1_view[i]->set_name("G-Buffer 1 Image View " + std::to_string(i));
+    m_image_2_format = m_compact_formats ? GBUFFER_2_FORMAT : GBUFFER_2_FALLBACK_FORMAT;
+    m_mesh_id_format = m_compact_formats ? GBUFFER_MESH_ID_FORMAT : GBUFFER_MESH_ID_FALLBACK_FORMAT;
 
-        m_image_2_view[i] = dw::vk::ImageView::create(vk_backend, m_image_2[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
-        m_image_2_view[i]->set_name("G-Buffer 2 Image View " + std::to_string(i));
+    for (int i = 0; i < 2; i++)
+    {
+        m_image_2[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, m_image_2_format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
+        m_image_2[i]->set_name("G-Buffer 2 Image " + std::to_string(i));
 
-        m_image_3_view[i] = dw::vk::ImageView::create(vk_backend, m_image_3[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
-        m_image_3_view[i]->set_name("G-Buffer 3 Image View " + std::to_string(i));
+        m_mesh_id[i] = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_input_width, m_input_height, 1, GBUFFER_MIP_LEVELS, 1, m_mesh_id_format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT);
+        m_mesh_id[i]->set_name("G-Buffer Mesh ID Image " + std::to_string(i));
 
-        m_depth_view[i] = dw::vk::ImageView::create(vk_backend, m_depth[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT, 0, GBUFFER_MIP_LEVELS);
-        m_depth_view[i]->set_name("G-Buffer Depth Image View " + std::to_string(i));
+        m_image_2_view[i] = dw::vk::ImageView::create(vk_backend, m_image_2[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
+        m_image_2_view[i]->set_name("G-Buffer 2 Image View " + std::to_string(i));
 
-        m_image_1_fbo_view[i] = dw::vk::ImageView::create(vk_backend, m_image_1[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_image_1_fbo_view[i]->set_name("G-Buffer 1 FBO Image View " + std::to_string(i));
+        m_mesh_id_view[i] = dw::vk::ImageView::create(vk_backend, m_mesh_id[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, GBUFFER_MIP_LEVELS);
+        m_mesh_id_view[i]->set_name("G-Buffer Mesh ID Image View " + std::to_string(i));
 
         m_image_2_fbo_view[i] = dw::vk::ImageView::create(vk_backend, m_image_2[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
         m_image_2_fbo_view[i]->set_name("G-Buffer 2 FBO Image View " + std::to_string(i));
 
-        m_image_3_fbo_view[i] = dw::vk::ImageView::create(vk_backend, m_image_3[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_image_3_fbo_view[i]->set_name("G-Buffer 3 FBO Image View " + std::to_string(i));
-
-        m_depth_fbo_view[i] = dw::vk::ImageView::create(vk_backend, m_depth[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT);
-        m_depth_fbo_view[i]->set_name("G-Buffer Depth FBO Image View " + std::to_string(i));
+        m_mesh_id_fbo_view[i] = dw::vk::ImageView::create(vk_backend, m_mesh_id[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_mesh_id_fbo_view[i]->set_name("G-Buffer Mesh ID FBO Image View " + std::to_string(i));
     }
 }
 
@@ -293,16 +638,47 @@ void GBuffer::create_images()
 
 void GBuffer::create_descriptor_set_layouts()
 {
-    dw::vk::DescriptorSetLayout::Desc desc;
+    auto vk_backend = m_backend.lock();
 
-    desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-    desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-    desc.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-    desc.add_binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
 
-    auto vk_backend = m_backend.lock();
-    m_ds_layout     = dw::vk::DescriptorSetLayout::create(vk_backend, desc);
-    m_ds_layout->set_name("G-Buffer DS Layout");
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_ds_layout = dw::vk::DescriptorSetLayout::create(vk_backend, desc);
+        m_ds_layout->set_name("G-Buffer DS Layout");
+    }
+
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_resolve_ds_layout = dw::vk::DescriptorSetLayout::create(vk_backend, desc);
+        m_resolve_ds_layout->set_name("G-Buffer Resolve DS Layout");
+    }
+
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GBUFFER_MIP_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GBUFFER_MIP_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GBUFFER_MIP_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GBUFFER_MIP_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GBUFFER_MIP_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_downsample_ds_layout = dw::vk::DescriptorSetLayout::create(vk_backend, desc);
+        m_downsample_ds_layout->set_name("G-Buffer Downsample DS Layout");
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -312,7 +688,11 @@ void GBuffer::create_descriptor_sets()
     auto vk_backend = m_backend.lock();
 
     for (int i = 0; i < 2; i++)
-        m_ds[i] = vk_backend->allocate_descriptor_set(m_ds_layout);
+    {
+        m_ds[i]            = vk_backend->allocate_descriptor_set(m_ds_layout);
+        m_resolve_ds[i]    = vk_backend->allocate_descriptor_set(m_resolve_ds_layout);
+        m_downsample_ds[i] = vk_backend->allocate_descriptor_set(m_downsample_ds_layout);
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -321,61 +701,114 @@ void GBuffer::write_descriptor_sets()
 {
     auto vk_backend = m_backend.lock();
 
+    // The sets are written again whenever the layout changes.
+    m_level_views.clear();
+
+    for (int i = 0; i < 2; i++)
+    {
+        dw::vk::ImageView::Ptr views[] = { m_image_1_view, m_image_2_view[i], m_image_3_view, m_depth_view[i], m_mesh_id_view[i] };
+
+        VkDescriptorImageInfo image_info[5];
+        VkWriteDescriptorSet  write_data[5];
+
+        for (uint32_t j = 0; j < 5; j++)
+        {
+            image_info[j].sampler     = vk_backend->nearest_sampler()->handle();
+            image_info[j].imageView   = views[j]->handle();
+            image_info[j].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+            DW_ZERO_MEMORY(write_data[j]);
+
+            write_data[j].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data[j].descriptorCount = 1;
+            write_data[j].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write_data[j].pImageInfo      = &image_info[j];
+            write_data[j].dstBinding      = j;
+            write_data[j].dstSet          = m_ds[i]->handle();
+        }
+
+        vkUpdateDescriptorSets(vk_backend->device(), 5, &write_data[0], 0, nullptr);
+    }
+
+    // The resolve writes the first mip of the targets the geometry passes would have drawn to.
     for (int i = 0; i < 2; i++)
     {
-        VkDescriptorImageInfo image_info[4];
+        dw::vk::ImageView::Ptr views[] = { m_visibility_view, m_image_1_fbo_view, m_image_2_fbo_view[i], m_image_3_fbo_view, m_mesh_id_fbo_view[i] };
+
+        VkDescriptorImageInfo image_info[5];
+        VkWriteDescriptorSet  write_data[5];
+
+        for (uint32_t j = 0; j < 5; j++)
+        {
+            image_info[j].sampler     = j == 0 ? vk_backend->nearest_sampler()->handle() : VK_NULL_HANDLE;
+            image_info[j].imageView   = views[j]->handle();
+            image_info[j].imageLayout = j == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+            DW_ZERO_MEMORY(write_data[j]);
+
+            write_data[j].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data[j].descriptorCount = 1;
+            write_data[j].descriptorType  = j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write_data[j].pImageInfo      = &image_info[j];
+            write_data[j].dstBinding      = j;
+            write_data[j].dstSet          = m_resolve_ds[i]->handle();
+        }
+
+        vkUpdateDescriptorSets(vk_backend->device(), 5, &write_data[0], 0, nullptr);
+    }
+
+    // The downsample samples the depth buffer, and reads and writes every mip of the other targets through a storage view
+    // per mip. The first mip of the G-buffer targets is bound through the views the geometry passes draw to.
+    for (int i = 0; i < 2; i++)
+    {
+        dw::vk::Image::Ptr     level_images[]      = { m_depth[i], m_image_1, m_image_2[i], m_image_3, m_mesh_id[i] };
+        dw::vk::ImageView::Ptr first_level_views[] = { nullptr, m_image_1_fbo_view, m_image_2_fbo_view[i], m_image_3_fbo_view, m_mesh_id_fbo_view[i] };
+        std::string            level_names[]       = { "Depth", "1", "2", "3", "Mesh ID" };
+
+        VkDescriptorImageInfo image_info[1 + 5 * GBUFFER_MIP_LEVELS];
+        VkWriteDescriptorSet  write_data[6];
 
         image_info[0].sampler     = vk_backend->nearest_sampler()->handle();
-        image_info[0].imageView   = m_image_1_view[i]->handle();
+        image_info[0].imageView   = m_depth_buffer_view->handle();
         image_info[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        image_info[1].sampler     = vk_backend->nearest_sampler()->handle();
-        image_info[1].imageView   = m_image_2_view[i]->handle();
-        image_info[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        image_info[2].sampler     = vk_backend->nearest_sampler()->handle();
-        image_info[2].imageView   = m_image_3_view[i]->handle();
-        image_info[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        image_info[3].sampler     = vk_backend->nearest_sampler()->handle();
-        image_info[3].imageView   = m_depth_view[i]->handle();
-        image_info[3].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        VkWriteDescriptorSet write_data[4];
-        DW_ZERO_MEMORY(write_data[0]);
-        DW_ZERO_MEMORY(write_data[1]);
-        DW_ZERO_MEMORY(write_data[2]);
-        DW_ZERO_MEMORY(write_data[3]);
-
-        write_data[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_data[0].descriptorCount = 1;
-        write_data[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write_data[0].pImageInfo      = &image_info[0];
-        write_data[0].dstBinding      = 0;
-        write_data[0].dstSet          = m_ds[i]->handle();
-
-        write_data[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_data[1].descriptorCount = 1;
-        write_data[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write_data[1].pImageInfo      = &image_info[1];
-        write_data[1].dstBinding      = 1;
-        write_data[1].dstSet          = m_ds[i]->handle();
-
-        write_data[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_data[2].descriptorCount = 1;
-        write_data[2].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write_data[2].pImageInfo      = &image_info[2];
-        write_data[2].dstBinding      = 2;
-        write_data[2].dstSet          = m_ds[i]->handle();
-
-        write_data[3].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_data[3].descriptorCount = 1;
-        write_data[3].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write_data[3].pImageInfo      = &image_info[3];
-        write_data[3].dstBinding      = 3;
-        write_data[3].dstSet          = m_ds[i]->handle();
-
-        vkUpdateDescriptorSets(vk_backend->device(), 4, &write_data[0], 0, nullptr);
+        uint32_t num_image_infos = 1;
+
+        for (uint32_t j = 0; j < 6; j++)
+        {
+            DW_ZERO_MEMORY(write_data[j]);
+
+            write_data[j].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data[j].descriptorCount = j == 0 ? 1 : GBUFFER_MIP_LEVELS;
+            write_data[j].descriptorType  = j == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write_data[j].pImageInfo      = j == 0 ? &image_info[0] : &image_info[num_image_infos];
+            write_data[j].dstBinding      = j;
+            write_data[j].dstSet          = m_downsample_ds[i]->handle();
+
+            if (j == 0)
+                continue;
+
+            for (uint32_t level = 0; level < GBUFFER_MIP_LEVELS; level++)
+            {
+                dw::vk::ImageView::Ptr view = level == 0 ? first_level_views[j - 1] : nullptr;
+
+                if (!view)
+                {
+                    view = dw::vk::ImageView::create(vk_backend, level_images[j - 1], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+                    view->set_name("G-Buffer " + level_names[j - 1] + " Level " + std::to_string(level) + " Image View " + std::to_string(i));
+
+                    m_level_views.push_back(view);
+                }
+
+                image_info[num_image_infos].sampler     = VK_NULL_HANDLE;
+                image_info[num_image_infos].imageView   = view->handle();
+                image_info[num_image_infos].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+                num_image_infos++;
+            }
+        }
+
+        vkUpdateDescriptorSets(vk_backend->device(), 6, &write_data[0], 0, nullptr);
     }
 }
 
@@ -389,8 +822,8 @@ void GBuffer::create_pipeline()
     // Create shader modules
     // ---------------------------------------------------------------------------
 
-    dw::vk::ShaderModule::Ptr vs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/g_buffer.vert.spv");
-    dw::vk::ShaderModule::Ptr fs = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/g_buffer.frag.spv");
+    dw::vk::ShaderModule::Ptr vs = ShaderLibrary::load(vk_backend, "shaders/g_buffer.vert.spv");
+    dw::vk::ShaderModule::Ptr fs = ShaderLibrary::load(vk_backend, "shaders/g_buffer.frag.spv");
 
     dw::vk::GraphicsPipeline::Desc pso_desc;
 
@@ -492,6 +925,7 @@ void GBuffer::create_pipeline()
         .set_blend_constants(0.0f, 0.0f, 0.0f, 0.0f)
         .add_attachment(blend_att_desc)
         .add_attachment(blend_att_desc)
+        .add_attachment(blend_att_desc)
         .add_attachment(blend_att_desc);
 
     pso_desc.set_color_blend_state(blend_state);
@@ -504,7 +938,9 @@ void GBuffer::create_pipeline()
 
     pl_desc.add_descriptor_set_layout(m_common_resources->scene_ds_layout)
         .add_descriptor_set_layout(m_common_resources->per_frame_ds_layout)
-        .add_push_constant_range(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GBufferPushConstants));
+        .add_descriptor_set_layout(m_draw_culler->ds_layout())
+        .add_push_constant_range(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GBufferPushConstants))
+        .add_push_constant_range(VK_SHADER_STAGE_VERTEX_BIT, DrawCuller::kPushConstantOffset, sizeof(uint32_t));
 
     m_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, pl_desc);
 
@@ -521,9 +957,10 @@ void GBuffer::create_pipeline()
     // Create rendering state
     // ---------------------------------------------------------------------------
 
-    pso_desc.add_color_attachment_format(VK_FORMAT_R8G8B8A8_UNORM);
-    pso_desc.add_color_attachment_format(VK_FORMAT_R16G16B16A16_SFLOAT);
-    pso_desc.add_color_attachment_format(VK_FORMAT_R16G16B16A16_SFLOAT);
+    pso_desc.add_color_attachment_format(GBUFFER_1_FORMAT);
+    pso_desc.add_color_attachment_format(m_image_2_format);
+    pso_desc.add_color_attachment_format(GBUFFER_3_FORMAT);
+    pso_desc.add_color_attachment_format(m_mesh_id_format);
     pso_desc.set_depth_attachment_format(vk_backend->swap_chain_depth_format());
     pso_desc.set_stencil_attachment_format(VK_FORMAT_UNDEFINED);
 
@@ -531,7 +968,217 @@ void GBuffer::create_pipeline()
     // Create pipeline
     // ---------------------------------------------------------------------------
 
-    m_pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc);
+    m_pipeline = dw::vk::GraphicsPipeline::create(vk_backend, pso_desc, m_common_resources->pipeline_cache->handle());
 }
 
-// -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::GraphicsPipeline::Ptr GBuffer::create_visibility_pipeline(const std::string& fragment_shader)
+{
+    auto vk_backend = m_backend.lock();
+
+    // ---------------------------------------------------------------------------
+    // Create shader modules
+    // ---------------------------------------------------------------------------
+
+    dw::vk::ShaderModule::Ptr vs = ShaderLibrary::load(vk_backend, "shaders/g_buffer_visibility.vert.spv");
+    dw::vk::ShaderModule::Ptr fs = ShaderLibrary::load(vk_backend, fragment_shader);
+
+    dw::vk::GraphicsPipeline::Desc pso_desc;
+
+    pso_desc.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, vs, "main")
+        .add_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main");
+
+    // ---------------------------------------------------------------------------
+    // Create vertex input state
+    // ---------------------------------------------------------------------------
+
+    // Only the position and the texture coordinate for alpha testing are read.
+    dw::vk::VertexInputStateDesc vertex_input_state_desc = {};
+
+    vertex_input_state_desc.add_binding_desc(0, sizeof(dw::Vertex), VK_VERTEX_INPUT_RATE_VERTEX);
+
+    vertex_input_state_desc.add_attribute_desc(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0);
+    vertex_input_state_desc.add_attribute_desc(1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(dw::Vertex, tex_coord));
+
+    pso_desc.set_vertex_input_state(vertex_input_state_desc);
+
+    // ---------------------------------------------------------------------------
+    // Create pipeline input assembly state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::InputAssemblyStateDesc input_assembly_state_desc;
+
+    input_assembly_state_desc.set_primitive_restart_enable(false)
+        .set_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+
+    pso_desc.set_input_assembly_state(input_assembly_state_desc);
+
+    // ---------------------------------------------------------------------------
+    // Create viewport state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::ViewportStateDesc vp_desc;
+
+    vp_desc.add_viewport(0.0f, 0.0f, m_input_width, m_input_height, 0.0f, 1.0f)
+        .add_scissor(0, 0, m_input_width, m_input_height);
+
+    pso_desc.set_viewport_state(vp_desc);
+
+    // ---------------------------------------------------------------------------
+    // Create rasterization state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::RasterizationStateDesc rs_state;
+
+    rs_state.set_depth_clamp(VK_FALSE)
+        .set_rasterizer_discard_enable(VK_FALSE)
+        .set_polygon_mode(VK_POLYGON_MODE_FILL)
+        .set_line_width(1.0f)
+        .set_cull_mode(VK_CULL_MODE_BACK_BIT)
+        .set_front_face(VK_FRONT_FACE_CLOCKWISE)
+        .set_depth_bias(VK_FALSE);
+
+    pso_desc.set_rasterization_state(rs_state);
+
+    // ---------------------------------------------------------------------------
+    // Create multisample state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::MultisampleStateDesc ms_state;
+
+    ms_state.set_sample_shading_enable(VK_FALSE)
+        .set_rasterization_samples(VK_SAMPLE_COUNT_1_BIT);
+
+    pso_desc.set_multisample_state(ms_state);
+
+    // ---------------------------------------------------------------------------
+    // Create depth stencil state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::DepthStencilStateDesc ds_state;
+
+    ds_state.set_depth_test_enable(VK_TRUE)
+        .set_depth_write_enable(VK_TRUE)
+        .set_depth_compare_op(VK_COMPARE_OP_LESS)
+        .set_depth_bounds_test_enable(VK_FALSE)
+        .set_stencil_test_enable(VK_FALSE);
+
+    pso_desc.set_depth_stencil_state(ds_state);
+
+    // ---------------------------------------------------------------------------
+    // Create color blend state
+    // ---------------------------------------------------------------------------
+
+    dw::vk::ColorBlendAttachmentStateDesc blend_att_desc;
+
+    blend_att_desc.set_color_write_mask(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT)
+        .set_blend_enable(VK_FALSE);
+
+    dw::vk::ColorBlendStateDesc blend_state;
+
+    blend_state.set_logic_op_enable(VK_FALSE)
+        .set_logic_op(VK_LOGIC_OP_COPY)
+        .set_blend_constants(0.0f, 0.0f, 0.0f, 0.0f)
+        .add_attachment(blend_att_desc);
+
+    pso_desc.set_color_blend_state(blend_state);
+
+    pso_desc.set_pipeline_layout(m_visibility_pipeline_layout);
+
+    // ---------------------------------------------------------------------------
+    // Create dynamic state
+    // ---------------------------------------------------------------------------
+
+    pso_desc.add_dynamic_state(VK_DYNAMIC_STATE_VIEWPORT)
+        .add_dynamic_state(VK_DYNAMIC_STATE_SCISSOR);
+
+    // ---------------------------------------------------------------------------
+    // Create rendering state
+    // ---------------------------------------------------------------------------
+
+    pso_desc.add_color_attachment_format(GBUFFER_VISIBILITY_FORMAT);
+    pso_desc.set_depth_attachment_format(vk_backend->swap_chain_depth_format());
+    pso_desc.set_stencil_attachment_format(VK_FORMAT_UNDEFINED);
+
+    // ---------------------------------------------------------------------------
+    // Create pipeline
+    // ---------------------------------------------------------------------------
+
+    return dw::vk::GraphicsPipeline::create(vk_backend, pso_desc, m_common_resources->pipeline_cache->handle());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::create_visibility_pipelines()
+{
+    auto vk_backend = m_backend.lock();
+
+    {
+        // ---------------------------------------------------------------------------
+        // Create pipeline layout
+        // ---------------------------------------------------------------------------
+
+        dw::vk::PipelineLayout::Desc pl_desc;
+
+        pl_desc.add_descriptor_set_layout(m_common_resources->scene_ds_layout)
+            .add_descriptor_set_layout(m_common_resources->per_frame_ds_layout)
+            .add_descriptor_set_layout(m_draw_culler->ds_layout())
+            .add_push_constant_range(VK_SHADER_STAGE_VERTEX_BIT, DrawCuller::kPushConstantOffset, sizeof(uint32_t));
+
+        m_visibility_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, pl_desc);
+        m_visibility_pipeline_layout->set_name("G-Buffer Visibility Pipeline Layout");
+
+        // Opaque materials get a pipeline without the alpha test, so that it can keep early depth testing.
+        m_visibility_opaque_pipeline = create_visibility_pipeline("shaders/g_buffer_visibility_opaque.frag.spv");
+        m_visibility_pipeline        = create_visibility_pipeline("shaders/g_buffer_visibility.frag.spv");
+    }
+
+    {
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, m_compact_formats ? "shaders/g_buffer_resolve.comp.spv" : "shaders/g_buffer_resolve_fallback.comp.spv");
+
+        dw::vk::PipelineLayout::Desc pl_desc;
+
+        pl_desc.add_descriptor_set_layout(m_common_resources->scene_ds_layout);
+        pl_desc.add_descriptor_set_layout(m_common_resources->per_frame_ds_layout);
+        pl_desc.add_descriptor_set_layout(m_draw_culler->ds_layout());
+        pl_desc.add_descriptor_set_layout(m_resolve_ds_layout);
+        pl_desc.add_push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GBufferPushConstants));
+
+        m_resolve_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, pl_desc);
+        m_resolve_pipeline_layout->set_name("G-Buffer Resolve Pipeline Layout");
+
+        dw::vk::ComputePipeline::Desc desc;
+
+        desc.set_shader_stage(module, "main");
+        desc.set_pipeline_layout(m_resolve_pipeline_layout);
+
+        m_resolve_pipeline = dw::vk::ComputePipeline::create(vk_backend, desc, m_common_resources->pipeline_cache->handle());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void GBuffer::create_downsample_pipeline()
+{
+    auto vk_backend = m_backend.lock();
+
+    dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, m_compact_formats ? "shaders/g_buffer_downsample.comp.spv" : "shaders/g_buffer_downsample_fallback.comp.spv");
+
+    dw::vk::PipelineLayout::Desc pl_desc;
+
+    pl_desc.add_descriptor_set_layout(m_downsample_ds_layout);
+    pl_desc.add_push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConstants));
+
+    m_downsample_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, pl_desc);
+    m_downsample_pipeline_layout->set_name("G-Buffer Downsample Pipeline Layout");
+
+    dw::vk::ComputePipeline::Desc desc;
+
+    desc.set_shader_stage(module, "main");
+    desc.set_pipeline_layout(m_downsample_pipeline_layout);
+
+    m_downsample_pipeline = dw::vk::ComputePipeline::create(vk_backend, desc, m_common_resources->pipeline_cache->handle());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
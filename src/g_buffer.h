@@ -1,50 +1,107 @@
 #pragma once
 
 #include <vk.h>
+#include "common.h"
+#include "render_graph.h"
+#include "draw_culler.h"
 
-struct CommonResources;
-
+// Only the targets the reprojection of the denoisers reads from the previous frame (normals, mesh IDs and depth) are
+// double buffered, everything else is only ever read in the frame it was drawn.
+//
+// In visibility buffer mode the geometry passes only write the draw and primitive of every pixel, alpha testing the
+// materials that need it being the only material work they do. A compute pass then fetches the triangle of every pixel
+// from the scene descriptor set, interpolates its attributes and evaluates the material once to fill the same targets,
+// so overdraw no longer pays for normal maps, roughness and metallic.
+//
+// The compact layout stores normals as RGB10A2 and mesh IDs as R16_UINT, the fallback layout as RGBA16F and R32_UINT.
+// Both can be switched between at runtime when the device supports the compact one.
+//
+// Depth formats cannot be written from compute shaders, so the depth buffer itself only has a single mip. The
+// downsample copies it into a float target along with the mips of every other target, and that copy is what the
+// descriptor sets bind.
 class GBuffer
 {
 public:
     GBuffer(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, uint32_t input_width, uint32_t input_height);
     ~GBuffer();
 
-    void                             render(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                             render(RenderGraph& graph, RayTraceScale scale);
+    void                             gui();
+    void                             profiler_gui();
+    size_t                           memory_usage();
+    void                             use_output(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages);
+    void                             use_history(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages);
     dw::vk::DescriptorSetLayout::Ptr ds_layout();
     dw::vk::DescriptorSet::Ptr       output_ds();
     dw::vk::DescriptorSet::Ptr       history_ds();
     dw::vk::Image::Ptr               depth_image();
     dw::vk::ImageView::Ptr           depth_image_view();
-    dw::vk::ImageView::Ptr           depth_fbo_image_view(uint32_t idx);
 
 private:
+    void select_formats();
     void create_images();
+    void create_layout_images();
+    void set_compact_formats(bool compact);
+    size_t layout_memory(bool compact);
+    size_t layout_writes(bool compact);
     void create_descriptor_set_layouts();
     void create_descriptor_sets();
     void write_descriptor_sets();
     void create_pipeline();
-    void downsample_gbuffer(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void use_images(RenderGraph::PassBuilder& builder, VkPipelineStageFlags2 stages, uint32_t idx, bool history);
+    void create_visibility_pipelines();
+    dw::vk::GraphicsPipeline::Ptr create_visibility_pipeline(const std::string& fragment_shader);
+    void create_downsample_pipeline();
+    void add_geometry_pass(RenderGraph& graph, CullPhase phase, bool visibility_buffer);
+    void add_resolve_pass(RenderGraph& graph);
+    void fill(dw::vk::CommandBuffer::Ptr cmd_buf, CullPhase phase, bool visibility_buffer);
+    void add_downsample_pass(RenderGraph& graph, uint32_t num_levels);
+    void resolve(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void downsample(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t num_levels);
 
 private:
-    std::weak_ptr<dw::vk::Backend>   m_backend;
-    CommonResources*                 m_common_resources;
-    uint32_t                         m_input_width;
-    uint32_t                         m_input_height;
-    dw::vk::Image::Ptr               m_image_1[2]; // RGB: Albedo, A: Metallic
-    dw::vk::Image::Ptr               m_image_2[2]; // RG: Normal, BA: Motion Vector
-    dw::vk::Image::Ptr               m_image_3[2]; // R: Roughness, G: Curvature, B: Mesh ID, A: Linear Z
-    dw::vk::Image::Ptr               m_depth[2];
-    dw::vk::ImageView::Ptr           m_image_1_view[2];
-    dw::vk::ImageView::Ptr           m_image_2_view[2];
-    dw::vk::ImageView::Ptr           m_image_3_view[2];
-    dw::vk::ImageView::Ptr           m_depth_view[2];
-    dw::vk::ImageView::Ptr           m_image_1_fbo_view[2];
-    dw::vk::ImageView::Ptr           m_image_2_fbo_view[2];
-    dw::vk::ImageView::Ptr           m_image_3_fbo_view[2];
-    dw::vk::ImageView::Ptr           m_depth_fbo_view[2];
-    dw::vk::GraphicsPipeline::Ptr    m_pipeline;
-    dw::vk::PipelineLayout::Ptr      m_pipeline_layout;
-    dw::vk::DescriptorSetLayout::Ptr m_ds_layout;
-    dw::vk::DescriptorSet::Ptr       m_ds[2];
+    std::weak_ptr<dw::vk::Backend>      m_backend;
+    CommonResources*                    m_common_resources;
+    uint32_t                            m_input_width;
+    uint32_t                            m_input_height;
+    bool                                m_visibility_buffer = false;
+    bool                                m_compact_supported = false; // See select_formats().
+    bool                                m_compact_formats   = true;  // RGB10A2 normals and R16_UINT mesh IDs.
+    VkFormat                            m_image_2_format    = VK_FORMAT_UNDEFINED;
+    VkFormat                            m_mesh_id_format    = VK_FORMAT_UNDEFINED;
+    dw::vk::Image::Ptr                  m_image_1;    // RGB: Albedo, A: Metallic
+    dw::vk::Image::Ptr                  m_image_2[2]; // RG: Normal, B: Roughness
+    dw::vk::Image::Ptr                  m_image_3;    // RG: Motion Vector, B: Curvature, A: Linear Z
+    dw::vk::Image::Ptr                  m_mesh_id[2];
+    dw::vk::Image::Ptr                  m_depth_buffer;
+    dw::vk::Image::Ptr                  m_depth[2];
+    dw::vk::Image::Ptr                  m_visibility; // R: Draw Index + 1, G: Primitive ID
+    dw::vk::ImageView::Ptr              m_image_1_view;
+    dw::vk::ImageView::Ptr              m_image_2_view[2];
+    dw::vk::ImageView::Ptr              m_image_3_view;
+    dw::vk::ImageView::Ptr              m_mesh_id_view[2];
+    dw::vk::ImageView::Ptr              m_depth_buffer_view;
+    dw::vk::ImageView::Ptr              m_depth_view[2];
+    dw::vk::ImageView::Ptr              m_image_1_fbo_view;
+    dw::vk::ImageView::Ptr              m_image_2_fbo_view[2];
+    dw::vk::ImageView::Ptr              m_image_3_fbo_view;
+    dw::vk::ImageView::Ptr              m_mesh_id_fbo_view[2];
+    dw::vk::ImageView::Ptr              m_visibility_view;
+    std::vector<dw::vk::ImageView::Ptr> m_level_views;
+    dw::vk::GraphicsPipeline::Ptr       m_pipeline;
+    dw::vk::GraphicsPipeline::Ptr       m_visibility_pipeline;
+    dw::vk::GraphicsPipeline::Ptr       m_visibility_opaque_pipeline;
+    dw::vk::PipelineLayout::Ptr         m_pipeline_layout;
+    dw::vk::PipelineLayout::Ptr         m_visibility_pipeline_layout;
+    dw::vk::ComputePipeline::Ptr        m_resolve_pipeline;
+    dw::vk::PipelineLayout::Ptr         m_resolve_pipeline_layout;
+    dw::vk::ComputePipeline::Ptr        m_downsample_pipeline;
+    dw::vk::PipelineLayout::Ptr         m_downsample_pipeline_layout;
+    dw::vk::DescriptorSetLayout::Ptr    m_ds_layout;
+    dw::vk::DescriptorSetLayout::Ptr    m_resolve_ds_layout;
+    dw::vk::DescriptorSetLayout::Ptr    m_downsample_ds_layout;
+    dw::vk::DescriptorSet::Ptr          m_ds[2];
+    dw::vk::DescriptorSet::Ptr          m_resolve_ds[2];
+    dw::vk::DescriptorSet::Ptr          m_downsample_ds[2];
+    std::unique_ptr<DrawCuller>         m_draw_culler;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ground_truth_path_tracer.h"
+#include "shader_library.h"
 #include <profiler.h>
 #include <macros.h>
 #include <imgui.h>
@@ -23,15 +24,15 @@ GroundTruthPathTracer::GroundTruthPathTracer(std::weak_ptr<dw::vk::Backend> back
 {
     auto vk_backend = m_backend.lock();
 
-    m_width  = vk_backend->swap_chain_extents().width;
-    m_height = vk_backend->swap_chain_extents().height;
+    m_width  = m_common_resources->output_width;
+    m_height = m_common_resources->output_height;
 
     m_path_trace.max_ray_bounces = vk_backend->ray_tracing_pipeline_properties().maxRayRecursionDepth;
 
     create_images();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipelines();
+    m_common_resources->pipeline_cache->queue([this]() { create_pipelines(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -42,69 +43,85 @@ GroundTruthPathTracer::~GroundTruthPathTracer()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void GroundTruthPathTracer::render(dw::vk::CommandBuffer::Ptr cmd_buf)
+void GroundTruthPathTracer::render(RenderGraph& graph)
 {
     if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_GROUND_TRUTH)
     {
-        DW_SCOPED_SAMPLE("Ground Truth Path Trace", cmd_buf);
-
         if (m_frame_idx == 0)
             m_ping_pong = false;
 
-        auto backend = m_backend.lock();
-
-        const uint32_t read_idx  = static_cast<uint32_t>(m_ping_pong);
-        const uint32_t write_idx = static_cast<uint32_t>(!m_ping_pong);
+        const uint32_t read_idx   = static_cast<uint32_t>(m_ping_pong);
+        const uint32_t write_idx  = static_cast<uint32_t>(!m_ping_pong);
+        const uint32_t num_frames = m_frame_idx++;
 
         VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_path_trace.images[write_idx], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, m_path_trace.images[read_idx], subresource_range);
+        graph.begin_group("Ground Truth");
 
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_path_trace.pipeline->handle());
+        graph.add_pass(
+            "Path Trace",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_path_trace.images[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, m_path_trace.images[read_idx], subresource_range);
+            },
+            [this, read_idx, write_idx, num_frames](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                path_trace(cmd_buf, read_idx, write_idx, num_frames);
+            });
 
-        PathTracePushConstants push_constants;
+        graph.end_group();
 
-        push_constants.num_frames           = m_frame_idx++;
-        push_constants.max_ray_bounces      = m_path_trace.max_ray_bounces;
-        push_constants.roughness_multiplier = m_common_resources->roughness_multiplier;
+        m_ping_pong = !m_ping_pong;
+    }
+}
 
-        vkCmdPushConstants(cmd_buf->handle(), m_path_trace.pipeline_layout->handle(), VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0, sizeof(push_constants), &push_constants);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        const uint32_t dynamic_offsets[] = {
-            m_common_resources->ubo_size * backend->current_frame_idx()
-        };
+dw::vk::Image::Ptr GroundTruthPathTracer::output_image()
+{
+    return m_path_trace.images[static_cast<uint32_t>(m_ping_pong)];
+}
 
-        VkDescriptorSet descriptor_sets[] = {
-            m_common_resources->current_scene()->descriptor_set()->handle(),
-            m_path_trace.write_ds[write_idx]->handle(),
-            m_path_trace.write_ds[read_idx]->handle(),
-            m_common_resources->per_frame_ds->handle(),
-            m_common_resources->current_skybox_ds->handle()
-        };
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_path_trace.pipeline_layout->handle(), 0, 5, descriptor_sets, 1, dynamic_offsets);
+void GroundTruthPathTracer::path_trace(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t read_idx, uint32_t write_idx, uint32_t num_frames)
+{
+    auto backend = m_backend.lock();
 
-        auto sbt = m_path_trace.sbt;
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_path_trace.pipeline->handle());
 
-        const VkStridedDeviceAddressRegionKHR raygen_sbt   = m_path_trace.pipeline->ray_gen_region();
-        const VkStridedDeviceAddressRegionKHR miss_sbt     = m_path_trace.pipeline->miss_group_region();
-        const VkStridedDeviceAddressRegionKHR hit_sbt      = m_path_trace.pipeline->hit_group_region();
-        const VkStridedDeviceAddressRegionKHR callable_sbt = { 0, 0, 0 };
+    PathTracePushConstants push_constants;
 
-        uint32_t rt_image_width  = m_width;
-        uint32_t rt_image_height = m_height;
+    push_constants.num_frames           = num_frames;
+    push_constants.max_ray_bounces      = m_path_trace.max_ray_bounces;
+    push_constants.roughness_multiplier = m_common_resources->roughness_multiplier;
 
-        vkCmdTraceRaysKHR(cmd_buf->handle(), &raygen_sbt, &miss_sbt, &hit_sbt, &callable_sbt, rt_image_width, rt_image_height, 1);
+    vkCmdPushConstants(cmd_buf->handle(), m_path_trace.pipeline_layout->handle(), VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0, sizeof(push_constants), &push_constants);
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_path_trace.images[write_idx], subresource_range);
-        
-        backend->flush_barriers(cmd_buf);
-        
-        m_ping_pong = !m_ping_pong;
-    }
+    const uint32_t dynamic_offsets[] = {
+        m_common_resources->ubo_size * backend->current_frame_idx()
+    };
+
+    VkDescriptorSet descriptor_sets[] = {
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
+        m_path_trace.write_ds[write_idx]->handle(),
+        m_path_trace.write_ds[read_idx]->handle(),
+        m_common_resources->per_frame_ds->handle(),
+        m_common_resources->current_skybox_ds->handle()
+    };
+
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_path_trace.pipeline_layout->handle(), 0, 5, descriptor_sets, 1, dynamic_offsets);
+
+    auto sbt = m_path_trace.sbt;
+
+    const VkStridedDeviceAddressRegionKHR raygen_sbt   = m_path_trace.pipeline->ray_gen_region();
+    const VkStridedDeviceAddressRegionKHR miss_sbt     = m_path_trace.pipeline->miss_group_region();
+    const VkStridedDeviceAddressRegionKHR hit_sbt      = m_path_trace.pipeline->hit_group_region();
+    const VkStridedDeviceAddressRegionKHR callable_sbt = { 0, 0, 0 };
+
+    uint32_t rt_image_width  = m_width;
+    uint32_t rt_image_height = m_height;
+
+    vkCmdTraceRaysKHR(cmd_buf->handle(), &raygen_sbt, &miss_sbt, &hit_sbt, &callable_sbt, rt_image_width, rt_image_height, 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -238,9 +255,9 @@ void GroundTruthPathTracer::create_pipelines()
     // Create shader modules
     // ---------------------------------------------------------------------------
 
-    dw::vk::ShaderModule::Ptr rgen  = dw::vk::ShaderModule::create_from_file(backend, "shaders/ground_truth_path_trace.rgen.spv");
-    dw::vk::ShaderModule::Ptr rchit = dw::vk::ShaderModule::create_from_file(backend, "shaders/ground_truth_path_trace.rchit.spv");
-    dw::vk::ShaderModule::Ptr rmiss = dw::vk::ShaderModule::create_from_file(backend, "shaders/ground_truth_path_trace.rmiss.spv");
+    dw::vk::ShaderModule::Ptr rgen  = ShaderLibrary::load(backend, "shaders/ground_truth_path_trace.rgen.spv");
+    dw::vk::ShaderModule::Ptr rchit = ShaderLibrary::load(backend, "shaders/ground_truth_path_trace.rchit.spv");
+    dw::vk::ShaderModule::Ptr rmiss = ShaderLibrary::load(backend, "shaders/ground_truth_path_trace.rmiss.spv");
 
     dw::vk::ShaderBindingTable::Desc sbt_desc;
 
@@ -272,7 +289,7 @@ void GroundTruthPathTracer::create_pipelines()
 
     desc.set_pipeline_layout(m_path_trace.pipeline_layout);
 
-    m_path_trace.pipeline = dw::vk::RayTracingPipeline::create(backend, desc);
+    m_path_trace.pipeline = dw::vk::RayTracingPipeline::create(backend, desc, m_common_resources->pipeline_cache->handle());
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
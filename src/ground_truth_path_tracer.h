@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "render_graph.h"
 
 class GBuffer;
 
@@ -10,9 +11,10 @@ public:
     GroundTruthPathTracer(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources);
     ~GroundTruthPathTracer();
 
-    void                       render(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                       render(RenderGraph& graph);
     void                       gui();
     dw::vk::DescriptorSet::Ptr output_ds();
+    dw::vk::Image::Ptr         output_image();
 
     inline void restart_accumulation() { m_frame_idx = 0; }
 
@@ -21,6 +23,7 @@ private:
     void create_descriptor_sets();
     void write_descriptor_sets();
     void create_pipelines();
+    void path_trace(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t read_idx, uint32_t write_idx, uint32_t num_frames);
 
 private:
     struct PathTrace
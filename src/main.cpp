@@ -1,11 +1,14 @@
 #include <application.h>
 #include <camera.h>
 #include <profiler.h>
+#include <logger.h>
 #include <assimp/scene.h>
 #include <equirectangular_to_cubemap.h>
 #include <imgui.h>
 #include <ImGuizmo.h>
 #include <math.h>
+#include <chrono>
+#include <algorithm>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/matrix_decompose.hpp>
 #include <gtc/quaternion.hpp>
@@ -18,6 +21,11 @@
 #include "ground_truth_path_tracer.h"
 #include "tone_map.h"
 #include "temporal_aa.h"
+#include "render_graph.h"
+#include "command_line.h"
+#include "benchmark.h"
+#include "trace_recorder.h"
+#include "mesh_cache.h"
 
 class HybridRendering : public dw::Application
 {
@@ -27,8 +35,52 @@ public:
 protected:
     bool init(int argc, const char* argv[]) override
     {
-        m_common_resources         = std::unique_ptr<CommonResources>(new CommonResources(m_vk_backend));
-        m_g_buffer                 = std::unique_ptr<GBuffer>(new GBuffer(m_vk_backend, m_common_resources.get(), m_width, m_height));
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (!parse_command_line(argc, argv, m_options))
+            return false;
+
+        if (m_options.scene >= SCENE_TYPE_COUNT)
+        {
+            DW_LOG_ERROR("Invalid scene index: " + std::to_string(m_options.scene));
+            return false;
+        }
+
+        if (m_options.sampler >= (int32_t)constants::blue_noise_samplers.size())
+        {
+            DW_LOG_ERROR("Invalid sampler index: " + std::to_string(m_options.sampler));
+            return false;
+        }
+
+        if (m_options.tune_workgroups > 0 && !m_options.benchmark.empty())
+        {
+            DW_LOG_ERROR("Workgroup tuning and the benchmark can not run together");
+            return false;
+        }
+
+        if (m_options.mesh_benchmark > 0)
+            MeshCache::benchmark("meshes/sponza.obj", m_options.mesh_benchmark);
+
+        m_common_resources = std::unique_ptr<CommonResources>(new CommonResources(m_vk_backend));
+
+        // Device creation fails if a requested feature is missing, so everything requested is enabled.
+        m_common_resources->enabled_features = m_device_features;
+
+        // Every module sizes its images from the output resolution, which only follows the swap chain when rendering to the window.
+        m_common_resources->headless      = m_options.headless;
+        m_common_resources->output_width  = m_options.width > 0 ? m_options.width : m_vk_backend->swap_chain_extents().width;
+        m_common_resources->output_height = m_options.height > 0 ? m_options.height : m_vk_backend->swap_chain_extents().height;
+
+        if (m_options.scene >= 0)
+            m_common_resources->current_scene_type = (SceneType)m_options.scene;
+
+        if (m_options.texture_budget > 0)
+            m_common_resources->texture_streamer->set_budget(size_t(m_options.texture_budget) * 1024 * 1024);
+
+        if (m_options.sampler >= 0)
+            m_common_resources->blue_noise_sampler = (BlueNoiseSampler)m_options.sampler;
+
+        m_g_buffer                 = std::unique_ptr<GBuffer>(new GBuffer(m_vk_backend, m_common_resources.get(), m_common_resources->output_width, m_common_resources->output_height));
         m_ray_traced_shadows       = std::unique_ptr<RayTracedShadows>(new RayTracedShadows(m_vk_backend, m_common_resources.get(), m_g_buffer.get()));
         m_ray_traced_ao            = std::unique_ptr<RayTracedAO>(new RayTracedAO(m_vk_backend, m_common_resources.get(), m_g_buffer.get()));
         m_ray_traced_reflections   = std::unique_ptr<RayTracedReflections>(new RayTracedReflections(m_vk_backend, m_common_resources.get(), m_g_buffer.get()));
@@ -37,10 +89,31 @@ protected:
         m_deferred_shading         = std::unique_ptr<DeferredShading>(new DeferredShading(m_vk_backend, m_common_resources.get(), m_g_buffer.get()));
         m_temporal_aa              = std::unique_ptr<TemporalAA>(new TemporalAA(m_vk_backend, m_common_resources.get(), m_g_buffer.get()));
         m_tone_map                 = std::unique_ptr<ToneMap>(new ToneMap(m_vk_backend, m_common_resources.get()));
+        m_render_graph             = std::unique_ptr<RenderGraph>(new RenderGraph(m_vk_backend, m_timeline_semaphore_features.timelineSemaphore == VK_TRUE));
+        m_trace_recorder           = std::unique_ptr<TraceRecorder>(new TraceRecorder());
+
+        m_common_resources->pipeline_cache->flush();
+
+        m_render_graph->set_trace_recorder(m_trace_recorder.get());
 
         create_camera();
         set_active_scene();
 
+        if (!m_options.benchmark.empty())
+            m_benchmark = std::unique_ptr<Benchmark>(new Benchmark(m_options.warmup_frames, m_options.benchmark_frames));
+
+        if (m_options.tune_workgroups > 0)
+            start_workgroup_tuning();
+
+        if (!m_options.trace.empty())
+            m_trace_recorder->start(m_options.trace, m_options.trace_frames);
+
+        // The framework always creates a window, keep it out of the way since nothing is rendered into it.
+        if (m_options.headless)
+            glfwHideWindow(m_window);
+
+        DW_LOG_INFO("Startup took " + std::to_string(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count()) + " ms");
+
         return true;
     }
 
@@ -48,6 +121,8 @@ protected:
 
     void update(double delta) override
     {
+        double frame_start = TraceRecorder::now();
+
         dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer();
 
         VkCommandBufferBeginInfo begin_info;
@@ -57,10 +132,32 @@ protected:
 
         vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
 
+        // The fence of this frame in flight has been waited on, so everything retired the last time it was recorded can go.
+        m_common_resources->deletion_queue->flush();
+        m_common_resources->scene_cache->update(m_common_resources->current_scene_type);
+
+        if (m_benchmark)
+        {
+            // Step every animation with a fixed timestep so each run renders exactly the same frames.
+            m_delta         = Benchmark::kTimestep * 1000.0f;
+            m_delta_seconds = Benchmark::kTimestep;
+
+            if (m_benchmark->begin_frame())
+                apply_benchmark_configuration(m_benchmark->current_configuration());
+        }
+        else if (m_common_resources->workgroup_tuner->tuning())
+        {
+            m_delta         = Benchmark::kTimestep * 1000.0f;
+            m_delta_seconds = Benchmark::kTimestep;
+
+            m_common_resources->workgroup_tuner->begin_frame();
+        }
+
         {
              DW_SCOPED_SAMPLE("Update", cmd_buf);
 
-             debug_gui();
+             if (!m_options.headless)
+                 debug_gui();
 
             // Update camera.
              update_camera();
@@ -72,66 +169,127 @@ protected:
              update_uniforms(cmd_buf);
 
              m_common_resources->current_scene()->build_tlas(cmd_buf);
+             m_common_resources->texture_streamer->update(cmd_buf, m_common_resources->current_scene());
 
              update_ibl(cmd_buf);
+        }
+
+        if (m_recreate_transient_images)
+        {
+            m_ray_traced_shadows->recreate_transient_images();
+            m_ray_traced_ao->recreate_transient_images();
+            m_ray_traced_reflections->recreate_transient_images();
+
+            m_common_resources->transient_allocator->collect();
+
+            m_recreate_transient_images = false;
+        }
+
+        // Render.
+        m_render_graph->reset();
+
+        m_common_resources->transient_allocator->declare_aliases(*m_render_graph);
+
+        // The G-buffer only needs mips down to the coarsest scale any ray traced pass works at.
+        RayTraceScale g_buffer_scale = std::max(std::max(m_ray_traced_shadows->scale(), m_ray_traced_ao->scale()), std::max(m_ray_traced_reflections->scale(), m_ddgi->scale()));
 
-            // Render.
-             m_g_buffer->render(cmd_buf);
-             m_ray_traced_shadows->render(cmd_buf);
-             m_ray_traced_ao->render(cmd_buf);
-             m_ddgi->render(cmd_buf);
-             m_ray_traced_reflections->render(cmd_buf, m_ddgi.get());
-             m_deferred_shading->render(cmd_buf,
-                                        m_ray_traced_ao.get(),
-                                        m_ray_traced_shadows.get(),
-                                        m_ray_traced_reflections.get(),
-                                        m_ddgi.get());
-             m_ground_truth_path_tracer->render(cmd_buf);
-             m_temporal_aa->render(cmd_buf,
-                                   m_deferred_shading.get(),
+        // Frames rendered past the requested count while a trace finishes overwrite the copy, the last one is written on exit.
+        m_tone_map->set_readback(!m_options.output.empty() && m_common_resources->num_frames + 1 >= m_options.num_frames);
+
+        m_g_buffer->render(*m_render_graph, g_buffer_scale);
+        m_ray_traced_shadows->render(*m_render_graph);
+        m_ray_traced_ao->render(*m_render_graph);
+        m_ddgi->render(*m_render_graph);
+        m_ray_traced_reflections->render(*m_render_graph, m_ddgi.get());
+        m_deferred_shading->render(*m_render_graph,
                                    m_ray_traced_ao.get(),
                                    m_ray_traced_shadows.get(),
                                    m_ray_traced_reflections.get(),
-                                   m_ddgi.get(),
-                                   m_ground_truth_path_tracer.get(),
-                                   m_delta_seconds);
-             m_tone_map->render(cmd_buf,
-                                m_temporal_aa.get(),
-                                m_deferred_shading.get(),
-                                m_ray_traced_ao.get(),
-                                m_ray_traced_shadows.get(),
-                                m_ray_traced_reflections.get(),
-                                m_ddgi.get(),
-                                m_ground_truth_path_tracer.get(),
-                                [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
-                                    render_gui(cmd_buf);
-                                });
-
-            ImGui::Render();
-
-            VkImageSubresourceRange output_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-            m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, VK_ACCESS_2_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, m_vk_backend->swapchain_image(), output_subresource_range);
-
-            m_vk_backend->flush_barriers(cmd_buf);
-        }
+                                   m_ddgi.get());
+        m_ground_truth_path_tracer->render(*m_render_graph);
+        m_temporal_aa->render(*m_render_graph,
+                              m_deferred_shading.get(),
+                              m_ray_traced_ao.get(),
+                              m_ray_traced_shadows.get(),
+                              m_ray_traced_reflections.get(),
+                              m_ddgi.get(),
+                              m_ground_truth_path_tracer.get(),
+                              m_delta_seconds);
+        m_tone_map->render(*m_render_graph,
+                           m_temporal_aa.get(),
+                           m_deferred_shading.get(),
+                           m_ray_traced_ao.get(),
+                           m_ray_traced_shadows.get(),
+                           m_ray_traced_reflections.get(),
+                           m_ddgi.get(),
+                           m_ground_truth_path_tracer.get(),
+                           m_options.headless ? std::function<void(dw::vk::CommandBuffer::Ptr)>() : [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                               render_gui(cmd_buf);
+                           });
+
+        // When headless the acquired swap chain image is left untouched, but it still has to be handed back through a present.
+        m_render_graph->add_pass(
+            "Present",
+            [this](RenderGraph::PassBuilder& builder) {
+                VkImageSubresourceRange output_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+                builder.use_resource(VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, VK_ACCESS_2_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, m_vk_backend->swapchain_image(), output_subresource_range);
+            },
+            nullptr);
+
+        m_render_graph->compile();
+
+        m_recreate_transient_images = m_common_resources->transient_allocator->update(*m_render_graph, transient_configuration());
+
+        // Async compute batches are submitted while the graph executes, the rest of the frame goes into the command buffer it returns.
+        cmd_buf = m_render_graph->execute(cmd_buf);
+
+        if (m_benchmark)
+            m_benchmark->end_frame(m_render_graph->gpu_timings());
+        else if (m_common_resources->workgroup_tuner->tuning())
+            m_common_resources->workgroup_tuner->end_frame(m_render_graph->gpu_timings());
+
+        ImGui::Render();
 
         vkEndCommandBuffer(cmd_buf->handle());
 
         submit_and_present({ cmd_buf });
 
+        m_trace_recorder->add_event(TraceRecorder::TRACK_CPU, 0, "Frame", frame_start, TraceRecorder::now());
+        m_trace_recorder->end_frame();
+
         m_common_resources->num_frames++;
 
         if (m_common_resources->first_frame)
             m_common_resources->first_frame = false;
 
         m_common_resources->ping_pong = !m_common_resources->ping_pong;
+
+        if (m_benchmark && m_benchmark->finished())
+        {
+            m_benchmark->write_results(m_options.benchmark, m_common_resources->output_width, m_common_resources->output_height);
+            m_benchmark.reset();
+
+            glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+        }
+        else if (m_options.tune_workgroups > 0 && m_common_resources->workgroup_tuner->finished())
+            glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+        else if (m_options.num_frames > 0 && m_common_resources->num_frames >= m_options.num_frames && !m_trace_recorder->capturing())
+            glfwSetWindowShouldClose(m_window, GLFW_TRUE);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void shutdown() override
     {
+        if (!m_options.output.empty())
+        {
+            m_vk_backend->wait_idle();
+            m_tone_map->write_output(m_options.output);
+        }
+
+        m_render_graph.reset();
+        m_trace_recorder.reset();
         m_tone_map.reset();
         m_temporal_aa.reset();
         m_deferred_shading.reset();
@@ -168,6 +326,9 @@ protected:
 
         if (code == GLFW_KEY_G)
             m_debug_gui = !m_debug_gui;
+
+        if (code == GLFW_KEY_T)
+            m_trace_recorder->start(m_trace_recorder->path(), m_trace_recorder->num_frames());
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -227,6 +388,20 @@ protected:
         settings.vsync             = true;
         settings.enable_validation = false;
 
+        // Async compute in the render graph is synchronized with timeline semaphores. Every Vulkan 1.2 device supports
+        // them, but they have to be enabled when the device is created.
+        m_timeline_semaphore_features.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        m_timeline_semaphore_features.timelineSemaphore = VK_TRUE;
+
+        settings.device_pnext = &m_timeline_semaphore_features;
+
+        // Multi draw indirect and the compact storage formats for the G-buffer, supported by every GPU capable of ray tracing.
+        m_device_features.multiDrawIndirect                 = VK_TRUE;
+        m_device_features.drawIndirectFirstInstance         = VK_TRUE;
+        m_device_features.shaderStorageImageExtendedFormats = VK_TRUE;
+
+        settings.device_features = m_device_features;
+
         return settings;
     }
 
@@ -234,6 +409,10 @@ protected:
 
     void window_resized(int width, int height) override
     {
+        // The offscreen output keeps the resolution requested on the command line.
+        if (m_options.headless)
+            return;
+
         // Override window resized method to update camera projection.
         m_main_camera->update_projection(60.0f, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE, float(m_width) / float(m_height));
 
@@ -247,7 +426,7 @@ private:
 
     void create_camera()
     {
-        m_main_camera                     = std::make_unique<dw::Camera>(60.0f, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE, float(m_width) / float(m_height), glm::vec3(0.0f, 35.0f, 125.0f), glm::vec3(0.0f, 0.0, -1.0f));
+        m_main_camera                     = std::make_unique<dw::Camera>(60.0f, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE, float(m_common_resources->output_width) / float(m_common_resources->output_height), glm::vec3(0.0f, 35.0f, 125.0f), glm::vec3(0.0f, 0.0, -1.0f));
         m_common_resources->prev_position = m_main_camera->m_position;
 
         float z_buffer_params_x             = -1.0 + (CAMERA_NEAR_PLANE / CAMERA_FAR_PLANE);
@@ -299,6 +478,18 @@ private:
                             ImGui::EndCombo();
                         }
 
+                        if (ImGui::TreeNode("Scene Cache"))
+                        {
+                            m_common_resources->scene_cache->gui();
+                            ImGui::TreePop();
+                        }
+
+                        if (ImGui::TreeNode("Texture Streaming"))
+                        {
+                            m_common_resources->texture_streamer->gui();
+                            ImGui::TreePop();
+                        }
+
                         if (ImGui::BeginCombo("Environment", constants::environment_types[m_common_resources->current_environment_type].c_str()))
                         {
                             for (uint32_t i = 0; i < constants::environment_types.size(); i++)
@@ -404,6 +595,21 @@ private:
 
                         ImGui::SliderFloat("Roughness Multiplier", &m_common_resources->roughness_multiplier, 0.0f, 1.0f);
 
+                        if (ImGui::BeginCombo("Sampler", constants::blue_noise_samplers[m_common_resources->blue_noise_sampler].c_str()))
+                        {
+                            for (uint32_t i = 0; i < constants::blue_noise_samplers.size(); i++)
+                            {
+                                const bool is_selected = (i == m_common_resources->blue_noise_sampler);
+
+                                if (ImGui::Selectable(constants::blue_noise_samplers[i].c_str(), is_selected))
+                                    m_common_resources->blue_noise_sampler = (BlueNoiseSampler)i;
+
+                                if (is_selected)
+                                    ImGui::SetItemDefaultFocus();
+                            }
+                            ImGui::EndCombo();
+                        }
+
                         m_tone_map->gui();
 
                         ImGui::TreePop();
@@ -538,11 +744,7 @@ private:
                                 const bool is_selected = (i == scale);
 
                                 if (ImGui::Selectable(constants::ray_trace_scales[i].c_str(), is_selected))
-                                {
-                                    m_vk_backend->wait_idle();
-                                    m_ray_traced_shadows.reset();
-                                    m_ray_traced_shadows = std::unique_ptr<RayTracedShadows>(new RayTracedShadows(m_vk_backend, m_common_resources.get(), m_g_buffer.get(), (RayTraceScale)i));
-                                }
+                                m_ray_traced_shadows->set_scale((RayTraceScale)i);
 
                                 if (is_selected)
                                     ImGui::SetItemDefaultFocus();
@@ -573,11 +775,7 @@ private:
                                 const bool is_selected = (i == scale);
 
                                 if (ImGui::Selectable(constants::ray_trace_scales[i].c_str(), is_selected))
-                                {
-                                    m_vk_backend->wait_idle();
-                                    m_ray_traced_reflections.reset();
-                                    m_ray_traced_reflections = std::unique_ptr<RayTracedReflections>(new RayTracedReflections(m_vk_backend, m_common_resources.get(), m_g_buffer.get(), (RayTraceScale)i));
-                                }
+                                m_ray_traced_reflections->set_scale((RayTraceScale)i);
 
                                 if (is_selected)
                                     ImGui::SetItemDefaultFocus();
@@ -609,11 +807,7 @@ private:
                                 const bool is_selected = (i == scale);
 
                                 if (ImGui::Selectable(constants::ray_trace_scales[i].c_str(), is_selected))
-                                {
-                                    m_vk_backend->wait_idle();
-                                    m_ray_traced_ao.reset();
-                                    m_ray_traced_ao = std::unique_ptr<RayTracedAO>(new RayTracedAO(m_vk_backend, m_common_resources.get(), m_g_buffer.get(), (RayTraceScale)i));
-                                }
+                                m_ray_traced_ao->set_scale((RayTraceScale)i);
 
                                 if (is_selected)
                                     ImGui::SetItemDefaultFocus();
@@ -644,12 +838,7 @@ private:
                                 const bool is_selected = (i == scale);
 
                                 if (ImGui::Selectable(constants::ray_trace_scales[i].c_str(), is_selected))
-                                {
-                                    m_vk_backend->wait_idle();
-                                    m_ddgi.reset();
-                                    m_ddgi = std::unique_ptr<DDGI>(new DDGI(m_vk_backend, m_common_resources.get(), m_g_buffer.get(), (RayTraceScale)i));
-                                    set_active_scene();
-                                }
+                                m_ddgi->set_scale((RayTraceScale)i);
 
                                 if (is_selected)
                                     ImGui::SetItemDefaultFocus();
@@ -672,6 +861,11 @@ private:
                         ImGui::TreePop();
                         ImGui::Separator();
                     }
+                    if (ImGui::TreeNode("G-Buffer"))
+                    {
+                        m_g_buffer->gui();
+                        ImGui::TreePop();
+                    }
                     if (ImGui::TreeNode("TAA"))
                     {
                         m_temporal_aa->gui();
@@ -679,7 +873,13 @@ private:
                     }
                 }
                 if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+                {
+                    m_render_graph->gui();
+                    m_trace_recorder->gui();
+                    m_common_resources->transient_allocator->gui();
+                    m_g_buffer->profiler_gui();
                     dw::profiler::ui();
+                }
 
                 ImGui::End();
             }
@@ -991,6 +1191,13 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
+    std::string transient_configuration()
+    {
+        return "Shadows " + constants::ray_trace_scales[m_ray_traced_shadows->scale()] + ", Reflections " + constants::ray_trace_scales[m_ray_traced_reflections->scale()] + ", AO " + constants::ray_trace_scales[m_ray_traced_ao->scale()];
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
     void update_light_animation()
     {
         if (m_light_animation)
@@ -1089,6 +1296,10 @@ private:
 
         m_common_resources->demo_players[m_common_resources->current_scene_type]->stop();
 
+        // Load the scene right away rather than whenever a module first touches it, and get the next one off the disk meanwhile.
+        m_common_resources->scene_cache->acquire(m_common_resources->current_scene_type);
+        m_common_resources->scene_cache->prefetch((m_common_resources->current_scene_type + 1) % SCENE_TYPE_COUNT);
+
         if (m_common_resources->current_scene_type == SCENE_TYPE_SHADOWS_TEST)
         {
             m_ddgi->set_normal_bias(1.0f);
@@ -1146,7 +1357,45 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
+    void apply_benchmark_configuration(const BenchmarkConfiguration& configuration)
+    {
+        m_common_resources->current_scene_type = configuration.scene;
+
+        set_active_scene();
+
+        m_ray_traced_shadows->set_scale(configuration.scale);
+        m_ray_traced_ao->set_scale(configuration.scale);
+        m_ray_traced_reflections->set_scale(configuration.scale);
+        m_ddgi->set_scale(configuration.scale);
+
+        m_ray_traced_shadows->set_denoise(configuration.denoise);
+        m_ray_traced_ao->set_denoise(configuration.denoise);
+        m_ray_traced_reflections->set_denoise(configuration.denoise);
+
+        // Every configuration follows the camera path of its scene from the start.
+        m_camera_type = CAMERA_TYPE_ANIMATED;
+        m_common_resources->demo_players[m_common_resources->current_scene_type]->play();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void start_workgroup_tuning()
+    {
+        // Upsampling only runs below full resolution, and every candidate is timed on the same view.
+        m_ray_traced_shadows->set_scale(RAY_TRACE_SCALE_HALF_RES);
+        m_ray_traced_ao->set_scale(RAY_TRACE_SCALE_HALF_RES);
+        m_ray_traced_reflections->set_scale(RAY_TRACE_SCALE_HALF_RES);
+
+        m_camera_type = CAMERA_TYPE_FIXED;
+
+        m_common_resources->workgroup_tuner->start(m_options.warmup_frames, m_options.tune_workgroups);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
 private:
+    CommandLineOptions                     m_options;
+    std::unique_ptr<Benchmark>             m_benchmark;
     std::unique_ptr<CommonResources>       m_common_resources;
     std::unique_ptr<GBuffer>               m_g_buffer;
     std::unique_ptr<DeferredShading>       m_deferred_shading;
@@ -1157,6 +1406,13 @@ private:
     std::unique_ptr<GroundTruthPathTracer> m_ground_truth_path_tracer;
     std::unique_ptr<TemporalAA>            m_temporal_aa;
     std::unique_ptr<ToneMap>               m_tone_map;
+    std::unique_ptr<RenderGraph>           m_render_graph;
+    std::unique_ptr<TraceRecorder>         m_trace_recorder;
+    bool                                   m_recreate_transient_images = false;
+
+    // Device features chained into the device creation, they stay enabled for its whole lifetime.
+    VkPhysicalDeviceFeatures                  m_device_features             = {};
+    VkPhysicalDeviceTimelineSemaphoreFeatures m_timeline_semaphore_features = {};
 
     // Camera.
     CameraType                  m_camera_type                = CAMERA_TYPE_FREE;
@@ -0,0 +1,746 @@
+#include "mesh_cache.h"
+#include "utility.h"
+#include <logger.h>
+#include <material.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <stb_image.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const char     kMagic[4]      = { 'H', 'R', 'M', 'C' };
+static const uint32_t kVersion       = 2;
+static const uint32_t kNumTextures   = 5;
+static const uint32_t kMaxPathLength = 256;
+static const uint32_t kImportFlags   = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+enum CacheTexture
+{
+    CACHE_TEXTURE_ALBEDO,
+    CACHE_TEXTURE_NORMAL,
+    CACHE_TEXTURE_ROUGHNESS,
+    CACHE_TEXTURE_METALLIC,
+    CACHE_TEXTURE_EMISSIVE
+};
+
+// Every stream starts at a 16 byte aligned offset, so it can be used in place once the file is mapped.
+struct CacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    int64_t  source_time;
+    uint32_t vertex_size;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+    uint32_t num_sub_meshes;
+    uint32_t num_materials;
+    float    min_extents[3];
+    float    max_extents[3];
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    uint64_t sub_meshes_offset;
+    uint64_t materials_offset;
+};
+
+struct CacheSubMesh
+{
+    uint32_t mat_idx;
+    uint32_t index_count;
+    uint32_t base_vertex;
+    uint32_t base_index;
+    float    min_extents[4];
+    float    max_extents[4];
+};
+
+struct CacheMaterial
+{
+    char     textures[kNumTextures][kMaxPathLength]; // Empty if the material has no texture in the slot.
+    float    albedo[4];
+    uint32_t alpha_tested; // Set if the albedo alpha can fall below the cut-off of the alpha test.
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+class MappedFile
+{
+public:
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string& path)
+    {
+#if defined(_WIN32)
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        m_size    = (size_t)size.QuadPart;
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (m_mapping)
+            m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        m_file = ::open(path.c_str(), O_RDONLY);
+
+        if (m_file == -1)
+            return false;
+
+        struct stat info;
+
+        if (fstat(m_file, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+
+        m_size = (size_t)info.st_size;
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+
+        if (data != MAP_FAILED)
+            m_data = (const uint8_t*)data;
+#endif
+
+        if (!m_data)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#if defined(_WIN32)
+        if (m_data)
+            UnmapViewOfFile(m_data);
+
+        if (m_mapping)
+            CloseHandle(m_mapping);
+
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+
+        m_mapping = nullptr;
+        m_file    = INVALID_HANDLE_VALUE;
+#else
+        if (m_data)
+            munmap((void*)m_data, m_size);
+
+        if (m_file != -1)
+            ::close(m_file);
+
+        m_file = -1;
+#endif
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t         size() const { return m_size; }
+
+private:
+#if defined(_WIN32)
+    HANDLE m_file    = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+    const uint8_t* m_data = nullptr;
+    size_t         m_size = 0;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct MeshCache::Data
+{
+    struct Material
+    {
+        std::string textures[kNumTextures];
+        glm::vec4   albedo;
+        bool        alpha_tested = true;
+    };
+
+    std::string              path;
+    bool                     baked = false; // Imported directly by create() otherwise.
+    MappedFile               file;
+    std::vector<dw::SubMesh> sub_meshes;
+    std::vector<Material>    materials;
+    glm::vec3                min_extents;
+    glm::vec3                max_extents;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Scenes are prepared on the prefetch thread while the main thread may load another one using the same mesh.
+static std::mutex g_bake_mutex;
+
+// Materials created from baked meshes that never fail the alpha test. The weak pointers tell a material apart from a
+// later one that was given the same address.
+static std::mutex                                                           g_material_mutex;
+static std::unordered_map<const dw::Material*, std::weak_ptr<dw::Material>> g_opaque_materials;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t align(uint64_t offset)
+{
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool source_info(const std::string& path, uint64_t& size, int64_t& time)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+
+    size = (uint64_t)info.st_size;
+    time = (int64_t)info.st_mtime;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string cache_path(const std::string& path)
+{
+    std::string name = path;
+
+    for (auto& c : name)
+    {
+        if (c == '/' || c == '\\' || c == ':' || c == '.')
+            c = '_';
+    }
+
+    return std::string(kCacheDirectory) + "/" + name + ".mesh";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool copy_texture_path(const aiMaterial* material, aiTextureType type, const std::string& directory, char* path)
+{
+    aiString texture;
+
+    if (material->GetTexture(type, 0, &texture) != AI_SUCCESS)
+        return false;
+
+    std::string full_path = directory + texture.C_Str();
+
+    if (full_path.size() >= kMaxPathLength)
+    {
+        DW_LOG_ERROR("Texture path too long for the mesh cache: " + full_path);
+        return false;
+    }
+
+    strcpy(path, full_path.c_str());
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The G-buffer discards fragments whose albedo alpha is below 0.1. Block compression and filtering can move alpha a
+// little, so any texel below a quarter counts. Textures are shared between materials, so each one is only read once.
+static bool is_alpha_tested(const char* albedo_texture, float albedo_alpha, std::unordered_map<std::string, bool>& textures)
+{
+    if (albedo_texture[0] == '\0')
+        return albedo_alpha < 0.1f;
+
+    auto it = textures.find(albedo_texture);
+
+    if (it != textures.end())
+        return it->second;
+
+    bool alpha_tested = false;
+    int  width        = 0;
+    int  height       = 0;
+    int  channels     = 0;
+
+    // Textures without an alpha channel are opaque. One that cannot be read is left to the alpha test.
+    if (!stbi_info(albedo_texture, &width, &height, &channels))
+        alpha_tested = true;
+    else if (channels == 2 || channels == 4)
+    {
+        uint8_t* pixels = stbi_load(albedo_texture, &width, &height, &channels, 4);
+
+        if (!pixels)
+            alpha_tested = true;
+        else
+        {
+            for (size_t i = 0; i < size_t(width) * size_t(height) && !alpha_tested; i++)
+                alpha_tested = pixels[i * 4 + 3] < 64;
+
+            stbi_image_free(pixels);
+        }
+    }
+
+    textures[albedo_texture] = alpha_tested;
+
+    return alpha_tested;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool bake(const std::string& source, const std::string& destination, uint64_t source_size, int64_t source_time)
+{
+    Assimp::Importer importer;
+
+    const aiScene* scene = importer.ReadFile(source, kImportFlags);
+
+    if (!scene)
+    {
+        DW_LOG_ERROR("Failed to import mesh: " + source + ", " + importer.GetErrorString());
+        return false;
+    }
+
+    std::vector<dw::Vertex>    vertices;
+    std::vector<uint32_t>      indices;
+    std::vector<CacheSubMesh>  sub_meshes(scene->mNumMeshes);
+    std::vector<CacheMaterial> materials(scene->mNumMaterials);
+    glm::vec3                  min_extents = glm::vec3(FLT_MAX);
+    glm::vec3                  max_extents = glm::vec3(-FLT_MAX);
+
+    for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+    {
+        const aiMesh* mesh     = scene->mMeshes[i];
+        CacheSubMesh& sub_mesh = sub_meshes[i];
+        glm::vec3     sub_min  = glm::vec3(FLT_MAX);
+        glm::vec3     sub_max  = glm::vec3(-FLT_MAX);
+
+        sub_mesh.mat_idx     = mesh->mMaterialIndex;
+        sub_mesh.base_vertex = (uint32_t)vertices.size();
+        sub_mesh.base_index  = (uint32_t)indices.size();
+
+        for (uint32_t j = 0; j < mesh->mNumVertices; j++)
+        {
+            dw::Vertex vertex;
+
+            glm::vec3 position = glm::vec3(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+
+            vertex.position  = glm::vec4(position, 1.0f);
+            vertex.tex_coord = mesh->HasTextureCoords(0) ? glm::vec4(mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y, 0.0f, 0.0f) : glm::vec4(0.0f);
+            vertex.normal    = mesh->HasNormals() ? glm::vec4(mesh->mNormals[j].x, mesh->mNormals[j].y, mesh->mNormals[j].z, 0.0f) : glm::vec4(0.0f);
+            vertex.tangent   = mesh->HasTangentsAndBitangents() ? glm::vec4(mesh->mTangents[j].x, mesh->mTangents[j].y, mesh->mTangents[j].z, 0.0f) : glm::vec4(0.0f);
+            vertex.bitangent = mesh->HasTangentsAndBitangents() ? glm::vec4(mesh->mBitangents[j].x, mesh->mBitangents[j].y, mesh->mBitangents[j].z, 0.0f) : glm::vec4(0.0f);
+
+            sub_min = glm::min(sub_min, position);
+            sub_max = glm::max(sub_max, position);
+
+            vertices.push_back(vertex);
+        }
+
+        // Points and lines are left over after triangulation if the source has any, they are not drawn.
+        for (uint32_t j = 0; j < mesh->mNumFaces; j++)
+        {
+            if (mesh->mFaces[j].mNumIndices != 3)
+                continue;
+
+            for (uint32_t k = 0; k < 3; k++)
+                indices.push_back(mesh->mFaces[j].mIndices[k]);
+        }
+
+        sub_mesh.index_count = (uint32_t)indices.size() - sub_mesh.base_index;
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            sub_mesh.min_extents[k] = sub_min[k];
+            sub_mesh.max_extents[k] = sub_max[k];
+        }
+
+        sub_mesh.min_extents[3] = 0.0f;
+        sub_mesh.max_extents[3] = 0.0f;
+
+        min_extents = glm::min(min_extents, sub_min);
+        max_extents = glm::max(max_extents, sub_max);
+    }
+
+    std::string                           directory = source.substr(0, source.find_last_of("/\\") + 1);
+    std::unordered_map<std::string, bool> alpha_tested_textures;
+
+    for (uint32_t i = 0; i < scene->mNumMaterials; i++)
+    {
+        const aiMaterial* material       = scene->mMaterials[i];
+        CacheMaterial&    cache_material = materials[i];
+
+        memset(&cache_material, 0, sizeof(CacheMaterial));
+
+        // glTF packs roughness and metalness into one texture, OBJ keeps them in the specular exponent and reflection maps.
+        copy_texture_path(material, aiTextureType_DIFFUSE, directory, cache_material.textures[CACHE_TEXTURE_ALBEDO]);
+        copy_texture_path(material, aiTextureType_EMISSIVE, directory, cache_material.textures[CACHE_TEXTURE_EMISSIVE]);
+
+        if (!copy_texture_path(material, aiTextureType_NORMALS, directory, cache_material.textures[CACHE_TEXTURE_NORMAL]))
+            copy_texture_path(material, aiTextureType_HEIGHT, directory, cache_material.textures[CACHE_TEXTURE_NORMAL]);
+
+        if (copy_texture_path(material, aiTextureType_UNKNOWN, directory, cache_material.textures[CACHE_TEXTURE_ROUGHNESS]))
+            strcpy(cache_material.textures[CACHE_TEXTURE_METALLIC], cache_material.textures[CACHE_TEXTURE_ROUGHNESS]);
+        else
+        {
+            copy_texture_path(material, aiTextureType_SHININESS, directory, cache_material.textures[CACHE_TEXTURE_ROUGHNESS]);
+            copy_texture_path(material, aiTextureType_REFLECTION, directory, cache_material.textures[CACHE_TEXTURE_METALLIC]);
+        }
+
+        aiColor4D albedo(1.0f, 1.0f, 1.0f, 1.0f);
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, albedo);
+
+        cache_material.albedo[0] = albedo.r;
+        cache_material.albedo[1] = albedo.g;
+        cache_material.albedo[2] = albedo.b;
+        cache_material.albedo[3] = albedo.a;
+
+        cache_material.alpha_tested = is_alpha_tested(cache_material.textures[CACHE_TEXTURE_ALBEDO], albedo.a, alpha_tested_textures) ? 1 : 0;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+
+    header.version           = kVersion;
+    header.source_size       = source_size;
+    header.source_time       = source_time;
+    header.vertex_size       = sizeof(dw::Vertex);
+    header.num_vertices      = (uint32_t)vertices.size();
+    header.num_indices       = (uint32_t)indices.size();
+    header.num_sub_meshes    = (uint32_t)sub_meshes.size();
+    header.num_materials     = (uint32_t)materials.size();
+    header.vertices_offset   = align(sizeof(CacheHeader));
+    header.indices_offset    = align(header.vertices_offset + vertices.size() * sizeof(dw::Vertex));
+    header.sub_meshes_offset = align(header.indices_offset + indices.size() * sizeof(uint32_t));
+    header.materials_offset  = align(header.sub_meshes_offset + sub_meshes.size() * sizeof(CacheSubMesh));
+
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        header.min_extents[k] = min_extents[k];
+        header.max_extents[k] = max_extents[k];
+    }
+
+    create_cache_directory();
+
+    return write_file_atomic(destination, "mesh cache", [&](std::ofstream& file) {
+        auto write = [&file](uint64_t offset, const void* data, size_t size) {
+            static const char kPadding[16] = {};
+
+            file.write(kPadding, (std::streamsize)(offset - (uint64_t)file.tellp()));
+            file.write((const char*)data, (std::streamsize)size);
+        };
+
+        write(0, &header, sizeof(CacheHeader));
+        write(header.vertices_offset, vertices.data(), vertices.size() * sizeof(dw::Vertex));
+        write(header.indices_offset, indices.data(), indices.size() * sizeof(uint32_t));
+        write(header.sub_meshes_offset, sub_meshes.data(), sub_meshes.size() * sizeof(CacheSubMesh));
+        write(header.materials_offset, materials.data(), materials.size() * sizeof(CacheMaterial));
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool validate(const MappedFile& file, uint64_t source_size, int64_t source_time)
+{
+    if (file.size() < sizeof(CacheHeader))
+        return false;
+
+    const CacheHeader* header = (const CacheHeader*)file.data();
+
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion || header->vertex_size != sizeof(dw::Vertex))
+        return false;
+
+    if (header->source_size != source_size || header->source_time != source_time)
+        return false;
+
+    if (header->vertices_offset + uint64_t(header->num_vertices) * sizeof(dw::Vertex) > file.size() || header->indices_offset + uint64_t(header->num_indices) * sizeof(uint32_t) > file.size() || header->sub_meshes_offset + uint64_t(header->num_sub_meshes) * sizeof(CacheSubMesh) > file.size() || header->materials_offset + uint64_t(header->num_materials) * sizeof(CacheMaterial) > file.size())
+        return false;
+
+    // The submeshes index straight into the streams and the material table once uploaded.
+    const CacheSubMesh* sub_meshes = (const CacheSubMesh*)(file.data() + header->sub_meshes_offset);
+
+    for (uint32_t i = 0; i < header->num_sub_meshes; i++)
+    {
+        if (uint64_t(sub_meshes[i].base_index) + sub_meshes[i].index_count > header->num_indices || sub_meshes[i].base_vertex > header->num_vertices || sub_meshes[i].mat_idx >= header->num_materials)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void decode(MeshCache::Data& data)
+{
+    const MappedFile&    file            = data.file;
+    const CacheHeader*   header          = (const CacheHeader*)file.data();
+    const CacheSubMesh*  cache_sub_mesh  = (const CacheSubMesh*)(file.data() + header->sub_meshes_offset);
+    const CacheMaterial* cache_materials = (const CacheMaterial*)(file.data() + header->materials_offset);
+
+    data.materials.resize(header->num_materials);
+
+    for (uint32_t i = 0; i < header->num_materials; i++)
+    {
+        for (uint32_t j = 0; j < kNumTextures; j++)
+            data.materials[i].textures[j] = std::string(cache_materials[i].textures[j], strnlen(cache_materials[i].textures[j], kMaxPathLength));
+
+        const float* albedo = cache_materials[i].albedo;
+
+        data.materials[i].albedo       = glm::vec4(albedo[0], albedo[1], albedo[2], albedo[3]);
+        data.materials[i].alpha_tested = cache_materials[i].alpha_tested != 0;
+    }
+
+    data.sub_meshes.resize(header->num_sub_meshes);
+
+    for (uint32_t i = 0; i < header->num_sub_meshes; i++)
+    {
+        dw::SubMesh& sub_mesh = data.sub_meshes[i];
+
+        sub_mesh.mat_idx     = cache_sub_mesh[i].mat_idx;
+        sub_mesh.index_count = cache_sub_mesh[i].index_count;
+        sub_mesh.base_vertex = cache_sub_mesh[i].base_vertex;
+        sub_mesh.base_index  = cache_sub_mesh[i].base_index;
+        sub_mesh.min_extents = glm::vec3(cache_sub_mesh[i].min_extents[0], cache_sub_mesh[i].min_extents[1], cache_sub_mesh[i].min_extents[2]);
+        sub_mesh.max_extents = glm::vec3(cache_sub_mesh[i].max_extents[0], cache_sub_mesh[i].max_extents[1], cache_sub_mesh[i].max_extents[2]);
+    }
+
+    data.min_extents = glm::vec3(header->min_extents[0], header->min_extents[1], header->min_extents[2]);
+    data.max_extents = glm::vec3(header->max_extents[0], header->max_extents[1], header->max_extents[2]);
+
+    // Fault the streams in here rather than during the upload, which copies them straight out of the mapping.
+    volatile uint8_t checksum = 0;
+
+    for (size_t offset = header->vertices_offset; offset < header->sub_meshes_offset; offset += 4096)
+        checksum += file.data()[offset];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<MeshCache::Data> MeshCache::prepare(const std::string& path)
+{
+    uint64_t source_size = 0;
+    int64_t  source_time = 0;
+
+    if (!source_info(path, source_size, source_time))
+    {
+        DW_LOG_ERROR("Failed to find mesh: " + path);
+        return nullptr;
+    }
+
+    auto data = std::make_shared<Data>();
+
+    data->path = path;
+
+    std::string cache = cache_path(path);
+
+    {
+        std::lock_guard<std::mutex> lock(g_bake_mutex);
+
+        if (!data->file.open(cache) || !validate(data->file, source_size, source_time))
+        {
+            data->file.close();
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            if (!bake(path, cache, source_size, source_time) || !data->file.open(cache) || !validate(data->file, source_size, source_time))
+            {
+                DW_LOG_ERROR("Failed to bake mesh, importing it directly: " + path);
+                return data;
+            }
+
+            DW_LOG_INFO("Baked " + path + " in " + std::to_string(elapsed_milliseconds(start)) + " ms");
+        }
+    }
+
+    decode(*data);
+
+    data->baked = true;
+
+    return data;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::Mesh::Ptr MeshCache::create(dw::vk::Backend::Ptr backend, const std::shared_ptr<Data>& data, TextureStreamer* texture_streamer)
+{
+    if (!data->baked)
+        return dw::Mesh::load(backend, data->path);
+
+    std::vector<dw::Material::Ptr> materials;
+
+    for (uint32_t i = 0; i < data->materials.size(); i++)
+    {
+        const Data::Material& material_data = data->materials[i];
+        std::string           name          = data->path + "/" + std::to_string(i);
+
+        if (texture_streamer && texture_streamer->can_register(material_data.textures))
+        {
+            std::string no_textures[kNumTextures];
+
+            dw::Material::Ptr material = dw::Material::load(backend, name, no_textures, material_data.albedo);
+
+            texture_streamer->register_material(material, material_data.textures);
+            materials.push_back(material);
+        }
+        else
+        {
+            std::string textures[kNumTextures];
+
+            for (uint32_t j = 0; j < kNumTextures; j++)
+                textures[j] = material_data.textures[j];
+
+            materials.push_back(dw::Material::load(backend, name, textures, material_data.albedo));
+        }
+
+        if (!material_data.alpha_tested)
+        {
+            std::lock_guard<std::mutex> lock(g_material_mutex);
+            g_opaque_materials[materials.back().get()] = materials.back();
+        }
+    }
+
+    const MappedFile&  file   = data->file;
+    const CacheHeader* header = (const CacheHeader*)file.data();
+
+    // The streams are read straight out of the mapping into the staging buffers of the upload.
+    dw::Vertex* vertices = (dw::Vertex*)(file.data() + header->vertices_offset);
+    uint32_t*   indices  = (uint32_t*)(file.data() + header->indices_offset);
+
+    return dw::Mesh::load(backend, data->path, header->num_vertices, vertices, header->num_indices, indices, header->num_sub_meshes, data->sub_meshes.data(), data->max_extents, data->min_extents, materials);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::Mesh::Ptr MeshCache::load(dw::vk::Backend::Ptr backend, const std::string& path, TextureStreamer* texture_streamer)
+{
+    std::shared_ptr<Data> data = prepare(path);
+
+    if (!data)
+        return nullptr;
+
+    return create(backend, data, texture_streamer);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MeshCache::alpha_tested(const dw::Material* material)
+{
+    std::lock_guard<std::mutex> lock(g_material_mutex);
+
+    auto it = g_opaque_materials.find(material);
+
+    if (it == g_opaque_materials.end())
+        return true;
+
+    auto opaque_material = it->second.lock();
+
+    if (opaque_material.get() != material)
+    {
+        g_opaque_materials.erase(it);
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MeshCache::benchmark(const std::string& path, uint32_t num_runs)
+{
+    uint64_t source_size = 0;
+    int64_t  source_time = 0;
+
+    if (!source_info(path, source_size, source_time))
+    {
+        DW_LOG_ERROR("Failed to find mesh: " + path);
+        return;
+    }
+
+    // Baked to a separate file, so the cache used for rendering is left alone.
+    std::string cache       = cache_path(path) + ".benchmark";
+    double      import_time = 0.0;
+    double      cold_time   = 0.0;
+    double      warm_time   = 0.0;
+    uint64_t    checksum    = 0;
+
+    for (uint32_t i = 0; i < num_runs; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        {
+            Assimp::Importer importer;
+
+            if (!importer.ReadFile(path, kImportFlags))
+            {
+                DW_LOG_ERROR("Failed to import mesh: " + path);
+                return;
+            }
+        }
+
+        import_time += elapsed_milliseconds(start);
+        start = std::chrono::high_resolution_clock::now();
+
+        if (!bake(path, cache, source_size, source_time))
+            return;
+
+        cold_time += elapsed_milliseconds(start);
+        start = std::chrono::high_resolution_clock::now();
+
+        {
+            MappedFile file;
+
+            if (!file.open(cache) || !validate(file, source_size, source_time))
+            {
+                DW_LOG_ERROR("Failed to map mesh cache: " + cache);
+                return;
+            }
+
+            // Touch every page, as the upload would.
+            for (size_t offset = 0; offset < file.size(); offset += 4096)
+                checksum += file.data()[offset];
+        }
+
+        warm_time += elapsed_milliseconds(start);
+    }
+
+    remove(cache.c_str());
+
+    DW_LOG_INFO("Mesh cache benchmark for " + path + " over " + std::to_string(num_runs) + " runs (checksum " + std::to_string(checksum) + ")");
+    DW_LOG_INFO("    Assimp import: " + std::to_string(import_time / num_runs) + " ms");
+    DW_LOG_INFO("    Cold (import and bake): " + std::to_string(cold_time / num_runs) + " ms");
+    DW_LOG_INFO("    Warm (map baked file): " + std::to_string(warm_time / num_runs) + " ms");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
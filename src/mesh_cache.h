@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vk.h>
+#include <mesh.h>
+#include <memory>
+#include <string>
+#include "texture_streamer.h"
+
+// Bakes meshes into a binary file under cache/ the first time they are loaded and memory maps that file on later
+// runs, which skips importing the source file through Assimp. The file holds the vertex and index streams, the
+// submesh and material tables and the bounds of every submesh. A file is baked again whenever the format version,
+// or the size or modification time of its source file, no longer match.
+//
+// Loading is split in two, so that the CPU side can run on any thread and only the upload is left to the one owning
+// the graphics queue.
+class MeshCache
+{
+public:
+    // The baked file of a mesh, mapped and validated, with its submesh and material tables decoded.
+    struct Data;
+
+    // Bakes the mesh if needed and maps it, without touching Vulkan. Safe to call from any thread.
+    static std::shared_ptr<Data> prepare(const std::string& path);
+
+    // Uploads a prepared mesh. Falls back to dw::Mesh::load if the mesh could not be baked. The material textures of
+    // baked meshes are registered with the texture streamer instead of being loaded, if one is given.
+    static dw::Mesh::Ptr create(dw::vk::Backend::Ptr backend, const std::shared_ptr<Data>& data, TextureStreamer* texture_streamer = nullptr);
+
+    // Prepares and creates the mesh in one go, returns null if the mesh doesn't exist.
+    static dw::Mesh::Ptr load(dw::vk::Backend::Ptr backend, const std::string& path, TextureStreamer* texture_streamer = nullptr);
+
+    // Whether fragments of a material can fail the alpha test. Only materials of baked meshes are known not to.
+    static bool alpha_tested(const dw::Material* material);
+
+    // Logs the CPU time of importing the mesh through Assimp against baking it (cold) and mapping the baked file (warm).
+    static void benchmark(const std::string& path, uint32_t num_runs);
+};
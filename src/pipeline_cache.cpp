@@ -0,0 +1,129 @@
+#include "pipeline_cache.h"
+#include "utility.h"
+#include <logger.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PipelineCache::PipelineCache(dw::vk::Backend::Ptr backend, const std::string& path) :
+    m_backend(backend), m_path(path)
+{
+    std::vector<uint8_t> data;
+
+    if (!read(backend, data))
+        data.clear();
+
+    VkPipelineCacheCreateInfo info {};
+
+    info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data.size();
+    info.pInitialData    = data.size() > 0 ? data.data() : nullptr;
+
+    if (vkCreatePipelineCache(backend->device(), &info, nullptr, &m_handle) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create pipeline cache");
+        throw std::runtime_error("Failed to create pipeline cache");
+    }
+
+    m_thread_pool = std::unique_ptr<ThreadPool>(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PipelineCache::~PipelineCache()
+{
+    auto backend = m_backend.lock();
+
+    vkDestroyPipelineCache(backend->device(), m_handle, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PipelineCache::queue(CreateFunc func)
+{
+    m_queue.push_back(func);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PipelineCache::flush()
+{
+    if (m_queue.size() == 0)
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<CreateFunc> queue;
+    queue.swap(m_queue);
+
+    m_thread_pool->run((uint32_t)queue.size(), m_thread_pool->num_threads(), [&queue](uint32_t job_idx, uint32_t thread_idx) {
+        queue[job_idx]();
+    });
+
+    DW_LOG_INFO("Created pipelines of " + std::to_string(queue.size()) + " modules on " + std::to_string(m_thread_pool->num_threads()) + " threads in " + std::to_string(elapsed_milliseconds(start)) + " ms");
+
+    write();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool PipelineCache::read(dw::vk::Backend::Ptr backend, std::vector<uint8_t>& data)
+{
+    std::ifstream file(m_path, std::ios::binary | std::ios::ate);
+
+    if (!file.is_open())
+        return false;
+
+    data.resize((size_t)file.tellg());
+
+    file.seekg(0);
+    file.read((char*)data.data(), data.size());
+
+    if (!file || data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+        return false;
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(backend->physical_device(), &properties);
+
+    // Drivers are expected to reject foreign data themselves, but not all of them do so gracefully.
+    if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        DW_LOG_INFO("Discarding pipeline cache created by a different device or driver: " + m_path);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void PipelineCache::write()
+{
+    auto backend = m_backend.lock();
+
+    size_t size = 0;
+
+    if (vkGetPipelineCacheData(backend->device(), m_handle, &size, nullptr) != VK_SUCCESS || size == 0)
+        return;
+
+    std::vector<uint8_t> data(size);
+
+    if (vkGetPipelineCacheData(backend->device(), m_handle, &size, data.data()) != VK_SUCCESS)
+        return;
+
+    create_parent_directory(m_path);
+
+    write_file_atomic(m_path, "pipeline cache", [&](std::ofstream& file) {
+        file.write((const char*)data.data(), size);
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vk.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Owns the VkPipelineCache every pipeline is created through, persisted to disk between runs. The saved data is only
+// reused if its header matches the vendor, device and pipeline cache UUID of the current driver. Modules queue the
+// creation of their pipelines, which flush() then spreads over worker threads.
+class PipelineCache
+{
+public:
+    using CreateFunc = std::function<void()>;
+
+public:
+    PipelineCache(dw::vk::Backend::Ptr backend, const std::string& path);
+    ~PipelineCache();
+
+    // The function runs on a worker thread, so it must not record or submit any commands.
+    void queue(CreateFunc func);
+
+    // Runs every queued function and writes the cache to disk.
+    void flush();
+
+    inline VkPipelineCache handle() { return m_handle; }
+
+private:
+    bool read(dw::vk::Backend::Ptr backend, std::vector<uint8_t>& data);
+    void write();
+
+private:
+    std::weak_ptr<dw::vk::Backend> m_backend;
+    std::string                    m_path;
+    VkPipelineCache                m_handle = VK_NULL_HANDLE;
+    std::unique_ptr<ThreadPool>    m_thread_pool;
+    std::vector<CreateFunc>        m_queue;
+};
@@ -1,4 +1,5 @@
 #include "ray_traced_ao.h"
+#include "shader_library.h"
 #include "g_buffer.h"
 #include <profiler.h>
 #include <macros.h>
@@ -12,6 +13,9 @@ static const int RAY_TRACE_NUM_THREADS_Y = 4;
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_X = 8;
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_Y = 8;
 
+// The workgroup size of the upsample pass is tuned per device, under the name the render graph reports it with.
+static const char* UPSAMPLE_PASS = "Ambient Occlusion/Upsample";
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct RayTracePushConstants
@@ -20,6 +24,7 @@ struct RayTracePushConstants
     float    ray_length;
     float    bias;
     int32_t  g_buffer_mip;
+    int32_t  blue_noise_sampler;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -71,20 +76,14 @@ const std::string RayTracedAO::kOutputTypeNames[] = {
 RayTracedAO::RayTracedAO(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale) :
     m_backend(backend), m_common_resources(common_resources), m_g_buffer(g_buffer), m_scale(scale)
 {
-    auto vk_backend = m_backend.lock();
-
-    float scale_divisor = powf(2.0f, float(scale));
-
-    m_width  = vk_backend->swap_chain_extents().width / scale_divisor;
-    m_height = vk_backend->swap_chain_extents().height / scale_divisor;
-
-    m_g_buffer_mip = static_cast<uint32_t>(scale);
-
+    update_dimensions();
     create_images();
     create_buffers();
+    create_descriptor_set_layouts();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipeline();
+    m_common_resources->workgroup_tuner->add_pass(UPSAMPLE_PASS, { 8, 8 });
+    m_common_resources->pipeline_cache->queue([this]() { create_pipeline(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -95,20 +94,124 @@ RayTracedAO::~RayTracedAO()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedAO::render(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedAO::render(RenderGraph& graph)
 {
-    DW_SCOPED_SAMPLE("Ambient Occlusion", cmd_buf);
+    graph.begin_group("Ambient Occlusion");
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+    uint32_t read_idx  = static_cast<uint32_t>(!m_common_resources->ping_pong);
+
+    if (m_first_frame)
+    {
+        graph.add_pass(
+            "Clear",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.history_length_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.color_image[read_idx], subresource_range);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                clear_images(cmd_buf);
+            });
+
+        m_first_frame = false;
+    }
 
-    clear_images(cmd_buf);
-    ray_trace(cmd_buf);
+    graph.add_pass(
+        "Ray Trace",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
+            m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+        },
+        [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            ray_trace(cmd_buf);
+        });
 
     if (m_denoise)
     {
-        denoise(cmd_buf);
+        graph.add_pass(
+            "Reset Args",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                reset_args(cmd_buf);
+            });
+
+        graph.add_pass(
+            "Temporal Accumulation",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.color_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.history_length_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.color_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.history_length_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                m_g_buffer->use_history(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                temporal_accumulation(cmd_buf);
+            });
+
+        // Both blur targets are cleared up-front so that the clears share a single barrier batch.
+        graph.add_pass(
+            "Bilateral Blur Clear",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[0], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[1], subresource_range);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                clear_blur_images(cmd_buf);
+            });
+
+        graph.add_pass(
+            "Bilateral Blur Vertical",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[0], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.color_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.history_length_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                bilateral_blur(cmd_buf, 0);
+            });
+
+        graph.add_pass(
+            "Bilateral Blur Horizontal",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[1], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_bilateral_blur.image[0], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.history_length_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                bilateral_blur(cmd_buf, 1);
+            });
 
         if (m_scale != RAY_TRACE_SCALE_FULL_RES)
-            upsample(cmd_buf);
+        {
+            graph.add_pass(
+                "Upsample",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_bilateral_blur.image[1], subresource_range);
+                    m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                },
+                [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    upsample(cmd_buf);
+                });
+        }
     }
+
+    graph.end_group();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -149,6 +252,120 @@ dw::vk::DescriptorSet::Ptr RayTracedAO::output_ds()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+dw::vk::Image::Ptr RayTracedAO::output_image()
+{
+    if (m_denoise)
+    {
+        if (m_current_output == OUTPUT_RAY_TRACE)
+            return m_ray_trace.image;
+        else if (m_current_output == OUTPUT_TEMPORAL_ACCUMULATION)
+            return m_temporal_accumulation.color_image[m_common_resources->ping_pong];
+        else if (m_current_output == OUTPUT_BILATERAL_BLUR)
+            return m_bilateral_blur.image[1];
+        else
+        {
+            if (m_scale == RAY_TRACE_SCALE_FULL_RES)
+                return m_bilateral_blur.image[1];
+            else
+                return m_upsample.image;
+        }
+    }
+    else
+        return m_ray_trace.image;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedAO::set_scale(RayTraceScale scale)
+{
+    if (scale == m_scale)
+        return;
+
+    // Pipelines and layouts do not depend on the resolution and are kept, everything else is replaced while the
+    // frames in flight keep using the old resources.
+    retire_resources(false);
+
+    m_scale = scale;
+
+    update_dimensions();
+    create_images();
+    create_buffers();
+    create_descriptor_sets();
+    write_descriptor_sets();
+
+    m_first_frame = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedAO::recreate_transient_images()
+{
+    retire_resources(true);
+    create_transient_images();
+    create_descriptor_sets();
+    write_descriptor_sets();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedAO::update_dimensions()
+{
+    float scale_divisor = powf(2.0f, float(m_scale));
+
+    m_width  = m_common_resources->output_width / scale_divisor;
+    m_height = m_common_resources->output_height / scale_divisor;
+
+    m_g_buffer_mip = static_cast<uint32_t>(m_scale);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedAO::retire_resources(bool transient_only)
+{
+    DeletionQueue* queue = m_common_resources->deletion_queue.get();
+
+    if (!transient_only)
+    {
+        queue->push(m_ray_trace.image);
+        queue->push(m_ray_trace.view);
+        queue->push(m_temporal_accumulation.denoise_tile_coords_buffer);
+        queue->push(m_temporal_accumulation.denoise_dispatch_args_buffer);
+
+        for (int i = 0; i < 2; i++)
+        {
+            queue->push(m_temporal_accumulation.color_image[i]);
+            queue->push(m_temporal_accumulation.color_view[i]);
+            queue->push(m_temporal_accumulation.history_length_image[i]);
+            queue->push(m_temporal_accumulation.history_length_view[i]);
+        }
+    }
+
+    // Transient images go back to the allocator, which defers destroying them on its own.
+    for (int i = 0; i < 2; i++)
+        queue->push(m_bilateral_blur.image_view[i]);
+
+    queue->push(m_upsample.image_view);
+
+    // Every descriptor set references at least one of the replaced images.
+    queue->push(m_ray_trace.write_ds);
+    queue->push(m_ray_trace.read_ds);
+    queue->push(m_ray_trace.bilinear_read_ds);
+    queue->push(m_temporal_accumulation.indirect_buffer_ds);
+    queue->push(m_upsample.write_ds);
+    queue->push(m_upsample.read_ds);
+
+    for (int i = 0; i < 2; i++)
+    {
+        queue->push(m_temporal_accumulation.write_ds[i]);
+        queue->push(m_temporal_accumulation.read_ds[i]);
+        queue->push(m_temporal_accumulation.output_read_ds[i]);
+        queue->push(m_bilateral_blur.write_ds[i]);
+        queue->push(m_bilateral_blur.read_ds[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void RayTracedAO::create_images()
 {
     auto backend = m_backend.lock();
@@ -178,11 +395,19 @@ void RayTracedAO::create_images()
         m_temporal_accumulation.history_length_view[i]->set_name("AO Denoise Reprojection History " + std::to_string(i));
     }
 
+    create_transient_images();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedAO::create_transient_images()
+{
+    auto backend = m_backend.lock();
+
     // Bilateral Blur
     for (int i = 0; i < 2; i++)
     {
-        m_bilateral_blur.image[i] = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_bilateral_blur.image[i]->set_name("AO Denoise Blur " + std::to_string(i));
+        m_bilateral_blur.image[i] = m_common_resources->transient_allocator->create_image("AO Denoise Blur " + std::to_string(i), VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_bilateral_blur.image_view[i] = dw::vk::ImageView::create(backend, m_bilateral_blur.image[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
         m_bilateral_blur.image_view[i]->set_name("AO Denoise Blur " + std::to_string(i));
@@ -190,10 +415,7 @@ void RayTracedAO::create_images()
 
     // Upsample
     {
-        auto vk_backend = m_backend.lock();
-
-        m_upsample.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, vk_backend->swap_chain_extents().width, vk_backend->swap_chain_extents().height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_upsample.image->set_name("AO Upsample");
+        m_upsample.image = m_common_resources->transient_allocator->create_image("AO Upsample", VK_IMAGE_TYPE_2D, m_common_resources->output_width, m_common_resources->output_height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_upsample.image_view = dw::vk::ImageView::create(backend, m_upsample.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
         m_upsample.image_view->set_name("AO Upsample");
@@ -212,6 +434,44 @@ void RayTracedAO::create_buffers()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void RayTracedAO::create_descriptor_set_layouts()
+{
+    auto backend = m_backend.lock();
+
+    // Temporal Reprojection
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_temporal_accumulation.write_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+        m_temporal_accumulation.write_ds_layout->set_name("AO Reprojection Write DS Layout");
+    }
+
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_temporal_accumulation.read_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+        m_temporal_accumulation.read_ds_layout->set_name("AO Reprojection Read DS Layout");
+    }
+
+    // Indirect Buffer
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_temporal_accumulation.indirect_buffer_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void RayTracedAO::create_descriptor_sets()
 {
     auto backend = m_backend.lock();
@@ -230,26 +490,6 @@ void RayTracedAO::create_descriptor_sets()
 
     // Temporal Reprojection
     {
-        {
-            dw::vk::DescriptorSetLayout::Desc desc;
-
-            desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-            desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-
-            m_temporal_accumulation.write_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
-            m_temporal_accumulation.write_ds_layout->set_name("AO Reprojection Write DS Layout");
-        }
-
-        {
-            dw::vk::DescriptorSetLayout::Desc desc;
-
-            desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-            desc.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-
-            m_temporal_accumulation.read_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
-            m_temporal_accumulation.read_ds_layout->set_name("AO Reprojection Read DS Layout");
-        }
-
         for (int i = 0; i < 2; i++)
         {
             m_temporal_accumulation.write_ds[i] = backend->allocate_descriptor_set(m_temporal_accumulation.write_ds_layout);
@@ -265,13 +505,6 @@ void RayTracedAO::create_descriptor_sets()
 
     // Indirect Buffer
     {
-        dw::vk::DescriptorSetLayout::Desc desc;
-
-        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-
-        m_temporal_accumulation.indirect_buffer_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
-
         m_temporal_accumulation.indirect_buffer_ds = backend->allocate_descriptor_set(m_temporal_accumulation.indirect_buffer_ds_layout);
         m_temporal_accumulation.indirect_buffer_ds->set_name("Temporal Accumulation Indirect Buffer");
     }
@@ -705,7 +938,7 @@ void RayTracedAO::create_pipeline()
 
     // Ray Trace
     {
-        dw::vk::ShaderModule::Ptr shader_module = dw::vk::ShaderModule::create_from_file(backend, "shaders/ao_ray_trace.comp.spv");
+        dw::vk::ShaderModule::Ptr shader_module = ShaderLibrary::load(backend, "shaders/ao_ray_trace.comp.spv");
 
         dw::vk::PipelineLayout::Desc pl_desc;
 
@@ -725,7 +958,7 @@ void RayTracedAO::create_pipeline()
         desc.set_shader_stage(shader_module, "main");
         desc.set_pipeline_layout(m_ray_trace.pipeline_layout);
 
-        m_ray_trace.pipeline = dw::vk::ComputePipeline::create(backend, desc);
+        m_ray_trace.pipeline = dw::vk::ComputePipeline::create(backend, desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Reset Args
@@ -737,14 +970,14 @@ void RayTracedAO::create_pipeline()
         m_reset_args.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_reset_args.pipeline_layout->set_name("Reset Args Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/ao_denoise_reset_args.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/ao_denoise_reset_args.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_reset_args.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Temporal Reprojection
@@ -765,14 +998,12 @@ void RayTracedAO::create_pipeline()
         m_temporal_accumulation.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_temporal_accumulation.pipeline_layout->set_name("AO Reprojection Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/ao_denoise_reprojection.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/ao_denoise_reprojection.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
+        m_temporal_accumulation.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_temporal_accumulation.pipeline_layout, "AO Reprojection"));
 
-        comp_desc.set_pipeline_layout(m_temporal_accumulation.pipeline_layout);
-        comp_desc.set_shader_stage(module, "main");
-
-        m_temporal_accumulation.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        // The bilateral blur of AO doesn't use the variance, so no moments are accumulated.
+        m_temporal_accumulation.pipeline->variant({ 0 });
     }
 
     // Bilateral Blur
@@ -790,14 +1021,14 @@ void RayTracedAO::create_pipeline()
         m_bilateral_blur.layout = dw::vk::PipelineLayout::create(backend, desc);
         m_bilateral_blur.layout->set_name("AO Blur Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/ao_denoise_bilateral_blur.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/ao_denoise_bilateral_blur.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_bilateral_blur.layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_bilateral_blur.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_bilateral_blur.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Upsample
@@ -813,14 +1044,13 @@ void RayTracedAO::create_pipeline()
         m_upsample.layout = dw::vk::PipelineLayout::create(backend, desc);
         m_upsample.layout->set_name("AO Upsample Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/ao_upsample.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/ao_upsample.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
+        m_upsample.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_upsample.layout, "AO Upsample"));
 
-        comp_desc.set_pipeline_layout(m_upsample.layout);
-        comp_desc.set_shader_stage(module, "main");
+        WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-        m_upsample.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_upsample.pipeline->variant({ size.x, size.y });
     }
 }
 
@@ -828,65 +1058,41 @@ void RayTracedAO::create_pipeline()
 
 void RayTracedAO::clear_images(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    if (m_first_frame)
-    {
-        auto backend = cmd_buf->backend().lock();
-
-        VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-        VkClearColorValue color;
-
-        color.float32[0] = 0.0f;
-        color.float32[1] = 0.0f;
-        color.float32[2] = 0.0f;
-        color.float32[3] = 0.0f;
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.history_length_image[!m_common_resources->ping_pong], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.color_image[!m_common_resources->ping_pong], subresource_range);
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.history_length_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.color_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    VkClearColorValue color;
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.history_length_image[!m_common_resources->ping_pong], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.color_image[!m_common_resources->ping_pong], subresource_range);
+    color.float32[0] = 0.0f;
+    color.float32[1] = 0.0f;
+    color.float32[2] = 0.0f;
+    color.float32[3] = 0.0f;
 
-        backend->flush_barriers(cmd_buf);
-        
-        m_first_frame = false;
-    }
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.history_length_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.color_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedAO::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Ray Trace", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
-    
-    backend->flush_barriers(cmd_buf);
-        
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_ray_trace.pipeline->handle());
 
     RayTracePushConstants push_constants;
 
-    push_constants.num_frames   = m_common_resources->num_frames;
-    push_constants.ray_length   = m_ray_trace.ray_length;
-    push_constants.bias         = m_ray_trace.bias;
-    push_constants.g_buffer_mip = m_g_buffer_mip;
+    push_constants.num_frames         = m_common_resources->num_frames;
+    push_constants.ray_length         = m_ray_trace.ray_length;
+    push_constants.bias               = m_ray_trace.bias;
+    push_constants.g_buffer_mip       = m_g_buffer_mip;
+    push_constants.blue_noise_sampler = m_common_resources->blue_noise_sampler;
 
     vkCmdPushConstants(cmd_buf->handle(), m_ray_trace.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
     const uint32_t dynamic_offset = m_common_resources->ubo_size * backend->current_frame_idx();
 
     VkDescriptorSet descriptor_sets[] = {
-        m_common_resources->current_scene()->descriptor_set()->handle(),
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
         m_ray_trace.write_ds->handle(),
         m_common_resources->per_frame_ds->handle(),
         m_g_buffer->output_ds()->handle(),
@@ -896,38 +1102,15 @@ void RayTracedAO::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_ray_trace.pipeline_layout->handle(), 0, 5, descriptor_sets, 1, &dynamic_offset);
 
     vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_width) / float(RAY_TRACE_NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_height) / float(RAY_TRACE_NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-}
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
-void RayTracedAO::denoise(dw::vk::CommandBuffer::Ptr cmd_buf)
-{
-    DW_SCOPED_SAMPLE("Denoise", cmd_buf);
-
-    reset_args(cmd_buf);
-    temporal_accumulation(cmd_buf);
-    bilateral_blur(cmd_buf);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedAO::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Upsample", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-    backend->flush_barriers(cmd_buf);
-        
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->variant({ size.x, size.y }));
 
     UpsamplePushConstants push_constants;
 
@@ -944,29 +1127,13 @@ void RayTracedAO::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
 
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.layout->handle(), 0, 3, descriptor_sets, 0, nullptr);
 
-    const int NUM_THREADS_X = 8;
-    const int NUM_THREADS_Y = 8;
-
-    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_upsample.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
+    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(size.x))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(size.y))), 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedAO::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Reset Args", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-
-    backend->flush_barriers(cmd_buf);
-        
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_reset_args.pipeline->handle());
 
     VkDescriptorSet descriptor_sets[] = {
@@ -982,20 +1149,9 @@ void RayTracedAO::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 
 void RayTracedAO::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Temporal Accumulation", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.color_image[m_common_resources->ping_pong], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.history_length_image[m_common_resources->ping_pong], subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-        
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->variant({ 0 }));
 
     TemporalReprojectionPushConstants push_constants;
 
@@ -1020,120 +1176,52 @@ void RayTracedAO::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf)
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline_layout->handle(), 0, 8, descriptor_sets, 1, &dynamic_offset);
 
     vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_width) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_height) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.color_image[m_common_resources->ping_pong], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.history_length_image[m_common_resources->ping_pong], subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedAO::bilateral_blur(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedAO::clear_blur_images(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Bilateral Blur", cmd_buf);
-
-    auto backend = m_backend.lock();
-
     VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-    // Vertical
-    {
-        DW_SCOPED_SAMPLE("Vertical", cmd_buf);
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[0], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-        
-        VkClearColorValue color;
-
-        color.float32[0] = 1.0f;
-        color.float32[1] = 1.0f;
-        color.float32[2] = 1.0f;
-        color.float32[3] = 1.0f;
+    VkClearColorValue color;
 
-        vkCmdClearColorImage(cmd_buf->handle(), m_bilateral_blur.image[0]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    color.float32[0] = 1.0f;
+    color.float32[1] = 1.0f;
+    color.float32[2] = 1.0f;
+    color.float32[3] = 1.0f;
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[0], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.pipeline->handle());
-
-        BilateralBlurPushConstants push_constants;
-
-        push_constants.z_buffer_params = m_common_resources->z_buffer_params;
-        push_constants.direction       = glm::ivec2(1, 0);
-        push_constants.radius          = m_bilateral_blur.blur_radius;
-        push_constants.g_buffer_mip    = m_g_buffer_mip;
-
-        vkCmdPushConstants(cmd_buf->handle(), m_bilateral_blur.layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
-
-        VkDescriptorSet descriptor_sets[] = {
-            m_bilateral_blur.write_ds[0]->handle(),
-            m_temporal_accumulation.output_read_ds[m_common_resources->ping_pong]->handle(),
-            m_temporal_accumulation.read_ds[m_common_resources->ping_pong]->handle(),
-            m_g_buffer->output_ds()->handle(),
-            m_temporal_accumulation.indirect_buffer_ds->handle()
-        };
-
-        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.layout->handle(), 0, 5, descriptor_sets, 0, nullptr);
-
-        vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_bilateral_blur.image[0], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-    }
-
-    // Horizontal
-    {
-        DW_SCOPED_SAMPLE("Horizontal", cmd_buf);
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[1], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-        
-        VkClearColorValue color;
-
-        color.float32[0] = 1.0f;
-        color.float32[1] = 1.0f;
-        color.float32[2] = 1.0f;
-        color.float32[3] = 1.0f;
-
-        vkCmdClearColorImage(cmd_buf->handle(), m_bilateral_blur.image[1]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_bilateral_blur.image[1], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.pipeline->handle());
+    vkCmdClearColorImage(cmd_buf->handle(), m_bilateral_blur.image[0]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    vkCmdClearColorImage(cmd_buf->handle(), m_bilateral_blur.image[1]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+}
 
-        BilateralBlurPushConstants push_constants;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        push_constants.z_buffer_params = m_common_resources->z_buffer_params;
-        push_constants.direction       = glm::ivec2(0, 1);
-        push_constants.radius          = m_bilateral_blur.blur_radius;
-        push_constants.g_buffer_mip    = m_g_buffer_mip;
+void RayTracedAO::bilateral_blur(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t idx)
+{
+    // The first pass blurs vertically from the temporal accumulation output, the second blurs horizontally from the first.
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.pipeline->handle());
 
-        vkCmdPushConstants(cmd_buf->handle(), m_bilateral_blur.layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    BilateralBlurPushConstants push_constants;
 
-        VkDescriptorSet descriptor_sets[] = {
-            m_bilateral_blur.write_ds[1]->handle(),
-            m_bilateral_blur.read_ds[0]->handle(),
-            m_temporal_accumulation.read_ds[m_common_resources->ping_pong]->handle(),
-            m_g_buffer->output_ds()->handle(),
-            m_temporal_accumulation.indirect_buffer_ds->handle()
-        };
+    push_constants.z_buffer_params = m_common_resources->z_buffer_params;
+    push_constants.direction       = idx == 0 ? glm::ivec2(1, 0) : glm::ivec2(0, 1);
+    push_constants.radius          = m_bilateral_blur.blur_radius;
+    push_constants.g_buffer_mip    = m_g_buffer_mip;
 
-        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.layout->handle(), 0, 5, descriptor_sets, 0, nullptr);
+    vkCmdPushConstants(cmd_buf->handle(), m_bilateral_blur.layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
-        vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
+    VkDescriptorSet descriptor_sets[] = {
+        m_bilateral_blur.write_ds[idx]->handle(),
+        idx == 0 ? m_temporal_accumulation.output_read_ds[m_common_resources->ping_pong]->handle() : m_bilateral_blur.read_ds[0]->handle(),
+        m_temporal_accumulation.read_ds[m_common_resources->ping_pong]->handle(),
+        m_g_buffer->output_ds()->handle(),
+        m_temporal_accumulation.indirect_buffer_ds->handle()
+    };
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_bilateral_blur.image[1], subresource_range);
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_bilateral_blur.layout->handle(), 0, 5, descriptor_sets, 0, nullptr);
 
-        backend->flush_barriers(cmd_buf);
-    }
+    vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
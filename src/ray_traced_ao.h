@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.h"
+#include "render_graph.h"
+#include "specialized_pipeline.h"
 
 class GBuffer;
 
@@ -23,29 +25,38 @@ public:
     RayTracedAO(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale = RAY_TRACE_SCALE_HALF_RES);
     ~RayTracedAO();
 
-    void                       render(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                       render(RenderGraph& graph);
     void                       gui();
     dw::vk::DescriptorSet::Ptr output_ds();
+    dw::vk::Image::Ptr         output_image();
+    void                       set_scale(RayTraceScale scale);
+    void                       recreate_transient_images();
 
     inline uint32_t      width() { return m_width; }
     inline uint32_t      height() { return m_height; }
     inline RayTraceScale scale() { return m_scale; }
+    inline bool          denoise() { return m_denoise; }
+    inline void          set_denoise(bool value) { m_denoise = value; }
     inline OutputType    current_output() { return m_current_output; }
     inline void          set_current_output(OutputType current_output) { m_current_output = current_output; }
 
 private:
+    void update_dimensions();
+    void retire_resources(bool transient_only);
     void create_images();
+    void create_transient_images();
     void create_buffers();
+    void create_descriptor_set_layouts();
     void create_descriptor_sets();
     void write_descriptor_sets();
     void create_pipeline();
     void clear_images(dw::vk::CommandBuffer::Ptr cmd_buf);
     void ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void denoise(dw::vk::CommandBuffer::Ptr cmd_buf);
     void upsample(dw::vk::CommandBuffer::Ptr cmd_buf);
     void reset_args(dw::vk::CommandBuffer::Ptr cmd_buf);
     void temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void bilateral_blur(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void clear_blur_images(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void bilateral_blur(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t idx);
 
 private:
     struct RayTrace
@@ -69,22 +80,22 @@ private:
 
     struct TemporalAccumulation
     {
-        float                            alpha = 0.01f;
-        dw::vk::Buffer::Ptr              denoise_tile_coords_buffer;
-        dw::vk::Buffer::Ptr              denoise_dispatch_args_buffer;
-        dw::vk::ComputePipeline::Ptr     pipeline;
-        dw::vk::PipelineLayout::Ptr      pipeline_layout;
-        dw::vk::DescriptorSetLayout::Ptr read_ds_layout;
-        dw::vk::DescriptorSetLayout::Ptr write_ds_layout;
-        dw::vk::DescriptorSetLayout::Ptr indirect_buffer_ds_layout;
-        dw::vk::Image::Ptr               color_image[2];
-        dw::vk::ImageView::Ptr           color_view[2];
-        dw::vk::Image::Ptr               history_length_image[2];
-        dw::vk::ImageView::Ptr           history_length_view[2];
-        dw::vk::DescriptorSet::Ptr       write_ds[2];
-        dw::vk::DescriptorSet::Ptr       read_ds[2];
-        dw::vk::DescriptorSet::Ptr       output_read_ds[2];
-        dw::vk::DescriptorSet::Ptr       indirect_buffer_ds;
+        float                                       alpha = 0.01f;
+        dw::vk::Buffer::Ptr                         denoise_tile_coords_buffer;
+        dw::vk::Buffer::Ptr                         denoise_dispatch_args_buffer;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::PipelineLayout::Ptr                 pipeline_layout;
+        dw::vk::DescriptorSetLayout::Ptr            read_ds_layout;
+        dw::vk::DescriptorSetLayout::Ptr            write_ds_layout;
+        dw::vk::DescriptorSetLayout::Ptr            indirect_buffer_ds_layout;
+        dw::vk::Image::Ptr                          color_image[2];
+        dw::vk::ImageView::Ptr                      color_view[2];
+        dw::vk::Image::Ptr                          history_length_image[2];
+        dw::vk::ImageView::Ptr                      history_length_view[2];
+        dw::vk::DescriptorSet::Ptr                  write_ds[2];
+        dw::vk::DescriptorSet::Ptr                  read_ds[2];
+        dw::vk::DescriptorSet::Ptr                  output_read_ds[2];
+        dw::vk::DescriptorSet::Ptr                  indirect_buffer_ds;
     };
 
     struct BilateralBlur
@@ -100,13 +111,13 @@ private:
 
     struct Upsample
     {
-        float                        power = 1.2f;
-        dw::vk::PipelineLayout::Ptr  layout;
-        dw::vk::ComputePipeline::Ptr pipeline;
-        dw::vk::Image::Ptr           image;
-        dw::vk::ImageView::Ptr       image_view;
-        dw::vk::DescriptorSet::Ptr   read_ds;
-        dw::vk::DescriptorSet::Ptr   write_ds;
+        float                                       power = 1.2f;
+        dw::vk::PipelineLayout::Ptr                 layout;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::Image::Ptr                          image;
+        dw::vk::ImageView::Ptr                      image_view;
+        dw::vk::DescriptorSet::Ptr                  read_ds;
+        dw::vk::DescriptorSet::Ptr                  write_ds;
     };
 
     std::weak_ptr<dw::vk::Backend> m_backend;
@@ -1,4 +1,5 @@
 #include "ray_traced_reflections.h"
+#include "shader_library.h"
 #include "g_buffer.h"
 #include "ddgi.h"
 #include <profiler.h>
@@ -10,6 +11,9 @@
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_X = 8;
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_Y = 8;
 
+// The workgroup size of the upsample pass is tuned per device, under the name the render graph reports it with.
+static const char* UPSAMPLE_PASS = "Ray Traced Reflections/Upsample";
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct RayTracePushConstants
@@ -23,6 +27,7 @@ struct RayTracePushConstants
     float    gi_intensity;
     float    rough_ddgi_intensity;
     float    ibl_indirect_specular_intensity;
+    int32_t  blue_noise_sampler;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -34,7 +39,6 @@ struct TemporalAccumulationPushConstants
     float     alpha;
     float     moments_alpha;
     int32_t   g_buffer_mip;
-    int       approximate_with_ddgi;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -47,7 +51,6 @@ struct ATrousFilterPushConstants
     float   phi_normal;
     float   sigma_depth;
     int32_t g_buffer_mip;
-    int32_t approximate_with_ddgi;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -80,20 +83,14 @@ const std::string RayTracedReflections::kOutputTypeNames[] = {
 RayTracedReflections::RayTracedReflections(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale) :
     m_backend(backend), m_common_resources(common_resources), m_g_buffer(g_buffer), m_scale(scale)
 {
-    auto vk_backend = m_backend.lock();
-
-    float scale_divisor = powf(2.0f, float(scale));
-
-    m_width  = vk_backend->swap_chain_extents().width / scale_divisor;
-    m_height = vk_backend->swap_chain_extents().height / scale_divisor;
-
-    m_g_buffer_mip = static_cast<uint32_t>(scale);
-
+    update_dimensions();
     create_images();
     create_buffers();
+    create_descriptor_set_layouts();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipelines();
+    m_common_resources->workgroup_tuner->add_pass(UPSAMPLE_PASS, { 8, 8 });
+    m_common_resources->pipeline_cache->queue([this]() { create_pipelines(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -104,22 +101,93 @@ RayTracedReflections::~RayTracedReflections()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedReflections::render(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* ddgi)
+void RayTracedReflections::render(RenderGraph& graph, DDGI* ddgi)
 {
-    DW_SCOPED_SAMPLE("Ray Traced Reflections", cmd_buf);
+    graph.begin_group("Ray Traced Reflections");
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+    uint32_t read_idx  = static_cast<uint32_t>(!m_common_resources->ping_pong);
+
+    if (m_first_frame)
+    {
+        graph.add_pass(
+            "Clear",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.prev_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[read_idx], subresource_range);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                clear_images(cmd_buf);
+            });
+
+        m_first_frame = false;
+    }
 
-    clear_images(cmd_buf);
-    ray_trace(cmd_buf, ddgi);
+    graph.add_pass(
+        "Ray Trace",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
+            m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR);
+            ddgi->use_probe_grid(builder, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR);
+        },
+        [this, ddgi](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            ray_trace(cmd_buf, ddgi);
+        });
 
     if (m_denoise)
     {
-        reset_args(cmd_buf);
-        temporal_accumulation(cmd_buf);
-        a_trous_filter(cmd_buf);
+        graph.add_pass(
+            "Reset Args",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                reset_args(cmd_buf);
+            });
+
+        graph.add_pass(
+            "Temporal Accumulation",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.blur_as_input ? m_temporal_accumulation.prev_image : m_temporal_accumulation.current_output_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                m_g_buffer->use_history(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                temporal_accumulation(cmd_buf);
+            });
+
+        a_trous_filter(graph);
 
         if (m_scale != RAY_TRACE_SCALE_FULL_RES)
-            upsample(cmd_buf);
+        {
+            graph.add_pass(
+                "Upsample",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[m_a_trous.read_idx], subresource_range);
+                    m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                },
+                [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    upsample(cmd_buf);
+                });
+        }
     }
+
+    graph.end_group();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -170,19 +238,124 @@ dw::vk::DescriptorSet::Ptr RayTracedReflections::output_ds()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedReflections::create_images()
+dw::vk::Image::Ptr RayTracedReflections::output_image()
 {
-    auto backend = m_backend.lock();
+    if (m_denoise)
+    {
+        if (m_current_output == OUTPUT_RAY_TRACE)
+            return m_ray_trace.image;
+        else if (m_current_output == OUTPUT_TEMPORAL_ACCUMULATION)
+            return m_temporal_accumulation.current_output_image[m_common_resources->ping_pong];
+        else if (m_current_output == OUTPUT_ATROUS)
+            return m_a_trous.image[m_a_trous.read_idx];
+        else
+        {
+            if (m_scale == RAY_TRACE_SCALE_FULL_RES)
+                return m_a_trous.image[m_a_trous.read_idx];
+            else
+                return m_upsample.image;
+        }
+    }
+    else
+        return m_ray_trace.image;
+}
 
-    // Ray Trace
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::set_scale(RayTraceScale scale)
+{
+    if (scale == m_scale)
+        return;
+
+    retire_resources(false);
+
+    m_scale = scale;
+
+    update_dimensions();
+    create_images();
+    create_buffers();
+    create_descriptor_sets();
+    write_descriptor_sets();
+
+    m_first_frame = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::recreate_transient_images()
+{
+    retire_resources(true);
+    create_transient_images();
+    create_descriptor_sets();
+    write_descriptor_sets();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::update_dimensions()
+{
+    float scale_divisor = powf(2.0f, float(m_scale));
+
+    m_width  = m_common_resources->output_width / scale_divisor;
+    m_height = m_common_resources->output_height / scale_divisor;
+
+    m_g_buffer_mip = static_cast<uint32_t>(m_scale);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::retire_resources(bool transient_only)
+{
+    DeletionQueue* queue = m_common_resources->deletion_queue.get();
+
+    if (!transient_only)
     {
-        m_ray_trace.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_ray_trace.image->set_name("Reflections Ray Trace");
+        queue->push(m_temporal_accumulation.prev_image);
+        queue->push(m_temporal_accumulation.prev_view);
+        queue->push(m_temporal_accumulation.denoise_tile_coords_buffer);
+        queue->push(m_temporal_accumulation.denoise_dispatch_args_buffer);
+        queue->push(m_temporal_accumulation.copy_tile_coords_buffer);
+        queue->push(m_temporal_accumulation.copy_dispatch_args_buffer);
 
-        m_ray_trace.view = dw::vk::ImageView::create(backend, m_ray_trace.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_ray_trace.view->set_name("Reflections Ray Trace");
+        for (int i = 0; i < 2; i++)
+        {
+            queue->push(m_temporal_accumulation.current_output_image[i]);
+            queue->push(m_temporal_accumulation.current_output_view[i]);
+            queue->push(m_temporal_accumulation.current_moments_image[i]);
+            queue->push(m_temporal_accumulation.current_moments_view[i]);
+        }
     }
 
+    // Transient images go back to the allocator, which defers destroying them on its own.
+    queue->push(m_ray_trace.view);
+    queue->push(m_upsample.image_view);
+
+    for (int i = 0; i < 2; i++)
+        queue->push(m_a_trous.view[i]);
+
+    queue->push(m_ray_trace.write_ds);
+    queue->push(m_ray_trace.read_ds);
+    queue->push(m_temporal_accumulation.indirect_buffer_ds);
+    queue->push(m_upsample.write_ds);
+    queue->push(m_upsample.read_ds);
+
+    for (int i = 0; i < 2; i++)
+    {
+        queue->push(m_temporal_accumulation.current_write_ds[i]);
+        queue->push(m_temporal_accumulation.current_read_ds[i]);
+        queue->push(m_temporal_accumulation.prev_read_ds[i]);
+        queue->push(m_temporal_accumulation.output_only_read_ds[i]);
+        queue->push(m_a_trous.read_ds[i]);
+        queue->push(m_a_trous.write_ds[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::create_images()
+{
+    auto backend = m_backend.lock();
+
     // Reprojection
     {
         for (int i = 0; i < 2; i++)
@@ -207,22 +380,35 @@ void RayTracedReflections::create_images()
         m_temporal_accumulation.prev_view->set_name("Reflections Previous Reprojection");
     }
 
+    create_transient_images();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::create_transient_images()
+{
+    auto backend = m_backend.lock();
+
+    // Ray Trace
+    {
+        m_ray_trace.image = m_common_resources->transient_allocator->create_image("Reflections Ray Trace", VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
+
+        m_ray_trace.view = dw::vk::ImageView::create(backend, m_ray_trace.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_ray_trace.view->set_name("Reflections Ray Trace");
+    }
+
     // A-Trous Filter
     for (int i = 0; i < 2; i++)
     {
-        m_a_trous.image[i] = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_a_trous.image[i]->set_name("A-Trous Filter " + std::to_string(i));
+        m_a_trous.image[i] = m_common_resources->transient_allocator->create_image("Reflections A-Trous Filter " + std::to_string(i), VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_a_trous.view[i] = dw::vk::ImageView::create(backend, m_a_trous.image[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_a_trous.view[i]->set_name("A-Trous Filter View " + std::to_string(i));
+        m_a_trous.view[i]->set_name("Reflections A-Trous Filter View " + std::to_string(i));
     }
 
     // Upsample
     {
-        auto vk_backend = m_backend.lock();
-
-        m_upsample.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, vk_backend->swap_chain_extents().width, vk_backend->swap_chain_extents().height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_upsample.image->set_name("Reflections Upsample");
+        m_upsample.image = m_common_resources->transient_allocator->create_image("Reflections Upsample", VK_IMAGE_TYPE_2D, m_common_resources->output_width, m_common_resources->output_height, 1, 1, 1, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_upsample.image_view = dw::vk::ImageView::create(backend, m_upsample.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
         m_upsample.image_view->set_name("Reflections Upsample");
@@ -244,16 +430,10 @@ void RayTracedReflections::create_buffers()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedReflections::create_descriptor_sets()
+void RayTracedReflections::create_descriptor_set_layouts()
 {
     auto backend = m_backend.lock();
 
-    // Ray Trace
-    {
-        m_ray_trace.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
-        m_ray_trace.read_ds  = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
-    }
-
     // Reprojection
     {
         dw::vk::DescriptorSetLayout::Desc desc;
@@ -273,13 +453,6 @@ void RayTracedReflections::create_descriptor_sets()
         m_temporal_accumulation.read_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
     }
 
-    for (int i = 0; i < 2; i++)
-    {
-        m_temporal_accumulation.current_write_ds[i]    = backend->allocate_descriptor_set(m_temporal_accumulation.write_ds_layout);
-        m_temporal_accumulation.current_read_ds[i]     = backend->allocate_descriptor_set(m_temporal_accumulation.read_ds_layout);
-        m_temporal_accumulation.prev_read_ds[i]        = backend->allocate_descriptor_set(m_temporal_accumulation.read_ds_layout);
-        m_temporal_accumulation.output_only_read_ds[i] = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
-    }
 
     // Indirect Buffer
     {
@@ -291,7 +464,32 @@ void RayTracedReflections::create_descriptor_sets()
         desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
 
         m_temporal_accumulation.indirect_buffer_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedReflections::create_descriptor_sets()
+{
+    auto backend = m_backend.lock();
+
+    // Ray Trace
+    {
+        m_ray_trace.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
+        m_ray_trace.read_ds  = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
+    }
+
+    // Reprojection
+    for (int i = 0; i < 2; i++)
+    {
+        m_temporal_accumulation.current_write_ds[i]    = backend->allocate_descriptor_set(m_temporal_accumulation.write_ds_layout);
+        m_temporal_accumulation.current_read_ds[i]     = backend->allocate_descriptor_set(m_temporal_accumulation.read_ds_layout);
+        m_temporal_accumulation.prev_read_ds[i]        = backend->allocate_descriptor_set(m_temporal_accumulation.read_ds_layout);
+        m_temporal_accumulation.output_only_read_ds[i] = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
+    }
 
+    // Indirect Buffer
+    {
         m_temporal_accumulation.indirect_buffer_ds = backend->allocate_descriptor_set(m_temporal_accumulation.indirect_buffer_ds_layout);
         m_temporal_accumulation.indirect_buffer_ds->set_name("Temporal Accumulation Indirect Buffer");
     }
@@ -801,9 +999,9 @@ void RayTracedReflections::create_pipelines()
         // Create shader modules
         // ---------------------------------------------------------------------------
 
-        dw::vk::ShaderModule::Ptr rgen  = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_ray_trace.rgen.spv");
-        dw::vk::ShaderModule::Ptr rchit = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_ray_trace.rchit.spv");
-        dw::vk::ShaderModule::Ptr rmiss = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_ray_trace.rmiss.spv");
+        dw::vk::ShaderModule::Ptr rgen  = ShaderLibrary::load(backend, "shaders/reflections_ray_trace.rgen.spv");
+        dw::vk::ShaderModule::Ptr rchit = ShaderLibrary::load(backend, "shaders/reflections_ray_trace.rchit.spv");
+        dw::vk::ShaderModule::Ptr rmiss = ShaderLibrary::load(backend, "shaders/reflections_ray_trace.rmiss.spv");
 
         dw::vk::ShaderBindingTable::Desc sbt_desc;
 
@@ -837,7 +1035,7 @@ void RayTracedReflections::create_pipelines()
 
         desc.set_pipeline_layout(m_ray_trace.pipeline_layout);
 
-        m_ray_trace.pipeline = dw::vk::RayTracingPipeline::create(backend, desc);
+        m_ray_trace.pipeline = dw::vk::RayTracingPipeline::create(backend, desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Reset Args
@@ -849,14 +1047,14 @@ void RayTracedReflections::create_pipelines()
         m_reset_args.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_reset_args.pipeline_layout->set_name("Reset Args Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_denoise_reset_args.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/reflections_denoise_reset_args.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_reset_args.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Reprojection
@@ -876,14 +1074,12 @@ void RayTracedReflections::create_pipelines()
         m_temporal_accumulation.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_temporal_accumulation.pipeline_layout->set_name("Reprojection Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_denoise_reprojection.comp.spv");
-
-        dw::vk::ComputePipeline::Desc comp_desc;
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/reflections_denoise_reprojection.comp.spv");
 
-        comp_desc.set_pipeline_layout(m_temporal_accumulation.pipeline_layout);
-        comp_desc.set_shader_stage(module, "main");
+        m_temporal_accumulation.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_temporal_accumulation.pipeline_layout, "Reprojection"));
 
-        m_temporal_accumulation.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_temporal_accumulation.pipeline->variant({ 0, 1 });
+        m_temporal_accumulation.pipeline->variant({ 1, 1 });
     }
 
     // Copy Tiles
@@ -897,14 +1093,14 @@ void RayTracedReflections::create_pipelines()
         m_copy_tiles.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_copy_tiles.pipeline_layout->set_name("Copy Tiles Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_denoise_copy_tiles.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/reflections_denoise_copy_tiles.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_copy_tiles.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_copy_tiles.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_copy_tiles.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // A-Trous Filter
@@ -921,14 +1117,12 @@ void RayTracedReflections::create_pipelines()
         m_a_trous.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_a_trous.pipeline_layout->set_name("A-Trous Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_denoise_atrous.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/reflections_denoise_atrous.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
-
-        comp_desc.set_pipeline_layout(m_a_trous.pipeline_layout);
-        comp_desc.set_shader_stage(module, "main");
+        m_a_trous.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_a_trous.pipeline_layout, "A-Trous"));
 
-        m_a_trous.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_a_trous.pipeline->variant({ 0 });
+        m_a_trous.pipeline->variant({ 1 });
     }
 
     // Upsample
@@ -944,14 +1138,13 @@ void RayTracedReflections::create_pipelines()
         m_upsample.layout = dw::vk::PipelineLayout::create(backend, desc);
         m_upsample.layout->set_name("Reflections Upsample Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/reflections_upsample.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/reflections_upsample.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
+        m_upsample.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_upsample.layout, "Reflections Upsample"));
 
-        comp_desc.set_pipeline_layout(m_upsample.layout);
-        comp_desc.set_shader_stage(module, "main");
+        WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-        m_upsample.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_upsample.pipeline->variant({ size.x, size.y });
     }
 }
 
@@ -959,53 +1152,26 @@ void RayTracedReflections::create_pipelines()
 
 void RayTracedReflections::clear_images(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    if (m_first_frame)
-    {
-        auto backend = cmd_buf->backend().lock();
-
-        VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-        VkClearColorValue color;
-
-        color.float32[0] = 0.0f;
-        color.float32[1] = 0.0f;
-        color.float32[2] = 0.0f;
-        color.float32[3] = 0.0f;
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.prev_image, subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image[!m_common_resources->ping_pong], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong], subresource_range);
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.prev_image->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_output_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    VkClearColorValue color;
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_output_image[!m_common_resources->ping_pong], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong], subresource_range);
+    color.float32[0] = 0.0f;
+    color.float32[1] = 0.0f;
+    color.float32[2] = 0.0f;
+    color.float32[3] = 0.0f;
 
-        backend->flush_barriers(cmd_buf);
-        
-        m_first_frame = false;
-    }
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.prev_image->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_output_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedReflections::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* ddgi)
 {
-    DW_SCOPED_SAMPLE("Ray Trace", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-        
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_ray_trace.pipeline->handle());
 
     RayTracePushConstants push_constants;
@@ -1015,10 +1181,11 @@ void RayTracedReflections::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* d
     push_constants.num_frames                      = m_common_resources->num_frames;
     push_constants.g_buffer_mip                    = m_g_buffer_mip;
     push_constants.sample_gi                       = m_ray_trace.sample_gi && !m_first_frame ? 1 : 0;
-    push_constants.approximate_with_ddgi           = m_ray_trace.approximate_with_ddgi && !m_first_frame ? 1 : 0;
+    push_constants.approximate_with_ddgi           = approximate_with_ddgi();
     push_constants.gi_intensity                    = m_ray_trace.gi_intensity;
     push_constants.rough_ddgi_intensity            = m_ray_trace.rough_ddgi_intensity;
     push_constants.ibl_indirect_specular_intensity = m_ray_trace.ibl_indirect_specular_intensity;
+    push_constants.blue_noise_sampler              = m_common_resources->blue_noise_sampler;
 
     vkCmdPushConstants(cmd_buf->handle(), m_ray_trace.pipeline_layout->handle(), VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0, sizeof(push_constants), &push_constants);
 
@@ -1028,7 +1195,7 @@ void RayTracedReflections::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* d
     };
 
     VkDescriptorSet descriptor_sets[] = {
-        m_common_resources->current_scene()->descriptor_set()->handle(),
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
         m_ray_trace.write_ds->handle(),
         m_common_resources->per_frame_ds->handle(),
         m_g_buffer->output_ds()->handle(),
@@ -1050,27 +1217,12 @@ void RayTracedReflections::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf, DDGI* d
     uint32_t rt_image_height = m_height;
 
     vkCmdTraceRaysKHR(cmd_buf->handle(), &raygen_sbt, &miss_sbt, &hit_sbt, &callable_sbt, rt_image_width, rt_image_height, 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedReflections::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Reset Args", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
-
-    backend->flush_barriers(cmd_buf);
-
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_reset_args.pipeline->handle());
 
     VkDescriptorSet descriptor_sets[] = {
@@ -1086,31 +1238,17 @@ void RayTracedReflections::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 
 void RayTracedReflections::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Temporal Accumulation", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image[m_common_resources->ping_pong], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[m_common_resources->ping_pong], subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->variant({ approximate_with_ddgi(), 1 }));
 
     TemporalAccumulationPushConstants push_constants;
 
-    push_constants.camera_delta          = m_common_resources->camera_delta;
-    push_constants.frame_time            = m_common_resources->frame_time;
-    push_constants.alpha                 = m_temporal_accumulation.alpha;
-    push_constants.moments_alpha         = m_temporal_accumulation.moments_alpha;
-    push_constants.g_buffer_mip          = m_g_buffer_mip;
-    push_constants.approximate_with_ddgi = m_ray_trace.approximate_with_ddgi && !m_first_frame ? 1 : 0;
+    push_constants.camera_delta  = m_common_resources->camera_delta;
+    push_constants.frame_time    = m_common_resources->frame_time;
+    push_constants.alpha         = m_temporal_accumulation.alpha;
+    push_constants.moments_alpha = m_temporal_accumulation.moments_alpha;
+    push_constants.g_buffer_mip  = m_g_buffer_mip;
 
     vkCmdPushConstants(cmd_buf->handle(), m_temporal_accumulation.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
@@ -1129,23 +1267,12 @@ void RayTracedReflections::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline_layout->handle(), 0, 7, descriptor_sets, 1, &dynamic_offset);
 
     vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_width) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_height) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_output_image[m_common_resources->ping_pong], subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[m_common_resources->ping_pong], subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedReflections::a_trous_filter(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedReflections::a_trous_filter(RenderGraph& graph)
 {
-    DW_SCOPED_SAMPLE("A-Trous Filter", cmd_buf);
-
-    auto backend = m_backend.lock();
-
     VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
     bool    ping_pong = false;
@@ -1157,119 +1284,129 @@ void RayTracedReflections::a_trous_filter(dw::vk::CommandBuffer::Ptr cmd_buf)
         read_idx  = (int32_t)ping_pong;
         write_idx = (int32_t)!ping_pong;
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[read_idx], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+        dw::vk::Image::Ptr input_image = i == 0 ? m_temporal_accumulation.current_output_image[m_common_resources->ping_pong] : m_a_trous.image[read_idx];
+
+        graph.add_pass(
+            "A-Trous Copy Tiles " + std::to_string(i),
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.copy_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.copy_dispatch_args_buffer);
+            },
+            [this, i, read_idx, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                a_trous_copy_tiles(cmd_buf, i, read_idx, write_idx);
+            });
+
+        graph.add_pass(
+            "A-Trous Iteration " + std::to_string(i),
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this, i, read_idx, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                a_trous_iteration(cmd_buf, i, read_idx, write_idx);
+            });
 
-        backend->flush_barriers(cmd_buf);
+        ping_pong = !ping_pong;
 
-        // Copy the required tiles
+        if (m_a_trous.feedback_iteration == i && m_temporal_accumulation.blur_as_input)
         {
-            DW_SCOPED_SAMPLE("Copy Tiles", cmd_buf);
-
-            vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_tiles.pipeline->handle());
-
-            VkDescriptorSet descriptor_sets[] = {
-                m_a_trous.write_ds[write_idx]->handle(),
-                i == 0 ? m_temporal_accumulation.output_only_read_ds[m_common_resources->ping_pong]->handle() : m_a_trous.read_ds[read_idx]->handle(),
-                m_temporal_accumulation.indirect_buffer_ds->handle()
-            };
-
-            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_tiles.pipeline_layout->handle(), 0, 3, descriptor_sets, 0, nullptr);
-
-            vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.copy_dispatch_args_buffer->handle(), 0);
+            graph.add_pass(
+                "A-Trous Feedback",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
+                    builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
+                },
+                [this, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    a_trous_feedback(cmd_buf, write_idx);
+                });
         }
+    }
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
+    m_a_trous.read_idx = write_idx;
+}
 
-        // A-Trous Filter
-        {
-            DW_SCOPED_SAMPLE("Iteration " + std::to_string(i), cmd_buf);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-            vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline->handle());
+void RayTracedReflections::a_trous_copy_tiles(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t i, int32_t read_idx, int32_t write_idx)
+{
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_tiles.pipeline->handle());
 
-            ATrousFilterPushConstants push_constants;
+    VkDescriptorSet descriptor_sets[] = {
+        m_a_trous.write_ds[write_idx]->handle(),
+        i == 0 ? m_temporal_accumulation.output_only_read_ds[m_common_resources->ping_pong]->handle() : m_a_trous.read_ds[read_idx]->handle(),
+        m_temporal_accumulation.indirect_buffer_ds->handle()
+    };
 
-            push_constants.radius                = m_a_trous.radius;
-            push_constants.step_size             = 1 << i;
-            push_constants.phi_color             = m_a_trous.phi_color;
-            push_constants.phi_normal            = m_a_trous.phi_normal;
-            push_constants.g_buffer_mip          = m_g_buffer_mip;
-            push_constants.sigma_depth           = m_a_trous.sigma_depth;
-            push_constants.approximate_with_ddgi = m_ray_trace.approximate_with_ddgi && !m_first_frame ? 1 : 0;
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_tiles.pipeline_layout->handle(), 0, 3, descriptor_sets, 0, nullptr);
 
-            vkCmdPushConstants(cmd_buf->handle(), m_a_trous.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.copy_dispatch_args_buffer->handle(), 0);
+}
 
-            VkDescriptorSet descriptor_sets[] = {
-                m_a_trous.write_ds[write_idx]->handle(),
-                i == 0 ? m_temporal_accumulation.output_only_read_ds[m_common_resources->ping_pong]->handle() : m_a_trous.read_ds[read_idx]->handle(),
-                m_g_buffer->output_ds()->handle(),
-                m_temporal_accumulation.indirect_buffer_ds->handle()
-            };
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline_layout->handle(), 0, 4, descriptor_sets, 0, nullptr);
+void RayTracedReflections::a_trous_iteration(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t i, int32_t read_idx, int32_t write_idx)
+{
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline->variant({ approximate_with_ddgi() }));
 
-            vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
-        }
+    ATrousFilterPushConstants push_constants;
 
-        ping_pong = !ping_pong;
+    push_constants.radius       = m_a_trous.radius;
+    push_constants.step_size    = 1 << i;
+    push_constants.phi_color    = m_a_trous.phi_color;
+    push_constants.phi_normal   = m_a_trous.phi_normal;
+    push_constants.g_buffer_mip = m_g_buffer_mip;
+    push_constants.sigma_depth  = m_a_trous.sigma_depth;
 
-        if (m_a_trous.feedback_iteration == i && m_temporal_accumulation.blur_as_input)
-        {
-            backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
-            backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-
-            backend->flush_barriers(cmd_buf);
-
-            VkImageCopy image_copy_region {};
-            image_copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_copy_region.srcSubresource.layerCount = 1;
-            image_copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_copy_region.dstSubresource.layerCount = 1;
-            image_copy_region.extent.width              = m_width;
-            image_copy_region.extent.height             = m_height;
-            image_copy_region.extent.depth              = 1;
-
-            // Issue the copy command
-            vkCmdCopyImage(
-                cmd_buf->handle(),
-                m_a_trous.image[write_idx]->handle(),
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                m_temporal_accumulation.prev_image->handle(),
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &image_copy_region);
-
-            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
-            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-
-            backend->flush_barriers(cmd_buf);
-        }
-    }
+    vkCmdPushConstants(cmd_buf->handle(), m_a_trous.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
-    m_a_trous.read_idx = write_idx;
+    VkDescriptorSet descriptor_sets[] = {
+        m_a_trous.write_ds[write_idx]->handle(),
+        i == 0 ? m_temporal_accumulation.output_only_read_ds[m_common_resources->ping_pong]->handle() : m_a_trous.read_ds[read_idx]->handle(),
+        m_g_buffer->output_ds()->handle(),
+        m_temporal_accumulation.indirect_buffer_ds->handle()
+    };
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline_layout->handle(), 0, 4, descriptor_sets, 0, nullptr);
 
-    backend->flush_barriers(cmd_buf);
+    vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedReflections::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedReflections::a_trous_feedback(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t write_idx)
 {
-    DW_SCOPED_SAMPLE("Upsample", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkImageCopy image_copy_region {};
+    image_copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_copy_region.srcSubresource.layerCount = 1;
+    image_copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_copy_region.dstSubresource.layerCount = 1;
+    image_copy_region.extent.width              = m_width;
+    image_copy_region.extent.height             = m_height;
+    image_copy_region.extent.depth              = 1;
+
+    // Issue the copy command
+    vkCmdCopyImage(
+        cmd_buf->handle(),
+        m_a_trous.image[write_idx]->handle(),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        m_temporal_accumulation.prev_image->handle(),
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1,
+        &image_copy_region);
+}
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    backend->flush_barriers(cmd_buf);
+void RayTracedReflections::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->variant({ size.x, size.y }));
 
     UpsamplePushConstants push_constants;
 
@@ -1285,14 +1422,7 @@ void RayTracedReflections::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
 
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.layout->handle(), 0, 3, descriptor_sets, 0, nullptr);
 
-    const uint32_t NUM_THREADS_X = 8;
-    const uint32_t NUM_THREADS_Y = 8;
-
-    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_upsample.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
+    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(size.x))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(size.y))), 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "ray_traced_shadows.h"
+#include "shader_library.h"
 #include "g_buffer.h"
 #include <profiler.h>
 #include <macros.h>
@@ -12,6 +13,9 @@ static const int RAY_TRACE_NUM_THREADS_Y = 4;
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_X = 8;
 static const uint32_t TEMPORAL_ACCUMULATION_NUM_THREADS_Y = 8;
 
+// The workgroup size of the upsample pass is tuned per device, under the name the render graph reports it with.
+static const char* UPSAMPLE_PASS = "Ray Traced Shadows/Upsample";
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct RayTracePushConstants
@@ -19,6 +23,7 @@ struct RayTracePushConstants
     float    bias;
     uint32_t num_frames;
     int32_t  g_buffer_mip;
+    int32_t  blue_noise_sampler;
 };
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -73,20 +78,14 @@ const std::string RayTracedShadows::kOutputTypeNames[] = {
 RayTracedShadows::RayTracedShadows(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale) :
     m_backend(backend), m_common_resources(common_resources), m_g_buffer(g_buffer), m_scale(scale)
 {
-    auto vk_backend = m_backend.lock();
-
-    float scale_divisor = powf(2.0f, float(scale));
-
-    m_width  = vk_backend->swap_chain_extents().width / scale_divisor;
-    m_height = vk_backend->swap_chain_extents().height / scale_divisor;
-
-    m_g_buffer_mip = static_cast<uint32_t>(scale);
-
+    update_dimensions();
     create_images();
     create_buffers();
+    create_descriptor_set_layouts();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipelines();
+    m_common_resources->workgroup_tuner->add_pass(UPSAMPLE_PASS, { 32, 32 });
+    m_common_resources->pipeline_cache->queue([this]() { create_pipelines(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -97,22 +96,91 @@ RayTracedShadows::~RayTracedShadows()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedShadows::render(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedShadows::render(RenderGraph& graph)
 {
-    DW_SCOPED_SAMPLE("Ray Traced Shadows", cmd_buf);
+    graph.begin_group("Ray Traced Shadows");
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    uint32_t write_idx = static_cast<uint32_t>(m_common_resources->ping_pong);
+    uint32_t read_idx  = static_cast<uint32_t>(!m_common_resources->ping_pong);
+
+    if (m_first_frame)
+    {
+        graph.add_pass(
+            "Clear",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.prev_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[read_idx], subresource_range);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                clear_images(cmd_buf);
+            });
+
+        m_first_frame = false;
+    }
 
-    clear_images(cmd_buf);
-    ray_trace(cmd_buf);
+    graph.add_pass(
+        "Ray Trace",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
+            m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+        },
+        [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            ray_trace(cmd_buf);
+        });
 
     if (m_denoise)
     {
-        reset_args(cmd_buf);
-        temporal_accumulation(cmd_buf);
-        a_trous_filter(cmd_buf);
+        graph.add_pass(
+            "Reset Args",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                reset_args(cmd_buf);
+            });
+
+        graph.add_pass(
+            "Temporal Accumulation",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                m_g_buffer->use_history(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                temporal_accumulation(cmd_buf);
+            });
+
+        a_trous_filter(graph);
 
         if (m_scale != RAY_TRACE_SCALE_FULL_RES)
-            upsample(cmd_buf);
+        {
+            graph.add_pass(
+                "Upsample",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[m_a_trous.read_idx], subresource_range);
+                    m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                },
+                [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    upsample(cmd_buf);
+                });
+        }
     }
+
+    graph.end_group();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -120,6 +188,7 @@ void RayTracedShadows::render(dw::vk::CommandBuffer::Ptr cmd_buf)
 void RayTracedShadows::gui()
 {
     ImGui::Checkbox("Denoise", &m_denoise);
+    ImGui::Checkbox("Soft Shadows", &m_ray_trace.soft_shadows);
     ImGui::InputFloat("Bias", &m_ray_trace.bias);
     ImGui::InputFloat("Alpha", &m_temporal_accumulation.alpha);
     ImGui::InputFloat("Alpha Moments", &m_temporal_accumulation.moments_alpha);
@@ -156,6 +225,124 @@ dw::vk::DescriptorSet::Ptr RayTracedShadows::output_ds()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+dw::vk::Image::Ptr RayTracedShadows::output_image()
+{
+    if (m_denoise)
+    {
+        if (m_current_output == OUTPUT_RAY_TRACE)
+            return m_ray_trace.image;
+        else if (m_current_output == OUTPUT_TEMPORAL_ACCUMULATION)
+            return m_temporal_accumulation.current_output_image;
+        else if (m_current_output == OUTPUT_ATROUS)
+            return m_a_trous.image[m_a_trous.read_idx];
+        else
+        {
+            if (m_scale == RAY_TRACE_SCALE_FULL_RES)
+                return m_a_trous.image[m_a_trous.read_idx];
+            else
+                return m_upsample.image;
+        }
+    }
+    else
+        return m_ray_trace.image;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::set_scale(RayTraceScale scale)
+{
+    if (scale == m_scale)
+        return;
+
+    // Pipelines and layouts do not depend on the resolution and are kept, everything else is replaced while the
+    // frames in flight keep using the old resources.
+    retire_resources(false);
+
+    m_scale = scale;
+
+    update_dimensions();
+    create_images();
+    create_buffers();
+    create_descriptor_sets();
+    write_descriptor_sets();
+
+    m_first_frame = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::recreate_transient_images()
+{
+    retire_resources(true);
+    create_transient_images();
+    create_descriptor_sets();
+    write_descriptor_sets();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::update_dimensions()
+{
+    float scale_divisor = powf(2.0f, float(m_scale));
+
+    m_width  = m_common_resources->output_width / scale_divisor;
+    m_height = m_common_resources->output_height / scale_divisor;
+
+    m_g_buffer_mip = static_cast<uint32_t>(m_scale);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::retire_resources(bool transient_only)
+{
+    DeletionQueue* queue = m_common_resources->deletion_queue.get();
+
+    if (!transient_only)
+    {
+        queue->push(m_ray_trace.image);
+        queue->push(m_ray_trace.view);
+        queue->push(m_temporal_accumulation.current_output_image);
+        queue->push(m_temporal_accumulation.current_output_view);
+        queue->push(m_temporal_accumulation.prev_image);
+        queue->push(m_temporal_accumulation.prev_view);
+        queue->push(m_temporal_accumulation.denoise_tile_coords_buffer);
+        queue->push(m_temporal_accumulation.denoise_dispatch_args_buffer);
+        queue->push(m_temporal_accumulation.shadow_tile_coords_buffer);
+        queue->push(m_temporal_accumulation.shadow_dispatch_args_buffer);
+
+        for (int i = 0; i < 2; i++)
+        {
+            queue->push(m_temporal_accumulation.current_moments_image[i]);
+            queue->push(m_temporal_accumulation.current_moments_view[i]);
+        }
+    }
+
+    // Transient images go back to the allocator, which defers destroying them on its own.
+    for (int i = 0; i < 2; i++)
+        queue->push(m_a_trous.view[i]);
+
+    queue->push(m_upsample.image_view);
+
+    // Every descriptor set references at least one of the replaced images.
+    queue->push(m_ray_trace.write_ds);
+    queue->push(m_ray_trace.read_ds);
+    queue->push(m_temporal_accumulation.output_only_read_ds);
+    queue->push(m_temporal_accumulation.indirect_buffer_ds);
+    queue->push(m_upsample.write_ds);
+    queue->push(m_upsample.read_ds);
+
+    for (int i = 0; i < 2; i++)
+    {
+        queue->push(m_temporal_accumulation.current_write_ds[i]);
+        queue->push(m_temporal_accumulation.current_read_ds[i]);
+        queue->push(m_temporal_accumulation.prev_read_ds[i]);
+        queue->push(m_a_trous.read_ds[i]);
+        queue->push(m_a_trous.write_ds[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void RayTracedShadows::create_images()
 {
     auto backend = m_backend.lock();
@@ -193,22 +380,27 @@ void RayTracedShadows::create_images()
         m_temporal_accumulation.prev_view->set_name("Shadows Previous Reprojection");
     }
 
+    create_transient_images();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::create_transient_images()
+{
+    auto backend = m_backend.lock();
+
     // A-Trous Filter
     for (int i = 0; i < 2; i++)
     {
-        m_a_trous.image[i] = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_a_trous.image[i]->set_name("A-Trous Filter " + std::to_string(i));
+        m_a_trous.image[i] = m_common_resources->transient_allocator->create_image("Shadows A-Trous Filter " + std::to_string(i), VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_a_trous.view[i] = dw::vk::ImageView::create(backend, m_a_trous.image[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-        m_a_trous.view[i]->set_name("A-Trous Filter View " + std::to_string(i));
+        m_a_trous.view[i]->set_name("Shadows A-Trous Filter View " + std::to_string(i));
     }
 
     // Upsample
     {
-        auto vk_backend = m_backend.lock();
-
-        m_upsample.image = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, vk_backend->swap_chain_extents().width, vk_backend->swap_chain_extents().height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
-        m_upsample.image->set_name("Shadows Upsample");
+        m_upsample.image = m_common_resources->transient_allocator->create_image("Shadows Upsample", VK_IMAGE_TYPE_2D, m_common_resources->output_width, m_common_resources->output_height, 1, 1, 1, VK_FORMAT_R16_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_SAMPLE_COUNT_1_BIT);
 
         m_upsample.image_view = dw::vk::ImageView::create(backend, m_upsample.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
         m_upsample.image_view->set_name("Shadows Upsample");
@@ -230,19 +422,10 @@ void RayTracedShadows::create_buffers()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedShadows::create_descriptor_sets()
+void RayTracedShadows::create_descriptor_set_layouts()
 {
     auto backend = m_backend.lock();
 
-    // Ray Trace
-    {
-        m_ray_trace.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
-        m_ray_trace.write_ds->set_name("Shadows Ray Trace Write");
-
-        m_ray_trace.read_ds = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
-        m_ray_trace.read_ds->set_name("Shadows Ray Trace Read");
-    }
-
     // Reprojection
     {
         dw::vk::DescriptorSetLayout::Desc desc;
@@ -262,6 +445,35 @@ void RayTracedShadows::create_descriptor_sets()
         m_temporal_accumulation.read_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
     }
 
+    // Indirect Buffer
+    {
+        dw::vk::DescriptorSetLayout::Desc desc;
+
+        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        m_temporal_accumulation.indirect_buffer_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayTracedShadows::create_descriptor_sets()
+{
+    auto backend = m_backend.lock();
+
+    // Ray Trace
+    {
+        m_ray_trace.write_ds = backend->allocate_descriptor_set(m_common_resources->storage_image_ds_layout);
+        m_ray_trace.write_ds->set_name("Shadows Ray Trace Write");
+
+        m_ray_trace.read_ds = backend->allocate_descriptor_set(m_common_resources->combined_sampler_ds_layout);
+        m_ray_trace.read_ds->set_name("Shadows Ray Trace Read");
+    }
+
+    // Reprojection
     for (int i = 0; i < 2; i++)
     {
         m_temporal_accumulation.current_write_ds[i] = backend->allocate_descriptor_set(m_temporal_accumulation.write_ds_layout);
@@ -279,15 +491,6 @@ void RayTracedShadows::create_descriptor_sets()
 
     // Indirect Buffer
     {
-        dw::vk::DescriptorSetLayout::Desc desc;
-
-        desc.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-        desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-        desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-        desc.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
-
-        m_temporal_accumulation.indirect_buffer_ds_layout = dw::vk::DescriptorSetLayout::create(backend, desc);
-
         m_temporal_accumulation.indirect_buffer_ds = backend->allocate_descriptor_set(m_temporal_accumulation.indirect_buffer_ds_layout);
         m_temporal_accumulation.indirect_buffer_ds->set_name("Temporal Accumulation Indirect Buffer");
     }
@@ -796,7 +999,7 @@ void RayTracedShadows::create_pipelines()
 
     // Ray Trace
     {
-        dw::vk::ShaderModule::Ptr shader_module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_ray_trace.comp.spv");
+        dw::vk::ShaderModule::Ptr shader_module = ShaderLibrary::load(backend, "shaders/shadows_ray_trace.comp.spv");
 
         dw::vk::PipelineLayout::Desc pl_desc;
 
@@ -811,12 +1014,11 @@ void RayTracedShadows::create_pipelines()
         m_ray_trace.pipeline_layout = dw::vk::PipelineLayout::create(backend, pl_desc);
         m_ray_trace.pipeline_layout->set_name("Ray Trace Pipeline Layout");
 
-        dw::vk::ComputePipeline::Desc desc;
+        m_ray_trace.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), shader_module, m_ray_trace.pipeline_layout, "Shadows Ray Trace"));
 
-        desc.set_shader_stage(shader_module, "main");
-        desc.set_pipeline_layout(m_ray_trace.pipeline_layout);
-
-        m_ray_trace.pipeline = dw::vk::ComputePipeline::create(backend, desc);
+        // Both settings of soft shadows are created up front so toggling them in the UI does not stall a frame.
+        m_ray_trace.pipeline->variant({ 1 });
+        m_ray_trace.pipeline->variant({ 0 });
     }
 
     // Reset Args
@@ -828,14 +1030,14 @@ void RayTracedShadows::create_pipelines()
         m_reset_args.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_reset_args.pipeline_layout->set_name("Reset Args Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_denoise_reset_args.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/shadows_denoise_reset_args.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_reset_args.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_reset_args.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Reprojection
@@ -855,14 +1057,12 @@ void RayTracedShadows::create_pipelines()
         m_temporal_accumulation.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_temporal_accumulation.pipeline_layout->set_name("Reprojection Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_denoise_reprojection.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/shadows_denoise_reprojection.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
+        m_temporal_accumulation.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_temporal_accumulation.pipeline_layout, "Shadows Reprojection"));
 
-        comp_desc.set_pipeline_layout(m_temporal_accumulation.pipeline_layout);
-        comp_desc.set_shader_stage(module, "main");
-
-        m_temporal_accumulation.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        // The variance guided filter needs the moments.
+        m_temporal_accumulation.pipeline->variant({ 1 });
     }
 
     // Copy Shadow Tiles
@@ -875,14 +1075,14 @@ void RayTracedShadows::create_pipelines()
         m_copy_shadow_tiles.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_copy_shadow_tiles.pipeline_layout->set_name("Copy Shadow Tiles Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_denoise_copy_shadow_tiles.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/shadows_denoise_copy_shadow_tiles.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_copy_shadow_tiles.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_copy_shadow_tiles.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_copy_shadow_tiles.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // A-Trous Filter
@@ -899,14 +1099,14 @@ void RayTracedShadows::create_pipelines()
         m_a_trous.pipeline_layout = dw::vk::PipelineLayout::create(backend, desc);
         m_a_trous.pipeline_layout->set_name("A-Trous Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_denoise_atrous.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/shadows_denoise_atrous.comp.spv");
 
         dw::vk::ComputePipeline::Desc comp_desc;
 
         comp_desc.set_pipeline_layout(m_a_trous.pipeline_layout);
         comp_desc.set_shader_stage(module, "main");
 
-        m_a_trous.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_a_trous.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc, m_common_resources->pipeline_cache->handle());
     }
 
     // Upsample
@@ -922,14 +1122,13 @@ void RayTracedShadows::create_pipelines()
         m_upsample.layout = dw::vk::PipelineLayout::create(backend, desc);
         m_upsample.layout->set_name("Shadows Upsample Pipeline Layout");
 
-        dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(backend, "shaders/shadows_upsample.comp.spv");
+        dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(backend, "shaders/shadows_upsample.comp.spv");
 
-        dw::vk::ComputePipeline::Desc comp_desc;
+        m_upsample.pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(backend, m_common_resources->pipeline_cache->handle(), module, m_upsample.layout, "Shadows Upsample"));
 
-        comp_desc.set_pipeline_layout(m_upsample.layout);
-        comp_desc.set_shader_stage(module, "main");
+        WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-        m_upsample.pipeline = dw::vk::ComputePipeline::create(backend, comp_desc);
+        m_upsample.pipeline->variant({ size.x, size.y });
     }
 }
 
@@ -937,64 +1136,40 @@ void RayTracedShadows::create_pipelines()
 
 void RayTracedShadows::clear_images(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    if (m_first_frame)
-    {
-        auto backend = cmd_buf->backend().lock();
-
-        VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-        VkClearColorValue color;
-
-        color.float32[0] = 0.0f;
-        color.float32[1] = 0.0f;
-        color.float32[2] = 0.0f;
-        color.float32[3] = 0.0f;
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.prev_image, subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-        
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.prev_image->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-        vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong], subresource_range);
+    VkClearColorValue color;
 
-        backend->flush_barriers(cmd_buf);
+    color.float32[0] = 0.0f;
+    color.float32[1] = 0.0f;
+    color.float32[2] = 0.0f;
+    color.float32[3] = 0.0f;
 
-        m_first_frame = false;
-    }
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.prev_image->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+    vkCmdClearColorImage(cmd_buf->handle(), m_temporal_accumulation.current_moments_image[!m_common_resources->ping_pong]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedShadows::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Ray Trace", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_ray_trace.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-      
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_ray_trace.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_ray_trace.pipeline->variant({ m_ray_trace.soft_shadows }));
 
     RayTracePushConstants push_constants;
 
-    push_constants.bias         = m_ray_trace.bias;
-    push_constants.num_frames   = m_common_resources->num_frames;
-    push_constants.g_buffer_mip = m_g_buffer_mip;
+    push_constants.bias               = m_ray_trace.bias;
+    push_constants.num_frames         = m_common_resources->num_frames;
+    push_constants.g_buffer_mip       = m_g_buffer_mip;
+    push_constants.blue_noise_sampler = m_common_resources->blue_noise_sampler;
 
     vkCmdPushConstants(cmd_buf->handle(), m_ray_trace.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
     const uint32_t dynamic_offset = m_common_resources->ubo_size * backend->current_frame_idx();
 
     VkDescriptorSet descriptor_sets[] = {
-        m_common_resources->current_scene()->descriptor_set()->handle(),
+        m_common_resources->texture_streamer->descriptor_set()->handle(),
         m_ray_trace.write_ds->handle(),
         m_common_resources->per_frame_ds->handle(),
         m_g_buffer->output_ds()->handle(),
@@ -1004,27 +1179,12 @@ void RayTracedShadows::ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf)
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_ray_trace.pipeline_layout->handle(), 0, 5, descriptor_sets, 1, &dynamic_offset);
 
     vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_width) / float(RAY_TRACE_NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_height) / float(RAY_TRACE_NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_ray_trace.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedShadows::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Reset Args", cmd_buf);
-
-    auto backend = m_backend.lock();
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
-
-    backend->flush_barriers(cmd_buf);
-
     vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_reset_args.pipeline->handle());
 
     VkDescriptorSet descriptor_sets[] = {
@@ -1040,22 +1200,9 @@ void RayTracedShadows::reset_args(dw::vk::CommandBuffer::Ptr cmd_buf)
 
 void RayTracedShadows::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Temporal Accumulation", cmd_buf);
-
     auto backend = m_backend.lock();
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_output_image, subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_temporal_accumulation.current_moments_image[m_common_resources->ping_pong], subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline->variant({ 1 }));
 
     TemporalAccumulationPushConstants push_constants;
 
@@ -1080,23 +1227,12 @@ void RayTracedShadows::temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf)
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal_accumulation.pipeline_layout->handle(), 0, 7, descriptor_sets, 1, &dynamic_offset);
 
     vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_width) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_height) / float(TEMPORAL_ACCUMULATION_NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_output_image, subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_moments_image[m_common_resources->ping_pong], subresource_range);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void RayTracedShadows::a_trous_filter(dw::vk::CommandBuffer::Ptr cmd_buf)
+void RayTracedShadows::a_trous_filter(RenderGraph& graph)
 {
-    DW_SCOPED_SAMPLE("A-Trous Filter", cmd_buf);
-
-    auto backend = m_backend.lock();
-
     VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
     bool    ping_pong = false;
@@ -1108,127 +1244,151 @@ void RayTracedShadows::a_trous_filter(dw::vk::CommandBuffer::Ptr cmd_buf)
         read_idx  = (int32_t)ping_pong;
         write_idx = (int32_t)!ping_pong;
 
-        backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+        graph.add_pass(
+            "A-Trous Clear " + std::to_string(i),
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+            },
+            [this, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                a_trous_clear(cmd_buf, write_idx);
+            });
+
+        graph.add_pass(
+            "A-Trous Iteration " + std::to_string(i),
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.record_on_main_thread();
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
+
+                if (i == 0)
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.current_output_image, subresource_range);
+                else
+                    builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[read_idx], subresource_range);
+
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.denoise_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, m_temporal_accumulation.shadow_tile_coords_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.denoise_dispatch_args_buffer);
+                builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, m_temporal_accumulation.shadow_dispatch_args_buffer);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this, i, read_idx, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                a_trous_iteration(cmd_buf, i, read_idx, write_idx);
+            });
 
-        backend->flush_barriers(cmd_buf);
+        ping_pong = !ping_pong;
 
-        VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        if (m_a_trous.feedback_iteration == i)
+        {
+            graph.add_pass(
+                "A-Trous Feedback",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
+                    builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
+                },
+                [this, write_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    a_trous_feedback(cmd_buf, write_idx);
+                });
+        }
+    }
 
-        VkClearColorValue color;
+    m_a_trous.read_idx = write_idx;
+}
 
-        color.float32[0] = 1.0f;
-        color.float32[1] = 1.0f;
-        color.float32[2] = 1.0f;
-        color.float32[3] = 1.0f;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        vkCmdClearColorImage(cmd_buf->handle(), m_a_trous.image[write_idx]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
-        
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[read_idx], subresource_range);
+void RayTracedShadows::a_trous_clear(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t write_idx)
+{
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        backend->flush_barriers(cmd_buf);
+    VkClearColorValue color;
 
-        {
-            DW_SCOPED_SAMPLE("Copy Shadow Tiles", cmd_buf);
+    color.float32[0] = 1.0f;
+    color.float32[1] = 1.0f;
+    color.float32[2] = 1.0f;
+    color.float32[3] = 1.0f;
 
-            vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_shadow_tiles.pipeline->handle());
+    vkCmdClearColorImage(cmd_buf->handle(), m_a_trous.image[write_idx]->handle(), VK_IMAGE_LAYOUT_GENERAL, &color, 1, &subresource_range);
+}
 
-            VkDescriptorSet descriptor_sets[] = {
-                m_a_trous.write_ds[write_idx]->handle(),
-                m_temporal_accumulation.indirect_buffer_ds->handle()
-            };
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_shadow_tiles.pipeline_layout->handle(), 0, 2, descriptor_sets, 0, nullptr);
+void RayTracedShadows::a_trous_iteration(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t i, int32_t read_idx, int32_t write_idx)
+{
+    {
+        DW_SCOPED_SAMPLE("Copy Shadow Tiles", cmd_buf);
 
-            vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.shadow_dispatch_args_buffer->handle(), 0);
-        }
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_shadow_tiles.pipeline->handle());
 
-        {
-            DW_SCOPED_SAMPLE("Iteration " + std::to_string(i), cmd_buf);
+        VkDescriptorSet descriptor_sets[] = {
+            m_a_trous.write_ds[write_idx]->handle(),
+            m_temporal_accumulation.indirect_buffer_ds->handle()
+        };
 
-            vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline->handle());
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_copy_shadow_tiles.pipeline_layout->handle(), 0, 2, descriptor_sets, 0, nullptr);
 
-            ATrousFilterPushConstants push_constants;
+        vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.shadow_dispatch_args_buffer->handle(), 0);
+    }
 
-            push_constants.radius         = m_a_trous.radius;
-            push_constants.step_size      = 1 << i;
-            push_constants.phi_visibility = m_a_trous.phi_visibility;
-            push_constants.phi_normal     = m_a_trous.phi_normal;
-            push_constants.sigma_depth    = m_a_trous.sigma_depth;
-            push_constants.g_buffer_mip   = m_g_buffer_mip;
-            push_constants.power          = i == (m_a_trous.filter_iterations - 1) ? m_a_trous.power : 0.0f;
+    {
+        DW_SCOPED_SAMPLE("Filter", cmd_buf);
 
-            vkCmdPushConstants(cmd_buf->handle(), m_a_trous.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline->handle());
 
-            VkDescriptorSet descriptor_sets[] = {
-                m_a_trous.write_ds[write_idx]->handle(),
-                i == 0 ? m_temporal_accumulation.output_only_read_ds->handle() : m_a_trous.read_ds[read_idx]->handle(),
-                m_g_buffer->output_ds()->handle(),
-                m_temporal_accumulation.indirect_buffer_ds->handle()
-            };
+        ATrousFilterPushConstants push_constants;
 
-            vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline_layout->handle(), 0, 4, descriptor_sets, 0, nullptr);
+        push_constants.radius         = m_a_trous.radius;
+        push_constants.step_size      = 1 << i;
+        push_constants.phi_visibility = m_a_trous.phi_visibility;
+        push_constants.phi_normal     = m_a_trous.phi_normal;
+        push_constants.sigma_depth    = m_a_trous.sigma_depth;
+        push_constants.g_buffer_mip   = m_g_buffer_mip;
+        push_constants.power          = i == (m_a_trous.filter_iterations - 1) ? m_a_trous.power : 0.0f;
 
-            vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
-        }
+        vkCmdPushConstants(cmd_buf->handle(), m_a_trous.pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
 
-        ping_pong = !ping_pong;
+        VkDescriptorSet descriptor_sets[] = {
+            m_a_trous.write_ds[write_idx]->handle(),
+            i == 0 ? m_temporal_accumulation.output_only_read_ds->handle() : m_a_trous.read_ds[read_idx]->handle(),
+            m_g_buffer->output_ds()->handle(),
+            m_temporal_accumulation.indirect_buffer_ds->handle()
+        };
 
-        if (m_a_trous.feedback_iteration == i)
-        {
-            backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
-            backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-
-            backend->flush_barriers(cmd_buf);
-
-            VkImageCopy image_copy_region {};
-            image_copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_copy_region.srcSubresource.layerCount = 1;
-            image_copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_copy_region.dstSubresource.layerCount = 1;
-            image_copy_region.extent.width              = m_width;
-            image_copy_region.extent.height             = m_height;
-            image_copy_region.extent.depth              = 1;
-
-            // Issue the copy command
-            vkCmdCopyImage(
-                cmd_buf->handle(),
-                m_a_trous.image[write_idx]->handle(),
-                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                m_temporal_accumulation.prev_image->handle(),
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &image_copy_region);
-
-            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_a_trous.image[write_idx], subresource_range);
-            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_temporal_accumulation.prev_image, subresource_range);
-
-            backend->flush_barriers(cmd_buf);
-        }
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_a_trous.pipeline_layout->handle(), 0, 4, descriptor_sets, 0, nullptr);
+
+        vkCmdDispatchIndirect(cmd_buf->handle(), m_temporal_accumulation.denoise_dispatch_args_buffer->handle(), 0);
     }
+}
 
-    m_a_trous.read_idx = write_idx;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_a_trous.image[write_idx], subresource_range);
-    
-    backend->flush_barriers(cmd_buf);
+void RayTracedShadows::a_trous_feedback(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t write_idx)
+{
+    VkImageCopy image_copy_region {};
+    image_copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_copy_region.srcSubresource.layerCount = 1;
+    image_copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_copy_region.dstSubresource.layerCount = 1;
+    image_copy_region.extent.width              = m_width;
+    image_copy_region.extent.height             = m_height;
+    image_copy_region.extent.depth              = 1;
+
+    // Issue the copy command
+    vkCmdCopyImage(
+        cmd_buf->handle(),
+        m_a_trous.image[write_idx]->handle(),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        m_temporal_accumulation.prev_image->handle(),
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1,
+        &image_copy_region);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void RayTracedShadows::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
 {
-    DW_SCOPED_SAMPLE("Upsample", cmd_buf);
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(UPSAMPLE_PASS);
 
-    auto backend = m_backend.lock();
-
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_upsample.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->handle());
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.pipeline->variant({ size.x, size.y }));
 
     UpsamplePushConstants push_constants;
 
@@ -1244,14 +1404,7 @@ void RayTracedShadows::upsample(dw::vk::CommandBuffer::Ptr cmd_buf)
 
     vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_upsample.layout->handle(), 0, 3, descriptor_sets, 0, nullptr);
 
-    const int NUM_THREADS_X = 32;
-    const int NUM_THREADS_Y = 32;
-
-    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(NUM_THREADS_X))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(NUM_THREADS_Y))), 1);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_upsample.image, subresource_range);
-
-    backend->flush_barriers(cmd_buf);
+    vkCmdDispatch(cmd_buf->handle(), static_cast<uint32_t>(ceil(float(m_upsample.image->width()) / float(size.x))), static_cast<uint32_t>(ceil(float(m_upsample.image->height()) / float(size.y))), 1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
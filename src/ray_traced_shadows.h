@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.h"
+#include "render_graph.h"
+#include "specialized_pipeline.h"
 
 class GBuffer;
 
@@ -23,19 +25,28 @@ public:
     RayTracedShadows(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources, GBuffer* g_buffer, RayTraceScale scale = RAY_TRACE_SCALE_FULL_RES);
     ~RayTracedShadows();
 
-    void                       render(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                       render(RenderGraph& graph);
     void                       gui();
     dw::vk::DescriptorSet::Ptr output_ds();
+    dw::vk::Image::Ptr         output_image();
+    void                       set_scale(RayTraceScale scale);
+    void                       recreate_transient_images();
 
     inline uint32_t      width() { return m_width; }
     inline uint32_t      height() { return m_height; }
     inline RayTraceScale scale() { return m_scale; }
+    inline bool          denoise() { return m_denoise; }
+    inline void          set_denoise(bool value) { m_denoise = value; }
     inline OutputType    current_output() { return m_current_output; }
     inline void          set_current_output(OutputType current_output) { m_current_output = current_output; }
 
 private:
+    void update_dimensions();
+    void retire_resources(bool transient_only);
     void create_images();
+    void create_transient_images();
     void create_buffers();
+    void create_descriptor_set_layouts();
     void create_descriptor_sets();
     void write_descriptor_sets();
     void create_pipelines();
@@ -43,19 +54,23 @@ private:
     void ray_trace(dw::vk::CommandBuffer::Ptr cmd_buf);
     void reset_args(dw::vk::CommandBuffer::Ptr cmd_buf);
     void temporal_accumulation(dw::vk::CommandBuffer::Ptr cmd_buf);
-    void a_trous_filter(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void a_trous_filter(RenderGraph& graph);
+    void a_trous_clear(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t write_idx);
+    void a_trous_iteration(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t i, int32_t read_idx, int32_t write_idx);
+    void a_trous_feedback(dw::vk::CommandBuffer::Ptr cmd_buf, int32_t write_idx);
     void upsample(dw::vk::CommandBuffer::Ptr cmd_buf);
 
 private:
     struct RayTrace
     {
-        float                        bias = 0.5f;
-        dw::vk::ComputePipeline::Ptr pipeline;
-        dw::vk::PipelineLayout::Ptr  pipeline_layout;
-        dw::vk::Image::Ptr           image;
-        dw::vk::ImageView::Ptr       view;
-        dw::vk::DescriptorSet::Ptr   write_ds;
-        dw::vk::DescriptorSet::Ptr   read_ds;
+        float                                       bias         = 0.5f;
+        bool                                        soft_shadows = true;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::PipelineLayout::Ptr                 pipeline_layout;
+        dw::vk::Image::Ptr                          image;
+        dw::vk::ImageView::Ptr                      view;
+        dw::vk::DescriptorSet::Ptr                  write_ds;
+        dw::vk::DescriptorSet::Ptr                  read_ds;
     };
 
     struct ResetArgs
@@ -66,28 +81,28 @@ private:
 
     struct TemporalAccumulation
     {
-        float                            alpha         = 0.01f;
-        float                            moments_alpha = 0.2f;
-        dw::vk::Buffer::Ptr              denoise_tile_coords_buffer;
-        dw::vk::Buffer::Ptr              denoise_dispatch_args_buffer;
-        dw::vk::Buffer::Ptr              shadow_tile_coords_buffer;
-        dw::vk::Buffer::Ptr              shadow_dispatch_args_buffer;
-        dw::vk::ComputePipeline::Ptr     pipeline;
-        dw::vk::PipelineLayout::Ptr      pipeline_layout;
-        dw::vk::DescriptorSetLayout::Ptr write_ds_layout;
-        dw::vk::DescriptorSetLayout::Ptr read_ds_layout;
-        dw::vk::DescriptorSetLayout::Ptr indirect_buffer_ds_layout;
-        dw::vk::Image::Ptr               current_output_image;
-        dw::vk::Image::Ptr               current_moments_image[2];
-        dw::vk::Image::Ptr               prev_image;
-        dw::vk::ImageView::Ptr           current_output_view;
-        dw::vk::ImageView::Ptr           current_moments_view[2];
-        dw::vk::ImageView::Ptr           prev_view;
-        dw::vk::DescriptorSet::Ptr       current_write_ds[2];
-        dw::vk::DescriptorSet::Ptr       current_read_ds[2];
-        dw::vk::DescriptorSet::Ptr       output_only_read_ds;
-        dw::vk::DescriptorSet::Ptr       prev_read_ds[2];
-        dw::vk::DescriptorSet::Ptr       indirect_buffer_ds;
+        float                                       alpha         = 0.01f;
+        float                                       moments_alpha = 0.2f;
+        dw::vk::Buffer::Ptr                         denoise_tile_coords_buffer;
+        dw::vk::Buffer::Ptr                         denoise_dispatch_args_buffer;
+        dw::vk::Buffer::Ptr                         shadow_tile_coords_buffer;
+        dw::vk::Buffer::Ptr                         shadow_dispatch_args_buffer;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::PipelineLayout::Ptr                 pipeline_layout;
+        dw::vk::DescriptorSetLayout::Ptr            write_ds_layout;
+        dw::vk::DescriptorSetLayout::Ptr            read_ds_layout;
+        dw::vk::DescriptorSetLayout::Ptr            indirect_buffer_ds_layout;
+        dw::vk::Image::Ptr                          current_output_image;
+        dw::vk::Image::Ptr                          current_moments_image[2];
+        dw::vk::Image::Ptr                          prev_image;
+        dw::vk::ImageView::Ptr                      current_output_view;
+        dw::vk::ImageView::Ptr                      current_moments_view[2];
+        dw::vk::ImageView::Ptr                      prev_view;
+        dw::vk::DescriptorSet::Ptr                  current_write_ds[2];
+        dw::vk::DescriptorSet::Ptr                  current_read_ds[2];
+        dw::vk::DescriptorSet::Ptr                  output_only_read_ds;
+        dw::vk::DescriptorSet::Ptr                  prev_read_ds[2];
+        dw::vk::DescriptorSet::Ptr                  indirect_buffer_ds;
     };
 
     struct CopyShadowTiles
@@ -116,12 +131,12 @@ private:
 
     struct Upsample
     {
-        dw::vk::PipelineLayout::Ptr  layout;
-        dw::vk::ComputePipeline::Ptr pipeline;
-        dw::vk::Image::Ptr           image;
-        dw::vk::ImageView::Ptr       image_view;
-        dw::vk::DescriptorSet::Ptr   read_ds;
-        dw::vk::DescriptorSet::Ptr   write_ds;
+        dw::vk::PipelineLayout::Ptr                 layout;
+        std::unique_ptr<SpecializedComputePipeline> pipeline;
+        dw::vk::Image::Ptr                          image;
+        dw::vk::ImageView::Ptr                      image_view;
+        dw::vk::DescriptorSet::Ptr                  read_ds;
+        dw::vk::DescriptorSet::Ptr                  write_ds;
     };
 
     std::weak_ptr<dw::vk::Backend> m_backend;
@@ -0,0 +1,1883 @@
+#include "render_graph.h"
+#include "trace_recorder.h"
+#include "utility.h"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <logger.h>
+#include <macros.h>
+#include <profiler.h>
+#include <imgui.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const uint32_t kMaxTimedPasses = 256;
+static const uint32_t kNumCalibrations = 4;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const VkAccessFlags2 kWriteAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_write(VkAccessFlags2 access)
+{
+    return (access & kWriteAccessMask) != 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_same_range(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b)
+{
+    return a.aspectMask == b.aspectMask && a.baseMipLevel == b.baseMipLevel && a.levelCount == b.levelCount && a.baseArrayLayer == b.baseArrayLayer && a.layerCount == b.layerCount;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static VkImageSubresourceRange merge_ranges(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b)
+{
+    VkImageSubresourceRange range;
+
+    range.aspectMask     = a.aspectMask | b.aspectMask;
+    range.baseMipLevel   = std::min(a.baseMipLevel, b.baseMipLevel);
+    range.levelCount     = std::max(a.baseMipLevel + a.levelCount, b.baseMipLevel + b.levelCount) - range.baseMipLevel;
+    range.baseArrayLayer = std::min(a.baseArrayLayer, b.baseArrayLayer);
+    range.layerCount     = std::max(a.baseArrayLayer + a.layerCount, b.baseArrayLayer + b.layerCount) - range.baseArrayLayer;
+
+    return range;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_overlapping(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b)
+{
+    return a.baseMipLevel < b.baseMipLevel + b.levelCount && b.baseMipLevel < a.baseMipLevel + a.levelCount && a.baseArrayLayer < b.baseArrayLayer + b.layerCount && b.baseArrayLayer < a.baseArrayLayer + a.layerCount;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// State of a single mip level and array layer of a resource while the graph is compiled. Buffers have a single one.
+struct SubresourceState
+{
+    bool                   known      = false;
+    bool                   written    = false;
+    VkPipelineStageFlags2  stage      = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2         access     = VK_ACCESS_2_NONE;
+    VkImageLayout          layout     = VK_IMAGE_LAYOUT_UNDEFINED;
+    RenderGraph::QueueType owner      = RenderGraph::QUEUE_TYPE_GRAPHICS;
+    int32_t                last_batch = -1;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct ResourceState
+{
+    std::vector<SubresourceState> subresources; // Indexed by mip level * num_layers + array layer.
+    VkImageSubresourceRange       subresource_range = {}; // Union of every range the graph declares for the resource.
+    uint32_t                      num_layers        = 1;
+    int32_t                       last_graphics     = -1;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Block of subresources in the same state, covered by a single barrier.
+struct SubresourceSpan
+{
+    VkImageSubresourceRange subresource_range;
+    SubresourceState        state;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_same_state(const SubresourceState& a, const SubresourceState& b)
+{
+    return a.known == b.known && a.written == b.written && a.stage == b.stage && a.access == b.access && a.layout == b.layout && a.owner == b.owner && a.last_batch == b.last_batch;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void for_each_subresource(ResourceState& state, const VkImageSubresourceRange& subresource_range, std::function<void(SubresourceState&)> func)
+{
+    if (subresource_range.levelCount == 0 || subresource_range.layerCount == 0)
+    {
+        func(state.subresources[0]);
+        return;
+    }
+
+    for (uint32_t mip = subresource_range.baseMipLevel; mip < subresource_range.baseMipLevel + subresource_range.levelCount; mip++)
+    {
+        for (uint32_t layer = subresource_range.baseArrayLayer; layer < subresource_range.baseArrayLayer + subresource_range.layerCount; layer++)
+            func(state.subresources[mip * state.num_layers + layer]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Splits the subresources of the range that pass the filter into the fewest blocks sharing the same state. Layers are
+// joined within a mip level first, then with the identical block of the previous mip level.
+static std::vector<SubresourceSpan> find_spans(const ResourceState& state, const VkImageSubresourceRange& subresource_range, std::function<bool(const SubresourceState&)> filter)
+{
+    std::vector<SubresourceSpan> spans;
+
+    if (subresource_range.levelCount == 0 || subresource_range.layerCount == 0)
+    {
+        if (filter(state.subresources[0]))
+            spans.push_back({ subresource_range, state.subresources[0] });
+
+        return spans;
+    }
+
+    for (uint32_t mip = subresource_range.baseMipLevel; mip < subresource_range.baseMipLevel + subresource_range.levelCount; mip++)
+    {
+        size_t first_span = spans.size();
+
+        for (uint32_t layer = subresource_range.baseArrayLayer; layer < subresource_range.baseArrayLayer + subresource_range.layerCount; layer++)
+        {
+            const SubresourceState& subresource = state.subresources[mip * state.num_layers + layer];
+
+            if (!filter(subresource))
+                continue;
+
+            if (spans.size() > first_span && spans.back().subresource_range.baseArrayLayer + spans.back().subresource_range.layerCount == layer && is_same_state(spans.back().state, subresource))
+                spans.back().subresource_range.layerCount++;
+            else
+                spans.push_back({ { subresource_range.aspectMask, mip, 1, layer, 1 }, subresource });
+        }
+
+        for (size_t i = first_span; i < spans.size();)
+        {
+            bool merged = false;
+
+            for (size_t j = 0; j < first_span && !merged; j++)
+            {
+                VkImageSubresourceRange&       previous = spans[j].subresource_range;
+                const VkImageSubresourceRange& current  = spans[i].subresource_range;
+
+                if (previous.baseMipLevel + previous.levelCount == mip && previous.baseArrayLayer == current.baseArrayLayer && previous.layerCount == current.layerCount && is_same_state(spans[j].state, spans[i].state))
+                {
+                    previous.levelCount++;
+                    merged = true;
+                }
+            }
+
+            if (merged)
+                spans.erase(spans.begin() + i);
+            else
+                i++;
+        }
+    }
+
+    return spans;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph* graph, uint32_t pass_idx) :
+    m_graph(graph), m_pass_idx(pass_idx)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, dw::vk::Image::Ptr image, VkImageSubresourceRange subresource_range)
+{
+    add_access(m_graph->find_or_add_resource(image.get(), image, nullptr, image->handle(), VK_NULL_HANDLE), stage, access, layout, subresource_range, false);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, dw::vk::Buffer::Ptr buffer)
+{
+    VkImageSubresourceRange subresource_range = {};
+
+    add_access(m_graph->find_or_add_resource(buffer.get(), nullptr, buffer, VK_NULL_HANDLE, buffer->handle()), stage, access, VK_IMAGE_LAYOUT_UNDEFINED, subresource_range, false);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, VkImage image, VkImageSubresourceRange subresource_range)
+{
+    add_access(m_graph->find_or_add_resource(image, nullptr, nullptr, image, VK_NULL_HANDLE), stage, access, layout, subresource_range, false);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkBuffer buffer)
+{
+    VkImageSubresourceRange subresource_range = {};
+
+    add_access(m_graph->find_or_add_resource(buffer, nullptr, nullptr, VK_NULL_HANDLE, buffer), stage, access, VK_IMAGE_LAYOUT_UNDEFINED, subresource_range, false);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::internal_transition(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, dw::vk::Image::Ptr image, VkImageSubresourceRange subresource_range)
+{
+    add_access(m_graph->find_or_add_resource(image.get(), image, nullptr, image->handle(), VK_NULL_HANDLE), stage, access, layout, subresource_range, true);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::set_queue(QueueType queue)
+{
+    m_graph->m_passes[m_pass_idx].requested_queue = queue;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::bind_untracked_resources()
+{
+    m_graph->m_passes[m_pass_idx].untracked = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::record_on_main_thread()
+{
+    m_graph->m_passes[m_pass_idx].main_thread = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::set_jobs(uint32_t num_jobs, std::function<void(dw::vk::CommandBuffer::Ptr, uint32_t)> job, std::function<void(dw::vk::CommandBuffer::Ptr)> finish, const std::vector<VkFormat>& color_formats, VkFormat depth_format)
+{
+    Pass& pass = m_graph->m_passes[m_pass_idx];
+
+    pass.num_jobs      = num_jobs;
+    pass.job           = job;
+    pass.finish        = finish;
+    pass.color_formats = color_formats;
+    pass.depth_format  = depth_format;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::PassBuilder::add_access(uint32_t resource, VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, VkImageSubresourceRange subresource_range, bool internal)
+{
+    Pass& pass = m_graph->m_passes[m_pass_idx];
+
+    m_graph->m_num_declared_accesses++;
+
+    // Overlapping accesses to the same resource within a pass are folded into one so that they get a single barrier.
+    // Disjoint ranges are kept apart, a pass may read one mip level of an image and write the next in another layout.
+    for (auto& existing : pass.accesses)
+    {
+        if (existing.resource != resource || existing.internal != internal)
+            continue;
+
+        if (!is_same_range(existing.subresource_range, subresource_range) && !is_overlapping(existing.subresource_range, subresource_range))
+            continue;
+
+        if (existing.layout != layout)
+        {
+            DW_LOG_ERROR("Conflicting image layouts declared within render graph pass: " + pass.name);
+            throw std::runtime_error("Conflicting image layouts declared within render graph pass: " + pass.name);
+        }
+
+        existing.stage |= stage;
+        existing.access |= access;
+        existing.subresource_range = merge_ranges(existing.subresource_range, subresource_range);
+
+        return;
+    }
+
+    Access new_access;
+
+    new_access.resource          = resource;
+    new_access.stage             = stage;
+    new_access.access            = access;
+    new_access.layout            = layout;
+    new_access.subresource_range = subresource_range;
+    new_access.internal          = internal;
+
+    pass.accesses.push_back(new_access);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+RenderGraph::RenderGraph(std::weak_ptr<dw::vk::Backend> backend, bool timeline_semaphores) :
+    m_backend(backend)
+{
+    m_thread_pool           = std::unique_ptr<ThreadPool>(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+    m_num_recording_threads = m_thread_pool->num_threads();
+
+    // Without a backend the graph can only be compiled, which is how the tests drive it.
+    if (m_backend.expired())
+        return;
+
+    create_semaphores(timeline_semaphores);
+    create_command_pools();
+    create_query_pools();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+RenderGraph::~RenderGraph()
+{
+    auto backend = m_backend.lock();
+
+    if (!backend)
+        return;
+
+    if (m_graphics_semaphore)
+        vkDestroySemaphore(backend->device(), m_graphics_semaphore, nullptr);
+
+    if (m_compute_semaphore)
+        vkDestroySemaphore(backend->device(), m_compute_semaphore, nullptr);
+
+    for (auto& queries : m_timestamp_queries)
+        vkDestroyQueryPool(backend->device(), queries.pool, nullptr);
+
+    if (m_calibration_pool)
+        vkDestroyQueryPool(backend->device(), m_calibration_pool, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::reset()
+{
+    // The next frame starts from the state the executed one left its resources in. Resources that have been destroyed
+    // since are dropped, their addresses may be reused by new ones.
+    if (m_compiled)
+    {
+        for (auto& state : m_compiled_states)
+            m_final_states[state.first] = std::move(state.second);
+    }
+
+    m_compiled_states.clear();
+
+    for (auto it = m_final_states.begin(); it != m_final_states.end();)
+    {
+        if (it->second.wrapped && it->second.image.expired() && it->second.buffer.expired())
+            it = m_final_states.erase(it);
+        else
+            it++;
+    }
+
+    m_resources.clear();
+    m_resource_map.clear();
+    m_alias_groups.clear();
+    m_passes.clear();
+    m_barriers.clear();
+    m_batches.clear();
+    m_return_acquires.clear();
+    m_current_group.clear();
+
+    m_compiled              = false;
+    m_async_active          = false;
+    m_parallel_active       = m_parallel_recording;
+    m_num_declared_accesses = 0;
+    m_num_barrier_batches   = 0;
+    m_num_alias_barriers    = 0;
+    m_num_submissions       = 0;
+    m_num_transfers         = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::begin_group(const std::string& name)
+{
+    m_current_group = name;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::end_group()
+{
+    m_current_group.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::add_pass(const std::string& name, SetupFunc setup, ExecuteFunc execute)
+{
+    Pass pass;
+
+    pass.name    = name;
+    pass.group   = m_current_group;
+    pass.execute = execute;
+
+    m_passes.push_back(pass);
+
+    PassBuilder builder(this, (uint32_t)m_passes.size() - 1);
+
+    if (setup)
+        setup(builder);
+
+    m_compiled = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::compile()
+{
+    std::vector<ResourceState> states(m_resources.size());
+
+    // Every mip level and array layer the graph touches is tracked on its own, so that ranges of a resource can be
+    // left in different states, e.g. mip levels written one at a time.
+    for (const auto& pass : m_passes)
+    {
+        for (const auto& access : pass.accesses)
+        {
+            ResourceState& state = states[access.resource];
+
+            if (access.subresource_range.levelCount == 0 || access.subresource_range.layerCount == 0)
+                continue;
+
+            if (state.subresource_range.levelCount == 0)
+                state.subresource_range = access.subresource_range;
+            else
+                state.subresource_range = merge_ranges(state.subresource_range, access.subresource_range);
+        }
+    }
+
+    for (uint32_t i = 0; i < states.size(); i++)
+    {
+        ResourceState&            state       = states[i];
+        const FinalResourceState* final_state = find_final_state(m_resources[i]);
+
+        uint32_t num_levels = std::max(1u, state.subresource_range.baseMipLevel + state.subresource_range.levelCount);
+
+        state.num_layers = std::max(1u, state.subresource_range.baseArrayLayer + state.subresource_range.layerCount);
+
+        if (!final_state)
+        {
+            state.subresources.resize(num_levels * state.num_layers);
+            continue;
+        }
+
+        // Subresources the previous frame used but this one doesn't are kept, so that they are not forgotten.
+        num_levels       = std::max(num_levels, final_state->num_levels);
+        state.num_layers = std::max(state.num_layers, final_state->num_layers);
+        state.subresources.resize(num_levels * state.num_layers);
+
+        for (uint32_t mip = 0; mip < final_state->num_levels; mip++)
+        {
+            for (uint32_t layer = 0; layer < final_state->num_layers; layer++)
+            {
+                const FinalState& previous    = final_state->subresources[mip * final_state->num_layers + layer];
+                SubresourceState& subresource = state.subresources[mip * state.num_layers + layer];
+
+                subresource.known   = previous.known;
+                subresource.written = previous.written;
+                subresource.stage   = previous.stage;
+                subresource.access  = previous.access;
+                subresource.layout  = previous.layout;
+            }
+        }
+    }
+
+    m_barriers.clear();
+    m_batches.clear();
+    m_return_acquires.clear();
+    m_num_barrier_batches = 0;
+    m_num_alias_barriers  = 0;
+    m_num_transfers       = 0;
+    m_async_active        = false;
+
+    for (auto& alias : m_alias_states)
+    {
+        alias.second.pass  = -1;
+        alias.second.batch = -1;
+    }
+
+    bool shared_family = m_graphics_queue_family == m_compute_queue_family;
+
+    for (auto& pass : m_passes)
+    {
+        bool async = m_async_compute && m_async_compute_available && (shared_family || !pass.untracked);
+
+        pass.queue      = async ? pass.requested_queue : QUEUE_TYPE_GRAPHICS;
+        pass.wait_batch = -1;
+        pass.acquires.clear();
+
+        if (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE)
+            m_async_active = true;
+    }
+
+    for (uint32_t pass_idx = 0; pass_idx < m_passes.size(); pass_idx++)
+    {
+        Pass& pass = m_passes[pass_idx];
+
+        pass.first_barrier = (uint32_t)m_barriers.size();
+        pass.alias_barriers.clear();
+
+        int32_t batch_idx = -1;
+
+        if (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE)
+        {
+            // The pass can start as soon as the last graphics pass that touched any of its resources has been submitted,
+            // it only joins the current batch if that doesn't hold back the passes already in it.
+            int32_t dependency = -1;
+
+            for (const auto& access : pass.accesses)
+            {
+                if (access.internal)
+                {
+                    DW_LOG_ERROR("Internal transitions are not supported on the async compute queue: " + pass.name);
+                    throw std::runtime_error("Internal transitions are not supported on the async compute queue: " + pass.name);
+                }
+
+                dependency = std::max(dependency, states[access.resource].last_graphics);
+
+                auto group = m_alias_groups.find(m_resources[access.resource].key);
+
+                // Memory last used by another resource on the graphics queue is only free once that pass has been submitted.
+                if (group != m_alias_groups.end())
+                {
+                    const AliasState& alias = m_alias_states[group->second];
+
+                    if (alias.owner != m_resources[access.resource].key && alias.queue == QUEUE_TYPE_GRAPHICS)
+                        dependency = std::max(dependency, alias.pass);
+                }
+            }
+
+            if (m_batches.size() == 0 || m_batches.back().closed || dependency > m_batches.back().dependency)
+            {
+                m_batches.push_back(Batch());
+                m_batches.back().dependency = dependency;
+            }
+
+            batch_idx = (int32_t)m_batches.size() - 1;
+            m_batches[batch_idx].passes.push_back(pass_idx);
+        }
+
+        for (const auto& access : pass.accesses)
+        {
+            Resource& resource = m_resources[access.resource];
+
+            resource.first_pass = std::min(resource.first_pass, pass_idx);
+            resource.last_pass  = pass_idx;
+
+            if (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE)
+                resource.async = true;
+
+            auto group = m_alias_groups.find(resource.key);
+
+            if (group == m_alias_groups.end())
+                continue;
+
+            AliasState& alias = m_alias_states[group->second];
+
+            resource.aliased = true;
+
+            // Another resource used the memory last, so its accesses have to complete before this one
+            // starts overwriting it. Whatever this resource held before is gone, so its first access transitions
+            // from UNDEFINED and doesn't need an ownership transfer.
+            if (alias.owner != resource.key)
+            {
+                for (auto& subresource : states[access.resource].subresources)
+                {
+                    subresource       = SubresourceState();
+                    subresource.owner = pass.queue;
+                }
+
+                if (alias.owner && alias.queue == pass.queue)
+                {
+                    VkMemoryBarrier2KHR barrier = {};
+
+                    barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+                    barrier.srcStageMask  = alias.stage;
+                    barrier.srcAccessMask = alias.access;
+                    barrier.dstStageMask  = access.stage;
+                    barrier.dstAccessMask = access.access;
+
+                    pass.alias_barriers.push_back(barrier);
+                    m_num_alias_barriers++;
+                }
+                else if (alias.owner && alias.queue == QUEUE_TYPE_ASYNC_COMPUTE && alias.pass != -1)
+                {
+                    // A barrier can't wait for work on another queue, so the memory is handed over through the semaphores
+                    // instead. Async passes taking it from the graphics queue depend on the pass that used it, see above.
+                    // Across frames the graphics queue waits for every batch before the frame ends, which covers both
+                    // directions. Since the contents are discarded no ownership transfer is needed.
+                    pass.wait_batch = std::max(pass.wait_batch, alias.batch);
+                }
+
+                alias.owner  = resource.key;
+                alias.queue  = pass.queue;
+                alias.stage  = VK_PIPELINE_STAGE_2_NONE;
+                alias.access = VK_ACCESS_2_NONE;
+            }
+
+            alias.stage |= access.stage;
+            alias.access |= access.access;
+            alias.pass  = (int32_t)pass_idx;
+            alias.batch = batch_idx;
+        }
+
+        for (const auto& access : pass.accesses)
+        {
+            if (access.internal)
+                continue;
+
+            ResourceState&  state    = states[access.resource];
+            const Resource& resource = m_resources[access.resource];
+
+            bool write = is_write(access.access);
+
+            // Reads following a read in the same layout are already covered if the previous barrier made
+            // the data visible to this stage, otherwise a barrier is required.
+            auto needs_barrier = [&](const SubresourceState& subresource) {
+                if (subresource.owner != pass.queue || !subresource.known || subresource.written || write || subresource.layout != access.layout)
+                    return true;
+
+                return (access.stage & ~subresource.stage) != 0 || (access.access & ~subresource.access) != 0;
+            };
+
+            // Parts of the range left in different states by earlier passes get a barrier each.
+            for (const auto& span : find_spans(state, access.subresource_range, needs_barrier))
+            {
+                const SubresourceState& previous = span.state;
+
+                bool transfer = previous.owner != pass.queue;
+
+                Barrier barrier;
+
+                barrier.resource          = access.resource;
+                barrier.src_stage         = previous.stage;
+                barrier.src_access        = previous.known ? previous.access : VK_ACCESS_2_NONE;
+                barrier.dst_stage         = access.stage;
+                barrier.dst_access        = access.access;
+                barrier.old_layout        = previous.known ? previous.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                barrier.new_layout        = access.layout;
+                barrier.subresource_range = span.subresource_range;
+                barrier.hoisted           = false;
+                barrier.initial           = !previous.known && !resource.aliased && (resource.image || resource.buffer);
+
+                // Widen a read barrier to cover every subsequent reader of the same data on the same queue so that
+                // they don't each need a barrier of their own.
+                if (!write)
+                {
+                    bool done = false;
+
+                    for (uint32_t next_idx = pass_idx + 1; next_idx < m_passes.size() && !done; next_idx++)
+                    {
+                        for (const auto& next_access : m_passes[next_idx].accesses)
+                        {
+                            if (next_access.resource != access.resource)
+                                continue;
+
+                            if (next_access.internal || is_write(next_access.access) || next_access.layout != access.layout || !is_same_range(next_access.subresource_range, access.subresource_range) || m_passes[next_idx].queue != pass.queue)
+                                done = true;
+                            else
+                            {
+                                barrier.dst_stage |= next_access.stage;
+                                barrier.dst_access |= next_access.access;
+                            }
+                        }
+                    }
+                }
+
+                if (transfer)
+                {
+                    Transfer ownership_transfer;
+
+                    ownership_transfer.resource          = access.resource;
+                    ownership_transfer.subresource_range = span.subresource_range;
+
+                    if (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE)
+                    {
+                        // The compute queue may not support the stages the resource was last used in, so the barrier
+                        // into the compute state is recorded on the graphics queue right before the release.
+                        ownership_transfer.layout         = access.layout;
+                        ownership_transfer.release_stage  = barrier.dst_stage;
+                        ownership_transfer.release_access = barrier.dst_access;
+                        ownership_transfer.acquire_stage  = barrier.dst_stage;
+                        ownership_transfer.acquire_access = barrier.dst_access;
+
+                        barrier.hoisted = true;
+
+                        m_batches[batch_idx].hoisted_barriers.push_back((uint32_t)m_barriers.size());
+                        m_batches[batch_idx].graphics_releases.push_back(ownership_transfer);
+                        m_batches[batch_idx].acquires.push_back(ownership_transfer);
+                    }
+                    else
+                    {
+                        // The acquire also covers the stages of the regular barrier that follows it, so the two chain.
+                        ownership_transfer.layout         = previous.layout;
+                        ownership_transfer.release_stage  = previous.stage;
+                        ownership_transfer.release_access = previous.access;
+                        ownership_transfer.acquire_stage  = previous.stage | barrier.dst_stage;
+                        ownership_transfer.acquire_access = previous.access | barrier.dst_access;
+
+                        m_batches[previous.last_batch].releases.push_back(ownership_transfer);
+                        pass.acquires.push_back(ownership_transfer);
+
+                        pass.wait_batch = std::max(pass.wait_batch, previous.last_batch);
+                    }
+
+                    m_num_transfers++;
+                }
+
+                m_barriers.push_back(barrier);
+
+                for_each_subresource(state, span.subresource_range, [&](SubresourceState& subresource) {
+                    subresource.known   = true;
+                    subresource.written = write;
+                    subresource.stage   = barrier.dst_stage;
+                    subresource.access  = barrier.dst_access;
+                    subresource.layout  = access.layout;
+                });
+            }
+        }
+
+        // Resources transitioned by the pass itself end up in a state the graph did not issue, so the next
+        // access always gets a barrier.
+        for (const auto& access : pass.accesses)
+        {
+            if (!access.internal)
+                continue;
+
+            for_each_subresource(states[access.resource], access.subresource_range, [&](SubresourceState& subresource) {
+                if (subresource.owner != pass.queue)
+                {
+                    DW_LOG_ERROR("Internal transitions of resources used on the async compute queue are not supported: " + pass.name);
+                    throw std::runtime_error("Internal transitions of resources used on the async compute queue are not supported: " + pass.name);
+                }
+
+                subresource.known   = true;
+                subresource.written = true;
+                subresource.stage   = access.stage;
+                subresource.access  = access.access;
+                subresource.layout  = access.layout;
+            });
+        }
+
+        for (const auto& access : pass.accesses)
+        {
+            ResourceState& state = states[access.resource];
+
+            for_each_subresource(state, access.subresource_range, [&](SubresourceState& subresource) {
+                subresource.owner = pass.queue;
+
+                if (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE)
+                    subresource.last_batch = batch_idx;
+            });
+
+            if (pass.queue == QUEUE_TYPE_GRAPHICS)
+                state.last_graphics = (int32_t)pass_idx;
+        }
+
+        // Passes recorded after the wait can't be moved in front of it.
+        if (pass.wait_batch != -1)
+            m_batches[pass.wait_batch].closed = true;
+
+        pass.num_barriers = (uint32_t)m_barriers.size() - pass.first_barrier;
+
+        if (pass.num_barriers > 0 || pass.alias_barriers.size() > 0)
+            m_num_barrier_batches++;
+    }
+
+    // Everything is handed back to the graphics queue at the end of the frame, so the next frame always starts
+    // with the graphics queue owning every resource.
+    for (uint32_t i = 0; i < states.size(); i++)
+    {
+        auto owned_by_compute = [](const SubresourceState& subresource) {
+            return subresource.owner == QUEUE_TYPE_ASYNC_COMPUTE;
+        };
+
+        for (const auto& span : find_spans(states[i], states[i].subresource_range, owned_by_compute))
+        {
+            Transfer ownership_transfer;
+
+            ownership_transfer.resource          = i;
+            ownership_transfer.layout            = span.state.layout;
+            ownership_transfer.subresource_range = span.subresource_range;
+            ownership_transfer.release_stage     = span.state.stage;
+            ownership_transfer.release_access    = span.state.access;
+            ownership_transfer.acquire_stage     = span.state.stage;
+            ownership_transfer.acquire_access    = span.state.access;
+
+            m_batches[span.state.last_batch].releases.push_back(ownership_transfer);
+            m_return_acquires.push_back(ownership_transfer);
+
+            m_num_transfers++;
+        }
+    }
+
+    m_compiled_states.clear();
+
+    for (uint32_t i = 0; i < states.size(); i++)
+    {
+        const Resource&      resource    = m_resources[i];
+        FinalResourceState&  final_state = m_compiled_states[resource.key];
+        const ResourceState& state       = states[i];
+
+        final_state.image      = resource.image;
+        final_state.buffer     = resource.buffer;
+        final_state.wrapped    = resource.image || resource.buffer;
+        final_state.num_levels = (uint32_t)state.subresources.size() / state.num_layers;
+        final_state.num_layers = state.num_layers;
+        final_state.subresources.resize(state.subresources.size());
+
+        for (uint32_t j = 0; j < state.subresources.size(); j++)
+        {
+            const SubresourceState& subresource = state.subresources[j];
+
+            final_state.subresources[j].known   = subresource.known;
+            final_state.subresources[j].written = subresource.written;
+            final_state.subresources[j].stage   = subresource.stage;
+            final_state.subresources[j].access  = subresource.access;
+            final_state.subresources[j].layout  = subresource.layout;
+        }
+    }
+
+    m_compiled = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::CommandBuffer::Ptr RenderGraph::execute(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    if (!m_compiled)
+        compile();
+
+    auto   start       = std::chrono::high_resolution_clock::now();
+    double trace_start = TraceRecorder::now();
+
+    m_cpu_time_groups.clear();
+    m_cpu_times.clear();
+
+    for (const auto& pass : m_passes)
+    {
+        const std::string& group = pass.group.empty() ? pass.name : pass.group;
+
+        if (m_cpu_times.find(group) == m_cpu_times.end())
+        {
+            m_cpu_time_groups.push_back(group);
+            m_cpu_times[group] = 0.0;
+        }
+    }
+
+    if (m_trace_recorder && m_trace_recorder->capturing() && m_trace_recorder->capture_id() != m_trace_capture_id)
+        calibrate_timestamps();
+
+    read_timestamps();
+    reset_timestamps(cmd_buf);
+
+    if (m_parallel_active)
+        record_secondaries();
+    else
+        m_num_secondaries = 0;
+
+    std::vector<uint32_t> passes;
+
+    if (!m_async_active)
+    {
+        for (uint32_t pass_idx = 0; pass_idx < m_passes.size(); pass_idx++)
+            passes.push_back(pass_idx);
+
+        execute_passes(cmd_buf, passes, "");
+
+        m_recording_wall_time = elapsed_milliseconds(start);
+        add_trace_event(0, "Render Graph", trace_start);
+
+        return cmd_buf;
+    }
+
+    auto backend = m_backend.lock();
+
+    uint32_t next_batch   = 0;
+    uint64_t waited_value = m_compute_value;
+    bool     dirty        = true;
+
+    // Graphics passes are collected until the command buffer has to be submitted, one past the last pass is visited
+    // so that batches depending on the final graphics passes get submitted as well.
+    for (uint32_t pass_idx = 0; pass_idx <= m_passes.size(); pass_idx++)
+    {
+        while (next_batch < m_batches.size() && m_batches[next_batch].dependency < (int32_t)pass_idx)
+        {
+            Batch& batch = m_batches[next_batch++];
+
+            if (dirty || batch.hoisted_barriers.size() > 0)
+            {
+                execute_passes(cmd_buf, passes, "");
+                passes.clear();
+
+                RecordedBarriers barriers;
+
+                for (uint32_t barrier_idx : batch.hoisted_barriers)
+                    add_barrier(m_barriers[barrier_idx], barriers);
+
+                flush_barriers(cmd_buf, barriers);
+
+                transfer_ownership(cmd_buf, batch.graphics_releases, true, QUEUE_TYPE_GRAPHICS);
+
+                vkEndCommandBuffer(cmd_buf->handle());
+
+                submit(backend->graphics_queue(), cmd_buf, VK_NULL_HANDLE, 0, m_graphics_semaphore, ++m_graphics_value);
+
+                cmd_buf = begin_command_buffer(QUEUE_TYPE_GRAPHICS);
+                dirty   = false;
+            }
+
+            dw::vk::CommandBuffer::Ptr compute_cmd_buf = begin_command_buffer(QUEUE_TYPE_ASYNC_COMPUTE);
+
+            transfer_ownership(compute_cmd_buf, batch.acquires, false, QUEUE_TYPE_GRAPHICS);
+            execute_passes(compute_cmd_buf, batch.passes, "Async ");
+            transfer_ownership(compute_cmd_buf, batch.releases, true, QUEUE_TYPE_ASYNC_COMPUTE);
+
+            vkEndCommandBuffer(compute_cmd_buf->handle());
+
+            submit(backend->compute_queue(), compute_cmd_buf, m_graphics_semaphore, m_graphics_value, m_compute_semaphore, ++m_compute_value);
+
+            batch.value = m_compute_value;
+        }
+
+        if (pass_idx == m_passes.size())
+            break;
+
+        const Pass& pass = m_passes[pass_idx];
+
+        if (pass.queue != QUEUE_TYPE_GRAPHICS)
+            continue;
+
+        // Everything recorded so far is independent of the batch, so it is submitted ahead of the wait to overlap with it.
+        // The wait applies to every later submission on the queue, including the one presenting the frame.
+        if (pass.wait_batch != -1 && m_batches[pass.wait_batch].value > waited_value)
+        {
+            if (dirty)
+            {
+                execute_passes(cmd_buf, passes, "");
+                passes.clear();
+
+                vkEndCommandBuffer(cmd_buf->handle());
+
+                submit(backend->graphics_queue(), cmd_buf, VK_NULL_HANDLE, 0, m_graphics_semaphore, ++m_graphics_value);
+
+                cmd_buf = begin_command_buffer(QUEUE_TYPE_GRAPHICS);
+                dirty   = false;
+            }
+
+            waited_value = m_batches[pass.wait_batch].value;
+
+            submit(backend->graphics_queue(), nullptr, m_compute_semaphore, waited_value, VK_NULL_HANDLE, 0);
+        }
+
+        passes.push_back(pass_idx);
+        dirty = true;
+    }
+
+    // The frame fence is only signaled by the graphics queue, so it has to wait for all of the compute work too.
+    if (m_compute_value > waited_value)
+        submit(backend->graphics_queue(), nullptr, m_compute_semaphore, m_compute_value, VK_NULL_HANDLE, 0);
+
+    execute_passes(cmd_buf, passes, "");
+
+    transfer_ownership(cmd_buf, m_return_acquires, false, QUEUE_TYPE_ASYNC_COMPUTE);
+
+    m_recording_wall_time = elapsed_milliseconds(start);
+    add_trace_event(0, "Render Graph", trace_start);
+
+    return cmd_buf;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::gui()
+{
+    ImGui::Text("Passes: %i", num_passes());
+    ImGui::Text("Declared Accesses: %i", m_num_declared_accesses);
+    ImGui::Text("Barriers: %i", (uint32_t)m_barriers.size());
+    ImGui::Text("Barrier Batches: %i", m_num_barrier_batches);
+    ImGui::Text("Alias Barriers: %i", m_num_alias_barriers);
+
+    if (m_async_compute_available)
+        ImGui::Checkbox("Async Compute", &m_async_compute);
+    else
+        ImGui::Text("Async Compute: Unavailable");
+
+    ImGui::Text("Async Batches: %i", (uint32_t)m_batches.size());
+    ImGui::Text("Queue Submissions: %i", m_num_submissions);
+    ImGui::Text("Ownership Transfers: %i", m_num_transfers);
+
+    int32_t num_threads = (int32_t)m_num_recording_threads;
+
+    ImGui::Checkbox("Parallel Recording", &m_parallel_recording);
+
+    if (ImGui::SliderInt("Recording Threads", &num_threads, 1, (int32_t)m_thread_pool->num_threads()))
+        set_num_recording_threads((uint32_t)num_threads);
+
+    double total_cpu_time = 0.0;
+
+    for (const auto& group : m_cpu_time_groups)
+        total_cpu_time += m_cpu_times[group];
+
+    ImGui::Text("Secondary Command Buffers: %i", m_num_secondaries);
+    ImGui::Text("Recording Wall Time: %.3f ms", m_recording_wall_time);
+    ImGui::Text("Recording CPU Time: %.3f ms", total_cpu_time);
+
+    if (ImGui::TreeNode("Recording CPU Time Per Group"))
+    {
+        for (const auto& group : m_cpu_time_groups)
+            ImGui::Text("%s: %.3f ms", group.c_str(), m_cpu_times[group]);
+
+        ImGui::TreePop();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::set_alias_group(const void* key, uint32_t group)
+{
+    m_alias_groups[key] = group;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool RenderGraph::lifetime(const void* key, uint32_t& first_pass, uint32_t& last_pass)
+{
+    auto it = m_resource_map.find(key);
+
+    if (!m_compiled || it == m_resource_map.end())
+        return false;
+
+    const Resource& resource = m_resources[it->second];
+
+    // Async compute passes overlap with graphics passes recorded around them, so their resources are treated
+    // as alive for the whole frame.
+    first_pass = resource.async ? 0 : resource.first_pass;
+    last_pass  = resource.async ? num_passes() - 1 : resource.last_pass;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::pass_acquires(uint32_t pass_idx, RecordedBarriers& barriers)
+{
+    add_transfers(m_passes[pass_idx].acquires, false, QUEUE_TYPE_ASYNC_COMPUTE, barriers);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::batch_transfers(uint32_t batch_idx, RecordedBarriers& graphics_releases, RecordedBarriers& acquires, RecordedBarriers& releases)
+{
+    const Batch& batch = m_batches[batch_idx];
+
+    add_transfers(batch.graphics_releases, true, QUEUE_TYPE_GRAPHICS, graphics_releases);
+    add_transfers(batch.acquires, false, QUEUE_TYPE_GRAPHICS, acquires);
+    add_transfers(batch.releases, true, QUEUE_TYPE_ASYNC_COMPUTE, releases);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::simulate_async_compute(uint32_t graphics_queue_family, uint32_t compute_queue_family)
+{
+    m_graphics_queue_family   = graphics_queue_family;
+    m_compute_queue_family    = compute_queue_family;
+    m_async_compute_available = true;
+    m_async_compute           = true;
+    m_compiled                = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::pass_barriers(uint32_t pass_idx, RecordedBarriers& barriers)
+{
+    const Pass& pass = m_passes[pass_idx];
+
+    for (uint32_t i = pass.first_barrier; i < pass.first_barrier + pass.num_barriers; i++)
+    {
+        if (!m_barriers[i].hoisted)
+            add_barrier(m_barriers[i], barriers);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t RenderGraph::find_or_add_resource(const void* key, dw::vk::Image::Ptr image, dw::vk::Buffer::Ptr buffer, VkImage image_handle, VkBuffer buffer_handle)
+{
+    auto it = m_resource_map.find(key);
+
+    if (it != m_resource_map.end())
+        return it->second;
+
+    Resource resource;
+
+    resource.key           = key;
+    resource.image         = image;
+    resource.buffer        = buffer;
+    resource.image_handle  = image_handle;
+    resource.buffer_handle = buffer_handle;
+
+    uint32_t idx = (uint32_t)m_resources.size();
+
+    m_resources.push_back(resource);
+    m_resource_map[key] = idx;
+
+    return idx;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const RenderGraph::FinalResourceState* RenderGraph::find_final_state(const Resource& resource)
+{
+    auto it = m_final_states.find(resource.key);
+
+    if (it == m_final_states.end())
+        return nullptr;
+
+    // The resource the state belongs to may have been destroyed and replaced by another one at the same address.
+    if (it->second.image.lock() != resource.image || it->second.buffer.lock() != resource.buffer)
+    {
+        m_final_states.erase(it);
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::execute_pass(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t pass_idx)
+{
+    const Pass& pass = m_passes[pass_idx];
+
+    transfer_ownership(cmd_buf, pass.acquires, false, QUEUE_TYPE_ASYNC_COMPUTE);
+
+    if (pass.alias_barriers.size() > 0)
+    {
+        VkDependencyInfoKHR dependency_info = {};
+
+        dependency_info.sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependency_info.memoryBarrierCount = (uint32_t)pass.alias_barriers.size();
+        dependency_info.pMemoryBarriers    = pass.alias_barriers.data();
+
+        vkCmdPipelineBarrier2KHR(cmd_buf->handle(), &dependency_info);
+    }
+
+    if (pass.num_barriers > 0)
+    {
+        RecordedBarriers barriers;
+
+        pass_barriers(pass_idx, barriers);
+        flush_barriers(cmd_buf, barriers);
+    }
+
+    DW_SCOPED_SAMPLE(pass.name, cmd_buf);
+
+    write_timestamp(cmd_buf, pass, false);
+
+    if (pass.secondary)
+    {
+        VkCommandBuffer secondary = pass.secondary->handle();
+        vkCmdExecuteCommands(cmd_buf->handle(), 1, &secondary);
+
+        write_timestamp(cmd_buf, pass, true);
+        return;
+    }
+
+    auto   start       = std::chrono::high_resolution_clock::now();
+    double trace_start = TraceRecorder::now();
+
+    if (pass.execute)
+        pass.execute(cmd_buf);
+
+    if (pass.num_jobs > 0)
+    {
+        if (pass.job_secondaries.size() > 0)
+        {
+            std::vector<VkCommandBuffer> secondaries;
+
+            for (const auto& secondary : pass.job_secondaries)
+                secondaries.push_back(secondary->handle());
+
+            vkCmdExecuteCommands(cmd_buf->handle(), (uint32_t)secondaries.size(), secondaries.data());
+        }
+        else
+        {
+            for (uint32_t job_idx = 0; job_idx < pass.num_jobs; job_idx++)
+                pass.job(cmd_buf, job_idx);
+        }
+
+        pass.finish(cmd_buf);
+    }
+
+    write_timestamp(cmd_buf, pass, true);
+
+    add_cpu_time(pass.group.empty() ? pass.name : pass.group, elapsed_milliseconds(start));
+    add_trace_event(0, pass.name, trace_start);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::execute_passes(dw::vk::CommandBuffer::Ptr cmd_buf, const std::vector<uint32_t>& passes, const std::string& prefix)
+{
+    uint32_t i = 0;
+
+    while (i < passes.size())
+    {
+        const std::string& group = m_passes[passes[i]].group;
+
+        uint32_t group_end = i;
+
+        while (group_end < passes.size() && m_passes[passes[group_end]].group == group)
+            group_end++;
+
+        if (group.empty())
+        {
+            for (; i < group_end; i++)
+                execute_pass(cmd_buf, passes[i]);
+        }
+        else
+        {
+            DW_SCOPED_SAMPLE(prefix + group, cmd_buf);
+
+            double trace_start = TraceRecorder::now();
+
+            for (; i < group_end; i++)
+                execute_pass(cmd_buf, passes[i]);
+
+            add_trace_event(0, prefix + group, trace_start);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::add_barrier(const Barrier& barrier, RecordedBarriers& barriers)
+{
+    const Resource& resource = m_resources[barrier.resource];
+
+    // Only the backend knows the state a resource was created or uploaded in, so the first use of one the graph has no
+    // state for goes through it. From then on the graph transitions the resource itself, starting from the state it was
+    // left in, which also holds for aliased images starting from UNDEFINED whenever they take over the memory.
+    if (barrier.initial)
+    {
+        if (resource.image)
+            m_backend.lock()->use_resource(barrier.dst_stage, barrier.dst_access, barrier.new_layout, resource.image, barrier.subresource_range);
+        else
+            m_backend.lock()->use_resource(barrier.dst_stage, barrier.dst_access, resource.buffer);
+
+        barriers.backend = true;
+    }
+    else if (resource.image_handle)
+    {
+        VkImageMemoryBarrier2KHR image_barrier = {};
+
+        image_barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        image_barrier.srcStageMask        = barrier.src_stage;
+        image_barrier.srcAccessMask       = barrier.src_access;
+        image_barrier.dstStageMask        = barrier.dst_stage;
+        image_barrier.dstAccessMask       = barrier.dst_access;
+        image_barrier.oldLayout           = barrier.old_layout;
+        image_barrier.newLayout           = barrier.new_layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image               = resource.image_handle;
+        image_barrier.subresourceRange    = barrier.subresource_range;
+
+        barriers.images.push_back(image_barrier);
+    }
+    else if (resource.buffer_handle)
+    {
+        VkBufferMemoryBarrier2KHR buffer_barrier = {};
+
+        buffer_barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+        buffer_barrier.srcStageMask        = barrier.src_stage;
+        buffer_barrier.srcAccessMask       = barrier.src_access;
+        buffer_barrier.dstStageMask        = barrier.dst_stage;
+        buffer_barrier.dstAccessMask       = barrier.dst_access;
+        buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.buffer              = resource.buffer_handle;
+        buffer_barrier.offset              = 0;
+        buffer_barrier.size                = VK_WHOLE_SIZE;
+
+        barriers.buffers.push_back(buffer_barrier);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::flush_barriers(dw::vk::CommandBuffer::Ptr cmd_buf, const RecordedBarriers& barriers)
+{
+    if (barriers.backend)
+        m_backend.lock()->flush_barriers(cmd_buf);
+
+    if (barriers.images.size() == 0 && barriers.buffers.size() == 0)
+        return;
+
+    VkDependencyInfoKHR dependency_info = {};
+
+    dependency_info.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency_info.imageMemoryBarrierCount  = (uint32_t)barriers.images.size();
+    dependency_info.pImageMemoryBarriers     = barriers.images.data();
+    dependency_info.bufferMemoryBarrierCount = (uint32_t)barriers.buffers.size();
+    dependency_info.pBufferMemoryBarriers    = barriers.buffers.data();
+
+    vkCmdPipelineBarrier2KHR(cmd_buf->handle(), &dependency_info);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::add_transfers(const std::vector<Transfer>& transfers, bool release, QueueType src_queue, RecordedBarriers& barriers)
+{
+    // Queues of the same family share ownership, the semaphores alone are enough.
+    if (m_graphics_queue_family == m_compute_queue_family)
+        return;
+
+    uint32_t src_family = src_queue == QUEUE_TYPE_GRAPHICS ? m_graphics_queue_family : m_compute_queue_family;
+    uint32_t dst_family = src_queue == QUEUE_TYPE_GRAPHICS ? m_compute_queue_family : m_graphics_queue_family;
+
+    for (const auto& transfer : transfers)
+    {
+        const Resource& resource = m_resources[transfer.resource];
+
+        VkPipelineStageFlags2 src_stage  = release ? transfer.release_stage : VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2        src_access = release ? transfer.release_access : VK_ACCESS_2_NONE;
+        VkPipelineStageFlags2 dst_stage  = release ? VK_PIPELINE_STAGE_2_NONE : transfer.acquire_stage;
+        VkAccessFlags2        dst_access = release ? VK_ACCESS_2_NONE : transfer.acquire_access;
+
+        if (resource.image_handle)
+        {
+            VkImageMemoryBarrier2KHR barrier = {};
+
+            barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+            barrier.srcStageMask        = src_stage;
+            barrier.srcAccessMask       = src_access;
+            barrier.dstStageMask        = dst_stage;
+            barrier.dstAccessMask       = dst_access;
+            barrier.oldLayout           = transfer.layout;
+            barrier.newLayout           = transfer.layout;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.image               = resource.image_handle;
+            barrier.subresourceRange    = transfer.subresource_range;
+
+            barriers.images.push_back(barrier);
+        }
+        else if (resource.buffer_handle)
+        {
+            VkBufferMemoryBarrier2KHR barrier = {};
+
+            barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+            barrier.srcStageMask        = src_stage;
+            barrier.srcAccessMask       = src_access;
+            barrier.dstStageMask        = dst_stage;
+            barrier.dstAccessMask       = dst_access;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.buffer              = resource.buffer_handle;
+            barrier.offset              = 0;
+            barrier.size                = VK_WHOLE_SIZE;
+
+            barriers.buffers.push_back(barrier);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::transfer_ownership(dw::vk::CommandBuffer::Ptr cmd_buf, const std::vector<Transfer>& transfers, bool release, QueueType src_queue)
+{
+    RecordedBarriers barriers;
+
+    add_transfers(transfers, release, src_queue, barriers);
+    flush_barriers(cmd_buf, barriers);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::submit(VkQueue queue, dw::vk::CommandBuffer::Ptr cmd_buf, VkSemaphore wait_semaphore, uint64_t wait_value, VkSemaphore signal_semaphore, uint64_t signal_value)
+{
+    VkCommandBuffer      cmd_buf_handle = cmd_buf ? cmd_buf->handle() : VK_NULL_HANDLE;
+    VkPipelineStageFlags wait_stage     = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info;
+    DW_ZERO_MEMORY(timeline_info);
+
+    timeline_info.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount   = wait_semaphore ? 1 : 0;
+    timeline_info.pWaitSemaphoreValues      = &wait_value;
+    timeline_info.signalSemaphoreValueCount = signal_semaphore ? 1 : 0;
+    timeline_info.pSignalSemaphoreValues    = &signal_value;
+
+    VkSubmitInfo submit_info;
+    DW_ZERO_MEMORY(submit_info);
+
+    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext                = &timeline_info;
+    submit_info.waitSemaphoreCount   = wait_semaphore ? 1 : 0;
+    submit_info.pWaitSemaphores      = &wait_semaphore;
+    submit_info.pWaitDstStageMask    = &wait_stage;
+    submit_info.commandBufferCount   = cmd_buf ? 1 : 0;
+    submit_info.pCommandBuffers      = &cmd_buf_handle;
+    submit_info.signalSemaphoreCount = signal_semaphore ? 1 : 0;
+    submit_info.pSignalSemaphores    = &signal_semaphore;
+
+    if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to submit render graph command buffer");
+        throw std::runtime_error("Failed to submit render graph command buffer");
+    }
+
+    m_num_submissions++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::CommandBuffer::Ptr RenderGraph::begin_command_buffer(QueueType queue)
+{
+    auto backend = m_backend.lock();
+
+    dw::vk::CommandBuffer::Ptr cmd_buf = queue == QUEUE_TYPE_GRAPHICS ? backend->allocate_graphics_command_buffer() : backend->allocate_compute_command_buffer();
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+
+    return cmd_buf;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::create_semaphores(bool timeline_semaphores)
+{
+    auto backend     = m_backend.lock();
+    auto queue_infos = backend->queue_infos();
+
+    // Without a separate compute queue the async passes simply stay on the graphics queue. Features can only be queried
+    // for support, so whether timeline semaphores were enabled when the device was created comes from its owner.
+    if (queue_infos.compute_queue_index == -1 || backend->compute_queue() == backend->graphics_queue() || !timeline_semaphores)
+    {
+        DW_LOG_INFO("Async compute unavailable, render graph passes will run on the graphics queue");
+        return;
+    }
+
+    // Only the resources declared by the passes are transferred between queue families, see bind_untracked_resources().
+    if (queue_infos.compute_queue_index != queue_infos.graphics_queue_index)
+        DW_LOG_INFO("Compute queue is in a separate queue family, render graph resources will be transferred between the families");
+
+    m_graphics_queue_family = (uint32_t)queue_infos.graphics_queue_index;
+    m_compute_queue_family  = (uint32_t)queue_infos.compute_queue_index;
+
+    VkSemaphoreTypeCreateInfo type_info;
+    DW_ZERO_MEMORY(type_info);
+
+    type_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphore_info;
+    DW_ZERO_MEMORY(semaphore_info);
+
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(backend->device(), &semaphore_info, nullptr, &m_graphics_semaphore) != VK_SUCCESS || vkCreateSemaphore(backend->device(), &semaphore_info, nullptr, &m_compute_semaphore) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create render graph timeline semaphores");
+        throw std::runtime_error("Failed to create render graph timeline semaphores");
+    }
+
+    m_async_compute_available = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::create_command_pools()
+{
+    auto backend = m_backend.lock();
+
+    m_command_pools.resize(dw::vk::Backend::kMaxFramesInFlight * m_thread_pool->num_threads());
+
+    for (auto& pool : m_command_pools)
+        pool.pool = dw::vk::CommandPool::create(backend, backend->queue_infos().graphics_queue_index);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::record_secondaries()
+{
+    auto backend = m_backend.lock();
+
+    // The frame fence has been waited on, so everything recorded from this frame's pools the last time around is done.
+    uint32_t first_pool = backend->current_frame_idx() * m_thread_pool->num_threads();
+
+    for (uint32_t i = 0; i < m_thread_pool->num_threads(); i++)
+    {
+        ThreadCommandPool& pool = m_command_pools[first_pool + i];
+
+        vkResetCommandPool(backend->device(), pool.pool->handle(), 0);
+        pool.num_used = 0;
+    }
+
+    std::vector<RecordingJob>                 jobs;
+    std::unordered_map<std::string, uint32_t> group_jobs;
+
+    // Passes of a group go into the same job and are recorded in order, so a module never runs on two threads at once.
+    for (uint32_t pass_idx = 0; pass_idx < m_passes.size(); pass_idx++)
+    {
+        Pass& pass = m_passes[pass_idx];
+
+        pass.secondary = nullptr;
+        pass.job_secondaries.clear();
+
+        if (pass.queue != QUEUE_TYPE_GRAPHICS)
+            continue;
+
+        if (pass.num_jobs > 0)
+        {
+            pass.job_secondaries.resize(pass.num_jobs);
+
+            for (uint32_t job_idx = 0; job_idx < pass.num_jobs; job_idx++)
+            {
+                RecordingJob job;
+
+                job.group      = pass.group.empty() ? pass.name : pass.group;
+                job.split_pass = (int32_t)pass_idx;
+                job.split_job  = job_idx;
+
+                jobs.push_back(job);
+            }
+        }
+        else if (!pass.main_thread && pass.execute)
+        {
+            const std::string& group = pass.group.empty() ? pass.name : pass.group;
+
+            auto it = group_jobs.find(group);
+
+            if (it == group_jobs.end())
+            {
+                RecordingJob job;
+
+                job.group = group;
+
+                group_jobs[group] = (uint32_t)jobs.size();
+                jobs.push_back(job);
+
+                it = group_jobs.find(group);
+            }
+
+            jobs[it->second].passes.push_back(pass_idx);
+        }
+    }
+
+    m_thread_pool->run((uint32_t)jobs.size(), m_num_recording_threads, [&](uint32_t job_idx, uint32_t thread_idx) {
+        RecordingJob&      job         = jobs[job_idx];
+        ThreadCommandPool& pool        = m_command_pools[first_pool + thread_idx];
+        auto               start       = std::chrono::high_resolution_clock::now();
+        double             trace_start = TraceRecorder::now();
+
+        if (job.split_pass != -1)
+        {
+            Pass& pass = m_passes[job.split_pass];
+
+            dw::vk::CommandBuffer::Ptr cmd_buf = begin_secondary(pool, &pass);
+
+            pass.job(cmd_buf, job.split_job);
+
+            vkEndCommandBuffer(cmd_buf->handle());
+
+            pass.job_secondaries[job.split_job] = cmd_buf;
+
+            if (tracing_cpu())
+                add_trace_event(thread_idx + 1, pass.name + " Job " + std::to_string(job.split_job), trace_start);
+        }
+        else
+        {
+            for (uint32_t pass_idx : job.passes)
+            {
+                Pass& pass = m_passes[pass_idx];
+
+                dw::vk::CommandBuffer::Ptr cmd_buf = begin_secondary(pool, nullptr);
+
+                pass.execute(cmd_buf);
+
+                vkEndCommandBuffer(cmd_buf->handle());
+
+                pass.secondary = cmd_buf;
+            }
+
+            add_trace_event(thread_idx + 1, job.group, trace_start);
+        }
+
+        job.cpu_time = elapsed_milliseconds(start);
+    });
+
+    m_num_secondaries = 0;
+
+    for (uint32_t i = 0; i < m_thread_pool->num_threads(); i++)
+        m_num_secondaries += m_command_pools[first_pool + i].num_used;
+
+    for (const auto& job : jobs)
+        add_cpu_time(job.group, job.cpu_time);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::CommandBuffer::Ptr RenderGraph::begin_secondary(ThreadCommandPool& pool, const Pass* split_pass)
+{
+    if (pool.num_used == pool.command_buffers.size())
+        pool.command_buffers.push_back(dw::vk::CommandBuffer::create(m_backend.lock(), pool.pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+
+    dw::vk::CommandBuffer::Ptr cmd_buf = pool.command_buffers[pool.num_used++];
+
+    VkCommandBufferInheritanceRenderingInfoKHR rendering_info;
+    DW_ZERO_MEMORY(rendering_info);
+
+    VkCommandBufferInheritanceInfo inheritance_info;
+    DW_ZERO_MEMORY(inheritance_info);
+
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    // Jobs of a split pass continue the rendering begun on the primary command buffer.
+    if (split_pass)
+    {
+        rendering_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        rendering_info.colorAttachmentCount    = (uint32_t)split_pass->color_formats.size();
+        rendering_info.pColorAttachmentFormats = split_pass->color_formats.data();
+        rendering_info.depthAttachmentFormat   = split_pass->depth_format;
+        rendering_info.rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+
+        inheritance_info.pNext = &rendering_info;
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+
+    vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+
+    return cmd_buf;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::add_cpu_time(const std::string& group, double cpu_time)
+{
+    m_cpu_times[group] += cpu_time;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::create_query_pools()
+{
+    auto backend = m_backend.lock();
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(backend->physical_device(), &properties);
+
+    uint32_t num_families = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(backend->physical_device(), &num_families, nullptr);
+
+    std::vector<VkQueueFamilyProperties> families(num_families);
+    vkGetPhysicalDeviceQueueFamilyProperties(backend->physical_device(), &num_families, families.data());
+
+    auto queue_infos = backend->queue_infos();
+
+    if (properties.limits.timestampPeriod == 0.0f || families[queue_infos.graphics_queue_index].timestampValidBits == 0)
+    {
+        DW_LOG_INFO("Timestamp queries unavailable, render graph passes will not be timed");
+        return;
+    }
+
+    // Async passes are left untimed on compute queues without timestamp support.
+    m_compute_timestamps = m_async_compute_available && families[m_compute_queue_family].timestampValidBits > 0;
+    m_timestamp_period   = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo pool_info;
+    DW_ZERO_MEMORY(pool_info);
+
+    pool_info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = kMaxTimedPasses * 2;
+
+    m_timestamp_queries.resize(dw::vk::Backend::kMaxFramesInFlight);
+
+    for (auto& queries : m_timestamp_queries)
+    {
+        if (vkCreateQueryPool(backend->device(), &pool_info, nullptr, &queries.pool) != VK_SUCCESS)
+        {
+            DW_LOG_ERROR("Failed to create timestamp query pool");
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+    }
+
+    pool_info.queryCount = kNumCalibrations;
+
+    if (vkCreateQueryPool(backend->device(), &pool_info, nullptr, &m_calibration_pool) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create calibration query pool");
+        throw std::runtime_error("Failed to create calibration query pool");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::read_timestamps()
+{
+    if (m_timestamp_queries.size() == 0)
+        return;
+
+    auto backend = m_backend.lock();
+
+    TimestampQueries& queries = m_timestamp_queries[backend->current_frame_idx()];
+
+    // The fence of this frame in flight has been waited on, so the queries written the last time it was recorded are available.
+    if (queries.names.size() == 0)
+        return;
+
+    std::vector<uint64_t> timestamps(queries.names.size() * 2);
+
+    if (vkGetQueryPoolResults(backend->device(), queries.pool, 0, (uint32_t)timestamps.size(), timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+
+    m_gpu_timings.resize(queries.names.size());
+
+    for (uint32_t i = 0; i < queries.names.size(); i++)
+    {
+        m_gpu_timings[i].name     = queries.names[i];
+        m_gpu_timings[i].gpu_time = double(timestamps[i * 2 + 1] - timestamps[i * 2]) * m_timestamp_period / 1000000.0;
+    }
+
+    if (!m_trace_recorder || !m_trace_recorder->capturing() || m_trace_recorder->capture_id() != m_trace_capture_id)
+        return;
+
+    // Timestamps of both queues share the device timebase, so a single calibration maps all of them onto the CPU clock.
+    for (uint32_t i = 0; i < queries.names.size(); i++)
+    {
+        double begin = m_calibration_time + double(int64_t(timestamps[i * 2] - m_calibration_tick)) * m_timestamp_period / 1000.0;
+        double end   = m_calibration_time + double(int64_t(timestamps[i * 2 + 1] - m_calibration_tick)) * m_timestamp_period / 1000.0;
+
+        m_trace_recorder->add_event(TraceRecorder::TRACK_GPU, queries.queues[i] == QUEUE_TYPE_ASYNC_COMPUTE ? 1 : 0, queries.names[i], begin, end);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::reset_timestamps(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    if (m_timestamp_queries.size() == 0)
+        return;
+
+    auto backend = m_backend.lock();
+
+    TimestampQueries& queries = m_timestamp_queries[backend->current_frame_idx()];
+
+    queries.names.clear();
+    queries.queues.clear();
+    queries.pass_queries.resize(m_passes.size());
+
+    for (uint32_t pass_idx = 0; pass_idx < m_passes.size(); pass_idx++)
+    {
+        const Pass& pass = m_passes[pass_idx];
+
+        queries.pass_queries[pass_idx] = -1;
+
+        if (queries.names.size() == kMaxTimedPasses || (pass.queue == QUEUE_TYPE_ASYNC_COMPUTE && !m_compute_timestamps))
+            continue;
+
+        queries.pass_queries[pass_idx] = (int32_t)queries.names.size() * 2;
+        queries.names.push_back(pass.group.empty() ? pass.name : pass.group + "/" + pass.name);
+        queries.queues.push_back(pass.queue);
+    }
+
+    // Async batches wait on the graphics submission containing the reset before writing their queries.
+    if (queries.names.size() > 0)
+        vkCmdResetQueryPool(cmd_buf->handle(), queries.pool, 0, (uint32_t)queries.names.size() * 2);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::write_timestamp(dw::vk::CommandBuffer::Ptr cmd_buf, const Pass& pass, bool end)
+{
+    if (m_timestamp_queries.size() == 0)
+        return;
+
+    auto backend = m_backend.lock();
+
+    const TimestampQueries& queries = m_timestamp_queries[backend->current_frame_idx()];
+
+    int32_t query = queries.pass_queries[&pass - m_passes.data()];
+
+    if (query == -1)
+        return;
+
+    if (end)
+        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.pool, query + 1);
+    else
+        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.pool, query);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::calibrate_timestamps()
+{
+    m_trace_capture_id = m_trace_recorder->capture_id();
+
+    if (m_timestamp_queries.size() == 0)
+    {
+        DW_LOG_INFO("Timestamp queries unavailable, traces will only contain CPU events");
+        return;
+    }
+
+    auto backend = m_backend.lock();
+
+    // VK_EXT_calibrated_timestamps is not enabled on the device, so the GPU clock is sampled by a timestamp submitted on its
+    // own and bracketed by CPU timestamps on either side of the submission. The tightest bracket out of a few attempts is kept.
+    vkQueueWaitIdle(backend->graphics_queue());
+
+    double best_window = -1.0;
+
+    for (uint32_t i = 0; i < kNumCalibrations; i++)
+    {
+        dw::vk::CommandBuffer::Ptr cmd_buf = begin_command_buffer(QUEUE_TYPE_GRAPHICS);
+
+        vkCmdResetQueryPool(cmd_buf->handle(), m_calibration_pool, i, 1);
+        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_calibration_pool, i);
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        double cpu_begin = TraceRecorder::now();
+
+        submit(backend->graphics_queue(), cmd_buf, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 0);
+        vkQueueWaitIdle(backend->graphics_queue());
+
+        double cpu_end = TraceRecorder::now();
+
+        uint64_t tick = 0;
+
+        if (vkGetQueryPoolResults(backend->device(), m_calibration_pool, i, 1, sizeof(uint64_t), &tick, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+            continue;
+
+        if (best_window < 0.0 || cpu_end - cpu_begin < best_window)
+        {
+            best_window        = cpu_end - cpu_begin;
+            m_calibration_tick = tick;
+            m_calibration_time = (cpu_begin + cpu_end) * 0.5;
+        }
+    }
+
+    if (best_window < 0.0)
+        DW_LOG_ERROR("Failed to calibrate GPU timestamps");
+    else
+        DW_LOG_INFO("Calibrated GPU timestamps to within " + std::to_string(best_window * 0.5) + " us");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool RenderGraph::tracing_cpu()
+{
+    return m_trace_recorder && m_trace_recorder->recording_cpu();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RenderGraph::add_trace_event(uint32_t thread, const std::string& name, double begin)
+{
+    if (tracing_cpu())
+        m_trace_recorder->add_event(TraceRecorder::TRACK_CPU, thread, name, begin, TraceRecorder::now());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <vk.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+class TraceRecorder;
+
+// Records the passes of a frame along with the resources each of them touches, and infers the
+// minimal set of pipeline barriers required between them. Compilation only looks at the declared
+// accesses and never touches Vulkan, the graph records the barriers it inferred when it is executed.
+// The state of every mip level and array layer is tracked separately, so a pass may read one mip of an image
+// while writing the next in another layout. Resetting a compiled graph carries the state it left every resource in
+// over to the next frame, so resources used by the graph must not be transitioned outside of it. A graph created
+// without a backend can only be compiled.
+//
+// Passes can ask to run on the async compute queue. When enabled, those passes are recorded into separate
+// command buffers that start as soon as the graphics passes they depend on have been submitted, synchronized
+// with timeline semaphores. Every resource is handed back to the graphics queue by the end of the frame.
+// Async compute needs the timelineSemaphore feature to be enabled on the device, which the owner of the device has
+// to tell the graph about, and a compute queue other than the graphics queue. When that queue is in another family,
+// the resources declared by the passes are transferred between the families, and passes binding resources the graph
+// doesn't know about stay on the graphics queue.
+//
+// With parallel recording enabled, the graphics passes of each group are recorded on worker threads into secondary
+// command buffers allocated from per-thread pools, and the main thread only records the barriers and stitches the
+// secondaries together. Passes that touch state shared between threads stay on the main thread.
+//
+// Every pass is wrapped in timestamp queries, the GPU times of a frame are read back once the same frame in flight
+// is executed again. When a trace recorder is attached, the passes are also added to its capture as CPU events for
+// the threads recording them and GPU events for the queues executing them, mapped onto the CPU clock.
+class RenderGraph
+{
+public:
+    enum QueueType
+    {
+        QUEUE_TYPE_GRAPHICS,
+        QUEUE_TYPE_ASYNC_COMPUTE
+    };
+
+    struct Barrier
+    {
+        uint32_t                resource;
+        VkPipelineStageFlags2   src_stage;
+        VkAccessFlags2          src_access;
+        VkPipelineStageFlags2   dst_stage;
+        VkAccessFlags2          dst_access;
+        VkImageLayout           old_layout;
+        VkImageLayout           new_layout;
+        VkImageSubresourceRange subresource_range;
+        bool                    hoisted; // Recorded on the graphics queue before the resource is handed to async compute.
+        bool                    initial; // First use of a resource the graph has no state for, see add_barrier().
+    };
+
+    struct RecordedBarriers
+    {
+        std::vector<VkImageMemoryBarrier2KHR>  images;
+        std::vector<VkBufferMemoryBarrier2KHR> buffers;
+        bool                                   backend = false; // Initial barriers were handed to the backend.
+    };
+
+    class PassBuilder
+    {
+    public:
+        void use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, dw::vk::Image::Ptr image, VkImageSubresourceRange subresource_range);
+        void use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, dw::vk::Buffer::Ptr buffer);
+
+        // For resources that are not wrapped by the framework, identified by their handle.
+        void use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, VkImage image, VkImageSubresourceRange subresource_range);
+        void use_resource(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkBuffer buffer);
+
+        // For passes that transition a resource themselves (blits, mip generation), declares the state it is left in.
+        void internal_transition(VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, dw::vk::Image::Ptr image, VkImageSubresourceRange subresource_range);
+
+        // Passes on the async compute queue may only use compute and transfer commands. They run on the graphics
+        // queue whenever async compute is disabled or unavailable.
+        void set_queue(QueueType queue);
+
+        // For passes that bind resources not declared to the graph, like the scene or the per-frame uniforms. Those are
+        // never transferred to another queue family, so the pass only runs async on a compute queue sharing the family.
+        void bind_untracked_resources();
+
+        // For passes that use the profiler, the GUI or anything tracking resource state on the CPU (blits, mip generation).
+        void record_on_main_thread();
+
+        // Splits the draws of a pass into jobs recorded in parallel. The execute function of the pass begins rendering with
+        // the given attachment formats, the jobs continue it and the finish function ends it. When recording in parallel the
+        // rendering has to begin with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR.
+        void set_jobs(uint32_t num_jobs, std::function<void(dw::vk::CommandBuffer::Ptr, uint32_t)> job, std::function<void(dw::vk::CommandBuffer::Ptr)> finish, const std::vector<VkFormat>& color_formats, VkFormat depth_format);
+
+    private:
+        friend class RenderGraph;
+
+        PassBuilder(RenderGraph* graph, uint32_t pass_idx);
+
+        void add_access(uint32_t resource, VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, VkImageSubresourceRange subresource_range, bool internal);
+
+    private:
+        RenderGraph* m_graph;
+        uint32_t     m_pass_idx;
+    };
+
+    struct PassTiming
+    {
+        std::string name; // Prefixed with the group the pass belongs to, e.g. "Shadows/Ray Trace".
+        double      gpu_time;
+    };
+
+    using SetupFunc   = std::function<void(PassBuilder&)>;
+    using ExecuteFunc = std::function<void(dw::vk::CommandBuffer::Ptr)>;
+    using JobFunc     = std::function<void(dw::vk::CommandBuffer::Ptr, uint32_t)>;
+
+public:
+    RenderGraph(std::weak_ptr<dw::vk::Backend> backend, bool timeline_semaphores = false);
+    ~RenderGraph();
+
+    void reset();
+    void begin_group(const std::string& name);
+    void end_group();
+
+    // Passes without an execute function only declare the state they leave their resources in, e.g. for presentation.
+    void add_pass(const std::string& name, SetupFunc setup, ExecuteFunc execute);
+
+    void compile();
+    void gui();
+
+    // Records the graph starting with the given command buffer. With async compute active, the work recorded so far
+    // is submitted along the way and the returned command buffer is the one the rest of the frame has to go into.
+    dw::vk::CommandBuffer::Ptr execute(dw::vk::CommandBuffer::Ptr cmd_buf);
+
+    // Resources in the same alias group share memory, so the first use of one has to wait for whichever
+    // resource used the memory before it, including in previous frames. Groups have to be set every frame.
+    void set_alias_group(const void* key, uint32_t group);
+
+    // First and last pass that used the resource, only valid after compilation.
+    bool lifetime(const void* key, uint32_t& first_pass, uint32_t& last_pass);
+
+    // Image and buffer barriers recorded in front of the pass, only valid after compilation. Barriers hoisted onto the
+    // graphics queue for async compute are recorded before the hand-over instead.
+    void pass_barriers(uint32_t pass_idx, RecordedBarriers& barriers);
+
+    // Ownership transfers between queue families, only valid after compilation. Acquires of a graphics pass are recorded
+    // right before its barriers. An async compute batch is preceded by the releases recorded on the graphics queue,
+    // starts with the acquires and ends with the releases back to the graphics queue.
+    void pass_acquires(uint32_t pass_idx, RecordedBarriers& barriers);
+    void batch_transfers(uint32_t batch_idx, RecordedBarriers& graphics_releases, RecordedBarriers& acquires, RecordedBarriers& releases);
+
+    // Makes a graph without a backend compile as if async compute was enabled with the given queue families.
+    void simulate_async_compute(uint32_t graphics_queue_family, uint32_t compute_queue_family);
+
+    inline const std::vector<Barrier>& barriers() { return m_barriers; }
+    inline uint32_t                    num_passes() { return (uint32_t)m_passes.size(); }
+    inline uint32_t                    num_declared_accesses() { return m_num_declared_accesses; }
+    inline uint32_t                    num_barrier_batches() { return m_num_barrier_batches; }
+    inline uint32_t                    num_alias_barriers() { return m_num_alias_barriers; }
+    inline uint32_t                    num_async_batches() { return (uint32_t)m_batches.size(); }
+    inline QueueType                   pass_queue(uint32_t pass_idx) { return m_passes[pass_idx].queue; }
+    inline bool                        async_compute_available() { return m_async_compute_available; }
+    inline bool                        async_compute() { return m_async_compute; }
+    inline void                        set_async_compute(bool value) { m_async_compute = value; }
+    inline uint32_t                    num_recording_threads() { return m_num_recording_threads; }
+    inline void                        set_num_recording_threads(uint32_t value) { m_num_recording_threads = std::max(1u, std::min(value, m_thread_pool->num_threads())); }
+    inline bool                        parallel_recording() { return m_parallel_recording; }
+    inline void                        set_parallel_recording(bool value) { m_parallel_recording = value; }
+
+    // Whether the passes registered since the last reset are recorded into secondary command buffers.
+    inline bool recording_in_parallel() { return m_parallel_active; }
+
+    // GPU time in milliseconds of every pass of the latest frame whose queries are available, which trails the frame
+    // being recorded by the number of frames in flight. Empty when the device does not support timestamps.
+    inline const std::vector<PassTiming>& gpu_timings() { return m_gpu_timings; }
+
+    // The recorder has to outlive the graph, or be detached before it is destroyed.
+    inline void set_trace_recorder(TraceRecorder* recorder) { m_trace_recorder = recorder; }
+
+private:
+    struct Resource
+    {
+        const void*         key;
+        dw::vk::Image::Ptr  image;
+        dw::vk::Buffer::Ptr buffer;
+        VkImage             image_handle  = VK_NULL_HANDLE;
+        VkBuffer            buffer_handle = VK_NULL_HANDLE;
+        uint32_t            first_pass = UINT32_MAX;
+        uint32_t            last_pass  = 0;
+        bool                async      = false;
+        bool                aliased    = false;
+    };
+
+    struct Access
+    {
+        uint32_t                resource;
+        VkPipelineStageFlags2   stage;
+        VkAccessFlags2          access;
+        VkImageLayout           layout;
+        VkImageSubresourceRange subresource_range;
+        bool                    internal;
+    };
+
+    // Queue family ownership transfer of a resource, recorded as a release on one queue and an acquire on the other.
+    struct Transfer
+    {
+        uint32_t                resource;
+        VkImageLayout           layout;
+        VkImageSubresourceRange subresource_range;
+        VkPipelineStageFlags2   release_stage;
+        VkAccessFlags2          release_access;
+        VkPipelineStageFlags2   acquire_stage;
+        VkAccessFlags2          acquire_access;
+    };
+
+    struct Pass
+    {
+        std::string                             name;
+        std::string                             group;
+        std::vector<Access>                     accesses;
+        std::vector<VkMemoryBarrier2KHR>        alias_barriers;
+        std::vector<Transfer>                   acquires;
+        ExecuteFunc                             execute;
+        ExecuteFunc                             finish;
+        JobFunc                                 job;
+        std::vector<VkFormat>                   color_formats;
+        VkFormat                                depth_format    = VK_FORMAT_UNDEFINED;
+        uint32_t                                num_jobs        = 0;
+        bool                                    main_thread     = false;
+        bool                                    untracked       = false;
+        QueueType                               requested_queue = QUEUE_TYPE_GRAPHICS;
+        QueueType                               queue           = QUEUE_TYPE_GRAPHICS;
+        int32_t                                 wait_batch      = -1;
+        uint32_t                                first_barrier   = 0;
+        uint32_t                                num_barriers    = 0;
+        dw::vk::CommandBuffer::Ptr              secondary;
+        std::vector<dw::vk::CommandBuffer::Ptr> job_secondaries;
+    };
+
+    // Unit of work for a recording thread, either all parallel passes of a group or a single job of a split pass.
+    struct RecordingJob
+    {
+        std::string           group;
+        std::vector<uint32_t> passes;
+        int32_t               split_pass = -1;
+        uint32_t              split_job  = 0;
+        double                cpu_time   = 0.0;
+    };
+
+    // Command pool of one recording thread for one frame in flight, secondaries are kept around and reused.
+    struct ThreadCommandPool
+    {
+        dw::vk::CommandPool::Ptr                pool;
+        std::vector<dw::vk::CommandBuffer::Ptr> command_buffers;
+        uint32_t                                num_used = 0;
+    };
+
+    // Consecutive async compute passes that are submitted together once every graphics pass up to and including
+    // the dependency has been submitted.
+    struct Batch
+    {
+        std::vector<uint32_t> passes;
+        std::vector<uint32_t> hoisted_barriers;
+        std::vector<Transfer> graphics_releases;
+        std::vector<Transfer> acquires;
+        std::vector<Transfer> releases;
+        int32_t               dependency = -1;
+        bool                  closed     = false;
+        uint64_t              value      = 0;
+    };
+
+    // Queries of one frame in flight, a begin and an end timestamp for each of the timed passes.
+    struct TimestampQueries
+    {
+        VkQueryPool              pool = VK_NULL_HANDLE;
+        std::vector<std::string> names;
+        std::vector<QueueType>   queues;
+        std::vector<int32_t>     pass_queries; // First query of each pass, -1 if the pass is not timed.
+    };
+
+    // State a mip level and array layer was left in by the last compiled frame, which the next frame starts from.
+    struct FinalState
+    {
+        bool                  known   = false;
+        bool                  written = false;
+        VkPipelineStageFlags2 stage   = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2        access  = VK_ACCESS_2_NONE;
+        VkImageLayout         layout  = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct FinalResourceState
+    {
+        std::weak_ptr<dw::vk::Image>  image; // Tells the resource apart from a later one created at the same address.
+        std::weak_ptr<dw::vk::Buffer> buffer;
+        bool                          wrapped    = false;
+        uint32_t                      num_levels = 1;
+        uint32_t                      num_layers = 1;
+        std::vector<FinalState>       subresources; // Indexed by mip level * num_layers + array layer.
+    };
+
+    struct AliasState
+    {
+        const void*           owner  = nullptr;
+        QueueType             queue  = QUEUE_TYPE_GRAPHICS;
+        VkPipelineStageFlags2 stage  = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2        access = VK_ACCESS_2_NONE;
+        int32_t               pass   = -1; // Last pass of the current frame that used the memory.
+        int32_t               batch  = -1; // Async compute batch that pass was recorded into.
+    };
+
+    uint32_t                   find_or_add_resource(const void* key, dw::vk::Image::Ptr image, dw::vk::Buffer::Ptr buffer, VkImage image_handle, VkBuffer buffer_handle);
+    const FinalResourceState*  find_final_state(const Resource& resource);
+    void                       execute_pass(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t pass_idx);
+    void                       execute_passes(dw::vk::CommandBuffer::Ptr cmd_buf, const std::vector<uint32_t>& passes, const std::string& prefix);
+    void                       add_barrier(const Barrier& barrier, RecordedBarriers& barriers);
+    void                       flush_barriers(dw::vk::CommandBuffer::Ptr cmd_buf, const RecordedBarriers& barriers);
+    void                       add_transfers(const std::vector<Transfer>& transfers, bool release, QueueType src_queue, RecordedBarriers& barriers);
+    void                       transfer_ownership(dw::vk::CommandBuffer::Ptr cmd_buf, const std::vector<Transfer>& transfers, bool release, QueueType src_queue);
+    void                       submit(VkQueue queue, dw::vk::CommandBuffer::Ptr cmd_buf, VkSemaphore wait_semaphore, uint64_t wait_value, VkSemaphore signal_semaphore, uint64_t signal_value);
+    dw::vk::CommandBuffer::Ptr begin_command_buffer(QueueType queue);
+    void                       create_semaphores(bool timeline_semaphores);
+    void                       create_command_pools();
+    void                       record_secondaries();
+    dw::vk::CommandBuffer::Ptr begin_secondary(ThreadCommandPool& pool, const Pass* split_pass);
+    void                       add_cpu_time(const std::string& group, double cpu_time);
+    void                       create_query_pools();
+    void                       read_timestamps();
+    void                       reset_timestamps(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void                       write_timestamp(dw::vk::CommandBuffer::Ptr cmd_buf, const Pass& pass, bool end);
+    void                       calibrate_timestamps();
+    bool                       tracing_cpu();
+    void                       add_trace_event(uint32_t thread, const std::string& name, double begin);
+
+private:
+    std::weak_ptr<dw::vk::Backend>            m_backend;
+    std::vector<Resource>                     m_resources;
+    std::unordered_map<const void*, uint32_t> m_resource_map;
+    std::unordered_map<const void*, uint32_t> m_alias_groups;
+    std::unordered_map<uint32_t, AliasState>  m_alias_states;
+    std::vector<Pass>                         m_passes;
+    std::vector<Barrier>                      m_barriers;
+    std::string                               m_current_group;
+    std::vector<Batch>                        m_batches;
+    std::vector<Transfer>                     m_return_acquires;
+    VkSemaphore                               m_graphics_semaphore      = VK_NULL_HANDLE;
+    VkSemaphore                               m_compute_semaphore       = VK_NULL_HANDLE;
+    uint64_t                                  m_graphics_value          = 0;
+    uint64_t                                  m_compute_value           = 0;
+    uint32_t                                  m_graphics_queue_family   = 0;
+    uint32_t                                  m_compute_queue_family    = 0;
+    bool                                      m_compiled                = false;
+    bool                                      m_async_compute           = false;
+    bool                                      m_async_compute_available = false;
+    bool                                      m_async_active            = false;
+    uint32_t                                  m_num_declared_accesses   = 0;
+    uint32_t                                  m_num_barrier_batches     = 0;
+    uint32_t                                  m_num_alias_barriers      = 0;
+    uint32_t                                  m_num_submissions         = 0;
+    uint32_t                                  m_num_transfers           = 0;
+    std::unique_ptr<ThreadPool>               m_thread_pool;
+    std::vector<ThreadCommandPool>            m_command_pools;
+    std::vector<std::string>                  m_cpu_time_groups;
+    std::unordered_map<std::string, double>   m_cpu_times;
+    double                                    m_recording_wall_time     = 0.0;
+    uint32_t                                  m_num_recording_threads   = 1;
+    uint32_t                                  m_num_secondaries         = 0;
+    bool                                      m_parallel_recording      = false;
+    bool                                      m_parallel_active         = false;
+    std::vector<TimestampQueries>             m_timestamp_queries;
+    std::vector<PassTiming>                   m_gpu_timings;
+    double                                    m_timestamp_period        = 0.0;
+    bool                                      m_compute_timestamps      = false;
+    TraceRecorder*                            m_trace_recorder          = nullptr;
+    uint32_t                                  m_trace_capture_id        = 0;
+    VkQueryPool                               m_calibration_pool        = VK_NULL_HANDLE;
+    uint64_t                                  m_calibration_tick        = 0;
+    double                                    m_calibration_time        = 0.0;
+
+    // State the last executed frame left every resource in, and the one the current frame will once it has been executed.
+    std::unordered_map<const void*, FinalResourceState> m_final_states;
+    std::unordered_map<const void*, FinalResourceState> m_compiled_states;
+};
@@ -0,0 +1,326 @@
+#include "scene_cache.h"
+#include <logger.h>
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static double seconds_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool read_file(const std::string& path, bool keep_contents, std::string& contents)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<char> chunk(1024 * 1024);
+
+    while (file)
+    {
+        file.read(chunk.data(), chunk.size());
+
+        if (keep_contents)
+            contents.append(chunk.data(), (size_t)file.gcount());
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Finds the buffers, material libraries and textures referenced by a glTF, OBJ or MTL file. Anything missed is simply
+// read on demand when the scene is loaded.
+static void find_dependencies(const std::string& path, const std::string& contents, std::vector<std::string>& dependencies)
+{
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    if (ends_with(path, ".gltf"))
+    {
+        size_t pos = 0;
+
+        while ((pos = contents.find("\"uri\"", pos)) != std::string::npos)
+        {
+            size_t begin = contents.find('"', contents.find(':', pos) + 1);
+            size_t end   = contents.find('"', begin + 1);
+
+            if (begin == std::string::npos || end == std::string::npos)
+                break;
+
+            std::string uri = contents.substr(begin + 1, end - begin - 1);
+
+            if (uri.compare(0, 5, "data:") != 0)
+                dependencies.push_back(directory + uri);
+
+            pos = end + 1;
+        }
+    }
+    else if (ends_with(path, ".obj") || ends_with(path, ".mtl"))
+    {
+        std::istringstream stream(contents);
+        std::string        line;
+
+        while (std::getline(stream, line))
+        {
+            std::istringstream tokens(line);
+            std::string        keyword;
+            std::string        token;
+            std::string        last;
+
+            tokens >> keyword;
+
+            if (keyword != "mtllib" && keyword.compare(0, 4, "map_") != 0 && keyword != "bump" && keyword != "disp" && keyword != "norm")
+                continue;
+
+            while (tokens >> token)
+                last = token;
+
+            if (!last.empty())
+                dependencies.push_back(directory + last);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SceneCache::SceneCache(std::weak_ptr<dw::vk::Backend> backend, DeletionQueue* deletion_queue, TextureStreamer* texture_streamer, const std::vector<SceneDescription>& descriptions) :
+    m_backend(backend), m_deletion_queue(deletion_queue), m_texture_streamer(texture_streamer), m_descriptions(descriptions)
+{
+    m_entries.resize(m_descriptions.size());
+
+    m_prefetch_thread = std::thread(&SceneCache::prefetch_meshes, this);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SceneCache::~SceneCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        m_prefetch_quit = true;
+    }
+
+    m_prefetch_condition.notify_all();
+    m_prefetch_thread.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::RayTracedScene::Ptr SceneCache::acquire(uint32_t scene)
+{
+    if (!m_entries[scene].scene)
+        load(scene);
+
+    return m_entries[scene].scene;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::prefetch(uint32_t scene)
+{
+    if (loaded(scene))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        m_prefetch_queue.push_back(scene);
+    }
+
+    m_prefetch_condition.notify_all();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::update(uint32_t active_scene)
+{
+    double now = seconds_now();
+
+    if (loaded(active_scene))
+        m_entries[active_scene].last_used = now;
+
+    if (m_eviction_timeout <= 0.0f)
+        return;
+
+    for (uint32_t i = 0; i < m_entries.size(); i++)
+    {
+        if (i != active_scene && loaded(i) && now - m_entries[i].last_used > m_eviction_timeout)
+            evict(i);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::gui()
+{
+    ImGui::SliderFloat("Scene Eviction Timeout", &m_eviction_timeout, 0.0f, 600.0f, "%.0f s");
+
+    for (uint32_t i = 0; i < m_entries.size(); i++)
+        ImGui::Text("%s: %s", m_descriptions[i].name.c_str(), loaded(i) ? "Loaded" : "Not Loaded");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::load(uint32_t scene)
+{
+    auto backend = m_backend.lock();
+    auto start   = std::chrono::high_resolution_clock::now();
+
+    const SceneDescription& description = m_descriptions[scene];
+    Entry&                  entry       = m_entries[scene];
+
+    entry.meshes.clear();
+
+    std::vector<std::shared_ptr<MeshCache::Data>> prefetched;
+
+    {
+        std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+
+        // A queued prefetch is no longer needed, one that is running is waited for since it may be baking the same meshes.
+        m_prefetch_queue.erase(std::remove(m_prefetch_queue.begin(), m_prefetch_queue.end(), scene), m_prefetch_queue.end());
+        m_prefetch_condition.wait(lock, [this, scene]() { return m_prefetching != (int32_t)scene; });
+
+        prefetched.swap(entry.prefetched);
+    }
+
+    for (uint32_t i = 0; i < description.meshes.size(); i++)
+    {
+        const std::string& path = description.meshes[i];
+
+        std::shared_ptr<MeshCache::Data> data = i < prefetched.size() ? prefetched[i] : MeshCache::prepare(path);
+        dw::Mesh::Ptr                    mesh = data ? MeshCache::create(backend, data, m_texture_streamer) : nullptr;
+
+        if (!mesh)
+        {
+            DW_LOG_ERROR("Failed to load mesh: " + path);
+            throw std::runtime_error("Failed to load mesh: " + path);
+        }
+
+        mesh->initialize_for_ray_tracing(backend);
+
+        entry.meshes.push_back(mesh);
+    }
+
+    // Only the mip tails are loaded up front, the rest is streamed in once the scene is rendered.
+    m_texture_streamer->flush();
+
+    std::vector<SceneDescription::Instance> instances = description.instances;
+
+    if (description.place_instances)
+        description.place_instances(entry.meshes, instances);
+
+    std::vector<dw::RayTracedScene::Instance> scene_instances;
+
+    for (const auto& instance : instances)
+    {
+        dw::RayTracedScene::Instance scene_instance;
+
+        scene_instance.mesh      = entry.meshes[instance.mesh];
+        scene_instance.transform = instance.transform;
+
+        scene_instances.push_back(scene_instance);
+    }
+
+    entry.scene     = dw::RayTracedScene::create(backend, scene_instances);
+    entry.last_used = seconds_now();
+
+    double load_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    DW_LOG_INFO("Loaded scene " + description.name + " in " + std::to_string(load_time) + " ms");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::evict(uint32_t scene)
+{
+    Entry& entry = m_entries[scene];
+
+    // Frames in flight may still trace against the scene.
+    m_deletion_queue->push(entry.scene);
+
+    for (auto& mesh : entry.meshes)
+        m_deletion_queue->push(mesh);
+
+    entry.scene = nullptr;
+    entry.meshes.clear();
+
+    DW_LOG_INFO("Evicted scene " + m_descriptions[scene].name);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SceneCache::prefetch_meshes()
+{
+    while (true)
+    {
+        uint32_t scene = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+
+            m_prefetch_condition.wait(lock, [this]() { return m_prefetch_quit || m_prefetch_queue.size() > 0; });
+
+            if (m_prefetch_quit)
+                return;
+
+            scene = m_prefetch_queue.front();
+            m_prefetch_queue.pop_front();
+
+            if (m_entries[scene].prefetched.size() > 0)
+                continue;
+
+            m_prefetching = (int32_t)scene;
+        }
+
+        // Baking, mapping and decoding happen here, the load only creates the GPU resources from the result.
+        std::vector<std::shared_ptr<MeshCache::Data>> prefetched;
+
+        for (const auto& path : m_descriptions[scene].meshes)
+            prefetched.push_back(MeshCache::prepare(path));
+
+        {
+            std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+
+            m_entries[scene].prefetched = prefetched;
+            m_prefetching               = -1;
+        }
+
+        m_prefetch_condition.notify_all();
+
+        // Reading the textures once puts them in the OS file cache, which is where the load picks them up from.
+        std::vector<std::string>        files = m_descriptions[scene].meshes;
+        std::unordered_set<std::string> visited;
+
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            std::string path = files[i];
+
+            if (!visited.insert(path).second)
+                continue;
+
+            bool        text = ends_with(path, ".gltf") || ends_with(path, ".obj") || ends_with(path, ".mtl");
+            std::string contents;
+
+            if (read_file(path, text, contents) && text)
+                find_dependencies(path, contents, files);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vk.h>
+#include <mesh.h>
+#include <ray_traced_scene.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "deletion_queue.h"
+#include "mesh_cache.h"
+#include "texture_streamer.h"
+
+struct SceneDescription
+{
+    struct Instance
+    {
+        uint32_t  mesh; // Index into the meshes of the description.
+        glm::mat4 transform;
+    };
+
+    std::string              name;
+    std::vector<std::string> meshes;
+    std::vector<Instance>    instances;
+
+    // For instances placed relative to the loaded meshes, e.g. along the extents of another mesh. Appended after the fixed instances.
+    std::function<void(const std::vector<dw::Mesh::Ptr>&, std::vector<Instance>&)> place_instances;
+};
+
+// Loads scenes the first time they are used rather than all of them up front, and evicts the ones that have not been
+// active for a while. The meshes of the scene expected next are baked, mapped and decoded on a background thread ahead
+// of time, so that the load itself only pays for uploading. Uploads and acceleration structure builds go through the
+// graphics queue and stay on the main thread.
+class SceneCache
+{
+public:
+    SceneCache(std::weak_ptr<dw::vk::Backend> backend, DeletionQueue* deletion_queue, TextureStreamer* texture_streamer, const std::vector<SceneDescription>& descriptions);
+    ~SceneCache();
+
+    // Returns the scene, loading it first if needed.
+    dw::RayTracedScene::Ptr acquire(uint32_t scene);
+
+    // Prepares the meshes of the scene on the background thread, unless it is already loaded.
+    void prefetch(uint32_t scene);
+
+    // Has to be called once per frame, after the deletion queue has been flushed.
+    void update(uint32_t active_scene);
+    void gui();
+
+    inline bool  loaded(uint32_t scene) { return m_entries[scene].scene != nullptr; }
+    inline float eviction_timeout() { return m_eviction_timeout; }
+    inline void  set_eviction_timeout(float value) { m_eviction_timeout = value; }
+
+private:
+    struct Entry
+    {
+        std::vector<dw::Mesh::Ptr>                    meshes;
+        dw::RayTracedScene::Ptr                       scene;
+        double                                        last_used = 0.0;
+        std::vector<std::shared_ptr<MeshCache::Data>> prefetched; // Guarded by the prefetch mutex.
+    };
+
+    void load(uint32_t scene);
+    void evict(uint32_t scene);
+    void prefetch_meshes();
+
+private:
+    std::weak_ptr<dw::vk::Backend> m_backend;
+    DeletionQueue*                 m_deletion_queue;
+    TextureStreamer*               m_texture_streamer;
+    std::vector<SceneDescription>  m_descriptions;
+    std::vector<Entry>             m_entries;
+    float                          m_eviction_timeout = 120.0f; // In seconds, zero keeps every scene loaded once used.
+    std::thread                    m_prefetch_thread;
+    std::mutex                     m_prefetch_mutex;
+    std::condition_variable        m_prefetch_condition;
+    std::deque<uint32_t>           m_prefetch_queue;
+    int32_t                        m_prefetching   = -1; // Scene the background thread is preparing.
+    bool                           m_prefetch_quit = false;
+};
@@ -0,0 +1,27 @@
+#include "shader_library.h"
+#include <logger.h>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::ShaderModule::Ptr ShaderLibrary::load(dw::vk::Backend::Ptr backend, const std::string& path)
+{
+#if defined(HYBRID_RENDERING_EMBED_SHADERS)
+    for (size_t i = 0; i < kNumEmbeddedShaders; i++)
+    {
+        const EmbeddedShader& shader = kEmbeddedShaders[i];
+
+        if (path == shader.path)
+        {
+            std::vector<char> spirv(shader.code, shader.code + shader.size);
+            return dw::vk::ShaderModule::create(backend, spirv);
+        }
+    }
+
+    DW_LOG_ERROR("Shader is not embedded, loading it from disk: " + path);
+#endif
+
+    return dw::vk::ShaderModule::create_from_file(backend, path);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
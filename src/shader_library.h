@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vk.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+struct EmbeddedShader
+{
+    const char*    path;
+    const uint8_t* code;
+    size_t         size;
+};
+
+#if defined(HYBRID_RENDERING_EMBED_SHADERS)
+// Defined in the source generated by cmake/EmbedShaders.cmake.
+extern const EmbeddedShader kEmbeddedShaders[];
+extern const size_t         kNumEmbeddedShaders;
+#endif
+
+// Creates shader modules from the SPIR-V embedded into the executable when it is built with
+// HYBRID_RENDERING_EMBED_SHADERS, and from the files next to the executable otherwise.
+class ShaderLibrary
+{
+public:
+    static dw::vk::ShaderModule::Ptr load(dw::vk::Backend::Ptr backend, const std::string& path);
+};
@@ -23,4 +23,20 @@ float sample_blue_noise(ivec2 coord, int sample_index, int sample_dimension, sam
 	return v;
 }
 
+// Must match BlueNoise::kSpatiotemporalSize and kSpatiotemporalDepth.
+#define SPATIOTEMPORAL_BLUE_NOISE_SIZE 64
+#define SPATIOTEMPORAL_BLUE_NOISE_DEPTH 32
+
+#define BLUE_NOISE_SAMPLER_SOBOL 0
+#define BLUE_NOISE_SAMPLER_SPATIOTEMPORAL 1
+
+vec2 sample_spatiotemporal_blue_noise(ivec2 coord, int frame, sampler2DArray spatiotemporal_tex)
+{
+	// wrap arguments, every frame reads the next layer
+	ivec3 texel = ivec3(coord % SPATIOTEMPORAL_BLUE_NOISE_SIZE, frame % SPATIOTEMPORAL_BLUE_NOISE_DEPTH);
+
+	// one fetch holds both dimensions, centered within their 256 levels like sample_blue_noise()
+	return (texelFetch(spatiotemporal_tex, texel, 0).rg * 255.0f + 0.5f) / 256.0f;
+}
+
 #endif
\ No newline at end of file
@@ -155,6 +155,46 @@ vec3 octohedral_to_direction(vec2 e)
     return normalize(v);
 }
 
+// ------------------------------------------------------------------------
+
+// A simple utility to convert a float to a 2-component octohedral representation
+vec2 direction_to_octohedral(vec3 normal)
+{
+    vec2 p = normal.xy * (1.0f / dot(abs(normal), vec3(1.0f)));
+    return normal.z > 0.0f ? p : (1.0f - abs(p.yx)) * (step(0.0f, p) * 2.0f - vec2(1.0f));
+}
+
+// ------------------------------------------------------------------------
+
+// G-buffer normals are octahedral encoded and stored in the [0, 1] range of a UNORM target.
+vec2 pack_normal(vec3 n)
+{
+    return direction_to_octohedral(n) * 0.5 + 0.5;
+}
+
+// ------------------------------------------------------------------------
+
+vec3 unpack_normal(vec2 e)
+{
+    return octohedral_to_direction(e * 2.0 - 1.0);
+}
+
+// ------------------------------------------------------------------------
+
+vec2 compute_motion_vector(vec4 prev_pos, vec4 current_pos)
+{
+    // Perspective division, covert clip space positions to NDC.
+    vec2 current = (current_pos.xy / current_pos.w);
+    vec2 prev    = (prev_pos.xy / prev_pos.w);
+
+    // Remap to [0, 1] range
+    current = current * 0.5 + 0.5;
+    prev    = prev * 0.5 + 0.5;
+
+    // Calculate velocity (current -> prev)
+    return (prev - current);
+}
+
 // ------------------------------------------------------------------
 
 float gaussian_weight(float offset, float deviation)
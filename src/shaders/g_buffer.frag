@@ -3,6 +3,8 @@
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_nonuniform_qualifier : require
 
+#define TEXTURE_FEEDBACK
+
 #include "common.glsl"
 #include "scene_descriptor_set.glsl"
 
@@ -17,14 +19,17 @@ layout(location = 3) in vec3 FS_IN_Tangent;
 layout(location = 4) in vec3 FS_IN_Bitangent;
 layout(location = 5) in vec4 FS_IN_CSPos;
 layout(location = 6) in vec4 FS_IN_PrevCSPos;
+layout(location = 7) flat in uint FS_IN_MaterialIdx;
+layout(location = 8) flat in uint FS_IN_MeshID;
 
 // ------------------------------------------------------------------------
 // OUTPUTS ----------------------------------------------------------------
 // ------------------------------------------------------------------------
 
 layout(location = 0) out vec4 FS_OUT_GBuffer1; // RGB: Albedo, A: Metallic
-layout(location = 1) out vec4 FS_OUT_GBuffer2; // RG: Normal, BA: Motion Vector
-layout(location = 2) out vec4 FS_OUT_GBuffer3; // R: Roughness, G: Curvature, B: Mesh ID, A: Linear Z
+layout(location = 1) out vec4 FS_OUT_GBuffer2; // RG: Normal, B: Roughness
+layout(location = 2) out vec4 FS_OUT_GBuffer3; // RG: Motion Vector, B: Curvature, A: Linear Z
+layout(location = 3) out uint FS_OUT_MeshID;
 
 // ------------------------------------------------------------------------
 // PUSH CONSTANTS ---------------------------------------------------------
@@ -32,9 +37,6 @@ layout(location = 2) out vec4 FS_OUT_GBuffer3; // R: Roughness, G: Curvature, B:
 
 layout(push_constant) uniform PushConstants
 {
-    mat4  model;
-    uint  material_idx;
-    uint  mesh_id;
     float roughness_multiplier;
 }
 u_PushConstants;
@@ -43,31 +45,6 @@ u_PushConstants;
 // FUNCTIONS --------------------------------------------------------------
 // ------------------------------------------------------------------------
 
-// A simple utility to convert a float to a 2-component octohedral representation
-vec2 direction_to_octohedral(vec3 normal)
-{
-    vec2 p = normal.xy * (1.0f / dot(abs(normal), vec3(1.0f)));
-    return normal.z > 0.0f ? p : (1.0f - abs(p.yx)) * (step(0.0f, p) * 2.0f - vec2(1.0f));
-}
-
-// ------------------------------------------------------------------------
-
-vec2 compute_motion_vector(vec4 prev_pos, vec4 current_pos)
-{
-    // Perspective division, covert clip space positions to NDC.
-    vec2 current = (current_pos.xy / current_pos.w);
-    vec2 prev    = (prev_pos.xy / prev_pos.w);
-
-    // Remap to [0, 1] range
-    current = current * 0.5 + 0.5;
-    prev    = prev * 0.5 + 0.5;
-
-    // Calculate velocity (current -> prev)
-    return (prev - current);
-}
-
-// ------------------------------------------------------------------------
-
 float compute_curvature(float depth)
 {
     vec3 dx = dFdx(FS_IN_Normal);
@@ -85,7 +62,12 @@ float compute_curvature(float depth)
 
 void main()
 {
-    const Material material = Materials.data[u_PushConstants.material_idx];
+    const Material material = fetch_material(FS_IN_MaterialIdx);
+    const uint     texels   = texture_feedback_texels(FS_IN_TexCoord);
+
+    // One pixel out of every 4x4 is plenty to find the mips that are needed.
+    if (all(equal(ivec2(gl_FragCoord.xy) & 3, ivec2(0))))
+        write_material_feedback(material, texels);
 
     vec4 albedo = fetch_albedo(material, FS_IN_TexCoord);
 
@@ -97,18 +79,20 @@ void main()
     FS_OUT_GBuffer1.a   = fetch_metallic(material, FS_IN_TexCoord);
 
     // G-Buffer 2
-    vec2 packed_normal = direction_to_octohedral(fetch_normal(material, normalize(FS_IN_Tangent), normalize(FS_IN_Bitangent), normalize(FS_IN_Normal), FS_IN_TexCoord));
-    vec2 motion_vector = compute_motion_vector(FS_IN_PrevCSPos, FS_IN_CSPos);
+    vec2  packed_normal = pack_normal(fetch_normal(material, normalize(FS_IN_Tangent), normalize(FS_IN_Bitangent), normalize(FS_IN_Normal), FS_IN_TexCoord));
+    float roughness     = fetch_roughness(material, FS_IN_TexCoord) * u_PushConstants.roughness_multiplier;
 
-    FS_OUT_GBuffer2 = vec4(packed_normal, motion_vector);
+    FS_OUT_GBuffer2 = vec4(packed_normal, clamp(roughness, 0.0, 1.0), 0.0);
 
     // G-Buffer 3
-    float roughness = fetch_roughness(material, FS_IN_TexCoord) * u_PushConstants.roughness_multiplier;
-    float linear_z  = gl_FragCoord.z / gl_FragCoord.w;
-    float curvature = compute_curvature(linear_z);
-    float mesh_id   = float(u_PushConstants.mesh_id);
+    vec2  motion_vector = compute_motion_vector(FS_IN_PrevCSPos, FS_IN_CSPos);
+    float linear_z      = gl_FragCoord.z / gl_FragCoord.w;
+    float curvature     = compute_curvature(linear_z);
+
+    FS_OUT_GBuffer3 = vec4(motion_vector, curvature, linear_z);
 
-    FS_OUT_GBuffer3 = vec4(roughness, curvature, mesh_id, linear_z);
+    // Mesh IDs only need to tell neighbouring surfaces apart, they wrap past 16 bits.
+    FS_OUT_MeshID = FS_IN_MeshID & 0xFFFF;
 }
 
 // ------------------------------------------------------------------------
\ No newline at end of file
@@ -3,6 +3,7 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "common.glsl"
+#include "g_buffer_draws.glsl"
 
 // ------------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------------
@@ -25,6 +26,8 @@ layout(location = 3) out vec3 FS_IN_Tangent;
 layout(location = 4) out vec3 FS_IN_Bitangent;
 layout(location = 5) out vec4 FS_IN_CSPos;
 layout(location = 6) out vec4 FS_IN_PrevCSPos;
+layout(location = 7) flat out uint FS_IN_MaterialIdx;
+layout(location = 8) flat out uint FS_IN_MeshID;
 
 out gl_PerVertex
 {
@@ -48,16 +51,26 @@ layout(set = 1, binding = 0) uniform PerFrameUBO
 }
 u_GlobalUBO;
 
+layout(set = 2, binding = 0, std430) readonly buffer DrawBuffer
+{
+    DrawData data[];
+}
+Draws;
+
+layout(set = 2, binding = 2, std430) readonly buffer VisibleDrawBuffer
+{
+    uint data[];
+}
+VisibleDraws;
+
 // ------------------------------------------------------------------------
 // PUSH CONSTANTS ---------------------------------------------------------
 // ------------------------------------------------------------------------
 
+// Zero unless the indirect commands cannot carry their first instance, see DrawCuller.
 layout(push_constant) uniform PushConstants
 {
-    mat4  model;
-    uint  material_idx;
-    uint  mesh_id;
-    float roughness_multiplier;
+    layout(offset = 16) uint first_instance;
 }
 u_PushConstants;
 
@@ -67,11 +80,15 @@ u_PushConstants;
 
 void main()
 {
+    // Every instance of an indirect draw is one of the visible draws of its submesh
+    uint     draw_idx = VisibleDraws.data[u_PushConstants.first_instance + gl_InstanceIndex];
+    DrawData draw     = Draws.data[draw_idx];
+
     // Transform position into world space
-    vec4 world_pos      = u_PushConstants.model * vec4(VS_IN_Position, 1.0);
+    vec4 world_pos      = draw.model * vec4(VS_IN_Position, 1.0);
 
     // Since this demo has static scenes we can use the current Model matrix as the previous one
-    vec4 prev_world_pos = u_PushConstants.model * vec4(VS_IN_Position, 1.0);
+    vec4 prev_world_pos = draw.model * vec4(VS_IN_Position, 1.0);
 
     // Transform world position into clip space
     gl_Position = u_GlobalUBO.view_proj * world_pos;
@@ -87,11 +104,15 @@ void main()
     FS_IN_Texcoord = VS_IN_Texcoord;
 
     // Transform vertex normal into world space
-    mat3 normal_mat = mat3(u_PushConstants.model);
+    mat3 normal_mat = mat3(draw.model);
 
     FS_IN_Normal    = normal_mat * VS_IN_Normal;
     FS_IN_Tangent   = normal_mat * VS_IN_Tangent;
     FS_IN_Bitangent = normal_mat * VS_IN_Bitangent;
+
+    // Draws are numbered in the order of the instances and their submeshes, which is what mesh IDs are
+    FS_IN_MaterialIdx = draw.material_idx;
+    FS_IN_MeshID      = draw_idx;
 }
 
 // ------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,176 @@
+// Body of g_buffer_downsample.comp and g_buffer_downsample_fallback.comp, which define the storage formats of the G-buffer
+// targets that depend on device support.
+
+// ------------------------------------------------------------------
+// DEFINES ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define NUM_THREADS_X 8
+#define NUM_THREADS_Y 8
+#define NUM_MIP_LEVELS 3
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = NUM_THREADS_X, local_size_y = NUM_THREADS_Y, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// DESCRIPTOR SETS --------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(set = 0, binding = 0) uniform sampler2D s_Depth;
+
+// The first mip of every target is read through the same kind of view the other mips are written through, so that the
+// whole image stays in a single layout for the dispatch.
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D i_Depth[NUM_MIP_LEVELS];
+layout(set = 0, binding = 2, rgba8) uniform image2D i_GBuffer1[NUM_MIP_LEVELS]; // RGB: Albedo, A: Metallic
+layout(set = 0, binding = 3, GBUFFER_2_IMAGE_FORMAT) uniform image2D i_GBuffer2[NUM_MIP_LEVELS]; // RG: Normal, B: Roughness
+layout(set = 0, binding = 4, rgba16f) uniform image2D i_GBuffer3[NUM_MIP_LEVELS]; // RG: Motion Vector, B: Curvature, A: Linear Z
+layout(set = 0, binding = 5, GBUFFER_MESH_ID_IMAGE_FORMAT) uniform uimage2D i_GBufferMeshID[NUM_MIP_LEVELS];
+
+// ------------------------------------------------------------------------
+// PUSH CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(push_constant) uniform PushConstants
+{
+    uint num_levels;
+}
+u_PushConstants;
+
+// ------------------------------------------------------------------
+// SHARED MEMORY ----------------------------------------------------
+// ------------------------------------------------------------------
+
+// Texel of the first mip that every texel of the second one was taken from.
+shared float g_Depth[NUM_THREADS_Y][NUM_THREADS_X];
+shared uint  g_Coord[NUM_THREADS_Y][NUM_THREADS_X];
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+uint pack_coord(ivec2 coord)
+{
+    return uint(coord.x) | (uint(coord.y) << 16);
+}
+
+// ------------------------------------------------------------------
+
+ivec2 unpack_coord(uint coord)
+{
+    return ivec2(coord & 0xFFFF, coord >> 16);
+}
+
+// ------------------------------------------------------------------
+
+// Averaging depth, normals or mesh IDs produces surfaces that do not exist, so every texel of a mip is a copy of one
+// texel of the first mip. Alternating between the closest and the farthest of each 2x2 in a checkerboard keeps both
+// sides of a depth discontinuity in the mip, which the upsampling filters of the ray traced passes rely on.
+bool is_closest_texel(ivec2 coord)
+{
+    return ((coord.x + coord.y) & 1) == 0;
+}
+
+// ------------------------------------------------------------------
+
+// The comparisons are inclusive so that the first candidate is always taken, even if it lies on the far plane.
+void select_texel(bool closest, float candidate_depth, uint candidate_coord, inout float depth, inout uint coord)
+{
+    if (closest ? candidate_depth <= depth : candidate_depth >= depth)
+    {
+        depth = candidate_depth;
+        coord = candidate_coord;
+    }
+}
+
+// ------------------------------------------------------------------
+
+void store_texel(uint level, ivec2 coord, ivec2 source_coord, float depth)
+{
+    vec4 g_buffer_1 = imageLoad(i_GBuffer1[0], source_coord);
+    vec4 g_buffer_2 = imageLoad(i_GBuffer2[0], source_coord);
+    vec4 g_buffer_3 = imageLoad(i_GBuffer3[0], source_coord);
+    uint mesh_id    = imageLoad(i_GBufferMeshID[0], source_coord).r;
+
+    if (level == 1)
+    {
+        imageStore(i_Depth[1], coord, vec4(depth));
+        imageStore(i_GBuffer1[1], coord, g_buffer_1);
+        imageStore(i_GBuffer2[1], coord, g_buffer_2);
+        imageStore(i_GBuffer3[1], coord, g_buffer_3);
+        imageStore(i_GBufferMeshID[1], coord, uvec4(mesh_id));
+    }
+    else
+    {
+        imageStore(i_Depth[2], coord, vec4(depth));
+        imageStore(i_GBuffer1[2], coord, g_buffer_1);
+        imageStore(i_GBuffer2[2], coord, g_buffer_2);
+        imageStore(i_GBuffer3[2], coord, g_buffer_3);
+        imageStore(i_GBufferMeshID[2], coord, uvec4(mesh_id));
+    }
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Every workgroup covers a 16x16 tile of the first mip: each thread copies the depth of a 2x2 quad and reduces it to one
+// texel of the second mip, a quarter of the threads then reduce those through shared memory to the third mip. The
+// ray traced passes never go below quarter resolution, so a single dispatch covers every mip without synchronizing
+// workgroups.
+void main()
+{
+    const ivec2 size       = textureSize(s_Depth, 0);
+    const ivec2 coord      = ivec2(gl_GlobalInvocationID.xy);
+    const ivec2 local_id   = ivec2(gl_LocalInvocationID.xy);
+    const bool  closest    = is_closest_texel(coord);
+    const ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+
+    float depth          = closest ? 1.0 : 0.0;
+    uint  selected_coord = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 source_coord = coord * 2 + offsets[i];
+
+        // Odd sizes leave a last row or column of the first mip that no texel of the second one covers, it still
+        // needs to be copied.
+        if (all(lessThan(source_coord, size)))
+            imageStore(i_Depth[0], source_coord, texelFetch(s_Depth, source_coord, 0));
+
+        source_coord = min(source_coord, size - 1);
+
+        select_texel(closest, texelFetch(s_Depth, source_coord, 0).r, pack_coord(source_coord), depth, selected_coord);
+    }
+
+    if (u_PushConstants.num_levels > 1 && all(lessThan(coord, imageSize(i_GBuffer1[1]))))
+        store_texel(1, coord, unpack_coord(selected_coord), depth);
+
+    g_Depth[local_id.y][local_id.x] = depth;
+    g_Coord[local_id.y][local_id.x] = selected_coord;
+
+    barrier();
+
+    if (u_PushConstants.num_levels > 2 && all(lessThan(local_id, ivec2(NUM_THREADS_X, NUM_THREADS_Y) / 2)))
+    {
+        const ivec2 level_coord   = ivec2(gl_WorkGroupID.xy) * ivec2(NUM_THREADS_X, NUM_THREADS_Y) / 2 + local_id;
+        const bool  level_closest = is_closest_texel(level_coord);
+
+        float level_depth          = level_closest ? 1.0 : 0.0;
+        uint  level_selected_coord = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            ivec2 shared_coord = local_id * 2 + offsets[i];
+
+            select_texel(level_closest, g_Depth[shared_coord.y][shared_coord.x], g_Coord[shared_coord.y][shared_coord.x], level_depth, level_selected_coord);
+        }
+
+        if (all(lessThan(level_coord, imageSize(i_GBuffer1[2]))))
+            store_texel(2, level_coord, unpack_coord(level_selected_coord), level_depth);
+    }
+}
+
+// ------------------------------------------------------------------
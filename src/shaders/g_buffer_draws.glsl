@@ -0,0 +1,38 @@
+#ifndef G_BUFFER_DRAWS_GLSL
+#define G_BUFFER_DRAWS_GLSL
+
+// ------------------------------------------------------------------------
+// STRUCTURES -------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+// A submesh of an instance, see DrawCuller.
+struct DrawData
+{
+    mat4 model;
+    vec4 center;  // xyz: Center of the world space bounds
+    vec4 extents; // xyz: Half extents of the world space bounds
+    uint material_idx;
+    uint index_count;
+    uint first_index;
+    int  vertex_offset;
+    uint group;          // Instanced command of the submesh the draw belongs to
+    uint first_instance; // First slot of the group in the visible draws of a phase
+    uint instance_idx;   // Instance of the scene the draw belongs to
+    uint padding;
+};
+
+// ------------------------------------------------------------------------
+
+// Same layout as VkDrawIndexedIndirectCommand.
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int  vertex_offset;
+    uint first_instance;
+};
+
+// ------------------------------------------------------------------------
+
+#endif
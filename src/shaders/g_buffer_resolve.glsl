@@ -0,0 +1,216 @@
+// Body of g_buffer_resolve.comp and g_buffer_resolve_fallback.comp, which define the storage formats of the G-buffer
+// targets that depend on device support.
+
+#define TEXTURE_FEEDBACK
+#define TEXTURE_GRADIENTS
+
+#include "common.glsl"
+#include "scene_descriptor_set.glsl"
+#include "g_buffer_draws.glsl"
+
+// ------------------------------------------------------------------
+// DEFINES ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#define NUM_THREADS_X 8
+#define NUM_THREADS_Y 8
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(local_size_x = NUM_THREADS_X, local_size_y = NUM_THREADS_Y, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// DESCRIPTOR SETS --------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(set = 1, binding = 0) uniform PerFrameUBO
+{
+    mat4  view_inverse;
+    mat4  proj_inverse;
+    mat4  view_proj_inverse;
+    mat4  prev_view_proj;
+    mat4  view_proj;
+    vec4  cam_pos;
+    vec4  current_prev_jitter;
+    Light light;
+}
+u_GlobalUBO;
+
+layout(set = 2, binding = 0, std430) readonly buffer DrawBuffer
+{
+    DrawData data[];
+}
+Draws;
+
+layout(set = 3, binding = 0) uniform usampler2D s_Visibility; // R: Draw Index + 1, G: Primitive ID
+layout(set = 3, binding = 1, rgba8) uniform writeonly image2D i_GBuffer1; // RGB: Albedo, A: Metallic
+layout(set = 3, binding = 2, GBUFFER_2_IMAGE_FORMAT) uniform writeonly image2D i_GBuffer2; // RG: Normal, B: Roughness
+layout(set = 3, binding = 3, rgba16f) uniform writeonly image2D i_GBuffer3; // RG: Motion Vector, B: Curvature, A: Linear Z
+layout(set = 3, binding = 4, GBUFFER_MESH_ID_IMAGE_FORMAT) uniform writeonly uimage2D i_GBufferMeshID;
+
+// ------------------------------------------------------------------------
+// PUSH CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(push_constant) uniform PushConstants
+{
+    float roughness_multiplier;
+}
+u_PushConstants;
+
+// ------------------------------------------------------------------
+// STRUCTURES -------------------------------------------------------
+// ------------------------------------------------------------------
+
+struct Barycentrics
+{
+    vec3 lambda;
+    vec3 ddx; // Change over one pixel to the right
+    vec3 ddy; // Change over one pixel down
+};
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Perspective correct barycentrics of a pixel and their screen space derivatives, computed analytically from the clip
+// space positions of the triangle ("Deferred Attribute Interpolation for Memory-Efficient Deferred Shading", Schied
+// and Dachsbacher 2015). The derivatives stand in for the ones the rasterizer would provide.
+Barycentrics compute_barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 ndc, vec2 size)
+{
+    vec3 inv_w = 1.0 / vec3(p0.w, p1.w, p2.w);
+
+    vec2 ndc0 = p0.xy * inv_w.x;
+    vec2 ndc1 = p1.xy * inv_w.y;
+    vec2 ndc2 = p2.xy * inv_w.z;
+
+    // Derivatives of the barycentrics divided by w along NDC x and y.
+    float inv_det = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3  ddx     = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * inv_det * inv_w;
+    vec3  ddy     = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * inv_det * inv_w;
+    float ddx_sum = dot(ddx, vec3(1.0));
+    float ddy_sum = dot(ddy, vec3(1.0));
+
+    vec2  delta        = ndc - ndc0;
+    float interp_inv_w = inv_w.x + delta.x * ddx_sum + delta.y * ddy_sum;
+
+    Barycentrics result;
+
+    result.lambda = (vec3(inv_w.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy) / interp_inv_w;
+
+    // A pixel is 2 / size wide in NDC.
+    ddx *= 2.0 / size.x;
+    ddy *= 2.0 / size.y;
+    ddx_sum *= 2.0 / size.x;
+    ddy_sum *= 2.0 / size.y;
+
+    result.ddx = (result.lambda * interp_inv_w + ddx) / (interp_inv_w + ddx_sum) - result.lambda;
+    result.ddy = (result.lambda * interp_inv_w + ddy) / (interp_inv_w + ddy_sum) - result.lambda;
+
+    return result;
+}
+
+// ------------------------------------------------------------------
+
+vec3 interpolate(vec3 a, vec3 b, vec3 c, vec3 weights)
+{
+    return a * weights.x + b * weights.y + c * weights.z;
+}
+
+// ------------------------------------------------------------------
+
+vec2 interpolate(vec2 a, vec2 b, vec2 c, vec3 weights)
+{
+    return a * weights.x + b * weights.y + c * weights.z;
+}
+
+// ------------------------------------------------------------------
+// MAIN -------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    const ivec2 size  = imageSize(i_GBuffer1);
+    const ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(coord, size)))
+        return;
+
+    const uvec2 visibility = texelFetch(s_Visibility, coord, 0).rg;
+
+    // Pixels nothing was drawn to get the values the targets of the MRT G-buffer are cleared to.
+    if (visibility.x == 0)
+    {
+        imageStore(i_GBuffer1, coord, vec4(0.0));
+        imageStore(i_GBuffer2, coord, vec4(0.0));
+        imageStore(i_GBuffer3, coord, vec4(0.0, 0.0, 0.0, -1.0));
+        imageStore(i_GBufferMeshID, coord, uvec4(0));
+        return;
+    }
+
+    const uint     draw_idx = visibility.x - 1;
+    const DrawData draw     = Draws.data[draw_idx];
+    const uint     mesh_idx = Instances.data[draw.instance_idx].mesh_idx;
+    const Material material = fetch_material(draw.material_idx);
+
+    // Fetch the triangle the same way the indexed draw did.
+    Vertex v[3];
+    vec4   clip_pos[3];
+
+    for (uint i = 0; i < 3; i++)
+    {
+        uint idx = Indices[nonuniformEXT(mesh_idx)].data[draw.first_index + 3 * visibility.y + i];
+
+        v[i]        = get_vertex(mesh_idx, uint(draw.vertex_offset + int(idx)));
+        clip_pos[i] = u_GlobalUBO.view_proj * draw.model * vec4(v[i].position.xyz, 1.0);
+    }
+
+    const vec2         tex_coord = (vec2(coord) + vec2(0.5)) / vec2(size);
+    const Barycentrics bary      = compute_barycentrics(clip_pos[0], clip_pos[1], clip_pos[2], tex_coord * 2.0 - 1.0, vec2(size));
+
+    // Interpolate the attributes the vertex shader of the MRT G-buffer passes on.
+    const mat3 normal_mat = mat3(draw.model);
+
+    vec3 position  = interpolate(v[0].position.xyz, v[1].position.xyz, v[2].position.xyz, bary.lambda);
+    vec2 texcoord  = interpolate(v[0].tex_coord.xy, v[1].tex_coord.xy, v[2].tex_coord.xy, bary.lambda);
+    vec3 normal    = normal_mat * interpolate(v[0].normal.xyz, v[1].normal.xyz, v[2].normal.xyz, bary.lambda);
+    vec3 tangent   = normal_mat * interpolate(v[0].tangent.xyz, v[1].tangent.xyz, v[2].tangent.xyz, bary.lambda);
+    vec3 bitangent = normal_mat * interpolate(v[0].bitangent.xyz, v[1].bitangent.xyz, v[2].bitangent.xyz, bary.lambda);
+
+    g_TexCoordDx = interpolate(v[0].tex_coord.xy, v[1].tex_coord.xy, v[2].tex_coord.xy, bary.ddx);
+    g_TexCoordDy = interpolate(v[0].tex_coord.xy, v[1].tex_coord.xy, v[2].tex_coord.xy, bary.ddy);
+
+    // One pixel out of every 4x4 is plenty to find the mips that are needed.
+    if (all(equal(coord & 3, ivec2(0))))
+        write_material_feedback(material, texture_feedback_texels(g_TexCoordDx, g_TexCoordDy));
+
+    // G-Buffer 1
+    vec4 albedo = fetch_albedo(material, texcoord);
+
+    imageStore(i_GBuffer1, coord, vec4(albedo.rgb, fetch_metallic(material, texcoord)));
+
+    // G-Buffer 2
+    vec2  packed_normal = pack_normal(fetch_normal(material, normalize(tangent), normalize(bitangent), normalize(normal), texcoord));
+    float roughness     = fetch_roughness(material, texcoord) * u_PushConstants.roughness_multiplier;
+
+    imageStore(i_GBuffer2, coord, vec4(packed_normal, clamp(roughness, 0.0, 1.0), 0.0));
+
+    // G-Buffer 3, scenes are static so the current model matrix is also the previous one.
+    vec4 world_pos = draw.model * vec4(position, 1.0);
+    vec4 cs_pos    = u_GlobalUBO.view_proj * world_pos;
+    vec4 prev_pos  = u_GlobalUBO.prev_view_proj * world_pos;
+
+    vec3  normal_dx = normal_mat * interpolate(v[0].normal.xyz, v[1].normal.xyz, v[2].normal.xyz, bary.ddx);
+    vec3  normal_dy = normal_mat * interpolate(v[0].normal.xyz, v[1].normal.xyz, v[2].normal.xyz, bary.ddy);
+    float curvature = sqrt(max(dot(normal_dx, normal_dx), dot(normal_dy, normal_dy)));
+
+    // The clip space z of the pixel is the gl_FragCoord.z / gl_FragCoord.w the MRT G-buffer stores.
+    imageStore(i_GBuffer3, coord, vec4(compute_motion_vector(prev_pos, cs_pos), curvature, cs_pos.z));
+
+    // Mesh IDs only need to tell neighbouring surfaces apart, they wrap past 16 bits.
+    imageStore(i_GBufferMeshID, coord, uvec4(draw_idx & 0xFFFF));
+}
+
+// ------------------------------------------------------------------
\ No newline at end of file
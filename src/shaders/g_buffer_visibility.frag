@@ -0,0 +1,37 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "common.glsl"
+#include "scene_descriptor_set.glsl"
+
+// ------------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 0) in vec2 FS_IN_TexCoord;
+layout(location = 1) flat in uint FS_IN_MaterialIdx;
+layout(location = 2) flat in uint FS_IN_DrawIdx;
+
+// ------------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 0) out uvec2 FS_OUT_Visibility; // R: Draw Index + 1, G: Primitive ID
+
+// ------------------------------------------------------------------------
+// MAIN -------------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+void main()
+{
+    // Only drawn for materials that can fail the alpha test, which is the only material work done per fragment.
+    if (fetch_albedo(fetch_material(FS_IN_MaterialIdx), FS_IN_TexCoord).a < 0.1)
+        discard;
+
+    // Zero is left for pixels nothing was drawn to.
+    FS_OUT_Visibility = uvec2(FS_IN_DrawIdx + 1, gl_PrimitiveID);
+}
+
+// ------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,86 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+#include "g_buffer_draws.glsl"
+
+// ------------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 0) in vec3 VS_IN_Position;
+layout(location = 1) in vec2 VS_IN_Texcoord;
+
+// ------------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 0) out vec2 FS_IN_Texcoord;
+layout(location = 1) flat out uint FS_IN_MaterialIdx;
+layout(location = 2) flat out uint FS_IN_DrawIdx;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+// ------------------------------------------------------------------------
+// DESCRIPTOR SETS --------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(set = 1, binding = 0) uniform PerFrameUBO
+{
+    mat4  view_inverse;
+    mat4  proj_inverse;
+    mat4  view_proj_inverse;
+    mat4  prev_view_proj;
+    mat4  view_proj;
+    vec4  cam_pos;
+    vec4  current_prev_jitter;
+    Light light;
+}
+u_GlobalUBO;
+
+layout(set = 2, binding = 0, std430) readonly buffer DrawBuffer
+{
+    DrawData data[];
+}
+Draws;
+
+layout(set = 2, binding = 2, std430) readonly buffer VisibleDrawBuffer
+{
+    uint data[];
+}
+VisibleDraws;
+
+// ------------------------------------------------------------------------
+// PUSH CONSTANTS ---------------------------------------------------------
+// ------------------------------------------------------------------------
+
+// Zero unless the indirect commands cannot carry their first instance, see DrawCuller.
+layout(push_constant) uniform PushConstants
+{
+    layout(offset = 16) uint first_instance;
+}
+u_PushConstants;
+
+// ------------------------------------------------------------------------
+// MAIN -------------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+void main()
+{
+    // Every instance of an indirect draw is one of the visible draws of its submesh
+    uint     draw_idx = VisibleDraws.data[u_PushConstants.first_instance + gl_InstanceIndex];
+    DrawData draw     = Draws.data[draw_idx];
+
+    gl_Position = u_GlobalUBO.view_proj * draw.model * vec4(VS_IN_Position, 1.0);
+
+    // The texture coordinate is only needed for alpha testing
+    FS_IN_Texcoord    = VS_IN_Texcoord;
+    FS_IN_MaterialIdx = draw.material_idx;
+    FS_IN_DrawIdx     = draw_idx;
+}
+
+// ------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 460
+
+// ------------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 2) flat in uint FS_IN_DrawIdx;
+
+// ------------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+layout(location = 0) out uvec2 FS_OUT_Visibility; // R: Draw Index + 1, G: Primitive ID
+
+// ------------------------------------------------------------------------
+// MAIN -------------------------------------------------------------------
+// ------------------------------------------------------------------------
+
+void main()
+{
+    // Without a discard the depth test can run before the fragment shader.
+    FS_OUT_Visibility = uvec2(FS_IN_DrawIdx + 1, gl_PrimitiveID);
+}
+
+// ------------------------------------------------------------------------
@@ -5,6 +5,14 @@
 #define M_PI 3.14159265359
 #endif
 
+// Shaders that specialize the visibility test define DDGI_VISIBILITY_TEST_CONSTANT before including this file, which
+// lets the driver strip the branch that is not taken instead of reading the flag from the uniform buffer.
+#if defined(DDGI_VISIBILITY_TEST_CONSTANT)
+#define DDGI_VISIBILITY_TEST(ddgi) DDGI_VISIBILITY_TEST_CONSTANT
+#else
+#define DDGI_VISIBILITY_TEST(ddgi) (ddgi.visibility_test == 1)
+#endif
+
 // ------------------------------------------------------------------------
 
 struct DDGIUniforms
@@ -253,7 +261,7 @@ vec3 sample_irradiance(in DDGIUniforms ddgi, vec3 P, vec3 N, vec3 Wo, sampler2D
         }
 
         // Moment visibility test
-        if (ddgi.visibility_test == 1)
+        if (DDGI_VISIBILITY_TEST(ddgi))
         {
             vec2 tex_coord = texture_coord_from_direction(-dir, p, ddgi.depth_texture_width, ddgi.depth_texture_height, ddgi.depth_probe_side_length);
 
@@ -3,6 +3,8 @@
 
 // ------------------------------------------------------------------------
 
+// With LIGHT_DISK_SAMPLING defined the includer passes a random sample and declares SOFT_SHADOWS as a bool specialization
+// constant. When it is set, Wi points to a sample on the disk of the light instead of its center.
 void fetch_light_properties(
     in Light light,
 #if !defined(SHADOW_RAY_ONLY)    
@@ -10,7 +12,7 @@ void fetch_light_properties(
 #endif    
     in vec3 P,
     in vec3 N,
-#if defined(SOFT_SHADOWS)
+#if defined(LIGHT_DISK_SAMPLING)
     in vec2 rng,
 #endif 
 #if !defined(SHADOW_RAY_ONLY)
@@ -36,18 +38,21 @@ void fetch_light_properties(
     {
         vec3 light_dir       = light_direction(light);
 
-#if defined(SOFT_SHADOWS)
-        vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
-        vec3 light_bitangent = normalize(cross(light_tangent, light_dir));
-
-        // calculate disk point
-        float point_radius = light_radius(light) * sqrt(rng.x);
-        float point_angle  = rng.y * 2.0f * M_PI;
-        vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
-        Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent);
-#else
-        Wi = light_dir;
+#if defined(LIGHT_DISK_SAMPLING)
+        if (SOFT_SHADOWS)
+        {
+            vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
+            vec3 light_bitangent = normalize(cross(light_tangent, light_dir));
+
+            // calculate disk point
+            float point_radius = light_radius(light) * sqrt(rng.x);
+            float point_angle  = rng.y * 2.0f * M_PI;
+            vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
+            Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent);
+        }
+        else
 #endif
+            Wi = light_dir;
 #if defined(RAY_TRACING)
         t_max = 10000.0f;
 #endif  
@@ -59,19 +64,22 @@ void fetch_light_properties(
         vec3  light_dir       = normalize(to_light);
         float light_distance = length(to_light);
 
-#if defined(SOFT_SHADOWS)
-        vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
-        vec3 light_bitangent = normalize(cross(light_tangent, light_dir));  
+#if defined(LIGHT_DISK_SAMPLING)
+        if (SOFT_SHADOWS)
+        {
+            vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
+            vec3 light_bitangent = normalize(cross(light_tangent, light_dir));  
         
-        // calculate disk point
-        float current_light_radius = light_radius(light) / light_distance;  
-        float point_radius = current_light_radius * sqrt(rng.x);
-        float point_angle  = rng.y * 2.0f * M_PI;
-        vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
-        Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent);
-#else
-        Wi = light_dir;
+            // calculate disk point
+            float current_light_radius = light_radius(light) / light_distance;  
+            float point_radius = current_light_radius * sqrt(rng.x);
+            float point_angle  = rng.y * 2.0f * M_PI;
+            vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
+            Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent);
+        }
+        else
 #endif
+            Wi = light_dir;
 #if defined(RAY_TRACING)
         t_max = light_distance;
 #endif  
@@ -83,19 +91,22 @@ void fetch_light_properties(
         vec3  light_dir      = normalize(to_light);
         float light_distance = length(to_light);
 
-#if defined(SOFT_SHADOWS)    
-        vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
-        vec3 light_bitangent = normalize(cross(light_tangent, light_dir));  
+#if defined(LIGHT_DISK_SAMPLING)
+        if (SOFT_SHADOWS)
+        {
+            vec3 light_tangent   = normalize(cross(light_dir, vec3(0.0f, 1.0f, 0.0f)));
+            vec3 light_bitangent = normalize(cross(light_tangent, light_dir));  
         
-        // calculate disk point
-        float current_light_radius = light_radius(light) / light_distance;  
-        float point_radius = current_light_radius * sqrt(rng.x);
-        float point_angle  = rng.y * 2.0f * M_PI;
-        vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
-        Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent); 
-#else
-        Wi = light_dir;
-#endif       
+            // calculate disk point
+            float current_light_radius = light_radius(light) / light_distance;  
+            float point_radius = current_light_radius * sqrt(rng.x);
+            float point_angle  = rng.y * 2.0f * M_PI;
+            vec2  disk_point   = vec2(point_radius * cos(point_angle), point_radius * sin(point_angle));    
+            Wi = normalize(light_dir + disk_point.x * light_tangent + disk_point.y * light_bitangent);
+        }
+        else
+#endif
+            Wi = light_dir;
 #if defined(RAY_TRACING)
         t_max = light_distance;
 #endif  
@@ -125,7 +136,7 @@ vec3 direct_lighting(
 #if defined(RAY_THROUGHPUT)
   , in vec3 T
 #endif    
-#if defined(SOFT_SHADOWS)
+#if defined(LIGHT_DISK_SAMPLING)
   , in vec2 rng1
 #endif
 #if defined(SAMPLE_SKY_LIGHT)
@@ -156,7 +167,7 @@ vec3 direct_lighting(
                                Wo, 
                                P, 
                                N, 
-                            #if defined(SOFT_SHADOWS)
+                            #if defined(LIGHT_DISK_SAMPLING)
                                rng1,
                             #endif 
                                Li, 
@@ -29,7 +29,7 @@ bool out_of_frame_disocclusion_check(ivec2 coord, ivec2 image_dim)
 
 // ------------------------------------------------------------------------
 
-bool mesh_id_disocclusion_check(float mesh_id, float mesh_id_prev)
+bool mesh_id_disocclusion_check(uint mesh_id, uint mesh_id_prev)
 {
     if (mesh_id == mesh_id_prev)
         return false;
@@ -49,7 +49,7 @@ bool normals_disocclusion_check(vec3 current_normal, vec3 history_normal)
 
 // ------------------------------------------------------------------------
 
-bool is_reprojection_valid(ivec2 coord, vec3 current_pos, vec3 history_pos, vec3 current_normal, vec3 history_normal, float current_mesh_id, float history_mesh_id, ivec2 image_dim)
+bool is_reprojection_valid(ivec2 coord, vec3 current_pos, vec3 history_pos, vec3 current_normal, vec3 history_normal, uint current_mesh_id, uint history_mesh_id, ivec2 image_dim)
 {
     // check if the history sample is within the frame
     if (out_of_frame_disocclusion_check(coord, image_dim)) return false;
@@ -112,6 +112,9 @@ vec2 compute_history_coord(ivec2 current_coord, ivec2 size, float depth, vec2 mo
 
 // ------------------------------------------------------------------
 
+// The includer declares REPROJECTION_MOMENTS as a bool specialization constant. When it is set, the history texture holds
+// the moments in RG and the history length in B, otherwise it only holds the history length in R and the returned moments
+// are zero.
 bool reproject(in ivec2 frag_coord, 
                in float depth, 
                in int g_buffer_mip,
@@ -125,23 +128,18 @@ bool reproject(in ivec2 frag_coord,
             #endif   
                in sampler2D sampler_gbuffer_2,
                in sampler2D sampler_gbuffer_3,
+               in usampler2D sampler_gbuffer_mesh_id,
                in sampler2D sampler_prev_gbuffer_2,
-               in sampler2D sampler_prev_gbuffer_3,
+               in usampler2D sampler_prev_gbuffer_mesh_id,
                in sampler2D sampler_prev_gbuffer_depth,
                in sampler2D sampler_history_output,
-            #if defined(REPROJECTION_MOMENTS)               
                in sampler2D sampler_history_moments_length,
-            #else 
-               in sampler2D sampler_history_length,
-            #endif
             #if defined(REPROJECTION_SINGLE_COLOR_CHANNEL)
                out float history_color,
             #else
                out vec3  history_color, 
             #endif
-            #if defined(REPROJECTION_MOMENTS)
-               out vec2 history_moments, 
-            #endif
+               out vec2 history_moments,
                out float history_length)
 {
     const vec2  image_dim    = vec2(textureSize(sampler_history_output, 0));
@@ -151,13 +149,13 @@ bool reproject(in ivec2 frag_coord,
     const vec4 center_g_buffer_2 = texelFetch(sampler_gbuffer_2, frag_coord, g_buffer_mip);
     const vec4 center_g_buffer_3 = texelFetch(sampler_gbuffer_3, frag_coord, g_buffer_mip);
 
-    const vec2  current_motion  = center_g_buffer_2.zw;
-    const vec3  current_normal  = octohedral_to_direction(center_g_buffer_2.xy);
-    const float current_mesh_id = center_g_buffer_3.z;
+    const vec2  current_motion  = center_g_buffer_3.xy;
+    const vec3  current_normal  = unpack_normal(center_g_buffer_2.xy);
+    const uint  current_mesh_id = texelFetch(sampler_gbuffer_mesh_id, frag_coord, g_buffer_mip).r;
     const vec3  current_pos     = world_position_from_depth(tex_coord, depth, view_proj_inverse);
 
 #if defined(REPROJECTION_REFLECTIONS)
-    const float curvature = center_g_buffer_3.g;
+    const float curvature = center_g_buffer_3.b;
     const vec2 history_tex_coord = tex_coord + current_motion;
     const vec2 reprojected_coord = compute_history_coord(frag_coord, 
                                                          ivec2(image_dim), 
@@ -182,9 +180,7 @@ bool reproject(in ivec2 frag_coord,
 #else
     history_color   = vec3(0.0f);
 #endif
-#if defined(REPROJECTION_MOMENTS)    
     history_moments = vec2(0.0f);
-#endif
 
     bool        v[4];
     const ivec2 offset[4] = { ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1) };
@@ -196,11 +192,10 @@ bool reproject(in ivec2 frag_coord,
         ivec2 loc = ivec2(history_coord_floor) + offset[sample_idx];
 
         vec4  sample_g_buffer_2 = texelFetch(sampler_prev_gbuffer_2, loc, g_buffer_mip);
-        vec4  sample_g_buffer_3 = texelFetch(sampler_prev_gbuffer_3, loc, g_buffer_mip);
+        uint  history_mesh_id   = texelFetch(sampler_prev_gbuffer_mesh_id, loc, g_buffer_mip).r;
         float sample_depth      = texelFetch(sampler_prev_gbuffer_depth, loc, g_buffer_mip).r;
 
-        vec3  history_normal  = octohedral_to_direction(sample_g_buffer_2.xy);
-        float history_mesh_id = sample_g_buffer_3.z;
+        vec3  history_normal  = unpack_normal(sample_g_buffer_2.xy);
         vec3  history_pos     = world_position_from_depth(history_tex_coord, sample_depth, view_proj_inverse);
 
         v[sample_idx] = is_reprojection_valid(history_coord, current_pos, history_pos, current_normal, history_normal, current_mesh_id, history_mesh_id, ivec2(image_dim));
@@ -225,9 +220,7 @@ bool reproject(in ivec2 frag_coord,
     #else
         history_color = vec3(0.0f);
     #endif
-    #if defined(REPROJECTION_MOMENTS)         
         history_moments = vec2(0.0f);
-    #endif
 
         // perform the actual bilinear interpolation
         for (int sample_idx = 0; sample_idx < 4; sample_idx++)
@@ -241,9 +234,8 @@ bool reproject(in ivec2 frag_coord,
             #else
                 history_color += w[sample_idx] * texelFetch(sampler_history_output, loc, 0).rgb;
             #endif            
-            #if defined(REPROJECTION_MOMENTS) 
-                history_moments += w[sample_idx] * texelFetch(sampler_history_moments_length, loc, 0).rg;
-            #endif                
+                if (REPROJECTION_MOMENTS)
+                    history_moments += w[sample_idx] * texelFetch(sampler_history_moments_length, loc, 0).rg;
                 sumw += w[sample_idx];
             }
         }
@@ -255,9 +247,7 @@ bool reproject(in ivec2 frag_coord,
     #else
         history_color   = valid ? history_color / sumw : vec3(0.0f);
     #endif    
-    #if defined(REPROJECTION_MOMENTS)         
         history_moments = valid ? history_moments / sumw : vec2(0.0f);
-    #endif
     }
     if (!valid) // perform cross-bilateral filter in the hope to find some suitable samples somewhere
     {
@@ -272,11 +262,10 @@ bool reproject(in ivec2 frag_coord,
                 ivec2 p = history_coord + ivec2(xx, yy);
 
                 vec4  sample_g_buffer_2 = texelFetch(sampler_prev_gbuffer_2, p, g_buffer_mip);
-                vec4  sample_g_buffer_3 = texelFetch(sampler_prev_gbuffer_3, p, g_buffer_mip);
+                uint  history_mesh_id   = texelFetch(sampler_prev_gbuffer_mesh_id, p, g_buffer_mip).r;
                 float sample_depth      = texelFetch(sampler_prev_gbuffer_depth, p, g_buffer_mip).r;
 
-                vec3  history_normal  = octohedral_to_direction(sample_g_buffer_2.xy);
-                float history_mesh_id = sample_g_buffer_3.z;
+                vec3  history_normal  = unpack_normal(sample_g_buffer_2.xy);
                 vec3  history_pos     = world_position_from_depth(history_tex_coord, sample_depth, view_proj_inverse);
 
                 if (is_reprojection_valid(history_coord, current_pos, history_pos, current_normal, history_normal, current_mesh_id, history_mesh_id, ivec2(image_dim)))
@@ -286,9 +275,8 @@ bool reproject(in ivec2 frag_coord,
                 #else
                     history_color += texelFetch(sampler_history_output, p, 0).rgb;
                 #endif
-                #if defined(REPROJECTION_MOMENTS) 
-                    history_moments += texelFetch(sampler_history_moments_length, p, 0).rg;
-                #endif                    
+                    if (REPROJECTION_MOMENTS)
+                        history_moments += texelFetch(sampler_history_moments_length, p, 0).rg;
                     cnt += 1.0;
                 }
             }
@@ -297,19 +285,16 @@ bool reproject(in ivec2 frag_coord,
         {
             valid = true;
             history_color /= cnt;
-        #if defined(REPROJECTION_MOMENTS)             
             history_moments /= cnt;
-        #endif            
         }
     }
 
     if (valid)
     {
-    #if defined(REPROJECTION_MOMENTS)        
-        history_length = texelFetch(sampler_history_moments_length, history_coord, 0).b;
-    #else
-        history_length = texelFetch(sampler_history_length, history_coord, 0).r;
-    #endif        
+        if (REPROJECTION_MOMENTS)
+            history_length = texelFetch(sampler_history_moments_length, history_coord, 0).b;
+        else
+            history_length = texelFetch(sampler_history_moments_length, history_coord, 0).r;
     }    
     else
     {
@@ -318,9 +303,7 @@ bool reproject(in ivec2 frag_coord,
     #else        
         history_color = vec3(0.0f);
     #endif
-    #if defined(REPROJECTION_MOMENTS)          
         history_moments = vec2(0.0f);
-    #endif
         history_length  = 0.0f;
     }
 
@@ -27,6 +27,13 @@ struct Material
     vec4  roughness_metallic;
 };
 
+// Texture indices of a material whose textures are streamed, see TextureStreamer.
+struct StreamedMaterial
+{
+    ivec4 texture_indices0;
+    ivec4 texture_indices1; // y: 1 if the material is streamed
+};
+
 struct Instance
 {
     mat4 model_matrix;
@@ -88,10 +95,104 @@ layout (set = 0, binding = 5) readonly buffer SubmeshInfoBuffer
 
 layout (set = 0, binding = 6) uniform sampler2D s_Textures[];
 
+layout (set = 0, binding = 7, std430) readonly buffer StreamedMaterialBuffer 
+{
+    StreamedMaterial data[];
+} StreamedMaterials;
+
+layout (set = 0, binding = 8, std430) buffer TextureFeedbackBuffer 
+{
+    uint data[];
+} TextureFeedback;
+
+#define STREAMED_TEXTURE_OFFSET 1024
+
 // ------------------------------------------------------------------------
 // FUNCTIONS --------------------------------------------------------------
 // ------------------------------------------------------------------------
 
+Material fetch_material(uint mat_idx)
+{
+    Material material = Materials.data[mat_idx];
+    StreamedMaterial streamed_material = StreamedMaterials.data[mat_idx];
+
+    if (streamed_material.texture_indices1.y == 1)
+    {
+        material.texture_indices0 = streamed_material.texture_indices0;
+        material.texture_indices1 = streamed_material.texture_indices1;
+    }
+
+    return material;
+}
+
+// ------------------------------------------------------------------------
+
+#if defined(TEXTURE_FEEDBACK)
+
+// Texels across the texture a pixel footprint with the given texture coordinate derivatives asks for.
+uint texture_feedback_texels(in vec2 texcoord_dx, in vec2 texcoord_dy)
+{
+    vec2 footprint = max(abs(texcoord_dx), abs(texcoord_dy));
+
+    return uint(clamp(1.0 / max(max(footprint.x, footprint.y), 1e-6), 1.0, 65535.0));
+}
+
+// ------------------------------------------------------------------------
+
+#if !defined(TEXTURE_GRADIENTS)
+
+// Texels across the texture the pixel footprint asks for, has to be called from uniform control flow.
+uint texture_feedback_texels(in vec2 texcoord)
+{
+    return texture_feedback_texels(dFdx(texcoord), dFdy(texcoord));
+}
+
+#endif
+
+// ------------------------------------------------------------------------
+
+void write_texture_feedback(in int texture_idx, in uint texels)
+{
+    if (texture_idx >= STREAMED_TEXTURE_OFFSET)
+        atomicMax(TextureFeedback.data[texture_idx - STREAMED_TEXTURE_OFFSET], texels);
+}
+
+// ------------------------------------------------------------------------
+
+void write_material_feedback(in Material material, in uint texels)
+{
+    write_texture_feedback(material.texture_indices0.x, texels);
+    write_texture_feedback(material.texture_indices0.y, texels);
+    write_texture_feedback(material.texture_indices0.z, texels);
+    write_texture_feedback(material.texture_indices0.w, texels);
+    write_texture_feedback(material.texture_indices1.x, texels);
+}
+
+#endif
+
+// ------------------------------------------------------------------------
+
+#if defined(TEXTURE_GRADIENTS)
+
+// Stages without implicit derivatives set the texture coordinate derivatives of the pixel before fetching materials.
+vec2 g_TexCoordDx;
+vec2 g_TexCoordDy;
+
+#endif
+
+// ------------------------------------------------------------------------
+
+vec4 sample_texture(in int texture_idx, in vec2 texcoord)
+{
+#if defined(TEXTURE_GRADIENTS)
+    return textureGrad(s_Textures[nonuniformEXT(texture_idx)], texcoord, g_TexCoordDx, g_TexCoordDy);
+#else
+    return texture(s_Textures[nonuniformEXT(texture_idx)], texcoord);
+#endif
+}
+
+// ------------------------------------------------------------------------
+
 Vertex get_vertex(uint mesh_idx, uint vertex_idx)
 {
     return Vertices[nonuniformEXT(mesh_idx)].data[vertex_idx];
@@ -166,8 +267,10 @@ vec3 get_normal_from_map(vec3 tangent, vec3 bitangent, vec3 normal, vec2 tex_coo
     // Create TBN matrix.
     mat3 TBN = mat3(normalize(tangent), normalize(bitangent), normalize(normal));
 
-    // Sample tangent space normal vector from normal map and remap it from [0, 1] to [-1, 1] range.
-    vec3 n = normalize(texture(s_Textures[nonuniformEXT(normal_map_idx)], tex_coord).rgb * 2.0 - 1.0);
+    // Sample tangent space normal vector from normal map and remap it from [0, 1] to [-1, 1] range. Z is reconstructed,
+    // since block compressed normal maps only store X and Y.
+    vec2 xy = sample_texture(int(normal_map_idx), tex_coord).rg * 2.0 - 1.0;
+    vec3 n  = normalize(vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0))));
 
     // Multiple vector by the TBN matrix to transform the normal from tangent space to world space.
     n = normalize(TBN * n);
@@ -182,7 +285,7 @@ vec4 fetch_albedo(in Material material, in vec2 texcoord)
     if (material.texture_indices0.x == -1)
         return material.albedo;
     else
-        return texture(s_Textures[nonuniformEXT(material.texture_indices0.x)], texcoord);
+        return sample_texture(material.texture_indices0.x, texcoord);
 }
 
 // ------------------------------------------------------------------------
@@ -204,7 +307,7 @@ float fetch_roughness(in Material material, in vec2 texcoord)
     if (material.texture_indices0.z == -1)
         return max(material.roughness_metallic.r, MIN_ROUGHNESS);
     else
-        return max(texture(s_Textures[nonuniformEXT(material.texture_indices0.z)], texcoord)[material.texture_indices1.z], MIN_ROUGHNESS);
+        return max(sample_texture(material.texture_indices0.z, texcoord)[material.texture_indices1.z], MIN_ROUGHNESS);
 }
 
 // ------------------------------------------------------------------------
@@ -214,7 +317,7 @@ float fetch_metallic(in Material material, in vec2 texcoord)
     if (material.texture_indices0.w == -1)
         return material.roughness_metallic.g;
     else
-        return texture(s_Textures[nonuniformEXT(material.texture_indices0.w)], texcoord)[material.texture_indices1.w];
+        return sample_texture(material.texture_indices0.w, texcoord)[material.texture_indices1.w];
 }
 
 // ------------------------------------------------------------------------
@@ -224,7 +327,7 @@ vec3 fetch_emissive(in Material material, in vec2 texcoord)
     if (material.texture_indices1.x == -1)
         return material.emissive.rgb;
     else
-        return texture(s_Textures[nonuniformEXT(material.texture_indices1.x)], texcoord).rgb;
+        return sample_texture(material.texture_indices1.x, texcoord).rgb;
 }
 
 // ------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "specialized_pipeline.h"
+#include <logger.h>
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SpecializedComputePipeline::SpecializedComputePipeline(dw::vk::Backend::Ptr backend, VkPipelineCache pipeline_cache, dw::vk::ShaderModule::Ptr shader_module, dw::vk::PipelineLayout::Ptr pipeline_layout, const std::string& name) :
+    m_backend(backend), m_pipeline_cache(pipeline_cache), m_shader_module(shader_module), m_pipeline_layout(pipeline_layout), m_name(name)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SpecializedComputePipeline::~SpecializedComputePipeline()
+{
+    auto backend = m_backend.lock();
+
+    for (auto& variant : m_variants)
+        vkDestroyPipeline(backend->device(), variant.second, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+VkPipeline SpecializedComputePipeline::variant(const std::vector<uint32_t>& constants)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_variants.find(constants);
+
+    if (it != m_variants.end())
+        return it->second;
+
+    auto backend = m_backend.lock();
+
+    std::vector<VkSpecializationMapEntry> entries(constants.size());
+
+    for (uint32_t i = 0; i < constants.size(); i++)
+    {
+        entries[i].constantID = i;
+        entries[i].offset     = i * sizeof(uint32_t);
+        entries[i].size       = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specialization_info;
+
+    specialization_info.mapEntryCount = (uint32_t)entries.size();
+    specialization_info.pMapEntries   = entries.data();
+    specialization_info.dataSize      = constants.size() * sizeof(uint32_t);
+    specialization_info.pData         = constants.data();
+
+    VkComputePipelineCreateInfo info {};
+
+    info.sType                     = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module              = m_shader_module->handle();
+    info.stage.pName               = "main";
+    info.stage.pSpecializationInfo = &specialization_info;
+    info.layout                    = m_pipeline_layout->handle();
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (vkCreateComputePipelines(backend->device(), m_pipeline_cache, 1, &info, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create compute pipeline variant: " + m_name);
+        throw std::runtime_error("Failed to create compute pipeline variant: " + m_name);
+    }
+
+    m_variants[constants] = pipeline;
+
+    return pipeline;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
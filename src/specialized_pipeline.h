@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vk.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Compute pipeline whose shader reads its tuning knobs from 32-bit specialization constants, numbered from zero in
+// the order the values are passed in (booleans are 0 or 1). A variant is created the first time a combination of
+// values is requested and kept for the lifetime of the object, so switching configurations back and forth never
+// compiles twice.
+class SpecializedComputePipeline
+{
+public:
+    SpecializedComputePipeline(dw::vk::Backend::Ptr backend, VkPipelineCache pipeline_cache, dw::vk::ShaderModule::Ptr shader_module, dw::vk::PipelineLayout::Ptr pipeline_layout, const std::string& name);
+    ~SpecializedComputePipeline();
+
+    // Safe to call from the recording threads. A missing variant is created on the spot.
+    VkPipeline variant(const std::vector<uint32_t>& constants);
+
+private:
+    std::weak_ptr<dw::vk::Backend>              m_backend;
+    VkPipelineCache                             m_pipeline_cache;
+    dw::vk::ShaderModule::Ptr                   m_shader_module;
+    dw::vk::PipelineLayout::Ptr                 m_pipeline_layout;
+    std::string                                 m_name;
+    std::mutex                                  m_mutex;
+    std::map<std::vector<uint32_t>, VkPipeline> m_variants;
+};
@@ -1,4 +1,5 @@
 #include "temporal_aa.h"
+#include "shader_library.h"
 #include "g_buffer.h"
 #include "deferred_shading.h"
 #include "ray_traced_ao.h"
@@ -13,6 +14,9 @@
 
 #define HALTON_SAMPLES 16
 
+// The workgroup size of the resolve pass is tuned per device, under the name the render graph reports it with.
+static const char* RESOLVE_PASS = "TAA/Resolve";
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 struct TAAPushConstants
@@ -49,7 +53,8 @@ TemporalAA::TemporalAA(std::weak_ptr<dw::vk::Backend> backend, CommonResources*
     create_images();
     create_descriptor_sets();
     write_descriptor_sets();
-    create_pipeline(g_buffer);
+    m_common_resources->workgroup_tuner->add_pass(RESOLVE_PASS, { 32, 32 });
+    m_common_resources->pipeline_cache->queue([this, g_buffer]() { create_pipeline(g_buffer); });
 
     for (int i = 1; i <= HALTON_SAMPLES; i++)
         m_jitter_samples.push_back(glm::vec2((2.0f * halton_sequence(2, i) - 1.0f), (2.0f * halton_sequence(3, i) - 1.0f)));
@@ -82,95 +87,142 @@ void TemporalAA::update()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void TemporalAA::render(dw::vk::CommandBuffer::Ptr cmd_buf,
-                        DeferredShading*           deferred_shading,
-                        RayTracedAO*               ao,
-                        RayTracedShadows*          shadows,
-                        RayTracedReflections*      reflections,
-                        DDGI*                      ddgi,
-                        GroundTruthPathTracer*     ground_truth_path_tracer,
-                        float                      delta_seconds)
+void TemporalAA::render(RenderGraph&           graph,
+                        DeferredShading*       deferred_shading,
+                        RayTracedAO*           ao,
+                        RayTracedShadows*      shadows,
+                        RayTracedReflections*  reflections,
+                        DDGI*                  ddgi,
+                        GroundTruthPathTracer* ground_truth_path_tracer,
+                        float                  delta_seconds)
 {
     if (m_enabled)
     {
-        DW_SCOPED_SAMPLE("TAA", cmd_buf);
+        const uint32_t write_idx = (uint32_t)m_common_resources->ping_pong;
+        const uint32_t read_idx  = (uint32_t)!m_common_resources->ping_pong;
+
+        VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        const uint32_t NUM_THREADS = 32;
-        const uint32_t write_idx   = (uint32_t)m_common_resources->ping_pong;
-        const uint32_t read_idx    = (uint32_t)!m_common_resources->ping_pong;
+        dw::vk::Image::Ptr input_image;
 
-        VkImageSubresourceRange subresource_range       = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-        VkImageSubresourceRange depth_subresource_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, m_g_buffer->depth_image()->mip_levels(), 0, 1 };
+        if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_FINAL)
+            input_image = deferred_shading->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_SHADOWS)
+            input_image = shadows->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_AMBIENT_OCCLUSION)
+            input_image = ao->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_REFLECTIONS)
+            input_image = reflections->output_image();
+        else
+            input_image = ddgi->output_image();
 
-        auto backend = m_backend.lock();
-        
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image[write_idx], subresource_range);
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_g_buffer->depth_image(), depth_subresource_range);
+        graph.begin_group("TAA");
 
-        backend->flush_barriers(cmd_buf);
-        
         if (m_reset)
         {
-            dw::vk::utilities::blitt_image(cmd_buf,
-                                           deferred_shading->output_image(),
-                                           m_image[read_idx],
-                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                           VK_IMAGE_ASPECT_COLOR_BIT,
-                                           VK_FILTER_NEAREST);
+            // The blit transitions both images itself and leaves them in SHADER_READ_ONLY_OPTIMAL.
+            graph.add_pass(
+                "Reset History",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.record_on_main_thread();
+                    builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, deferred_shading->output_image(), subresource_range);
+                    builder.internal_transition(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, deferred_shading->output_image(), subresource_range);
+                    builder.internal_transition(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image[read_idx], subresource_range);
+                },
+                [this, deferred_shading, read_idx](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                    dw::vk::utilities::blitt_image(cmd_buf,
+                                                   deferred_shading->output_image(),
+                                                   m_image[read_idx],
+                                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                   VK_IMAGE_ASPECT_COLOR_BIT,
+                                                   VK_FILTER_NEAREST);
+                });
         }
 
-        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->handle());
+        graph.add_pass(
+            "Resolve",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image[write_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image[read_idx], subresource_range);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, subresource_range);
+                m_g_buffer->use_output(builder, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+            },
+            [this, deferred_shading, ao, shadows, reflections, ddgi, read_idx, write_idx, delta_seconds](dw::vk::CommandBuffer::Ptr cmd_buf) {
+                resolve(cmd_buf, deferred_shading, ao, shadows, reflections, ddgi, read_idx, write_idx, delta_seconds);
+            });
+
+        graph.end_group();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::Image::Ptr TemporalAA::output_image()
+{
+    return m_image[m_common_resources->ping_pong];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        TAAPushConstants push_constants;
+void TemporalAA::resolve(dw::vk::CommandBuffer::Ptr cmd_buf,
+                         DeferredShading*           deferred_shading,
+                         RayTracedAO*               ao,
+                         RayTracedShadows*          shadows,
+                         RayTracedReflections*      reflections,
+                         DDGI*                      ddgi,
+                         uint32_t                   read_idx,
+                         uint32_t                   write_idx,
+                         float                      delta_seconds)
+{
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(RESOLVE_PASS);
 
-        push_constants.texel_size          = glm::vec4(1.0f / float(m_width), 1.0f / float(m_height), float(m_width), float(m_height));
-        push_constants.current_prev_jitter = glm::vec4(m_current_jitter, m_prev_jitter);
-        push_constants.time_params         = glm::vec4(static_cast<float>(glfwGetTime()), sinf(static_cast<float>(glfwGetTime())), cosf(static_cast<float>(glfwGetTime())), delta_seconds);
-        push_constants.feedback_min        = m_feedback_min;
-        push_constants.feedback_max        = m_feedback_max;
-        push_constants.sharpen             = static_cast<int>(m_sharpen);
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->variant({ size.x, size.y }));
 
-        vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    TAAPushConstants push_constants;
 
-        VkDescriptorSet read_ds;
+    push_constants.texel_size          = glm::vec4(1.0f / float(m_width), 1.0f / float(m_height), float(m_width), float(m_height));
+    push_constants.current_prev_jitter = glm::vec4(m_current_jitter, m_prev_jitter);
+    push_constants.time_params         = glm::vec4(static_cast<float>(glfwGetTime()), sinf(static_cast<float>(glfwGetTime())), cosf(static_cast<float>(glfwGetTime())), delta_seconds);
+    push_constants.feedback_min        = m_feedback_min;
+    push_constants.feedback_max        = m_feedback_max;
+    push_constants.sharpen             = static_cast<int>(m_sharpen);
 
-        if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_FINAL)
-            read_ds = deferred_shading->output_ds()->handle();
-        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_SHADOWS)
-            read_ds = shadows->output_ds()->handle();
-        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_AMBIENT_OCCLUSION)
-            read_ds = ao->output_ds()->handle();
-        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_REFLECTIONS)
-            read_ds = reflections->output_ds()->handle();
-        else
-            read_ds = ddgi->output_ds()->handle();
-
-        VkDescriptorSet descriptor_sets[] = {
-            m_write_ds[write_idx]->handle(),
-            read_ds,
-            m_read_ds[read_idx]->handle(),
-            m_g_buffer->output_ds()->handle()
-        };
-
-        vkCmdBindDescriptorSets(cmd_buf->handle(),
-                                VK_PIPELINE_BIND_POINT_COMPUTE,
-                                m_pipeline_layout->handle(),
-                                0,
-                                4,
-                                descriptor_sets,
-                                0,
-                                nullptr);
-
-        vkCmdDispatch(cmd_buf->handle(),
-                      static_cast<uint32_t>(ceil(float(m_width) / float(NUM_THREADS))),
-                      static_cast<uint32_t>(ceil(float(m_height) / float(NUM_THREADS))),
-                      1);
-
-        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image[write_idx], subresource_range);
-
-        backend->flush_barriers(cmd_buf);
-    }
+    vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+
+    VkDescriptorSet read_ds;
+
+    if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_FINAL)
+        read_ds = deferred_shading->output_ds()->handle();
+    else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_SHADOWS)
+        read_ds = shadows->output_ds()->handle();
+    else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_AMBIENT_OCCLUSION)
+        read_ds = ao->output_ds()->handle();
+    else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_REFLECTIONS)
+        read_ds = reflections->output_ds()->handle();
+    else
+        read_ds = ddgi->output_ds()->handle();
+
+    VkDescriptorSet descriptor_sets[] = {
+        m_write_ds[write_idx]->handle(),
+        read_ds,
+        m_read_ds[read_idx]->handle(),
+        m_g_buffer->output_ds()->handle()
+    };
+
+    vkCmdBindDescriptorSets(cmd_buf->handle(),
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_pipeline_layout->handle(),
+                            0,
+                            4,
+                            descriptor_sets,
+                            0,
+                            nullptr);
+
+    vkCmdDispatch(cmd_buf->handle(),
+                  static_cast<uint32_t>(ceil(float(m_width) / float(size.x))),
+                  static_cast<uint32_t>(ceil(float(m_height) / float(size.y))),
+                  1);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -202,8 +254,8 @@ void TemporalAA::create_images()
 {
     auto vk_backend = m_backend.lock();
 
-    m_width  = vk_backend->swap_chain_extents().width;
-    m_height = vk_backend->swap_chain_extents().height;
+    m_width  = m_common_resources->output_width;
+    m_height = m_common_resources->output_height;
 
     // TAA
     for (int i = 0; i < 2; i++)
@@ -324,14 +376,13 @@ void TemporalAA::create_pipeline(GBuffer* g_buffer)
 
     m_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, desc);
 
-    dw::vk::ShaderModule::Ptr module = dw::vk::ShaderModule::create_from_file(vk_backend, "shaders/taa.comp.spv");
+    dw::vk::ShaderModule::Ptr module = ShaderLibrary::load(vk_backend, "shaders/taa.comp.spv");
 
-    dw::vk::ComputePipeline::Desc comp_desc;
+    m_pipeline = std::unique_ptr<SpecializedComputePipeline>(new SpecializedComputePipeline(vk_backend, m_common_resources->pipeline_cache->handle(), module, m_pipeline_layout, "TAA"));
 
-    comp_desc.set_pipeline_layout(m_pipeline_layout);
-    comp_desc.set_shader_stage(module, "main");
+    WorkgroupSize size = m_common_resources->workgroup_tuner->size(RESOLVE_PASS);
 
-    m_pipeline = dw::vk::ComputePipeline::create(vk_backend, comp_desc);
+    m_pipeline->variant({ size.x, size.y });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
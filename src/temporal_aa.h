@@ -2,6 +2,8 @@
 
 #include <vk.h>
 #include <glm.hpp>
+#include "render_graph.h"
+#include "specialized_pipeline.h"
 
 struct CommonResources;
 class GBuffer;
@@ -19,16 +21,17 @@ public:
     ~TemporalAA();
 
     void                       update();
-    void                       render(dw::vk::CommandBuffer::Ptr cmd_buf,
-                                      DeferredShading*           deferred_shading,
-                                      RayTracedAO*               ao,
-                                      RayTracedShadows*          shadows,
-                                      RayTracedReflections*      reflections,
-                                      DDGI*                      ddgi,
-                                      GroundTruthPathTracer*     ground_truth_path_tracer,
-                                      float                      delta_seconds);
+    void                       render(RenderGraph&           graph,
+                                      DeferredShading*       deferred_shading,
+                                      RayTracedAO*           ao,
+                                      RayTracedShadows*      shadows,
+                                      RayTracedReflections*  reflections,
+                                      DDGI*                  ddgi,
+                                      GroundTruthPathTracer* ground_truth_path_tracer,
+                                      float                  delta_seconds);
     void                       gui();
     dw::vk::DescriptorSet::Ptr output_ds();
+    dw::vk::Image::Ptr         output_image();
 
     inline bool      enabled() { return m_enabled; }
     inline glm::vec2 current_jitter() { return m_current_jitter; }
@@ -39,26 +42,35 @@ private:
     void create_descriptor_sets();
     void write_descriptor_sets();
     void create_pipeline(GBuffer* g_buffer);
+    void resolve(dw::vk::CommandBuffer::Ptr cmd_buf,
+                 DeferredShading*           deferred_shading,
+                 RayTracedAO*               ao,
+                 RayTracedShadows*          shadows,
+                 RayTracedReflections*      reflections,
+                 DDGI*                      ddgi,
+                 uint32_t                   read_idx,
+                 uint32_t                   write_idx,
+                 float                      delta_seconds);
 
 private:
-    std::weak_ptr<dw::vk::Backend>          m_backend;
-    uint32_t                                m_width;
-    uint32_t                                m_height;
-    CommonResources*                        m_common_resources;
-    GBuffer*                                m_g_buffer;
-    std::vector<dw::vk::Image::Ptr>         m_image;
-    std::vector<dw::vk::ImageView::Ptr>     m_view;
-    dw::vk::ComputePipeline::Ptr            m_pipeline;
-    dw::vk::PipelineLayout::Ptr             m_pipeline_layout;
-    std::vector<dw::vk::DescriptorSet::Ptr> m_read_ds;
-    std::vector<dw::vk::DescriptorSet::Ptr> m_write_ds;
-    bool                                    m_enabled      = true;
-    bool                                    m_sharpen      = true;
-    bool                                    m_reset        = true;
-    float                                   m_feedback_min = 0.88f;
-    float                                   m_feedback_max = 0.97f;
-    std::vector<glm::vec2>                  m_jitter_samples;
-    glm::vec3                               m_prev_camera_pos = glm::vec3(0.0f);
-    glm::vec2                               m_prev_jitter     = glm::vec2(0.0f);
-    glm::vec2                               m_current_jitter  = glm::vec2(0.0f);
+    std::weak_ptr<dw::vk::Backend>              m_backend;
+    uint32_t                                    m_width;
+    uint32_t                                    m_height;
+    CommonResources*                            m_common_resources;
+    GBuffer*                                    m_g_buffer;
+    std::vector<dw::vk::Image::Ptr>             m_image;
+    std::vector<dw::vk::ImageView::Ptr>         m_view;
+    std::unique_ptr<SpecializedComputePipeline> m_pipeline;
+    dw::vk::PipelineLayout::Ptr                 m_pipeline_layout;
+    std::vector<dw::vk::DescriptorSet::Ptr>     m_read_ds;
+    std::vector<dw::vk::DescriptorSet::Ptr>     m_write_ds;
+    bool                                        m_enabled      = true;
+    bool                                        m_sharpen      = true;
+    bool                                        m_reset        = true;
+    float                                       m_feedback_min = 0.88f;
+    float                                       m_feedback_max = 0.97f;
+    std::vector<glm::vec2>                      m_jitter_samples;
+    glm::vec3                                   m_prev_camera_pos = glm::vec3(0.0f);
+    glm::vec2                                   m_prev_jitter     = glm::vec2(0.0f);
+    glm::vec2                                   m_current_jitter  = glm::vec2(0.0f);
 };
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include "texture_cache.h"
+#include "block_compression.h"
+#include "utility.h"
+#include <logger.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const char     kMagic[4] = { 'H', 'R', 'T', 'C' };
+static const uint32_t kVersion  = 1;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct CacheHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    int64_t  source_time;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_mips;
+    uint64_t mip_offsets[TextureCache::kMaxMips];
+    uint64_t mip_sizes[TextureCache::kMaxMips];
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool source_info(const std::string& path, uint64_t& size, int64_t& time)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+
+    size = (uint64_t)info.st_size;
+    time = (int64_t)info.st_mtime;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static VkFormat baked_format(TextureUsage usage, bool compress)
+{
+    if (!compress)
+        return VK_FORMAT_R8G8B8A8_UNORM;
+
+    switch (usage)
+    {
+        case TEXTURE_USAGE_NORMAL:
+        case TEXTURE_USAGE_PACKED_MASKS:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case TEXTURE_USAGE_MASK:
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string cache_path(const std::string& path, TextureUsage usage, VkFormat format)
+{
+    std::string name = path;
+
+    for (auto& c : name)
+    {
+        if (c == '/' || c == '\\' || c == ':' || c == '.')
+            c = '_';
+    }
+
+    // Normal maps and packed masks share BC5, but compress different channels.
+    static const char* kUsageNames[] = { "color", "normal", "mask", "packed" };
+
+    return std::string(kCacheDirectory) + "/" + name + "_" + kUsageNames[usage] + (format == VK_FORMAT_R8G8B8A8_UNORM ? ".rgba8" : ".bc") + ".tex";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// 2x2 box filter, the last row or column of odd sizes is reused.
+static void downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst)
+{
+    uint32_t dst_width  = std::max(1u, width / 2);
+    uint32_t dst_height = std::max(1u, height / 2);
+
+    dst.resize(size_t(dst_width) * dst_height * 4);
+
+    for (uint32_t y = 0; y < dst_height; y++)
+    {
+        uint32_t y0 = std::min(y * 2, height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+        for (uint32_t x = 0; x < dst_width; x++)
+        {
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                uint32_t sum = src[(size_t(y0) * width + x0) * 4 + c] + src[(size_t(y0) * width + x1) * 4 + c] + src[(size_t(y1) * width + x0) * 4 + c] + src[(size_t(y1) * width + x1) * 4 + c];
+
+                dst[(size_t(y) * dst_width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void encode(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, TextureUsage usage, VkFormat format, std::vector<uint8_t>& data)
+{
+    data.resize(TextureCache::size(format, width, height));
+
+    switch (format)
+    {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            BlockCompression::encode_bc4(pixels.data(), width, height, 0, data.data());
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            if (usage == TEXTURE_USAGE_NORMAL)
+                BlockCompression::encode_bc5(pixels.data(), width, height, 0, 1, data.data());
+            else
+                BlockCompression::encode_bc5(pixels.data(), width, height, 1, 2, data.data());
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            BlockCompression::encode_bc7(pixels.data(), width, height, data.data());
+            break;
+        default:
+            memcpy(data.data(), pixels.data(), pixels.size());
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool bake(const std::string& source, const std::string& destination, TextureUsage usage, VkFormat format, uint64_t source_size, int64_t source_time)
+{
+    int32_t width    = 0;
+    int32_t height   = 0;
+    int32_t channels = 0;
+
+    uint8_t* pixels = stbi_load(source.c_str(), &width, &height, &channels, 4);
+
+    if (!pixels)
+    {
+        DW_LOG_ERROR("Failed to load texture: " + source);
+        return false;
+    }
+
+    uint32_t num_mips = uint32_t(floorf(log2f(float(std::max(width, height))))) + 1;
+
+    if (num_mips > TextureCache::kMaxMips)
+    {
+        DW_LOG_ERROR("Texture too large for the texture cache: " + source);
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    std::vector<uint8_t> level(pixels, pixels + size_t(width) * height * 4);
+    std::vector<uint8_t> next_level;
+    std::vector<uint8_t> data;
+
+    stbi_image_free(pixels);
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+
+    header.version     = kVersion;
+    header.source_size = source_size;
+    header.source_time = source_time;
+    header.format      = (uint32_t)format;
+    header.width       = uint32_t(width);
+    header.height      = uint32_t(height);
+    header.num_mips    = num_mips;
+
+    create_cache_directory();
+
+    return write_file_atomic(destination, "texture cache", [&](std::ofstream& file) {
+        // The header is written again once the offsets of the mips are known.
+        file.write((const char*)&header, sizeof(CacheHeader));
+
+        for (uint32_t mip = 0; mip < num_mips; mip++)
+        {
+            uint32_t mip_width  = std::max(1u, header.width >> mip);
+            uint32_t mip_height = std::max(1u, header.height >> mip);
+
+            encode(level, mip_width, mip_height, usage, format, data);
+
+            header.mip_offsets[mip] = (uint64_t)file.tellp();
+            header.mip_sizes[mip]   = data.size();
+
+            file.write((const char*)data.data(), data.size());
+
+            if (mip + 1 < num_mips)
+            {
+                downsample(level, mip_width, mip_height, next_level);
+                level.swap(next_level);
+            }
+        }
+
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(CacheHeader));
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool read_header(const std::string& path, VkFormat format, uint64_t source_size, int64_t source_time, CacheHeader& header)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file.is_open())
+        return false;
+
+    uint64_t file_size = (uint64_t)file.tellg();
+
+    if (file_size < sizeof(CacheHeader))
+        return false;
+
+    file.seekg(0);
+    file.read((char*)&header, sizeof(CacheHeader));
+
+    if (!file.good() || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.format != (uint32_t)format)
+        return false;
+
+    if (header.source_size != source_size || header.source_time != source_time)
+        return false;
+
+    if (header.num_mips == 0 || header.num_mips > TextureCache::kMaxMips)
+        return false;
+
+    for (uint32_t mip = 0; mip < header.num_mips; mip++)
+    {
+        if (header.mip_offsets[mip] + header.mip_sizes[mip] > file_size || header.mip_sizes[mip] != TextureCache::size(format, std::max(1u, header.width >> mip), std::max(1u, header.height >> mip)))
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TextureCache::open(const std::string& source, TextureUsage usage, bool compress, Entry& entry)
+{
+    uint64_t source_size = 0;
+    int64_t  source_time = 0;
+
+    if (!source_info(source, source_size, source_time))
+    {
+        DW_LOG_ERROR("Failed to find texture: " + source);
+        return false;
+    }
+
+    VkFormat    format = baked_format(usage, compress);
+    std::string path   = cache_path(source, usage, format);
+    CacheHeader header;
+
+    if (!read_header(path, format, source_size, source_time, header))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if (!bake(source, path, usage, format, source_size, source_time) || !read_header(path, format, source_size, source_time, header))
+        {
+            DW_LOG_ERROR("Failed to bake texture: " + source);
+            return false;
+        }
+
+        DW_LOG_INFO("Baked " + source + " in " + std::to_string(elapsed_milliseconds(start)) + " ms");
+    }
+
+    entry.path     = path;
+    entry.format   = format;
+    entry.width    = header.width;
+    entry.height   = header.height;
+    entry.num_mips = header.num_mips;
+
+    for (uint32_t mip = 0; mip < kMaxMips; mip++)
+    {
+        entry.offsets[mip] = header.mip_offsets[mip];
+        entry.sizes[mip]   = header.mip_sizes[mip];
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TextureCache::read(const Entry& entry, uint32_t first_mip, std::vector<uint8_t>& data, std::vector<size_t>& sizes)
+{
+    std::ifstream file(entry.path, std::ios::binary);
+
+    if (!file.is_open() || first_mip >= entry.num_mips)
+        return false;
+
+    // The mips are stored one after the other, so the whole range is read at once.
+    uint64_t size = entry.offsets[entry.num_mips - 1] + entry.sizes[entry.num_mips - 1] - entry.offsets[first_mip];
+
+    data.resize(size);
+    sizes.clear();
+
+    for (uint32_t mip = first_mip; mip < entry.num_mips; mip++)
+        sizes.push_back(entry.sizes[mip]);
+
+    file.seekg(entry.offsets[first_mip]);
+    file.read((char*)data.data(), size);
+
+    return file.good();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t TextureCache::size(VkFormat format, uint32_t width, uint32_t height)
+{
+    switch (format)
+    {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return BlockCompression::size(width, height, 8);
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return BlockCompression::size(width, height, 16);
+        default:
+            return size_t(width) * size_t(height) * 4;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vk.h>
+#include <string>
+#include <vector>
+
+// Decides the block compressed format a texture is baked into, based on the material slot it is used in.
+enum TextureUsage
+{
+    TEXTURE_USAGE_COLOR,       // BC7 from RGBA, for albedo and emissive textures.
+    TEXTURE_USAGE_NORMAL,      // BC5 from RG, the shaders reconstruct Z.
+    TEXTURE_USAGE_MASK,        // BC4 from R, for separate roughness and metallic textures.
+    TEXTURE_USAGE_PACKED_MASKS // BC5 from GB, for glTF roughness and metallic textures.
+};
+
+// Bakes textures into a binary file under cache/ the first time they are loaded, holding the whole mip chain in the
+// format GPUs sample from directly, so later runs skip decoding the image, building mips and compressing them. The
+// file is named after the source and the format, and baked again whenever the format version, or the size or
+// modification time of its source file, no longer match. Uncompressed files hold the RGBA8 mip chain instead, for
+// devices that cannot sample the BC formats.
+class TextureCache
+{
+public:
+    static const uint32_t kMaxMips = 16;
+
+    struct Entry
+    {
+        std::string path; // Of the cache file.
+        VkFormat    format   = VK_FORMAT_UNDEFINED;
+        uint32_t    width    = 0;
+        uint32_t    height   = 0;
+        uint32_t    num_mips = 0;
+        uint64_t    offsets[kMaxMips];
+        uint64_t    sizes[kMaxMips];
+    };
+
+    // Bakes the texture first if its cache file is missing or stale. Safe to call from several threads at once, as
+    // long as they open different textures.
+    static bool open(const std::string& source, TextureUsage usage, bool compress, Entry& entry);
+
+    // Reads every mip from first_mip down to 1x1, tightly packed.
+    static bool read(const Entry& entry, uint32_t first_mip, std::vector<uint8_t>& data, std::vector<size_t>& sizes);
+
+    // Size of a mip of the given extent in any of the formats textures are baked into.
+    static size_t size(VkFormat format, uint32_t width, uint32_t height);
+};
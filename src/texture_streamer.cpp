@@ -0,0 +1,933 @@
+#include "texture_streamer.h"
+#include "texture_cache.h"
+#include "utility.h"
+#include <logger.h>
+#include <macros.h>
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <queue>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Mips up to this size stay resident for as long as the texture is registered.
+static const uint32_t kTailSize = 64;
+
+// Frames a finer mip stays wanted after the feedback last asked for it, so textures at the edge of the screen do not
+// bounce between two residencies.
+static const uint64_t kKeepFrames = 120;
+
+// Limits the work done per frame, the rest is picked up on the following frames.
+static const size_t   kUploadBudget     = 64 * 1024 * 1024;
+static const uint32_t kMaxQueuedDecodes = 8;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct StreamedMaterial
+{
+    glm::ivec4 texture_indices0;
+    glm::ivec4 texture_indices1; // y: Set to 1 for streamed materials.
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string format_megabytes(size_t value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f MB", double(value) / (1024.0 * 1024.0));
+
+    return buffer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t mip_size(VkFormat format, uint32_t width, uint32_t height, uint32_t mip)
+{
+    return TextureCache::size(format, std::max(1u, width >> mip), std::max(1u, height >> mip));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static size_t chain_size(VkFormat format, uint32_t width, uint32_t height, uint32_t num_mips, uint32_t first_mip)
+{
+    size_t size = 0;
+
+    for (uint32_t mip = first_mip; mip < num_mips; mip++)
+        size += mip_size(format, width, height, mip);
+
+    return size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t tail_mip(uint32_t width, uint32_t height, uint32_t num_mips)
+{
+    uint32_t mip = 0;
+
+    while (mip + 1 < num_mips && std::max(width >> mip, height >> mip) > kTailSize)
+        mip++;
+
+    return mip;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Channel of a texture the shaders have to read, block compressed masks only keep the channels they were baked from.
+static int32_t texture_channel(VkFormat format, TextureUsage usage, int32_t channel)
+{
+    if (format == VK_FORMAT_BC4_UNORM_BLOCK)
+        return 0;
+    else if (format == VK_FORMAT_BC5_UNORM_BLOCK && usage == TEXTURE_USAGE_PACKED_MASKS)
+        return channel - 1;
+    else
+        return channel;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TextureStreamer::TextureStreamer(dw::vk::Backend::Ptr backend, DeletionQueue* deletion_queue, dw::vk::DescriptorSetLayout::Ptr scene_ds_layout) :
+    m_backend(backend), m_deletion_queue(deletion_queue)
+{
+    VkSamplerCreateInfo info;
+    DW_ZERO_MEMORY(info);
+
+    info.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    info.magFilter    = VK_FILTER_LINEAR;
+    info.minFilter    = VK_FILTER_LINEAR;
+    info.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.maxLod       = VK_LOD_CLAMP_NONE;
+    info.borderColor  = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    if (vkCreateSampler(backend->device(), &info, nullptr, &m_sampler) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create texture streaming sampler");
+        throw std::runtime_error("Failed to create texture streaming sampler");
+    }
+
+    // BC formats are optional in Vulkan, textures stay uncompressed on devices without them.
+    const VkFormat kCompressedFormats[] = { VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK };
+
+    m_compress = true;
+
+    for (VkFormat format : kCompressedFormats)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(backend->physical_device(), format, &properties);
+
+        if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+            m_compress = false;
+    }
+
+    if (!m_compress)
+        DW_LOG_INFO("BC texture formats are not supported, streaming uncompressed textures");
+
+    for (uint32_t i = 0; i < dw::vk::Backend::kMaxFramesInFlight; i++)
+    {
+        m_ds[i]           = backend->allocate_descriptor_set(scene_ds_layout);
+        m_ds_scene_ids[i] = UINT32_MAX;
+
+        m_material_buffer[i] = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(StreamedMaterial) * kMaxMaterials, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        m_feedback_buffer[i] = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t) * kMaxTextures, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        memset(m_feedback_buffer[i]->mapped_ptr(), 0, sizeof(uint32_t) * kMaxTextures);
+        vmaFlushAllocation(backend->allocator(), m_feedback_buffer[i]->allocation(), 0, VK_WHOLE_SIZE);
+    }
+
+    m_thread_pool   = std::unique_ptr<ThreadPool>(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+    m_decode_thread = std::thread(&TextureStreamer::decode_thread, this);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_decode_mutex);
+        m_decode_quit = true;
+    }
+
+    m_decode_condition.notify_one();
+    m_decode_thread.join();
+
+    report();
+
+    auto backend = m_backend.lock();
+
+    vkDestroySampler(backend->device(), m_sampler, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TextureStreamer::can_register(const std::string textures[5])
+{
+    std::vector<std::string> new_paths;
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        if (!textures[i].empty() && m_slot_indices.find(textures[i]) == m_slot_indices.end() && std::find(new_paths.begin(), new_paths.end(), textures[i]) == new_paths.end())
+            new_paths.push_back(textures[i]);
+    }
+
+    if (new_paths.size() <= m_free_slots.size() + (kMaxTextures - m_textures.size()))
+        return true;
+
+    if (!m_out_of_slots)
+    {
+        DW_LOG_INFO("Out of streamed texture slots, materials that do not fit keep every mip resident");
+        m_out_of_slots = true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::register_material(dw::Material::Ptr material, const std::string textures[5])
+{
+    auto it = m_materials.find(material.get());
+
+    // The address of a released material may be handed out again before it was noticed as expired.
+    if (it != m_materials.end())
+    {
+        for (int32_t texture : it->second.textures)
+        {
+            if (texture != -1)
+                release_slot(texture - kFirstTexture);
+        }
+
+        m_materials.erase(it);
+    }
+
+    Material streamed_material;
+
+    streamed_material.material = material;
+
+    TextureUsage usages[5] = { TEXTURE_USAGE_COLOR, TEXTURE_USAGE_NORMAL, TEXTURE_USAGE_MASK, TEXTURE_USAGE_MASK, TEXTURE_USAGE_COLOR };
+
+    // glTF packs roughness and metallic into the green and blue channels of the same texture.
+    if (!textures[2].empty() && textures[2] == textures[3])
+    {
+        usages[2] = TEXTURE_USAGE_PACKED_MASKS;
+        usages[3] = TEXTURE_USAGE_PACKED_MASKS;
+
+        streamed_material.roughness_channel = 1;
+        streamed_material.metallic_channel  = 2;
+    }
+
+    for (uint32_t i = 0; i < 5; i++)
+        streamed_material.textures[i] = textures[i].empty() ? -1 : int32_t(kFirstTexture + allocate_slot(textures[i], usages[i]));
+
+    m_materials[material.get()] = streamed_material;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::flush()
+{
+    if (m_unloaded_slots.size() == 0)
+        return;
+
+    auto backend = m_backend.lock();
+    auto start   = std::chrono::high_resolution_clock::now();
+
+    std::vector<Decode> decodes(m_unloaded_slots.size());
+
+    for (uint32_t i = 0; i < decodes.size(); i++)
+    {
+        decodes[i].path       = m_textures[m_unloaded_slots[i]].path;
+        decodes[i].usage      = m_textures[m_unloaded_slots[i]].usage;
+        decodes[i].compress   = m_compress;
+        decodes[i].slot       = m_unloaded_slots[i];
+        decodes[i].generation = m_textures[m_unloaded_slots[i]].generation;
+        decodes[i].mip        = UINT32_MAX;
+    }
+
+    m_unloaded_slots.clear();
+
+    m_thread_pool->run((uint32_t)decodes.size(), m_thread_pool->num_threads(), [this, &decodes](uint32_t job_idx, uint32_t thread_idx) {
+        decode(decodes[job_idx]);
+    });
+
+    dw::vk::BatchUploader uploader(backend);
+
+    for (auto& decode : decodes)
+    {
+        Texture& texture = m_textures[decode.slot];
+
+        if (decode.failed)
+        {
+            DW_LOG_ERROR("Failed to load streamed texture: " + texture.path);
+            continue;
+        }
+
+        uint32_t num_mips = decode.num_mips - decode.mip;
+
+        texture.format       = decode.format;
+        texture.width        = decode.width;
+        texture.height       = decode.height;
+        texture.num_mips     = decode.num_mips;
+        texture.resident_mip = decode.mip;
+        texture.wanted_mip   = decode.mip;
+        texture.target_mip   = decode.mip;
+        texture.image        = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, std::max(1u, decode.width >> decode.mip), std::max(1u, decode.height >> decode.mip), 1, num_mips, 1, decode.format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        texture.image->set_name(texture.path);
+        texture.image_view = dw::vk::ImageView::create(backend, texture.image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, num_mips, 0, 1);
+
+        uploader.upload_image_data(texture.image, decode.pixels.data(), decode.sizes);
+    }
+
+    uploader.submit();
+
+    DW_LOG_INFO("Loaded the mip tails of " + std::to_string(decodes.size()) + " streamed textures in " + std::to_string(elapsed_milliseconds(start)) + " ms");
+
+    report();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::update(dw::vk::CommandBuffer::Ptr cmd_buf, dw::RayTracedScene::Ptr scene)
+{
+    m_frame++;
+
+    release_expired_materials();
+    bind_uploads();
+    read_feedback();
+    apply_budget();
+    queue_decodes();
+    upload_decodes(cmd_buf);
+    write_descriptor_set(scene);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::gui()
+{
+    size_t   resident_size = 0;
+    size_t   full_size     = 0;
+    uint32_t num_textures  = 0;
+    uint32_t num_pending   = 0;
+
+    for (const auto& texture : m_textures)
+    {
+        if (!texture.image)
+            continue;
+
+        resident_size += chain_size(texture.format, texture.width, texture.height, texture.num_mips, texture.resident_mip);
+        full_size += chain_size(texture.format, texture.width, texture.height, texture.num_mips, 0);
+        num_textures++;
+
+        if (texture.pending)
+            num_pending++;
+    }
+
+    int32_t budget = int32_t(m_budget / (1024 * 1024));
+
+    if (ImGui::SliderInt("Texture Budget", &budget, 16, 4096, "%d MB"))
+        m_budget = size_t(budget) * 1024 * 1024;
+
+    ImGui::Text("Streamed Textures: %u (%u pending)", num_textures, num_pending);
+    ImGui::Text("Format: %s", m_compress ? "BC4/BC5/BC7" : "RGBA8");
+    ImGui::Text("Resident: %s of %s", format_megabytes(resident_size).c_str(), format_megabytes(full_size).c_str());
+
+    if (ImGui::Button("Log Memory Report"))
+        report();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::report()
+{
+    size_t   resident_size = 0;
+    size_t   full_size     = 0;
+    uint32_t num_textures  = 0;
+
+    for (const auto& texture : m_textures)
+    {
+        if (!texture.image)
+            continue;
+
+        resident_size += chain_size(texture.format, texture.width, texture.height, texture.num_mips, texture.resident_mip);
+        full_size += chain_size(texture.format, texture.width, texture.height, texture.num_mips, 0);
+        num_textures++;
+    }
+
+    DW_LOG_INFO("Texture streaming: " + std::to_string(num_textures) + " textures, " + format_megabytes(resident_size) + " resident, " + format_megabytes(full_size) + " with every mip resident, budget " + format_megabytes(m_budget));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::DescriptorSet::Ptr TextureStreamer::descriptor_set()
+{
+    auto backend = m_backend.lock();
+
+    return m_ds[backend->current_frame_idx()];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t TextureStreamer::allocate_slot(const std::string& path, TextureUsage usage)
+{
+    auto it = m_slot_indices.find(path);
+
+    if (it != m_slot_indices.end())
+    {
+        Texture& texture = m_textures[it->second];
+
+        // BC7 keeps every channel, so a texture used in several ways falls back to it. Textures that have been loaded
+        // already keep their format, the shaders then read the channels of the first usage.
+        if (texture.usage != usage)
+        {
+            if (!texture.image)
+                texture.usage = TEXTURE_USAGE_COLOR;
+            else if (texture.usage != TEXTURE_USAGE_COLOR)
+                DW_LOG_ERROR("Streamed texture used as more than one kind of map: " + path);
+        }
+
+        texture.ref_count++;
+        return it->second;
+    }
+
+    uint32_t slot = 0;
+
+    if (m_free_slots.size() > 0)
+    {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    }
+    else
+    {
+        // can_register() has made sure there is room.
+        slot = (uint32_t)m_textures.size();
+        m_textures.resize(m_textures.size() + 1);
+    }
+
+    Texture& texture = m_textures[slot];
+
+    texture.path      = path;
+    texture.usage     = usage;
+    texture.ref_count = 1;
+
+    m_slot_indices[path] = slot;
+    m_unloaded_slots.push_back(slot);
+
+    return slot;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::release_slot(uint32_t slot)
+{
+    Texture& texture = m_textures[slot];
+
+    if (--texture.ref_count > 0)
+        return;
+
+    // Frames in flight may still sample the images.
+    m_deletion_queue->push(texture.image);
+    m_deletion_queue->push(texture.image_view);
+    m_deletion_queue->push(texture.next_image);
+    m_deletion_queue->push(texture.next_image_view);
+
+    m_slot_indices.erase(texture.path);
+    m_unloaded_slots.erase(std::remove(m_unloaded_slots.begin(), m_unloaded_slots.end(), slot), m_unloaded_slots.end());
+
+    uint32_t generation = texture.generation + 1;
+
+    texture            = Texture();
+    texture.generation = generation;
+
+    m_free_slots.push_back(slot);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::release_expired_materials()
+{
+    for (auto it = m_materials.begin(); it != m_materials.end();)
+    {
+        if (it->second.material.expired())
+        {
+            for (int32_t texture : it->second.textures)
+            {
+                if (texture != -1)
+                    release_slot(texture - kFirstTexture);
+            }
+
+            it = m_materials.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::read_feedback()
+{
+    auto backend = m_backend.lock();
+
+    // Written by the last frame that used this frame in flight, whose fence has been waited on. Every entry holds the
+    // number of texels across the texture the most demanding sampled pixel asked for, zero if it was not sampled.
+    dw::vk::Buffer::Ptr buffer   = m_feedback_buffer[backend->current_frame_idx()];
+    uint32_t*           feedback = (uint32_t*)buffer->mapped_ptr();
+
+    // Neither direction is guaranteed to be host coherent.
+    vmaInvalidateAllocation(backend->allocator(), buffer->allocation(), 0, VK_WHOLE_SIZE);
+
+    for (uint32_t i = 0; i < m_textures.size(); i++)
+    {
+        Texture& texture = m_textures[i];
+
+        if (!texture.image || texture.failed)
+            continue;
+
+        uint32_t tail = tail_mip(texture.width, texture.height, texture.num_mips);
+        uint32_t mip  = tail;
+
+        if (feedback[i] > 0)
+        {
+            float texels = float(std::max(texture.width, texture.height)) / float(feedback[i]);
+
+            mip = texels > 1.0f ? std::min(uint32_t(floorf(log2f(texels))), tail) : 0;
+        }
+
+        // Finer requests apply right away, coarser ones only once the finer mips have not been asked for in a while.
+        if ((feedback[i] > 0 && mip <= texture.wanted_mip) || m_frame - texture.wanted_frame > kKeepFrames)
+        {
+            texture.wanted_mip   = mip;
+            texture.wanted_frame = m_frame;
+        }
+    }
+
+    memset(feedback, 0, sizeof(uint32_t) * kMaxTextures);
+    vmaFlushAllocation(backend->allocator(), buffer->allocation(), 0, VK_WHOLE_SIZE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::apply_budget()
+{
+    struct Candidate
+    {
+        size_t   size; // Of the finest mip the texture would keep.
+        uint64_t wanted_frame;
+        uint32_t slot;
+
+        bool operator<(const Candidate& other) const
+        {
+            return size < other.size || (size == other.size && wanted_frame > other.wanted_frame);
+        }
+    };
+
+    std::priority_queue<Candidate> candidates;
+    size_t                         total_size = 0;
+
+    for (uint32_t i = 0; i < m_textures.size(); i++)
+    {
+        Texture& texture = m_textures[i];
+
+        if (!texture.image)
+            continue;
+
+        texture.target_mip = texture.failed ? texture.resident_mip : texture.wanted_mip;
+        total_size += chain_size(texture.format, texture.width, texture.height, texture.num_mips, texture.target_mip);
+
+        if (!texture.failed && texture.target_mip < tail_mip(texture.width, texture.height, texture.num_mips))
+            candidates.push({ mip_size(texture.format, texture.width, texture.height, texture.target_mip), texture.wanted_frame, i });
+    }
+
+    // Drops the finest mip of the largest textures first, preferring the ones asked for the longest time ago. Mip
+    // tails are never dropped, so the budget can be exceeded by them alone.
+    while (total_size > m_budget && !candidates.empty())
+    {
+        Candidate candidate = candidates.top();
+        candidates.pop();
+
+        Texture& texture = m_textures[candidate.slot];
+
+        total_size -= candidate.size;
+        texture.target_mip++;
+
+        if (texture.target_mip < tail_mip(texture.width, texture.height, texture.num_mips))
+            candidates.push({ mip_size(texture.format, texture.width, texture.height, texture.target_mip), texture.wanted_frame, candidate.slot });
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::queue_decodes()
+{
+    std::vector<uint32_t> coarser;
+    std::vector<uint32_t> finer;
+
+    for (uint32_t i = 0; i < m_textures.size(); i++)
+    {
+        const Texture& texture = m_textures[i];
+
+        if (!texture.image || texture.failed || texture.pending || texture.target_mip == texture.resident_mip)
+            continue;
+
+        if (texture.target_mip > texture.resident_mip)
+            coarser.push_back(i);
+        else
+            finer.push_back(i);
+    }
+
+    // Releasing memory goes first, so the budget holds while mips are streamed in.
+    coarser.insert(coarser.end(), finer.begin(), finer.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_decode_mutex);
+
+        for (uint32_t slot : coarser)
+        {
+            if (m_decode_queue.size() >= kMaxQueuedDecodes)
+                break;
+
+            Texture& texture = m_textures[slot];
+            Decode   decode;
+
+            // The path is copied since the slot may be released while the decode is running.
+            decode.path       = texture.path;
+            decode.usage      = texture.usage;
+            decode.compress   = m_compress;
+            decode.slot       = slot;
+            decode.generation = texture.generation;
+            decode.mip        = texture.target_mip;
+
+            texture.pending = true;
+
+            m_decode_queue.push_back(std::move(decode));
+        }
+    }
+
+    m_decode_condition.notify_one();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::upload_decodes(dw::vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = m_backend.lock();
+
+    std::vector<Decode> decodes;
+    size_t              upload_size = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_decode_mutex);
+
+        uint32_t count = 0;
+
+        while (count < m_decoded.size() && (count == 0 || upload_size + m_decoded[count].pixels.size() <= kUploadBudget))
+            upload_size += m_decoded[count++].pixels.size();
+
+        decodes.insert(decodes.end(), std::make_move_iterator(m_decoded.begin()), std::make_move_iterator(m_decoded.begin() + count));
+        m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+    }
+
+    for (auto& decode : decodes)
+    {
+        if (decode.generation != m_textures[decode.slot].generation)
+            continue;
+
+        Texture& texture = m_textures[decode.slot];
+
+        // The cache file may have been baked again in another format since the mip tail was loaded.
+        if (decode.failed || decode.format != texture.format || decode.num_mips != texture.num_mips)
+        {
+            // Keeps the current residency rather than retrying every frame.
+            DW_LOG_ERROR("Failed to stream texture: " + texture.path);
+
+            texture.failed  = true;
+            texture.pending = false;
+            continue;
+        }
+
+        uint32_t num_mips = texture.num_mips - decode.mip;
+
+        dw::vk::Buffer::Ptr staging = dw::vk::Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, decode.pixels.size(), VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        memcpy(staging->mapped_ptr(), decode.pixels.data(), decode.pixels.size());
+
+        texture.next_mip        = decode.mip;
+        texture.next_frame      = m_frame;
+        texture.next_image      = dw::vk::Image::create(backend, VK_IMAGE_TYPE_2D, std::max(1u, texture.width >> decode.mip), std::max(1u, texture.height >> decode.mip), 1, num_mips, 1, texture.format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+        texture.next_image->set_name(texture.path);
+        texture.next_image_view = dw::vk::ImageView::create(backend, texture.next_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, num_mips, 0, 1);
+
+        std::vector<VkBufferImageCopy> regions;
+        size_t                         offset = 0;
+
+        for (uint32_t mip = 0; mip < num_mips; mip++)
+        {
+            VkBufferImageCopy region {};
+
+            region.bufferOffset                = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel   = mip;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width           = std::max(1u, texture.width >> (decode.mip + mip));
+            region.imageExtent.height          = std::max(1u, texture.height >> (decode.mip + mip));
+            region.imageExtent.depth           = 1;
+
+            regions.push_back(region);
+
+            offset += decode.sizes[mip];
+        }
+
+        VkImageMemoryBarrier barrier {};
+
+        barrier.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask               = 0;
+        barrier.dstAccessMask               = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout                   = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout                   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                       = texture.next_image->handle();
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = num_mips;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(cmd_buf->handle(), staging->handle(), texture.next_image->handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(cmd_buf->handle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        m_deletion_queue->push(staging);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::bind_uploads()
+{
+    for (auto& texture : m_textures)
+    {
+        // The image is only bound once the frame that uploaded it has retired, since async compute work of the frames
+        // in between may be submitted ahead of the graphics command buffer holding the copy.
+        if (!texture.next_image || m_frame < texture.next_frame + dw::vk::Backend::kMaxFramesInFlight)
+            continue;
+
+        m_deletion_queue->push(texture.image);
+        m_deletion_queue->push(texture.image_view);
+
+        texture.image        = texture.next_image;
+        texture.image_view   = texture.next_image_view;
+        texture.resident_mip = texture.next_mip;
+        texture.pending      = false;
+
+        texture.next_image      = nullptr;
+        texture.next_image_view = nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::write_descriptor_set(dw::RayTracedScene::Ptr scene)
+{
+    auto backend = m_backend.lock();
+
+    uint32_t                   frame_idx = backend->current_frame_idx();
+    dw::vk::DescriptorSet::Ptr ds        = m_ds[frame_idx];
+
+    // Streamed materials are indexed like the material buffer of the scene, the rest are left zeroed.
+    StreamedMaterial* materials = (StreamedMaterial*)m_material_buffer[frame_idx]->mapped_ptr();
+
+    memset(materials, 0, sizeof(StreamedMaterial) * kMaxMaterials);
+
+    for (const auto& instance : scene->instances())
+    {
+        auto mesh = instance.mesh.lock();
+
+        for (const auto& submesh : mesh->sub_meshes())
+        {
+            auto& mat = mesh->material(submesh.mat_idx);
+            auto  it  = m_materials.find(mat.get());
+
+            if (it == m_materials.end())
+                continue;
+
+            uint32_t material_idx = scene->material_index(mat->id());
+
+            if (material_idx >= kMaxMaterials)
+                continue;
+
+            int32_t textures[5];
+
+            // Textures that failed to load are left out rather than bound without an image.
+            for (uint32_t i = 0; i < 5; i++)
+                textures[i] = it->second.textures[i] != -1 && m_textures[it->second.textures[i] - kFirstTexture].image ? it->second.textures[i] : -1;
+
+            materials[material_idx].texture_indices0 = glm::ivec4(textures[0], textures[1], textures[2], textures[3]);
+            int32_t roughness_channel = it->second.roughness_channel;
+            int32_t metallic_channel  = it->second.metallic_channel;
+
+            if (textures[2] != -1)
+                roughness_channel = texture_channel(m_textures[textures[2] - kFirstTexture].format, m_textures[textures[2] - kFirstTexture].usage, roughness_channel);
+
+            if (textures[3] != -1)
+                metallic_channel = texture_channel(m_textures[textures[3] - kFirstTexture].format, m_textures[textures[3] - kFirstTexture].usage, metallic_channel);
+
+            materials[material_idx].texture_indices1 = glm::ivec4(textures[4], 1, roughness_channel, metallic_channel);
+        }
+    }
+
+    vmaFlushAllocation(backend->allocator(), m_material_buffer[frame_idx]->allocation(), 0, VK_WHOLE_SIZE);
+
+    // The buffers and the TLAS of the scene descriptor set are copied every frame, since they change along with the
+    // scene. The mesh buffers and the framework's textures only change with the scene itself.
+    const uint32_t kNumSceneBindings              = 7;
+    const uint32_t kCopyCounts[kNumSceneBindings] = { 1, 1, 1, kMaxSceneBuffers, kMaxSceneBuffers, kMaxSceneBuffers, kFirstTexture };
+
+    uint32_t num_copies = m_ds_scene_ids[frame_idx] == scene->id() ? 3 : kNumSceneBindings;
+
+    m_ds_scene_ids[frame_idx] = scene->id();
+
+    VkDescriptorSet     src_ds = scene->descriptor_set()->handle();
+    VkCopyDescriptorSet copies[kNumSceneBindings];
+
+    for (uint32_t i = 0; i < num_copies; i++)
+    {
+        DW_ZERO_MEMORY(copies[i]);
+
+        copies[i].sType           = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+        copies[i].srcSet          = src_ds;
+        copies[i].srcBinding      = i;
+        copies[i].dstSet          = ds->handle();
+        copies[i].dstBinding      = i;
+        copies[i].descriptorCount = kCopyCounts[i];
+    }
+
+    std::vector<VkDescriptorImageInfo> image_infos;
+    std::vector<uint32_t>              image_slots;
+
+    image_infos.reserve(m_textures.size());
+
+    for (uint32_t i = 0; i < m_textures.size(); i++)
+    {
+        if (!m_textures[i].image)
+            continue;
+
+        VkDescriptorImageInfo image_info;
+
+        image_info.sampler     = m_sampler;
+        image_info.imageView   = m_textures[i].image_view->handle();
+        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        image_infos.push_back(image_info);
+        image_slots.push_back(i);
+    }
+
+    VkDescriptorBufferInfo buffer_infos[2];
+
+    buffer_infos[0].buffer = m_material_buffer[frame_idx]->handle();
+    buffer_infos[0].offset = 0;
+    buffer_infos[0].range  = VK_WHOLE_SIZE;
+
+    buffer_infos[1].buffer = m_feedback_buffer[frame_idx]->handle();
+    buffer_infos[1].offset = 0;
+    buffer_infos[1].range  = VK_WHOLE_SIZE;
+
+    std::vector<VkWriteDescriptorSet> write_datas;
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        VkWriteDescriptorSet write_data;
+        DW_ZERO_MEMORY(write_data);
+
+        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data.descriptorCount = 1;
+        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_data.pBufferInfo     = &buffer_infos[i];
+        write_data.dstBinding      = 7 + i;
+        write_data.dstSet          = ds->handle();
+
+        write_datas.push_back(write_data);
+    }
+
+    for (uint32_t i = 0; i < image_infos.size(); i++)
+    {
+        VkWriteDescriptorSet write_data;
+        DW_ZERO_MEMORY(write_data);
+
+        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data.descriptorCount = 1;
+        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write_data.pImageInfo      = &image_infos[i];
+        write_data.dstBinding      = 6;
+        write_data.dstArrayElement = kFirstTexture + image_slots[i];
+        write_data.dstSet          = ds->handle();
+
+        write_datas.push_back(write_data);
+    }
+
+    vkUpdateDescriptorSets(backend->device(), write_datas.size(), write_datas.data(), num_copies, copies);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::decode_thread()
+{
+    while (true)
+    {
+        Decode decode;
+
+        {
+            std::unique_lock<std::mutex> lock(m_decode_mutex);
+
+            m_decode_condition.wait(lock, [this]() { return m_decode_quit || m_decode_queue.size() > 0; });
+
+            if (m_decode_quit)
+                return;
+
+            decode = std::move(m_decode_queue.front());
+            m_decode_queue.pop_front();
+        }
+
+        TextureStreamer::decode(decode);
+
+        std::lock_guard<std::mutex> lock(m_decode_mutex);
+        m_decoded.push_back(std::move(decode));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TextureStreamer::decode(Decode& decode)
+{
+    TextureCache::Entry entry;
+
+    decode.pixels.clear();
+    decode.sizes.clear();
+
+    if (!TextureCache::open(decode.path, decode.usage, decode.compress, entry))
+    {
+        decode.failed = true;
+        return;
+    }
+
+    decode.format   = entry.format;
+    decode.width    = entry.width;
+    decode.height   = entry.height;
+    decode.num_mips = entry.num_mips;
+    decode.mip      = std::min(decode.mip, tail_mip(decode.width, decode.height, decode.num_mips));
+
+    if (!TextureCache::read(entry, decode.mip, decode.pixels, decode.sizes))
+        decode.failed = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vk.h>
+#include <material.h>
+#include <ray_traced_scene.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "deletion_queue.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+// Streams the mip levels of material textures in and out based on what the G-buffer actually samples. Materials are
+// loaded without textures and registered here instead, every texture gets a slot at kFirstTexture and above in the
+// texture array of the scene descriptor set. The G-buffer writes the finest mip each slot needs into a feedback
+// buffer, which is read back once its frame has retired. Every texture only holds the mips from the finest one
+// needed down to the tail, and the textures sampled least are coarsened first whenever the total exceeds the budget.
+//
+// Residency changes are decoded on a background thread and recreate the image with the new mip range, the new image
+// is only bound once its upload has retired. Shaders therefore never see mips that are not resident, and need no
+// clamping of their own. Since descriptor sets cannot change while a frame in flight uses them, every frame in
+// flight gets its own copy of the scene descriptor set with the streamed textures written into it. Mips are read from
+// the texture cache, block compressed if the device can sample the BC formats.
+class TextureStreamer
+{
+public:
+    static const uint32_t kFirstTexture    = 1024; // Slots below this are left to the textures the framework loads.
+    static const uint32_t kMaxTextures     = 1024;
+    static const uint32_t kMaxMaterials    = 4096;
+    static const uint32_t kMaxSceneBuffers = 1024; // Per binding of the vertex, index and material index buffers.
+
+public:
+    TextureStreamer(dw::vk::Backend::Ptr backend, DeletionQueue* deletion_queue, dw::vk::DescriptorSetLayout::Ptr scene_ds_layout);
+    ~TextureStreamer();
+
+    // Returns false if the textures would need more slots than are left, the material should then be loaded with its
+    // textures and keep every mip resident.
+    bool can_register(const std::string textures[5]);
+
+    // Takes over the albedo, normal, roughness, metallic and emissive textures of a material loaded without them.
+    // Empty paths are left untextured.
+    void register_material(dw::Material::Ptr material, const std::string textures[5]);
+
+    // Loads the mip tails of every texture registered since the last call and uploads them before returning. Textures
+    // missing from the texture cache are baked on every core first.
+    void flush();
+
+    // Has to be called once per frame after the deletion queue has been flushed and the TLAS of the scene built.
+    void update(dw::vk::CommandBuffer::Ptr cmd_buf, dw::RayTracedScene::Ptr scene);
+    void gui();
+
+    // Logs the memory held by the streamed textures against what keeping all of their mips resident would take.
+    void report();
+
+    // Copy of the scene descriptor set used by the frame being recorded.
+    dw::vk::DescriptorSet::Ptr descriptor_set();
+
+    inline size_t budget() { return m_budget; }
+    inline void   set_budget(size_t value) { m_budget = value; }
+
+private:
+    struct Texture
+    {
+        std::string            path;
+        TextureUsage           usage        = TEXTURE_USAGE_COLOR;
+        VkFormat               format       = VK_FORMAT_UNDEFINED;
+        uint32_t               ref_count    = 0;
+        uint32_t               generation   = 0; // Bumped whenever the slot is reused, so stale decodes are dropped.
+        uint32_t               width        = 0;
+        uint32_t               height       = 0;
+        uint32_t               num_mips     = 0;
+        uint32_t               resident_mip = 0; // Finest resident mip, only valid while the image is set.
+        uint32_t               wanted_mip   = 0; // Finest mip requested by the feedback within the last kKeepFrames.
+        uint64_t               wanted_frame = 0;
+        uint32_t               target_mip   = 0; // Wanted mip after applying the budget.
+        bool                   pending      = false;
+        bool                   failed       = false; // Streaming failed, the resident mips are kept as they are.
+        dw::vk::Image::Ptr     image;
+        dw::vk::ImageView::Ptr image_view;
+        dw::vk::Image::Ptr     next_image; // Uploaded but not bound yet, until the upload has retired.
+        dw::vk::ImageView::Ptr next_image_view;
+        uint32_t               next_mip   = 0;
+        uint64_t               next_frame = 0;
+    };
+
+    struct Material
+    {
+        std::weak_ptr<dw::Material> material;
+        int32_t                     textures[5];
+        int32_t                     roughness_channel = 0;
+        int32_t                     metallic_channel  = 0;
+    };
+
+    struct Decode
+    {
+        std::string          path;
+        TextureUsage         usage      = TEXTURE_USAGE_COLOR;
+        bool                 compress   = false;
+        VkFormat             format     = VK_FORMAT_UNDEFINED;
+        uint32_t             slot       = 0;
+        uint32_t             generation = 0;
+        uint32_t             mip        = 0; // Finest mip to keep, UINT32_MAX for the mip tail.
+        uint32_t             width      = 0;
+        uint32_t             height     = 0;
+        uint32_t             num_mips   = 0;
+        std::vector<uint8_t> pixels; // Every mip from the kept one down to 1x1, tightly packed.
+        std::vector<size_t>  sizes;
+        bool                 failed = false;
+    };
+
+    uint32_t allocate_slot(const std::string& path, TextureUsage usage);
+    void     release_slot(uint32_t slot);
+    void     release_expired_materials();
+    void     read_feedback();
+    void     apply_budget();
+    void     queue_decodes();
+    void     upload_decodes(dw::vk::CommandBuffer::Ptr cmd_buf);
+    void     bind_uploads();
+    void     write_descriptor_set(dw::RayTracedScene::Ptr scene);
+    void     decode_thread();
+
+    static void decode(Decode& decode);
+
+private:
+    std::weak_ptr<dw::vk::Backend>              m_backend;
+    DeletionQueue*                              m_deletion_queue;
+    size_t                                      m_budget       = 512 * 1024 * 1024;
+    uint64_t                                    m_frame        = 0;
+    bool                                        m_compress     = false; // Set if the device can sample BC4, BC5 and BC7.
+    bool                                        m_out_of_slots = false; // Logged the first time a material did not fit.
+    VkSampler                                   m_sampler      = VK_NULL_HANDLE;
+    std::vector<Texture>                        m_textures;
+    std::vector<uint32_t>                       m_free_slots;
+    std::unordered_map<std::string, uint32_t>   m_slot_indices;
+    std::unordered_map<dw::Material*, Material> m_materials;
+    std::vector<uint32_t>                       m_unloaded_slots; // Registered since the last flush().
+    std::unique_ptr<ThreadPool>                 m_thread_pool;
+    dw::vk::DescriptorSet::Ptr                  m_ds[dw::vk::Backend::kMaxFramesInFlight];
+    uint32_t                                    m_ds_scene_ids[dw::vk::Backend::kMaxFramesInFlight]; // Scene whose buffers and textures were copied.
+    dw::vk::Buffer::Ptr                         m_material_buffer[dw::vk::Backend::kMaxFramesInFlight];
+    dw::vk::Buffer::Ptr                         m_feedback_buffer[dw::vk::Backend::kMaxFramesInFlight];
+    std::thread                                 m_decode_thread;
+    std::mutex                                  m_decode_mutex;
+    std::condition_variable                     m_decode_condition;
+    std::deque<Decode>                          m_decode_queue;
+    std::vector<Decode>                         m_decoded;
+    bool                                        m_decode_quit = false;
+};
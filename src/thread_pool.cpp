@@ -0,0 +1,102 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ThreadPool::ThreadPool(uint32_t num_threads) :
+    m_next_job(0)
+{
+    for (uint32_t i = 1; i < std::max(num_threads, 1u); i++)
+        m_workers.push_back(std::thread(&ThreadPool::worker, this, i));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake_condition.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ThreadPool::run(uint32_t num_jobs, uint32_t num_threads, JobFunc func)
+{
+    if (num_jobs == 0)
+        return;
+
+    num_threads = std::min(std::max(num_threads, 1u), this->num_threads());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_func               = func;
+        m_num_jobs           = num_jobs;
+        m_num_active_threads = num_threads;
+        m_num_busy_workers   = num_threads - 1;
+        m_next_job           = 0;
+        m_generation++;
+    }
+
+    if (num_threads > 1)
+        m_wake_condition.notify_all();
+
+    run_jobs(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_condition.wait(lock, [this]() { return m_num_busy_workers == 0; });
+
+    m_func = nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ThreadPool::worker(uint32_t thread_idx)
+{
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake_condition.wait(lock, [&]() { return m_stop || m_generation != generation; });
+
+            if (m_stop)
+                return;
+
+            generation = m_generation;
+
+            // Threads beyond the requested count sit this batch out.
+            if (thread_idx >= m_num_active_threads)
+                continue;
+        }
+
+        run_jobs(thread_idx);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_num_busy_workers--;
+        }
+
+        m_done_condition.notify_one();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ThreadPool::run_jobs(uint32_t thread_idx)
+{
+    uint32_t job_idx;
+
+    while ((job_idx = m_next_job.fetch_add(1)) < m_num_jobs)
+        m_func(job_idx, thread_idx);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that cooperatively run a batch of jobs. The calling thread takes part as thread
+// index 0, so a pool created for a single thread runs everything inline.
+class ThreadPool
+{
+public:
+    using JobFunc = std::function<void(uint32_t job_idx, uint32_t thread_idx)>;
+
+public:
+    ThreadPool(uint32_t num_threads);
+    ~ThreadPool();
+
+    // Runs every job on at most num_threads threads and returns once all of them have completed.
+    void run(uint32_t num_jobs, uint32_t num_threads, JobFunc func);
+
+    inline uint32_t num_threads() { return (uint32_t)m_workers.size() + 1; }
+
+private:
+    void worker(uint32_t thread_idx);
+    void run_jobs(uint32_t thread_idx);
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex               m_mutex;
+    std::condition_variable  m_wake_condition;
+    std::condition_variable  m_done_condition;
+    JobFunc                  m_func;
+    std::atomic<uint32_t>    m_next_job;
+    uint32_t                 m_num_jobs           = 0;
+    uint32_t                 m_num_active_threads = 0;
+    uint32_t                 m_num_busy_workers   = 0;
+    uint64_t                 m_generation         = 0;
+    bool                     m_stop               = false;
+};
@@ -9,6 +9,8 @@
 #include <imgui.h>
 #include <profiler.h>
 #include <macros.h>
+#include <logger.h>
+#include <stdio.h>
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -23,12 +25,13 @@ struct ToneMapPushConstants
 ToneMap::ToneMap(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources) :
     m_backend(backend), m_common_resources(common_resources)
 {
-    auto vk_backend = backend.lock();
+    m_width  = m_common_resources->output_width;
+    m_height = m_common_resources->output_height;
 
-    m_width  = vk_backend->swap_chain_extents().width;
-    m_height = vk_backend->swap_chain_extents().height;
+    if (m_common_resources->headless)
+        create_offscreen_target();
 
-    create_pipeline();
+    m_common_resources->pipeline_cache->queue([this]() { create_pipeline(); });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -39,7 +42,31 @@ ToneMap::~ToneMap()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void ToneMap::render(dw::vk::CommandBuffer::Ptr                      cmd_buf,
+dw::vk::Image::Ptr ToneMap::output_image()
+{
+    auto backend = m_backend.lock();
+
+    if (m_offscreen_image)
+        return m_offscreen_image;
+    else
+        return backend->swapchain_image();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::ImageView::Ptr ToneMap::output_view()
+{
+    auto backend = m_backend.lock();
+
+    if (m_offscreen_image)
+        return m_offscreen_view;
+    else
+        return backend->swapchain_image_view();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ToneMap::render(RenderGraph&                                    graph,
                      TemporalAA*                                     temporal_aa,
                      DeferredShading*                                deferred_shading,
                      RayTracedAO*                                    ao,
@@ -49,21 +76,130 @@ void ToneMap::render(dw::vk::CommandBuffer::Ptr                      cmd_buf,
                      GroundTruthPathTracer*                          ground_truth_path_tracer,
                      std::function<void(dw::vk::CommandBuffer::Ptr)> gui_callback)
 {
-    DW_SCOPED_SAMPLE("Tone Map", cmd_buf);
-
-    auto backend = m_backend.lock();
-
     VkImageSubresourceRange input_subresource_range  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
     VkImageSubresourceRange output_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, backend->swapchain_image(), output_subresource_range);
+    dw::vk::Image::Ptr input_image;
+
+    if (temporal_aa->enabled() && m_common_resources->current_visualization_type != VISUALIZATION_TYPE_GROUND_TRUTH)
+        input_image = temporal_aa->output_image();
+    else
+    {
+        if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_FINAL)
+            input_image = deferred_shading->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_SHADOWS)
+            input_image = shadows->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_AMBIENT_OCCLUSION)
+            input_image = ao->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_REFLECTIONS)
+            input_image = reflections->output_image();
+        else if (m_common_resources->current_visualization_type == VISUALIZATION_TYPE_GLOBAL_ILLUIMINATION)
+            input_image = ddgi->output_image();
+        else
+            input_image = ground_truth_path_tracer->output_image();
+    }
+
+    graph.add_pass(
+        "Tone Map",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.record_on_main_thread();
+            builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, output_image(), output_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, input_subresource_range);
+        },
+        [this, temporal_aa, deferred_shading, ao, shadows, reflections, ddgi, ground_truth_path_tracer, gui_callback](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            tone_map(cmd_buf, temporal_aa, deferred_shading, ao, shadows, reflections, ddgi, ground_truth_path_tracer, gui_callback);
+        });
+
+    if (!m_readback || !m_offscreen_image)
+        return;
+
+    graph.add_pass(
+        "Readback",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_offscreen_image, output_subresource_range);
+            builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, m_readback_buffer);
+        },
+        [this](dw::vk::CommandBuffer::Ptr cmd_buf) {
+            VkBufferImageCopy region {};
+
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width           = m_width;
+            region.imageExtent.height          = m_height;
+            region.imageExtent.depth           = 1;
+
+            vkCmdCopyImageToBuffer(cmd_buf->handle(), m_offscreen_image->handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_readback_buffer->handle(), 1, &region);
+        });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool ToneMap::write_output(const std::string& path)
+{
+    if (!m_readback_buffer)
+    {
+        DW_LOG_ERROR("Only the offscreen output can be written to an image: " + path);
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+    {
+        DW_LOG_ERROR("Failed to open output image for writing: " + path);
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", m_width, m_height);
+
+    // The offscreen target is RGBA8, PPM has no alpha channel.
+    const uint8_t*       texels = (const uint8_t*)m_readback_buffer->mapped_ptr();
+    std::vector<uint8_t> row(m_width * 3);
+    bool                 success = true;
+
+    for (uint32_t y = 0; y < m_height && success; y++)
+    {
+        for (uint32_t x = 0; x < m_width; x++)
+        {
+            const uint8_t* texel = texels + (size_t(y) * m_width + x) * 4;
+
+            row[x * 3 + 0] = texel[0];
+            row[x * 3 + 1] = texel[1];
+            row[x * 3 + 2] = texel[2];
+        }
+
+        success = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    success = fclose(file) == 0 && success;
+
+    if (!success)
+    {
+        DW_LOG_ERROR("Failed to write output image: " + path);
+        return false;
+    }
 
-    backend->flush_barriers(cmd_buf);
+    DW_LOG_INFO("Wrote output image: " + path);
 
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ToneMap::tone_map(dw::vk::CommandBuffer::Ptr                      cmd_buf,
+                       TemporalAA*                                     temporal_aa,
+                       DeferredShading*                                deferred_shading,
+                       RayTracedAO*                                    ao,
+                       RayTracedShadows*                               shadows,
+                       RayTracedReflections*                           reflections,
+                       DDGI*                                           ddgi,
+                       GroundTruthPathTracer*                          ground_truth_path_tracer,
+                       std::function<void(dw::vk::CommandBuffer::Ptr)> gui_callback)
+{
     VkRenderingAttachmentInfoKHR color_attachment = {};
 
     color_attachment.sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-    color_attachment.imageView        = backend->swapchain_image_view()->handle();
+    color_attachment.imageView        = output_view()->handle();
     color_attachment.imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     color_attachment.loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
@@ -161,10 +297,26 @@ void ToneMap::create_pipeline()
     desc.add_push_constant_range(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ToneMapPushConstants));
     desc.add_descriptor_set_layout(m_common_resources->combined_sampler_ds_layout);
 
-    VkFormat format = vk_backend->swap_chain_image_format();
+    VkFormat format = m_offscreen_image ? m_offscreen_image->format() : vk_backend->swap_chain_image_format();
 
     m_pipeline_layout = dw::vk::PipelineLayout::create(vk_backend, desc);
     m_pipeline        = dw::vk::GraphicsPipeline::create_for_post_process(vk_backend, "shaders/triangle.vert.spv", "shaders/tone_map.frag.spv", m_pipeline_layout, 1, &format);
 }
 
-// -----------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ToneMap::create_offscreen_target()
+{
+    auto vk_backend = m_backend.lock();
+
+    m_offscreen_image = dw::vk::Image::create(vk_backend, VK_IMAGE_TYPE_2D, m_width, m_height, 1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT);
+    m_offscreen_image->set_name("Tone Map Offscreen Output");
+
+    m_offscreen_view = dw::vk::ImageView::create(vk_backend, m_offscreen_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_offscreen_view->set_name("Tone Map Offscreen Output");
+
+    m_readback_buffer = dw::vk::Buffer::create(vk_backend, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size_t(m_width) * m_height * 4, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_readback_buffer->set_name("Tone Map Readback");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
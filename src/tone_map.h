@@ -3,6 +3,8 @@
 #include <vk.h>
 #include <glm.hpp>
 #include <functional>
+#include <string>
+#include "render_graph.h"
 
 struct CommonResources;
 class TemporalAA;
@@ -19,7 +21,7 @@ public:
     ToneMap(std::weak_ptr<dw::vk::Backend> backend, CommonResources* common_resources);
     ~ToneMap();
 
-    void render(dw::vk::CommandBuffer::Ptr                      cmd_buf,
+    void render(RenderGraph&                                    graph,
                 TemporalAA*                                     temporal_aa,
                 DeferredShading*                                deferred_shading,
                 RayTracedAO*                                    ao,
@@ -30,8 +32,27 @@ public:
                 std::function<void(dw::vk::CommandBuffer::Ptr)> gui_callback);
     void gui();
 
+    // The swap chain image, or the offscreen target when rendering headless.
+    dw::vk::Image::Ptr     output_image();
+    dw::vk::ImageView::Ptr output_view();
+
+    // Copies the offscreen target into a host visible buffer after tone mapping in every frame rendered while enabled.
+    // Once the GPU is idle the copy of the last frame can be written to a binary PPM image.
+    inline void set_readback(bool value) { m_readback = value; }
+    bool        write_output(const std::string& path);
+
 private:
+    void create_offscreen_target();
     void create_pipeline();
+    void tone_map(dw::vk::CommandBuffer::Ptr                      cmd_buf,
+                  TemporalAA*                                     temporal_aa,
+                  DeferredShading*                                deferred_shading,
+                  RayTracedAO*                                    ao,
+                  RayTracedShadows*                               shadows,
+                  RayTracedReflections*                           reflections,
+                  DDGI*                                           ddgi,
+                  GroundTruthPathTracer*                          ground_truth_path_tracer,
+                  std::function<void(dw::vk::CommandBuffer::Ptr)> gui_callback);
 
 private:
     std::weak_ptr<dw::vk::Backend> m_backend;
@@ -41,4 +62,8 @@ private:
     float                          m_exposure = 1.0f;
     dw::vk::GraphicsPipeline::Ptr  m_pipeline;
     dw::vk::PipelineLayout::Ptr    m_pipeline_layout;
+    dw::vk::Image::Ptr             m_offscreen_image;
+    dw::vk::ImageView::Ptr         m_offscreen_view;
+    dw::vk::Buffer::Ptr            m_readback_buffer;
+    bool                           m_readback = false;
 };
\ No newline at end of file
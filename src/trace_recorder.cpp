@@ -0,0 +1,190 @@
+#include "trace_recorder.h"
+#include <vk.h>
+#include <logger.h>
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string escape(const std::string& str)
+{
+    std::string result;
+
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+
+        result += c;
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TraceRecorder::TraceRecorder(uint32_t max_events) :
+    m_max_events(max_events)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::start(const std::string& path, uint32_t num_frames)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_state != STATE_IDLE)
+        return;
+
+    m_events.clear();
+    m_events.reserve(m_max_events);
+
+    m_path          = path;
+    m_num_frames    = std::max(num_frames, 1u);
+    m_frame         = 0;
+    m_next_event    = 0;
+    m_num_dropped   = 0;
+    m_capture_begin = now();
+    m_state         = STATE_CAPTURING;
+    m_capture_id++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::add_event(Track track, uint32_t thread, const std::string& name, double begin, double end)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_state == STATE_IDLE || (track == TRACK_CPU && m_state != STATE_CAPTURING))
+        return;
+
+    // GPU timings trail the CPU by the frames in flight, the first ones to arrive belong to frames from before the capture.
+    if (track == TRACK_GPU && m_frame < dw::vk::Backend::kMaxFramesInFlight)
+        return;
+
+    Event event = { name, begin, end, track, thread };
+
+    if (m_events.size() < m_max_events)
+        m_events.push_back(event);
+    else
+    {
+        m_events[m_next_event] = event;
+        m_next_event           = (m_next_event + 1) % m_max_events;
+        m_num_dropped++;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::end_frame()
+{
+    if (m_state == STATE_IDLE)
+        return;
+
+    m_frame++;
+
+    if (m_state == STATE_CAPTURING && m_frame == m_num_frames)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_state = STATE_DRAINING;
+    }
+    else if (m_state == STATE_DRAINING && m_frame == m_num_frames + dw::vk::Backend::kMaxFramesInFlight)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        write();
+
+        m_state = STATE_IDLE;
+        m_events.clear();
+        m_events.shrink_to_fit();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::gui()
+{
+    if (m_state == STATE_IDLE)
+    {
+        int32_t num_frames = (int32_t)m_num_frames;
+
+        if (ImGui::SliderInt("Trace Frames", &num_frames, 1, 300))
+            m_num_frames = (uint32_t)num_frames;
+
+        if (ImGui::Button("Capture Trace"))
+            start(m_path, m_num_frames);
+
+        if (!m_last_result.empty())
+            ImGui::Text("%s", m_last_result.c_str());
+    }
+    else
+        ImGui::Text("Capturing Trace: %i/%i", m_frame, m_num_frames);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double TraceRecorder::now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TraceRecorder::write()
+{
+    std::ofstream file(m_path);
+
+    if (!file.is_open())
+    {
+        DW_LOG_ERROR("Failed to open trace output: " + m_path);
+        m_last_result = "Failed to write " + m_path;
+        return false;
+    }
+
+    // Times are written relative to the start of the capture, in microseconds as the format expects.
+    file << std::fixed << std::setprecision(3);
+
+    file << "{\n";
+    file << "    \"displayTimeUnit\": \"ms\",\n";
+    file << "    \"traceEvents\": [\n";
+    file << "        { \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": { \"name\": \"CPU\" } },\n";
+    file << "        { \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": { \"name\": \"GPU\" } },\n";
+    file << "        { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"Graphics Queue\" } },\n";
+    file << "        { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": { \"name\": \"Async Compute Queue\" } },\n";
+    file << "        { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, \"args\": { \"name\": \"Main Thread\" } }";
+
+    uint32_t num_threads = 1;
+
+    for (const auto& event : m_events)
+    {
+        if (event.track == TRACK_CPU)
+            num_threads = std::max(num_threads, event.thread + 1);
+    }
+
+    for (uint32_t i = 1; i < num_threads; i++)
+        file << ",\n        { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << i << ", \"args\": { \"name\": \"Recording Thread " << i << "\" } }";
+
+    for (const auto& event : m_events)
+    {
+        file << ",\n";
+        file << "        { \"name\": \"" << escape(event.name) << "\", \"ph\": \"X\", \"pid\": " << (uint32_t)event.track << ", \"tid\": " << event.thread << ", \"ts\": " << event.begin - m_capture_begin << ", \"dur\": " << event.end - event.begin << " }";
+    }
+
+    file << "\n    ]\n";
+    file << "}\n";
+
+    m_last_result = "Wrote " + std::to_string(m_events.size()) + " events to " + m_path;
+
+    if (m_num_dropped > 0)
+        m_last_result += " (" + std::to_string(m_num_dropped) + " dropped)";
+
+    DW_LOG_INFO(m_last_result);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Captures CPU and GPU events over a window of frames and writes them in the Chrome trace event format, which can be
+// loaded into chrome://tracing or Perfetto. All times are in microseconds on the CPU clock returned by now(), GPU
+// timestamps are mapped onto it by the render graph. Events go into a fixed-size ring buffer, so a capture that runs
+// longer than expected keeps the most recent events instead of growing without bound.
+class TraceRecorder
+{
+public:
+    enum Track
+    {
+        TRACK_CPU,
+        TRACK_GPU
+    };
+
+    struct Event
+    {
+        std::string name;
+        double      begin;
+        double      end;
+        Track       track;
+        uint32_t    thread; // Recording thread on the CPU track, queue on the GPU track.
+    };
+
+public:
+    TraceRecorder(uint32_t max_events = 65536);
+
+    // Starts capturing the given number of frames, the trace is written once the GPU events of the last one have arrived.
+    void start(const std::string& path, uint32_t num_frames);
+
+    // Safe to call from any thread. Events outside of the capture window are dropped.
+    void add_event(Track track, uint32_t thread, const std::string& name, double begin, double end);
+
+    // Has to be called once per frame after the frame has been submitted.
+    void end_frame();
+    void gui();
+
+    static double now();
+
+    inline bool               capturing() { return m_state != STATE_IDLE; }
+    inline bool               recording_cpu() { return m_state == STATE_CAPTURING; }
+    inline uint32_t           capture_id() { return m_capture_id; }
+    inline const std::string& path() { return m_path; }
+    inline uint32_t           num_frames() { return m_num_frames; }
+
+private:
+    enum State
+    {
+        STATE_IDLE,
+        STATE_CAPTURING,
+        STATE_DRAINING // Waiting for the GPU events of the captured frames, which trail the CPU by the frames in flight.
+    };
+
+    bool write();
+
+private:
+    std::mutex         m_mutex;
+    std::vector<Event> m_events;
+    uint32_t           m_max_events;
+    uint32_t           m_next_event      = 0;
+    uint32_t           m_num_dropped     = 0;
+    State              m_state           = STATE_IDLE;
+    std::string        m_path            = "trace.json";
+    uint32_t           m_num_frames      = 60;
+    uint32_t           m_frame           = 0;
+    uint32_t           m_capture_id      = 0;
+    double             m_capture_begin   = 0.0;
+    std::string        m_last_result;
+};
@@ -0,0 +1,411 @@
+#include "transient_resource_allocator.h"
+#include <stdexcept>
+#include <algorithm>
+#include <logger.h>
+#include <macros.h>
+#include <imgui.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float to_megabytes(uint64_t size)
+{
+    return float(double(size) / (1024.0 * 1024.0));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool overlaps(uint32_t first_a, uint32_t last_a, uint32_t first_b, uint32_t last_b)
+{
+    return first_a <= last_b && first_b <= last_a;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TransientResourceAllocator::TransientResourceAllocator(std::weak_ptr<dw::vk::Backend> backend, DeletionQueue* deletion_queue) :
+    m_backend(backend), m_deletion_queue(deletion_queue)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TransientResourceAllocator::~TransientResourceAllocator()
+{
+    auto backend = m_backend.lock();
+
+    for (auto& entry : m_entries)
+        destroy_entry(entry);
+
+    m_entries.clear();
+
+    for (auto& block : m_blocks)
+    {
+        if (block.allocation)
+            vmaFreeMemory(backend->allocator(), block.allocation);
+    }
+
+    m_blocks.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::Image::Ptr TransientResourceAllocator::create_image(const std::string& name, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count)
+{
+    auto backend = m_backend.lock();
+
+    VkImageCreateInfo image_info;
+    DW_ZERO_MEMORY(image_info);
+
+    image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType     = type;
+    image_info.extent.width  = width;
+    image_info.extent.height = height;
+    image_info.extent.depth  = depth;
+    image_info.mipLevels     = mip_levels;
+    image_info.arrayLayers   = array_size;
+    image_info.format        = format;
+    image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage         = usage;
+    image_info.samples       = sample_count;
+    image_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+    Entry entry;
+
+    entry.name = name;
+
+    if (vkCreateImage(backend->device(), &image_info, nullptr, &entry.image) != VK_SUCCESS)
+    {
+        DW_LOG_ERROR("Failed to create transient image: " + name);
+        throw std::runtime_error("Failed to create transient image: " + name);
+    }
+
+    vkGetImageMemoryRequirements(backend->device(), entry.image, &entry.requirements);
+
+    VmaAllocationCreateInfo alloc_info;
+    DW_ZERO_MEMORY(alloc_info);
+
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    auto it = m_plan.find(name);
+
+    if (it != m_plan.end())
+    {
+        Block& block = m_blocks[it->second];
+
+        // Only use the planned block if the image still fits, otherwise it gets its own memory until the next plan.
+        if (entry.requirements.size <= block.size && entry.requirements.alignment <= block.alignment && (entry.requirements.memoryTypeBits & block.memory_type_bits) == block.memory_type_bits)
+        {
+            if (!block.allocation)
+            {
+                VkMemoryRequirements block_requirements;
+
+                block_requirements.size           = block.size;
+                block_requirements.alignment      = block.alignment;
+                block_requirements.memoryTypeBits = block.memory_type_bits;
+
+                if (vmaAllocateMemory(backend->allocator(), &block_requirements, &alloc_info, &block.allocation, nullptr) != VK_SUCCESS)
+                {
+                    DW_LOG_ERROR("Failed to allocate transient memory block");
+                    throw std::runtime_error("Failed to allocate transient memory block");
+                }
+            }
+
+            entry.block = it->second;
+            block.num_images++;
+        }
+    }
+
+    if (entry.block == -1)
+    {
+        if (vmaAllocateMemory(backend->allocator(), &entry.requirements, &alloc_info, &entry.allocation, nullptr) != VK_SUCCESS)
+        {
+            DW_LOG_ERROR("Failed to allocate memory for transient image: " + name);
+            throw std::runtime_error("Failed to allocate memory for transient image: " + name);
+        }
+    }
+
+    vmaBindImageMemory(backend->allocator(), entry.block == -1 ? entry.allocation : m_blocks[entry.block].allocation, entry.image);
+
+    dw::vk::Image::Ptr image = wrap_image(backend, entry.image, type, width, height, depth, mip_levels, array_size, format, usage, sample_count);
+    image->set_name(name);
+
+    entry.key     = image.get();
+    entry.wrapper = image;
+
+    m_entries.push_back(entry);
+
+    return image;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+dw::vk::Image::Ptr TransientResourceAllocator::wrap_image(dw::vk::Backend::Ptr backend, VkImage image, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count)
+{
+    // The swap chain factory is the only constructor of the framework that leaves the image and its memory alone when
+    // the wrapper is destroyed, nothing else about it is specific to swap chain images.
+    return dw::vk::Image::create_from_swapchain(backend, image, type, width, height, depth, mip_levels, array_size, format, VMA_MEMORY_USAGE_GPU_ONLY, usage, sample_count);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TransientResourceAllocator::declare_aliases(RenderGraph& graph)
+{
+    for (const auto& entry : m_entries)
+    {
+        if (entry.block != -1 && !entry.wrapper.expired())
+            graph.set_alias_group(entry.key, (uint32_t)entry.block);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TransientResourceAllocator::update(RenderGraph& graph, const std::string& configuration)
+{
+    collect();
+
+    m_requested_size = 0;
+    m_allocated_size = 0;
+
+    for (auto& entry : m_entries)
+    {
+        entry.used = graph.lifetime(entry.key, entry.first_pass, entry.last_pass);
+
+        m_requested_size += entry.requirements.size;
+
+        if (entry.block == -1)
+            m_allocated_size += entry.requirements.size;
+    }
+
+    for (const auto& block : m_blocks)
+    {
+        if (block.allocation)
+            m_allocated_size += block.size;
+    }
+
+    if (m_reports.find(configuration) == m_reports.end())
+        m_configurations.push_back(configuration);
+
+    Report& report = m_reports[configuration];
+
+    report.requested_size = m_requested_size;
+    report.allocated_size = m_allocated_size;
+
+    if (is_plan_valid())
+        return false;
+
+    plan();
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TransientResourceAllocator::collect()
+{
+    auto backend = m_backend.lock();
+
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->wrapper.expired())
+        {
+            Entry entry = *it;
+
+            m_deletion_queue->push_function([this, entry]() mutable {
+                destroy_entry(entry);
+            });
+
+            it = m_entries.erase(it);
+        }
+        else
+            it++;
+    }
+
+    for (auto& block : m_blocks)
+    {
+        if (block.allocation && block.num_images == 0)
+        {
+            vmaFreeMemory(backend->allocator(), block.allocation);
+            block.allocation = VK_NULL_HANDLE;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TransientResourceAllocator::gui()
+{
+    ImGui::Text("Transient Requested: %.2f MB", to_megabytes(m_requested_size));
+    ImGui::Text("Transient Allocated: %.2f MB", to_megabytes(m_allocated_size));
+    ImGui::Text("Transient Saved: %.2f MB", to_megabytes(m_requested_size - std::min(m_requested_size, m_allocated_size)));
+
+    if (ImGui::TreeNode("Transient Configurations"))
+    {
+        for (const auto& configuration : m_configurations)
+        {
+            const Report& report = m_reports[configuration];
+
+            ImGui::Text("%s: %.2f MB saved", configuration.c_str(), to_megabytes(report.requested_size - std::min(report.requested_size, report.allocated_size)));
+        }
+
+        ImGui::TreePop();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool TransientResourceAllocator::is_plan_valid()
+{
+    for (uint32_t i = 0; i < m_entries.size(); i++)
+    {
+        const Entry& a = m_entries[i];
+
+        if (a.block == -1)
+            return false;
+
+        if (!a.used)
+            continue;
+
+        for (uint32_t j = i + 1; j < m_entries.size(); j++)
+        {
+            const Entry& b = m_entries[j];
+
+            if (b.used && a.block == b.block && overlaps(a.first_pass, a.last_pass, b.first_pass, b.last_pass))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TransientResourceAllocator::plan()
+{
+    std::vector<uint32_t> order(m_entries.size());
+
+    for (uint32_t i = 0; i < m_entries.size(); i++)
+        order[i] = i;
+
+    // Placing the largest images first keeps the blocks close to the size of their biggest member.
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return m_entries[a].requirements.size > m_entries[b].requirements.size;
+    });
+
+    auto backend = m_backend.lock();
+
+    // Blocks stay alive until the images bound to them are destroyed, so the new plan can't touch those. Blocks
+    // without images are retired and get reused before any new one is added.
+    std::vector<uint32_t> free_blocks;
+
+    for (uint32_t i = 0; i < m_blocks.size(); i++)
+    {
+        Block& block = m_blocks[i];
+
+        if (block.num_images > 0)
+            continue;
+
+        if (block.allocation)
+            vmaFreeMemory(backend->allocator(), block.allocation);
+
+        block = Block();
+
+        free_blocks.push_back(i);
+    }
+
+    // Reused in ascending order, so that the retired blocks at the end of the list can be trimmed afterwards.
+    std::reverse(free_blocks.begin(), free_blocks.end());
+
+    std::vector<uint32_t>              block_indices;
+    std::vector<std::vector<uint32_t>> members;
+
+    m_plan.clear();
+
+    for (uint32_t entry_idx : order)
+    {
+        const Entry& entry = m_entries[entry_idx];
+        int32_t      found = -1;
+
+        for (uint32_t i = 0; i < members.size() && found == -1; i++)
+        {
+            const Block& block = m_blocks[block_indices[i]];
+
+            if ((block.memory_type_bits & entry.requirements.memoryTypeBits) == 0)
+                continue;
+
+            bool fits = true;
+
+            if (entry.used)
+            {
+                for (uint32_t member_idx : members[i])
+                {
+                    const Entry& member = m_entries[member_idx];
+
+                    if (member.used && overlaps(entry.first_pass, entry.last_pass, member.first_pass, member.last_pass))
+                    {
+                        fits = false;
+                        break;
+                    }
+                }
+            }
+
+            if (fits)
+                found = (int32_t)i;
+        }
+
+        if (found == -1)
+        {
+            if (free_blocks.size() > 0)
+            {
+                block_indices.push_back(free_blocks.back());
+                free_blocks.pop_back();
+            }
+            else
+            {
+                block_indices.push_back((uint32_t)m_blocks.size());
+                m_blocks.push_back(Block());
+            }
+
+            m_blocks[block_indices.back()].memory_type_bits = entry.requirements.memoryTypeBits;
+            members.push_back({});
+
+            found = (int32_t)members.size() - 1;
+        }
+
+        Block& block = m_blocks[block_indices[found]];
+
+        block.size      = std::max(block.size, entry.requirements.size);
+        block.alignment = std::max(block.alignment, entry.requirements.alignment);
+        block.memory_type_bits &= entry.requirements.memoryTypeBits;
+
+        members[found].push_back(entry_idx);
+
+        m_plan[entry.name] = block_indices[found];
+    }
+
+    // Images only refer to blocks by index, so only the unused tail of the list can be dropped.
+    while (m_blocks.size() > 0 && m_blocks.back().num_images == 0 && std::find(block_indices.begin(), block_indices.end(), (uint32_t)m_blocks.size() - 1) == block_indices.end())
+        m_blocks.pop_back();
+
+    uint64_t planned_size = 0;
+
+    for (uint32_t block_idx : block_indices)
+        planned_size += m_blocks[block_idx].size;
+
+    DW_LOG_INFO("Transient images: " + std::to_string(m_entries.size()) + " images in " + std::to_string(members.size()) + " blocks, " + std::to_string(to_megabytes(m_requested_size)) + " MB requested, " + std::to_string(to_megabytes(planned_size)) + " MB planned");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void TransientResourceAllocator::destroy_entry(Entry& entry)
+{
+    auto backend = m_backend.lock();
+
+    vkDestroyImage(backend->device(), entry.image, nullptr);
+
+    if (entry.block != -1)
+        m_blocks[entry.block].num_images--;
+    else
+        vmaFreeMemory(backend->allocator(), entry.allocation);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vk.h>
+#include <vk_mem_alloc.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "render_graph.h"
+#include "deletion_queue.h"
+
+// Creates images whose contents only have to survive part of a frame. Lifetimes are taken from the compiled
+// render graph and images that are never alive at the same time are bound to the same memory block. Images
+// are created with their own memory until a plan exists, and whenever the lifetimes stop matching the plan
+// a new one is made and the owners are asked to recreate their transient images. Images whose wrapper has been
+// released are destroyed through the deletion queue, so their memory stays valid for the frames still using it.
+class TransientResourceAllocator
+{
+public:
+    TransientResourceAllocator(std::weak_ptr<dw::vk::Backend> backend, DeletionQueue* deletion_queue);
+    ~TransientResourceAllocator();
+
+    dw::vk::Image::Ptr create_image(const std::string& name, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count);
+    void               declare_aliases(RenderGraph& graph);
+    bool               update(RenderGraph& graph, const std::string& configuration);
+    void               collect();
+    void               gui();
+
+    inline uint64_t requested_size() { return m_requested_size; }
+    inline uint64_t allocated_size() { return m_allocated_size; }
+
+private:
+    struct Block
+    {
+        VmaAllocation allocation       = VK_NULL_HANDLE;
+        VkDeviceSize  size             = 0;
+        VkDeviceSize  alignment        = 0;
+        uint32_t      memory_type_bits = 0;
+        uint32_t      num_images       = 0;
+    };
+
+    struct Entry
+    {
+        std::string                  name;
+        VkImage                      image = VK_NULL_HANDLE;
+        const dw::vk::Image*         key   = nullptr;
+        std::weak_ptr<dw::vk::Image> wrapper;
+        VkMemoryRequirements         requirements;
+        int32_t                      block      = -1;
+        VmaAllocation                allocation = VK_NULL_HANDLE;
+        bool                         used       = false;
+        uint32_t                     first_pass = 0;
+        uint32_t                     last_pass  = 0;
+    };
+
+    struct Report
+    {
+        uint64_t requested_size = 0;
+        uint64_t allocated_size = 0;
+    };
+
+    // Wraps an image bound to memory owned by the allocator. The wrapper never destroys the image, the allocator does
+    // once the wrapper has been released.
+    static dw::vk::Image::Ptr wrap_image(dw::vk::Backend::Ptr backend, VkImage image, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count);
+
+    bool is_plan_valid();
+    void plan();
+    void destroy_entry(Entry& entry);
+
+private:
+    std::weak_ptr<dw::vk::Backend>           m_backend;
+    DeletionQueue*                           m_deletion_queue;
+    std::vector<Entry>                       m_entries;
+    std::vector<Block>                       m_blocks;
+    std::unordered_map<std::string, int32_t> m_plan;
+    std::vector<std::string>                 m_configurations;
+    std::unordered_map<std::string, Report>  m_reports;
+    uint64_t                                 m_requested_size = 0;
+    uint64_t                                 m_allocated_size = 0;
+};
@@ -0,0 +1,98 @@
+#include "utility.h"
+#include <logger.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#    include <direct.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* const kCacheDirectory = "cache";
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void create_directory(const std::string& directory)
+{
+#if defined(_WIN32)
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double elapsed_milliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void create_cache_directory()
+{
+    create_directory(kCacheDirectory);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void create_parent_directory(const std::string& path)
+{
+    size_t separator = path.find_last_of("/\\");
+
+    if (separator != std::string::npos)
+        create_directory(path.substr(0, separator));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool write_file_atomic(const std::string& path, const std::string& description, std::function<void(std::ofstream&)> write)
+{
+    std::string temporary = path + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            DW_LOG_ERROR("Failed to write " + description + ": " + temporary);
+            return false;
+        }
+
+        write(file);
+
+        if (!file.good())
+        {
+            file.close();
+            remove(temporary.c_str());
+
+            DW_LOG_ERROR("Failed to write " + description + ": " + temporary);
+            return false;
+        }
+    }
+
+    // rename() replaces the destination atomically on POSIX, but fails on Windows if it exists.
+#if defined(_WIN32)
+    bool replaced = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool replaced = rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+
+    if (!replaced)
+    {
+        remove(temporary.c_str());
+
+        DW_LOG_ERROR("Failed to write " + description + ": " + path);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
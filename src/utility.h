@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+
+// Directory under the working directory that every baked or cached file is written to.
+extern const char* const kCacheDirectory;
+
+double elapsed_milliseconds(std::chrono::high_resolution_clock::time_point start);
+
+// Creates the cache directory if it does not exist yet.
+void create_cache_directory();
+
+// Creates the directory the file at the given path is in, if it does not exist yet. Only the last level is created.
+void create_parent_directory(const std::string& path);
+
+// Writes the file under a temporary name first and replaces the destination with it once complete, so an interrupted
+// write never leaves a truncated file behind and readers see either the old or the new contents. Fails if the stream
+// is no longer good after the callback, logging the error against the description.
+bool write_file_atomic(const std::string& path, const std::string& description, std::function<void(std::ofstream&)> write);
@@ -0,0 +1,290 @@
+#include "workgroup_tuner.h"
+#include "utility.h"
+#include <logger.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const WorkgroupSize kCandidates[] = {
+    { 8, 4 },
+    { 8, 8 },
+    { 16, 8 },
+    { 16, 16 },
+    { 32, 8 },
+    { 32, 16 },
+    { 32, 32 }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    return samples[samples.size() / 2];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static std::string to_string(WorkgroupSize size)
+{
+    return std::to_string(size.x) + "x" + std::to_string(size.y);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+WorkgroupTuner::WorkgroupTuner(dw::vk::Backend::Ptr backend, const std::string& path) :
+    m_path(path)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(backend->physical_device(), &properties);
+
+    m_vendor_id = properties.vendorID;
+    m_device_id = properties.deviceID;
+
+    for (const auto& candidate : kCandidates)
+    {
+        if (candidate.x <= properties.limits.maxComputeWorkGroupSize[0] && candidate.y <= properties.limits.maxComputeWorkGroupSize[1] && candidate.x * candidate.y <= properties.limits.maxComputeWorkGroupInvocations)
+            m_candidates.push_back(candidate);
+    }
+
+    read();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+WorkgroupSize WorkgroupTuner::add_pass(const std::string& name, WorkgroupSize default_size)
+{
+    Pass pass;
+
+    pass.name         = name;
+    pass.default_size = default_size;
+    pass.size         = default_size;
+
+    auto it = m_saved_sizes.find(name);
+
+    if (it != m_saved_sizes.end())
+        pass.size = it->second;
+
+    m_pass_indices[name] = (uint32_t)m_passes.size();
+    m_passes.push_back(pass);
+
+    return pass.size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+WorkgroupSize WorkgroupTuner::size(const std::string& name)
+{
+    auto it = m_pass_indices.find(name);
+
+    if (it == m_pass_indices.end())
+    {
+        DW_LOG_ERROR("Workgroup size requested for unregistered pass: " + name);
+        throw std::runtime_error("Workgroup size requested for unregistered pass: " + name);
+    }
+
+    if (tuning() && m_current_candidate >= 0)
+        return m_candidates[m_current_candidate];
+
+    return m_passes[it->second].size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WorkgroupTuner::start(uint32_t warmup_frames, uint32_t measured_frames)
+{
+    m_tuning            = true;
+    m_warmup_frames     = std::max(warmup_frames, (uint32_t)dw::vk::Backend::kMaxFramesInFlight);
+    m_measured_frames   = std::max(measured_frames, 1u);
+    m_frame             = 0;
+    m_current_candidate = -1;
+
+    for (auto& pass : m_passes)
+    {
+        pass.samples.clear();
+        pass.samples.resize(m_candidates.size());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool WorkgroupTuner::begin_frame()
+{
+    if (!tuning())
+        return false;
+
+    if (m_current_candidate == -1 || m_frame == m_warmup_frames + m_measured_frames)
+    {
+        m_current_candidate++;
+        m_frame = 0;
+
+        if (finished())
+        {
+            select();
+            write();
+
+            return false;
+        }
+
+        DW_LOG_INFO("Workgroup tuning " + std::to_string(m_current_candidate + 1) + "/" + std::to_string(m_candidates.size()) + ": " + to_string(m_candidates[m_current_candidate]));
+
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WorkgroupTuner::end_frame(const std::vector<RenderGraph::PassTiming>& timings)
+{
+    if (!tuning() || m_current_candidate < 0)
+        return;
+
+    // The first frames still report timings recorded with the previous candidate, along with the shader compilation.
+    if (m_frame++ < m_warmup_frames)
+        return;
+
+    for (const auto& timing : timings)
+    {
+        auto it = m_pass_indices.find(timing.name);
+
+        if (it != m_pass_indices.end())
+            m_passes[it->second].samples[m_current_candidate].push_back(timing.gpu_time);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WorkgroupTuner::select()
+{
+    for (auto& pass : m_passes)
+    {
+        int32_t best_candidate = -1;
+        double  best_time      = 0.0;
+        double  default_time   = 0.0;
+
+        for (uint32_t i = 0; i < m_candidates.size(); i++)
+        {
+            if (pass.samples[i].size() == 0)
+                continue;
+
+            double time = median(pass.samples[i]);
+
+            if (best_candidate == -1 || time < best_time)
+            {
+                best_candidate = i;
+                best_time      = time;
+            }
+
+            if (m_candidates[i].x == pass.default_size.x && m_candidates[i].y == pass.default_size.y)
+                default_time = time;
+        }
+
+        // Passes can be skipped by the current settings, e.g. upsampling at full resolution.
+        if (best_candidate == -1)
+        {
+            DW_LOG_INFO("Workgroup tuning: " + pass.name + " did not run, keeping " + to_string(pass.size));
+            continue;
+        }
+
+        pass.size = m_candidates[best_candidate];
+        m_saved_sizes[pass.name] = pass.size;
+
+        DW_LOG_INFO("Workgroup tuning: " + pass.name + " " + to_string(pass.size) + " (" + std::to_string(best_time) + " ms, " + to_string(pass.default_size) + " " + std::to_string(default_time) + " ms)");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WorkgroupTuner::read()
+{
+    std::ifstream file(m_path);
+
+    if (!file.is_open())
+        return;
+
+    // Every line holds the vendor ID, device ID, pass name, and the width and height of the workgroup separated by tabs.
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::vector<std::string> fields;
+        std::stringstream        stream(line);
+        std::string              field;
+
+        while (std::getline(stream, field, '\t'))
+            fields.push_back(field);
+
+        uint32_t      vendor_id = 0;
+        uint32_t      device_id = 0;
+        WorkgroupSize size      = { 0, 0 };
+
+        try
+        {
+            if (fields.size() != 5)
+                throw std::invalid_argument(line);
+
+            vendor_id = (uint32_t)std::stoul(fields[0]);
+            device_id = (uint32_t)std::stoul(fields[1]);
+            size.x    = (uint32_t)std::stoul(fields[3]);
+            size.y    = (uint32_t)std::stoul(fields[4]);
+        }
+        catch (const std::exception&)
+        {
+            DW_LOG_ERROR("Ignoring malformed line in " + m_path + ": " + line);
+            continue;
+        }
+
+        if (vendor_id != m_vendor_id || device_id != m_device_id)
+        {
+            m_foreign_lines.push_back(line);
+            continue;
+        }
+
+        auto it = std::find_if(m_candidates.begin(), m_candidates.end(), [&size](const WorkgroupSize& candidate) {
+            return candidate.x == size.x && candidate.y == size.y;
+        });
+
+        if (it == m_candidates.end())
+        {
+            DW_LOG_ERROR("Ignoring unsupported workgroup size in " + m_path + ": " + line);
+            continue;
+        }
+
+        m_saved_sizes[fields[2]] = size;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WorkgroupTuner::write()
+{
+    // A run interrupted while writing must not lose the sizes tuned on other GPUs.
+    bool written = write_file_atomic(m_path, "workgroup sizes", [&](std::ofstream& file) {
+        file << "# Written by --tune-workgroups: vendor ID, device ID, pass, workgroup width and height.\n";
+
+        for (const auto& line : m_foreign_lines)
+            file << line << "\n";
+
+        for (const auto& pass : m_passes)
+        {
+            auto it = m_saved_sizes.find(pass.name);
+
+            if (it != m_saved_sizes.end())
+                file << m_vendor_id << "\t" << m_device_id << "\t" << pass.name << "\t" << it->second.x << "\t" << it->second.y << "\n";
+        }
+    });
+
+    if (written)
+        DW_LOG_INFO("Workgroup sizes written to " + m_path);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vk.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "render_graph.h"
+
+struct WorkgroupSize
+{
+    uint32_t x;
+    uint32_t y;
+};
+
+// Picks the workgroup size of compute passes whose shaders take it as specialization constants 0 and 1. While tuning,
+// every candidate size the device supports is applied to all registered passes at once for a fixed number of frames,
+// and each pass keeps the candidate with the lowest median GPU time. The winners are saved to a config file under the
+// vendor and device ID of the GPU, and loaded on the next startup on the same device.
+class WorkgroupTuner
+{
+public:
+    WorkgroupTuner(dw::vk::Backend::Ptr backend, const std::string& path);
+
+    // Registers a pass under the name the render graph reports its GPU time with, e.g. "TAA/Resolve", and returns the
+    // size it starts out with. All passes have to be registered before the first frame.
+    WorkgroupSize add_pass(const std::string& name, WorkgroupSize default_size);
+
+    // Size the pass has to be dispatched with in the frame being recorded.
+    WorkgroupSize size(const std::string& name);
+
+    void start(uint32_t warmup_frames, uint32_t measured_frames);
+
+    // Has to be called at the start of every frame while tuning, returns true when the next candidate is applied.
+    bool begin_frame();
+    void end_frame(const std::vector<RenderGraph::PassTiming>& timings);
+
+    inline bool tuning() { return m_tuning && !finished(); }
+    inline bool finished() { return m_current_candidate >= (int32_t)m_candidates.size(); }
+
+private:
+    struct Pass
+    {
+        std::string                      name;
+        WorkgroupSize                    default_size;
+        WorkgroupSize                    size;
+        std::vector<std::vector<double>> samples; // GPU times of every candidate.
+    };
+
+    void select();
+    void read();
+    void write();
+
+private:
+    std::string                                    m_path;
+    uint32_t                                       m_vendor_id;
+    uint32_t                                       m_device_id;
+    bool                                           m_tuning            = false;
+    uint32_t                                       m_warmup_frames     = 0;
+    uint32_t                                       m_measured_frames   = 0;
+    uint32_t                                       m_frame             = 0;
+    int32_t                                        m_current_candidate = -1;
+    std::vector<WorkgroupSize>                     m_candidates;
+    std::vector<Pass>                              m_passes;
+    std::unordered_map<std::string, uint32_t>      m_pass_indices;
+    std::unordered_map<std::string, WorkgroupSize> m_saved_sizes;
+    std::vector<std::string>                       m_foreign_lines; // Entries of other devices, written back untouched.
+};
@@ -0,0 +1,662 @@
+#include "render_graph.h"
+#include <stdio.h>
+#include <stdexcept>
+#include <string>
+
+// Drives the barrier inference of the render graph on the CPU. The graph is created without a backend, so passes are
+// declared against fake handles and only compiled, the checks look at the barriers it would record for every pass.
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint32_t g_num_failures = 0;
+
+#define CHECK(condition)                                                            \
+    if (!(condition))                                                               \
+    {                                                                               \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);       \
+        g_num_failures++;                                                           \
+    }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static const VkImageSubresourceRange kMip0      = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+static const VkImageSubresourceRange kMip1      = { VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, 0, 1 };
+static const VkImageSubresourceRange kMip2      = { VK_IMAGE_ASPECT_COLOR_BIT, 2, 1, 0, 1 };
+static const VkImageSubresourceRange kMips1To2  = { VK_IMAGE_ASPECT_COLOR_BIT, 1, 2, 0, 1 };
+static const VkImageSubresourceRange kAllMips   = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 3, 0, 1 };
+static const VkImageSubresourceRange kAllLayers = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+
+// Distinct values, so that the objects the fake handles point to can't be folded into one.
+static const int kImageObject  = 1;
+static const int kOtherObject  = 2;
+static const int kBufferObject = 3;
+
+static const VkImage  kImage  = (VkImage)kImageObject;
+static const VkImage  kOther  = (VkImage)kOtherObject;
+static const VkBuffer kBuffer = (VkBuffer)&kBufferObject;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_range(const VkImageSubresourceRange& range, uint32_t base_mip, uint32_t num_mips, uint32_t base_layer, uint32_t num_layers)
+{
+    return range.baseMipLevel == base_mip && range.levelCount == num_mips && range.baseArrayLayer == base_layer && range.layerCount == num_layers;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static RenderGraph::RecordedBarriers recorded_barriers(RenderGraph& graph)
+{
+    RenderGraph::RecordedBarriers barriers;
+
+    for (uint32_t i = 0; i < graph.num_passes(); i++)
+        graph.pass_barriers(i, barriers);
+
+    return barriers;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void write_color(RenderGraph& graph, VkImage image, VkImageSubresourceRange range)
+{
+    graph.add_pass(
+        "Write",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, image, range);
+        },
+        nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_write_then_read()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+
+    graph.add_pass(
+        "Read",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 2);
+
+    if (barriers.images.size() != 2)
+        return;
+
+    CHECK(barriers.images[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(barriers.images[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(barriers.images[1].srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+    CHECK(barriers.images[1].srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    CHECK(barriers.images[1].dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    CHECK(barriers.images[1].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(barriers.images[1].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_widened_reads()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+
+    graph.add_pass(
+        "Compute Read",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+        },
+        nullptr);
+
+    graph.add_pass(
+        "Fragment Read",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    // The first read barrier covers the second reader too.
+    CHECK(barriers.images.size() == 2);
+
+    if (barriers.images.size() != 2)
+        return;
+
+    CHECK(barriers.images[1].dstStageMask == (VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_read_mip_write_next_mip()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+
+    graph.add_pass(
+        "Downsample",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, kMips1To2);
+        },
+        nullptr);
+
+    graph.add_pass(
+        "Read All Mips",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kAllMips);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    // One barrier for the write, two for the downsample and one for each of the two states the mips are left in.
+    CHECK(barriers.images.size() == 5);
+
+    if (barriers.images.size() != 5)
+        return;
+
+    CHECK(barriers.images[1].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(barriers.images[1].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(is_range(barriers.images[1].subresourceRange, 0, 1, 0, 1));
+
+    CHECK(barriers.images[2].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(barriers.images[2].newLayout == VK_IMAGE_LAYOUT_GENERAL);
+    CHECK(is_range(barriers.images[2].subresourceRange, 1, 2, 0, 1));
+
+    CHECK(barriers.images[3].oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(barriers.images[3].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    CHECK(barriers.images[3].dstStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+    CHECK(is_range(barriers.images[3].subresourceRange, 0, 1, 0, 1));
+
+    CHECK(barriers.images[4].oldLayout == VK_IMAGE_LAYOUT_GENERAL);
+    CHECK(barriers.images[4].srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+    CHECK(barriers.images[4].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(is_range(barriers.images[4].subresourceRange, 1, 2, 0, 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_mip_chain()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+
+    const VkImageSubresourceRange mips[] = { kMip0, kMip1, kMip2 };
+
+    // Every pass reads the mip written by the previous one, which is left in GENERAL.
+    for (uint32_t i = 1; i < 3; i++)
+    {
+        graph.add_pass(
+            "Mip " + std::to_string(i),
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, mips[i - 1]);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, mips[i]);
+            },
+            nullptr);
+    }
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 5);
+
+    if (barriers.images.size() != 5)
+        return;
+
+    CHECK(barriers.images[3].oldLayout == VK_IMAGE_LAYOUT_GENERAL);
+    CHECK(barriers.images[3].srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+    CHECK(is_range(barriers.images[3].subresourceRange, 1, 1, 0, 1));
+    CHECK(barriers.images[4].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(is_range(barriers.images[4].subresourceRange, 2, 1, 0, 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_array_layers()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    // Faces of a cubemap written one at a time end up in the same state, so a single barrier covers all of them.
+    for (uint32_t i = 0; i < 6; i++)
+        write_color(graph, kImage, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, i, 1 });
+
+    graph.add_pass(
+        "Read Cubemap",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kAllLayers);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 7);
+
+    if (barriers.images.size() != 7)
+        return;
+
+    CHECK(is_range(barriers.images[6].subresourceRange, 0, 1, 0, 6));
+    CHECK(barriers.images[6].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_folded_accesses()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    graph.add_pass(
+        "Read Write",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, kAllMips);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, kMip1);
+            builder.use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, kBuffer);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, kBuffer);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    // Overlapping accesses in the same layout and repeated buffer accesses get a single barrier each.
+    CHECK(barriers.images.size() == 1);
+    CHECK(barriers.buffers.size() == 1);
+
+    if (barriers.images.size() != 1 || barriers.buffers.size() != 1)
+        return;
+
+    CHECK(barriers.images[0].dstAccessMask == (VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT));
+    CHECK(is_range(barriers.images[0].subresourceRange, 0, 3, 0, 1));
+    CHECK(barriers.buffers[0].dstStageMask == (VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_conflicting_layouts()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    bool thrown = false;
+
+    try
+    {
+        graph.add_pass(
+            "Conflict",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kAllMips);
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, kMip2);
+            },
+            nullptr);
+    }
+    catch (std::runtime_error&)
+    {
+        thrown = true;
+    }
+
+    CHECK(thrown);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_independent_resources()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+    write_color(graph, kOther, kMip0);
+
+    graph.add_pass(
+        "Read Other",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kOther, kMip0);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 3);
+
+    if (barriers.images.size() != 3)
+        return;
+
+    CHECK(barriers.images[0].image == kImage);
+    CHECK(barriers.images[1].image == kOther);
+    CHECK(barriers.images[2].image == kOther);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_aliased_resources()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    graph.set_alias_group(kImage, 0);
+    graph.set_alias_group(kOther, 0);
+
+    write_color(graph, kImage, kMip0);
+    write_color(graph, kOther, kMip0);
+
+    graph.add_pass(
+        "Read Overwritten",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    // Taking the memory back discards whatever the image held, so it is transitioned from UNDEFINED again.
+    CHECK(graph.num_alias_barriers() == 2);
+    CHECK(barriers.images.size() == 3);
+
+    if (barriers.images.size() != 3)
+        return;
+
+    CHECK(barriers.images[2].image == kImage);
+    CHECK(barriers.images[2].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(barriers.images[2].srcAccessMask == VK_ACCESS_2_NONE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_buffer_barriers()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    graph.add_pass(
+        "Cull",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, kBuffer);
+        },
+        nullptr);
+
+    graph.add_pass(
+        "Draw",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, kBuffer);
+        },
+        nullptr);
+
+    graph.compile();
+
+    const auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 0);
+    CHECK(barriers.buffers.size() == 2);
+
+    if (barriers.buffers.size() != 2)
+        return;
+
+    CHECK(barriers.buffers[1].buffer == kBuffer);
+    CHECK(barriers.buffers[1].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    CHECK(barriers.buffers[1].srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+    CHECK(barriers.buffers[1].dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+    CHECK(barriers.buffers[1].dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+    CHECK(barriers.buffers[1].size == VK_WHOLE_SIZE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void read_color(RenderGraph& graph, VkImage image, VkImageSubresourceRange range)
+{
+    graph.add_pass(
+        "Read",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, image, range);
+        },
+        nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_state_across_frames()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    write_color(graph, kImage, kMip0);
+    graph.compile();
+
+    // The next frame picks the image up in the state the previous one left it in.
+    graph.reset();
+    read_color(graph, kImage, kMip0);
+    graph.compile();
+
+    auto barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 1);
+
+    if (barriers.images.size() == 1)
+    {
+        CHECK(barriers.images[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        CHECK(barriers.images[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        CHECK(barriers.images[0].srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        CHECK(barriers.images[0].srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    }
+
+    // Reading it again the same way needs no barrier at all.
+    graph.reset();
+    read_color(graph, kImage, kMip0);
+    graph.compile();
+
+    barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 0);
+
+    // A graph that was never compiled doesn't change the state carried over.
+    graph.reset();
+    write_color(graph, kImage, kMip0);
+    graph.reset();
+    write_color(graph, kImage, kMip0);
+    graph.compile();
+
+    barriers = recorded_barriers(graph);
+
+    CHECK(barriers.images.size() == 1);
+
+    if (barriers.images.size() == 1)
+        CHECK(barriers.images[0].oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Writes kImage on the graphics queue, reads it on async compute to write kOther, which is read on the graphics queue again.
+static void add_async_passes(RenderGraph& graph)
+{
+    write_color(graph, kImage, kMip0);
+
+    graph.add_pass(
+        "Async",
+        [&](RenderGraph::PassBuilder& builder) {
+            builder.set_queue(RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, kImage, kMip0);
+            builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kOther, kMip0);
+        },
+        nullptr);
+
+    read_color(graph, kOther, kMip0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_async_same_family()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    graph.simulate_async_compute(0, 0);
+
+    add_async_passes(graph);
+
+    graph.compile();
+
+    CHECK(graph.pass_queue(1) == RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+    CHECK(graph.num_async_batches() == 1);
+
+    if (graph.num_async_batches() != 1)
+        return;
+
+    // Queues of the same family share ownership, the semaphores alone order them.
+    RenderGraph::RecordedBarriers graphics_releases, acquires, releases, pass_acquires;
+
+    graph.batch_transfers(0, graphics_releases, acquires, releases);
+    graph.pass_acquires(2, pass_acquires);
+
+    CHECK(graphics_releases.images.size() == 0);
+    CHECK(acquires.images.size() == 0);
+    CHECK(releases.images.size() == 0);
+    CHECK(pass_acquires.images.size() == 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_async_cross_family()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    graph.simulate_async_compute(0, 1);
+
+    add_async_passes(graph);
+
+    graph.compile();
+
+    CHECK(graph.pass_queue(1) == RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+    CHECK(graph.num_async_batches() == 1);
+
+    if (graph.num_async_batches() != 1)
+        return;
+
+    RenderGraph::RecordedBarriers graphics_releases, acquires, releases, pass_acquires, barriers;
+
+    graph.batch_transfers(0, graphics_releases, acquires, releases);
+    graph.pass_acquires(2, pass_acquires);
+    graph.pass_barriers(2, barriers);
+
+    // The graphics queue transitions the image for the compute pass and releases it in that layout.
+    CHECK(graphics_releases.images.size() == 2);
+    CHECK(acquires.images.size() == 2);
+
+    if (graphics_releases.images.size() == 2 && acquires.images.size() == 2)
+    {
+        CHECK(graphics_releases.images[0].image == kImage);
+        CHECK(graphics_releases.images[0].srcQueueFamilyIndex == 0);
+        CHECK(graphics_releases.images[0].dstQueueFamilyIndex == 1);
+        CHECK(graphics_releases.images[0].oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        CHECK(graphics_releases.images[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        CHECK(acquires.images[0].image == kImage);
+        CHECK(acquires.images[0].srcQueueFamilyIndex == 0);
+        CHECK(acquires.images[0].dstQueueFamilyIndex == 1);
+        CHECK(acquires.images[0].dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    }
+
+    // The written image goes back for the graphics pass reading it, the other one at the end of the frame.
+    CHECK(releases.images.size() == 2);
+    CHECK(pass_acquires.images.size() == 1);
+
+    if (releases.images.size() == 2 && pass_acquires.images.size() == 1)
+    {
+        CHECK(releases.images[0].image == kOther);
+        CHECK(releases.images[0].srcQueueFamilyIndex == 1);
+        CHECK(releases.images[0].dstQueueFamilyIndex == 0);
+        CHECK(releases.images[0].oldLayout == VK_IMAGE_LAYOUT_GENERAL);
+        CHECK(releases.images[1].image == kImage);
+        CHECK(pass_acquires.images[0].image == kOther);
+        CHECK(pass_acquires.images[0].srcQueueFamilyIndex == 1);
+        CHECK(pass_acquires.images[0].dstQueueFamilyIndex == 0);
+        CHECK(pass_acquires.images[0].newLayout == VK_IMAGE_LAYOUT_GENERAL);
+    }
+
+    // The transition for the graphics pass follows the acquire.
+    CHECK(barriers.images.size() == 1);
+
+    if (barriers.images.size() == 1)
+    {
+        CHECK(barriers.images[0].oldLayout == VK_IMAGE_LAYOUT_GENERAL);
+        CHECK(barriers.images[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        CHECK(barriers.images[0].srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void test_untracked_resources()
+{
+    RenderGraph graph((std::weak_ptr<dw::vk::Backend>()));
+
+    auto add_untracked_pass = [&]() {
+        graph.add_pass(
+            "Ray Trace",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.set_queue(RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+                builder.bind_untracked_resources();
+                builder.use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, kImage, kMip0);
+            },
+            nullptr);
+    };
+
+    // Resources the graph doesn't know about can't be transferred to another family.
+    graph.simulate_async_compute(0, 1);
+    add_untracked_pass();
+    graph.compile();
+
+    CHECK(graph.pass_queue(0) == RenderGraph::QUEUE_TYPE_GRAPHICS);
+    CHECK(graph.num_async_batches() == 0);
+
+    graph.reset();
+    graph.simulate_async_compute(0, 0);
+    add_untracked_pass();
+    graph.compile();
+
+    CHECK(graph.pass_queue(0) == RenderGraph::QUEUE_TYPE_ASYNC_COMPUTE);
+    CHECK(graph.num_async_batches() == 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+    test_write_then_read();
+    test_widened_reads();
+    test_read_mip_write_next_mip();
+    test_mip_chain();
+    test_array_layers();
+    test_folded_accesses();
+    test_conflicting_layouts();
+    test_independent_resources();
+    test_aliased_resources();
+    test_buffer_barriers();
+    test_state_across_frames();
+    test_async_same_family();
+    test_async_cross_family();
+    test_untracked_resources();
+
+    if (g_num_failures > 0)
+    {
+        printf("%u render graph checks failed\n", g_num_failures);
+        return 1;
+    }
+
+    printf("All render graph checks passed\n");
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------